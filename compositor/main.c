@@ -73,6 +73,7 @@
 #define WINDOW_TITLE "Weston Compositor"
 /* flight recorder size (in bytes) */
 #define DEFAULT_FLIGHT_REC_SIZE (5 * 1024 * 1024)
+#define DEFAULT_LOG_ASYNC_QUEUE_SIZE (1024 * 1024)
 #define DEFAULT_FLIGHT_REC_SCOPES "log,drm-backend"
 
 struct wet_output_config {
@@ -701,6 +702,9 @@ usage(int error_code)
 #endif
 		"  --modules\t\tLoad the comma-separated list of modules\n"
 		"  --log=FILE\t\tLog to the given file\n"
+		"  --log-async=drop|block\n\t\t\tWrite the log and debug streams "
+			"from a thread,\n\t\t\tdropping or waiting when "
+			"behind\n"
 		"  -c, --config=FILE\tConfig file to load, defaults to weston.ini\n"
 		"  --no-config\t\tDo not read weston.ini\n"
 		"  --wait-for-debugger\tRaise SIGSTOP on start-up\n"
@@ -711,6 +715,11 @@ usage(int error_code)
 		"  -f, --flight-rec-scopes=SCOPE\n\t\t\tSpecify log scopes to "
 			"subscribe to.\n\t\t\tCan specify multiple scopes, "
 			"each followed by comma\n"
+		"  --flight-rec-file=FILE\n\t\t\tKeep the flight recorder in FILE, "
+			"where it\n\t\t\tsurvives a crash. See "
+			"tools/flight-rec-decode.py\n"
+		"  --timeline-trace=FILE\n\t\t\tWrite the timeline to FILE in "
+			"binary form.\n\t\t\tSee tools/timeline-trace-to-json.py\n"
 		"  -h, --help\t\tThis help message\n\n");
 
 #if defined(BUILD_DRM_COMPOSITOR)
@@ -737,6 +746,15 @@ usage(int error_code)
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (deprecated alias for --renderer=pixman)\n"
 		"  --use-gl\t\tUse the GL renderer (deprecated alias for --renderer=gl)\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
+		"  --refresh-rate=RATE\tRefresh rate of the outputs in mHz\n"
+		"  --pacing=MODE\t\tWhen outputs finish frames, MODE is one of:\n"
+		"\t\t\t\tfixed (on a virtual vblank, default),\n"
+		"\t\t\t\tasap (right after rendering),\n"
+		"\t\t\t\tvrr (variable refresh rate emulation)\n"
+		"  --vrr-min-rate=RATE\tLowest refresh rate in mHz for vrr pacing\n"
+		"  --gl-dmabuf\t\tRender GL outputs into dmabufs instead of pbuffers\n"
+		"  --render-node=PATH\tAllocate the dmabufs with GBM on this DRM\n"
+		"\t\t\t\trender node instead of udmabuf, implies --gl-dmabuf\n"
 		"\n");
 #endif
 
@@ -954,6 +972,20 @@ wet_load_module(struct weston_compositor *compositor,
 	return 0;
 }
 
+static char *
+wet_get_shell_module_name(const char *name)
+{
+	char *module;
+
+	if (strstr(name, "-shell.so"))
+		module = strdup(name);
+	else
+		str_printf(&module, "%s-shell.so", name);
+	assert(module);
+
+	return module;
+}
+
 static int
 wet_load_shell(struct weston_compositor *compositor,
 	       const char *_name, int *argc, char *argv[])
@@ -962,12 +994,7 @@ wet_load_shell(struct weston_compositor *compositor,
 	int (*shell_init)(struct weston_compositor *ec,
 			  int *argc, char *argv[]);
 
-	if (strstr(_name, "-shell.so"))
-		name = strdup(_name);
-	else
-		str_printf(&name, "%s-shell.so", _name);
-	assert(name);
-
+	name = wet_get_shell_module_name(_name);
 	shell_init = weston_load_module(name, "wet_shell_init", MODULEDIR);
 	free(name);
 
@@ -978,6 +1005,15 @@ wet_load_shell(struct weston_compositor *compositor,
 	return 0;
 }
 
+static void
+wet_startup_preload_shell(struct wet_startup *startup, const char *shell)
+{
+	char *name = wet_get_shell_module_name(shell);
+
+	wet_startup_preload(startup, name, MODULEDIR);
+	free(name);
+}
+
 static char *
 wet_get_binary_path(const char *name, const char *dir)
 {
@@ -1041,6 +1077,29 @@ load_modules(struct weston_compositor *ec, const char *modules,
 	return 0;
 }
 
+static void
+wet_startup_preload_modules(struct wet_startup *startup, const char *modules)
+{
+	const char *p, *end;
+	char buffer[256];
+
+	if (modules == NULL)
+		return;
+
+	p = modules;
+	while (*p) {
+		end = strchrnul(p, ',');
+		snprintf(buffer, sizeof buffer, "%.*s", (int) (end - p), p);
+
+		if (buffer[0] && !strstr(buffer, "xwayland.so"))
+			wet_startup_preload(startup, buffer, MODULEDIR);
+
+		p = end;
+		while (*p == ',')
+			p++;
+	}
+}
+
 static int
 save_touch_device_calibration(struct weston_compositor *compositor,
 			      struct weston_touch_device *device,
@@ -1107,6 +1166,7 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	uint32_t clipboard_max_size;
 	bool color_management;
 	bool cal;
 
@@ -1147,6 +1207,17 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_uint(s, "clipboard-max-size",
+				       &clipboard_max_size, 0);
+	ec->clipboard_max_size = clipboard_max_size;
+
+	weston_config_section_get_string(s, "shader-cache-dir",
+					 &ec->shader_cache_dir, NULL);
+	weston_config_section_get_bool(s, "shader-cache-prewarm",
+				       &ec->shader_cache_prewarm, false);
+	weston_config_section_get_bool(s, "late-latch", &ec->late_latch,
+				       false);
+
 	weston_config_section_get_bool(s, "color-management",
 				       &color_management, false);
 	if (color_management) {
@@ -2093,6 +2164,7 @@ drm_backend_output_configure(struct weston_output *output,
 	char *modeline = NULL;
 	char *gbm_format = NULL;
 	char *content_type = NULL;
+	char *vrr_mode = NULL;
 	char *seat = NULL;
 
 	api = weston_drm_output_get_api(output->compositor);
@@ -2155,6 +2227,22 @@ drm_backend_output_configure(struct weston_output *output,
 		return -1;
 	free(content_type);
 
+	weston_config_section_get_string(section,
+					 "vrr-mode", &vrr_mode, "never");
+	if (strcmp(vrr_mode, "never") == 0) {
+		api->set_vrr_mode(output, WESTON_DRM_VRR_MODE_NEVER);
+	} else if (strcmp(vrr_mode, "fullscreen") == 0) {
+		api->set_vrr_mode(output, WESTON_DRM_VRR_MODE_FULLSCREEN);
+	} else if (strcmp(vrr_mode, "always") == 0) {
+		api->set_vrr_mode(output, WESTON_DRM_VRR_MODE_ALWAYS);
+	} else {
+		weston_log("Error: unknown vrr-mode for output %s: \"%s\"\n",
+			   output->name, vrr_mode);
+		free(vrr_mode);
+		return -1;
+	}
+	free(vrr_mode);
+
 	weston_config_section_get_string(section, "seat", &seat, "");
 
 	api->set_seat(output, seat);
@@ -3011,6 +3099,10 @@ load_drm_backend(struct weston_compositor *c, int *argc, char **argv,
 	                               &config.pageflip_timeout, 0);
 	weston_config_section_get_bool(section, "pixman-shadow",
 				       &config.use_pixman_shadow, true);
+	weston_config_section_get_bool(section, "seamless-takeover",
+				       &config.seamless_takeover, false);
+	weston_config_section_get_bool(section, "shm-scanout",
+				       &config.shm_scanout, false);
 	if (without_input)
 		c->require_input = !without_input;
 
@@ -3078,6 +3170,8 @@ load_headless_backend(struct weston_compositor *c,
 	bool no_outputs = false;
 	int ret = 0;
 	char *transform = NULL;
+	char *pacing = NULL;
+	char *render_node = NULL;
 
 	struct wet_output_config *parsed_options = wet_init_parsed_options(c);
 	if (!parsed_options)
@@ -3099,10 +3193,30 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &force_gl },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
+		{ WESTON_OPTION_INTEGER, "refresh-rate", 0, &config.refresh },
+		{ WESTON_OPTION_STRING, "pacing", 0, &pacing },
+		{ WESTON_OPTION_INTEGER, "vrr-min-rate", 0, &config.vrr_min_refresh },
+		{ WESTON_OPTION_BOOLEAN, "gl-dmabuf", 0, &config.gl_dmabuf },
+		{ WESTON_OPTION_STRING, "render-node", 0, &render_node },
 	};
 
 	parse_options(options, ARRAY_LENGTH(options), argc, argv);
 
+	if (pacing) {
+		if (strcmp(pacing, "fixed") == 0) {
+			config.pacing = WESTON_HEADLESS_PACING_FIXED;
+		} else if (strcmp(pacing, "asap") == 0) {
+			config.pacing = WESTON_HEADLESS_PACING_ASAP;
+		} else if (strcmp(pacing, "vrr") == 0) {
+			config.pacing = WESTON_HEADLESS_PACING_VRR;
+		} else {
+			weston_log("Invalid pacing \"%s\"\n", pacing);
+			free(pacing);
+			return -1;
+		}
+		free(pacing);
+	}
+
 	if ((force_pixman && force_gl) ||
 	    (renderer != WESTON_RENDERER_AUTO && (force_pixman || force_gl))) {
 		weston_log("Conflicting renderer specifications\n");
@@ -3123,6 +3237,11 @@ load_headless_backend(struct weston_compositor *c,
 		free(transform);
 	}
 
+	if (render_node) {
+		config.render_node = render_node;
+		config.gl_dmabuf = true;
+	}
+
 	config.base.struct_version = WESTON_HEADLESS_BACKEND_CONFIG_VERSION;
 	config.base.struct_size = sizeof(struct weston_headless_backend_config);
 
@@ -3131,6 +3250,7 @@ load_headless_backend(struct weston_compositor *c,
 	/* load the actual wayland backend and configure it */
 	ret = weston_compositor_load_backend(c, WESTON_BACKEND_HEADLESS,
 					     &config.base);
+	free(render_node);
 
 	if (ret < 0)
 		return ret;
@@ -3956,6 +4076,12 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	char *log = NULL;
 	char *log_scopes = NULL;
 	char *flight_rec_scopes = NULL;
+	char *timeline_trace = NULL;
+	char *flight_rec_file = NULL;
+	char *log_async = NULL;
+	struct wet_startup *startup = NULL;
+	bool staged_startup;
+	enum weston_log_overflow log_overflow = WESTON_LOG_OVERFLOW_DROP_OLDEST;
 	char *server_socket = NULL;
 	int32_t idle_time = -1;
 	int32_t help = 0;
@@ -3974,6 +4100,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	struct weston_log_context *log_ctx = NULL;
 	struct weston_log_subscriber *logger = NULL;
 	struct weston_log_subscriber *flight_rec = NULL;
+	struct weston_log_subscriber *tl_trace = NULL;
 	sigset_t mask;
 	struct sigaction action;
 
@@ -3991,6 +4118,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 #endif
 		{ WESTON_OPTION_STRING, "modules", 0, &option_modules },
 		{ WESTON_OPTION_STRING, "log", 0, &log },
+		{ WESTON_OPTION_STRING, "log-async", 0, &log_async },
 		{ WESTON_OPTION_BOOLEAN, "help", 'h', &help },
 		{ WESTON_OPTION_BOOLEAN, "version", 0, &version },
 		{ WESTON_OPTION_BOOLEAN, "no-config", 0, &noconfig },
@@ -3999,6 +4127,8 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 		{ WESTON_OPTION_BOOLEAN, "debug", 0, &debug_protocol },
 		{ WESTON_OPTION_STRING, "logger-scopes", 'l', &log_scopes },
 		{ WESTON_OPTION_STRING, "flight-rec-scopes", 'f', &flight_rec_scopes },
+		{ WESTON_OPTION_STRING, "flight-rec-file", 0, &flight_rec_file },
+		{ WESTON_OPTION_STRING, "timeline-trace", 0, &timeline_trace },
 	};
 
 	wl_list_init(&wet.layoutput_list);
@@ -4020,6 +4150,19 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 		return EXIT_SUCCESS;
 	}
 
+	if (log_async) {
+		if (strcmp(log_async, "drop") == 0) {
+			log_overflow = WESTON_LOG_OVERFLOW_DROP_OLDEST;
+		} else if (strcmp(log_async, "block") == 0) {
+			log_overflow = WESTON_LOG_OVERFLOW_BLOCK;
+		} else {
+			fprintf(stderr, "Invalid --log-async policy '%s', "
+				"expected 'drop' or 'block'.\n", log_async);
+			free(cmdline);
+			return EXIT_FAILURE;
+		}
+	}
+
 	log_ctx = weston_log_ctx_create();
 	if (!log_ctx) {
 		fprintf(stderr, "Failed to initialize weston debug framework.\n");
@@ -4034,17 +4177,44 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
 	weston_log_set_handler(vlog, vlog_continue);
 
-	logger = weston_log_subscriber_create_log(weston_logfile);
+	startup = wet_startup_create();
+
+	if (log_async) {
+		weston_log_ctx_set_stream_async(log_ctx,
+						DEFAULT_LOG_ASYNC_QUEUE_SIZE,
+						log_overflow);
+		logger = weston_log_subscriber_create_log_async(weston_logfile,
+								DEFAULT_LOG_ASYNC_QUEUE_SIZE,
+								log_overflow);
+	}
+	if (!logger)
+		logger = weston_log_subscriber_create_log(weston_logfile);
 
 	if (!flight_rec_scopes)
 		flight_rec_scopes = DEFAULT_FLIGHT_REC_SCOPES;
 
-	if (flight_rec_scopes && strlen(flight_rec_scopes) > 0)
-		flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	if (flight_rec_scopes && strlen(flight_rec_scopes) > 0) {
+		if (flight_rec_file) {
+			flight_rec = weston_log_subscriber_create_flight_rec_mapped(flight_rec_file,
+										    DEFAULT_FLIGHT_REC_SIZE);
+			if (!flight_rec)
+				fprintf(stderr, "Failed to create flight recorder "
+					"file %s: %s\n", flight_rec_file,
+					strerror(errno));
+		}
+		if (!flight_rec)
+			flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	}
 
 	weston_log_subscribe_to_scopes(log_ctx, logger, flight_rec,
 				       log_scopes, flight_rec_scopes);
 
+	if (timeline_trace) {
+		tl_trace = weston_log_subscriber_create_timeline_trace(timeline_trace);
+		if (tl_trace)
+			weston_log_subscribe(log_ctx, tl_trace, "timeline");
+	}
+
 	weston_log("%s\n"
 		   STAMP_SPACE "%s\n"
 		   STAMP_SPACE "Bug reports to: %s\n"
@@ -4057,6 +4227,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 
 	weston_log("Flight recorder: %s\n", flight_rec ? "enabled" : "disabled");
 	verify_xdg_runtime_dir();
+	wet_startup_stage(startup, "log");
 
 	display = wl_display_create();
 	if (display == NULL) {
@@ -4129,6 +4300,31 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 			backend = weston_choose_default_backend();
 	}
 
+	if (!shell)
+		weston_config_section_get_string(section, "shell", &shell,
+						 "desktop");
+
+	if (!xwayland) {
+		weston_config_section_get_bool(section, "xwayland", &xwayland,
+					       false);
+	}
+
+	weston_config_section_get_string(section, "modules", &modules, "");
+
+	wet_startup_stage(startup, "config");
+
+	weston_config_section_get_bool(section, "staged-startup",
+				       &staged_startup, false);
+	if (staged_startup) {
+		wet_startup_preload_shell(startup, shell);
+		if (xwayland)
+			wet_startup_preload(startup, "xwayland.so",
+					    LIBWESTON_MODULEDIR);
+		wet_startup_preload_modules(startup, modules);
+		wet_startup_preload_modules(startup, option_modules);
+		wet_startup_preload_start(startup);
+	}
+
 	wet.compositor = weston_compositor_create(display, log_ctx, &wet, test_data);
 	if (wet.compositor == NULL) {
 		weston_log("fatal: failed to create compositor\n");
@@ -4162,6 +4358,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 				       &wet.compositor->require_input, true);
 
 	wet_set_environment_variables(wet.compositor);
+	wet_startup_stage(startup, "compositor");
 
 	if (load_backend(wet.compositor, backend, &argc, argv, config,
 			 renderer) < 0) {
@@ -4178,6 +4375,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	weston_compositor_flush_heads_changed(wet.compositor);
 	if (wet.init_failed)
 		goto out;
+	wet_startup_stage(startup, "backend");
 
 	if (idle_time < 0)
 		weston_config_section_get_int(section, "idle-time", &idle_time, -1);
@@ -4213,33 +4411,28 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	} else if (weston_create_listening_socket(display, socket_name)) {
 		goto out;
 	}
-
-	if (!shell)
-		weston_config_section_get_string(section, "shell", &shell,
-						 "desktop");
+	wet_startup_stage(startup, "socket");
 
 	if (wet_load_shell(wet.compositor, shell, &argc, argv) < 0)
 		goto out;
+	wet_startup_stage(startup, "shell");
 
 	/* Load xwayland before other modules - this way if we're using
 	 * the systemd-notify module it will notify after we're ready
 	 * to receive xwayland connections.
 	 */
-	if (!xwayland) {
-		weston_config_section_get_bool(section, "xwayland", &xwayland,
-					       false);
-	}
 	if (xwayland) {
 		if (wet_load_xwayland(wet.compositor) < 0)
 			goto out;
+		wet_startup_stage(startup, "xwayland");
 	}
 
-	weston_config_section_get_string(section, "modules", &modules, "");
 	if (load_modules(wet.compositor, modules, &argc, argv) < 0)
 		goto out;
 
 	if (load_modules(wet.compositor, option_modules, &argc, argv) < 0)
 		goto out;
+	wet_startup_stage(startup, "modules");
 
 	section = weston_config_get_section(config, "keyboard", NULL, NULL);
 	weston_config_section_get_bool(section, "numlock-on", &numlock_on, false);
@@ -4260,6 +4453,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	if (argc > 1)
 		goto out;
 
+	wet_startup_finish(startup, wet.compositor);
 	weston_compositor_wake(wet.compositor);
 
 	if (execute_autolaunch(&wet, config) < 0)
@@ -4295,11 +4489,15 @@ out_signals:
 	wl_display_destroy(display);
 
 out_display:
+	if (startup)
+		wet_startup_destroy(startup);
 	weston_log_scope_destroy(log_scope);
 	log_scope = NULL;
 	weston_log_subscriber_destroy(logger);
 	if (flight_rec)
 		weston_log_subscriber_destroy(flight_rec);
+	if (tl_trace)
+		weston_log_subscriber_destroy(tl_trace);
 	weston_log_ctx_destroy(log_ctx);
 	weston_log_file_close();
 
@@ -4313,6 +4511,9 @@ out_display:
 	free(option_modules);
 	free(log);
 	free(log_scopes);
+	free(timeline_trace);
+	free(flight_rec_file);
+	free(log_async);
 	free(modules);
 
 	return ret;
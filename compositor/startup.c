@@ -0,0 +1,291 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libweston/libweston.h>
+#include "weston-private.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+
+/*
+ * Startup timeline and module preloading
+ *
+ * The frontend marks the end of each startup stage, and the time each took
+ * is logged once the compositor is ready, followed by the time to the
+ * first rendered frame.
+ *
+ * In staged startup mode, the shell, Xwayland and plugin modules are
+ * dlopen()ed by a separate thread while the main thread creates the
+ * compositor and initializes the backend, which mostly waits for the
+ * kernel and the GPU driver. When the main thread gets to a module, it
+ * finds it already loaded and only has to run its init function. The
+ * libweston objects themselves are still only touched by the main thread.
+ */
+
+#define STAGES_MAX 16
+#define PRELOAD_MAX 16
+
+struct wet_startup_stage {
+	const char *name;
+	struct timespec end;
+};
+
+struct wet_startup_frame_listener {
+	struct wl_listener frame;
+	struct wl_listener destroy;
+	struct wet_startup *startup;
+	struct wl_list link;	/**< wet_startup::frame_listener_list */
+};
+
+struct wet_startup {
+	struct timespec start;
+	struct wet_startup_stage stages[STAGES_MAX];
+	int stage_count;
+
+	char *preload_paths[PRELOAD_MAX];
+	void *preload_handles[PRELOAD_MAX];
+	int preload_count;
+	pthread_t preload_thread;
+	bool preload_running;
+
+	struct wl_list frame_listener_list;
+};
+
+/** Start timing the compositor startup
+ *
+ * The time is counted from the call to this function.
+ */
+struct wet_startup *
+wet_startup_create(void)
+{
+	struct wet_startup *startup;
+
+	startup = xzalloc(sizeof *startup);
+	clock_gettime(CLOCK_MONOTONIC, &startup->start);
+	wl_list_init(&startup->frame_listener_list);
+
+	return startup;
+}
+
+/** Mark the end of a startup stage
+ *
+ * \param name A static string naming the stage that has just finished,
+ * which began where the previous stage ended.
+ */
+void
+wet_startup_stage(struct wet_startup *startup, const char *name)
+{
+	struct wet_startup_stage *stage;
+
+	if (startup->stage_count == STAGES_MAX)
+		return;
+
+	stage = &startup->stages[startup->stage_count++];
+	stage->name = name;
+	clock_gettime(CLOCK_MONOTONIC, &stage->end);
+}
+
+/** Queue a module to be loaded by the preload thread
+ *
+ * \param name The module file name, resolved like weston_load_module() does.
+ * \param module_dir The directory of the module.
+ *
+ * Must be called before wet_startup_preload_start().
+ */
+void
+wet_startup_preload(struct wet_startup *startup,
+		    const char *name, const char *module_dir)
+{
+	char path[PATH_MAX];
+	size_t len;
+
+	if (startup->preload_running || startup->preload_count == PRELOAD_MAX)
+		return;
+
+	if (name[0] == '/') {
+		len = snprintf(path, sizeof path, "%s", name);
+	} else {
+		len = weston_module_path_from_env(name, path, sizeof path);
+		if (len == 0)
+			len = snprintf(path, sizeof path, "%s/%s",
+				       module_dir, name);
+	}
+
+	if (len >= sizeof path)
+		return;
+
+	startup->preload_paths[startup->preload_count++] = xstrdup(path);
+}
+
+static void *
+preload_thread(void *data)
+{
+	struct wet_startup *startup = data;
+	int i;
+
+	/* Failures are left for the main thread to report when it loads
+	 * the module itself. */
+	for (i = 0; i < startup->preload_count; i++)
+		startup->preload_handles[i] =
+			dlopen(startup->preload_paths[i], RTLD_NOW);
+
+	return NULL;
+}
+
+/** Start loading the queued modules in a separate thread */
+void
+wet_startup_preload_start(struct wet_startup *startup)
+{
+	if (startup->preload_count == 0 || startup->preload_running)
+		return;
+
+	if (pthread_create(&startup->preload_thread, NULL,
+			   preload_thread, startup) != 0) {
+		weston_log("Failed to start the module preload thread\n");
+		return;
+	}
+
+	startup->preload_running = true;
+}
+
+/* The modules have been loaded by the main thread by now, or have failed
+ * to. Either way the preload references are no longer needed. */
+static void
+wet_startup_preload_finish(struct wet_startup *startup)
+{
+	int i;
+
+	if (startup->preload_running)
+		pthread_join(startup->preload_thread, NULL);
+	startup->preload_running = false;
+
+	for (i = 0; i < startup->preload_count; i++) {
+		if (startup->preload_handles[i])
+			dlclose(startup->preload_handles[i]);
+		startup->preload_handles[i] = NULL;
+		free(startup->preload_paths[i]);
+	}
+	startup->preload_count = 0;
+}
+
+static void
+frame_listener_destroy(struct wet_startup_frame_listener *fl)
+{
+	wl_list_remove(&fl->frame.link);
+	wl_list_remove(&fl->destroy.link);
+	wl_list_remove(&fl->link);
+	free(fl);
+}
+
+static void
+frame_listener_destroy_all(struct wet_startup *startup)
+{
+	struct wet_startup_frame_listener *fl, *tmp;
+
+	wl_list_for_each_safe(fl, tmp, &startup->frame_listener_list, link)
+		frame_listener_destroy(fl);
+}
+
+static void
+handle_first_frame(struct wl_listener *listener, void *data)
+{
+	struct wet_startup_frame_listener *fl =
+		container_of(listener, struct wet_startup_frame_listener, frame);
+	struct wet_startup *startup = fl->startup;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	weston_log("Startup: first frame after %.1f ms\n",
+		   timespec_sub_to_nsec(&now, &startup->start) / 1e6);
+
+	frame_listener_destroy_all(startup);
+}
+
+static void
+handle_output_destroy(struct wl_listener *listener, void *data)
+{
+	struct wet_startup_frame_listener *fl =
+		container_of(listener, struct wet_startup_frame_listener,
+			     destroy);
+
+	frame_listener_destroy(fl);
+}
+
+/** Log the startup timeline
+ *
+ * Called when the compositor is ready to run. Logs the time taken by each
+ * stage, and later the time to the first frame rendered on any output.
+ */
+void
+wet_startup_finish(struct wet_startup *startup,
+		   struct weston_compositor *compositor)
+{
+	struct wet_startup_frame_listener *fl;
+	struct weston_output *output;
+	const struct timespec *prev = &startup->start;
+	int i;
+
+	wet_startup_preload_finish(startup);
+
+	weston_log("Startup timeline:\n");
+	for (i = 0; i < startup->stage_count; i++) {
+		struct wet_startup_stage *stage = &startup->stages[i];
+
+		weston_log_continue(STAMP_SPACE "%-12s %8.1f ms %8.1f ms\n",
+				    stage->name,
+				    timespec_sub_to_nsec(&stage->end, prev) / 1e6,
+				    timespec_sub_to_nsec(&stage->end,
+							 &startup->start) / 1e6);
+		prev = &stage->end;
+	}
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		fl = xzalloc(sizeof *fl);
+		fl->startup = startup;
+		fl->frame.notify = handle_first_frame;
+		wl_signal_add(&output->frame_signal, &fl->frame);
+		fl->destroy.notify = handle_output_destroy;
+		wl_signal_add(&output->destroy_signal, &fl->destroy);
+		wl_list_insert(&startup->frame_listener_list, &fl->link);
+	}
+}
+
+void
+wet_startup_destroy(struct wet_startup *startup)
+{
+	wet_startup_preload_finish(startup);
+	frame_listener_destroy_all(startup);
+	free(startup);
+}
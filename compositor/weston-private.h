@@ -40,3 +40,25 @@ int
 wet_output_set_color_characteristics(struct weston_output *output,
 				     struct weston_config *wc,
 				     struct weston_config_section *section);
+
+struct wet_startup;
+
+struct wet_startup *
+wet_startup_create(void);
+
+void
+wet_startup_stage(struct wet_startup *startup, const char *name);
+
+void
+wet_startup_preload(struct wet_startup *startup,
+		    const char *name, const char *module_dir);
+
+void
+wet_startup_preload_start(struct wet_startup *startup);
+
+void
+wet_startup_finish(struct wet_startup *startup,
+		   struct weston_compositor *compositor);
+
+void
+wet_startup_destroy(struct wet_startup *startup);
@@ -39,6 +39,7 @@ struct screenshooter {
 	struct wl_listener client_destroy_listener;
 	struct wl_listener compositor_destroy_listener;
 	struct weston_recorder *recorder;
+	struct weston_h264_recorder *h264_recorder;
 	struct wl_listener authorization;
 };
 
@@ -105,6 +106,30 @@ recorder_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 	}
 }
 
+static void
+h264_recorder_binding(struct weston_keyboard *keyboard,
+		      const struct timespec *time, uint32_t key, void *data)
+{
+	struct weston_compositor *ec = keyboard->seat->compositor;
+	struct weston_output *output;
+	struct screenshooter *shooter = data;
+	static const char filename[] = "capture.h264";
+
+	if (shooter->h264_recorder) {
+		weston_h264_recorder_stop(shooter->h264_recorder);
+		shooter->h264_recorder = NULL;
+	} else {
+		if (keyboard->focus && keyboard->focus->output)
+			output = keyboard->focus->output;
+		else
+			output = container_of(ec->output_list.next,
+					      struct weston_output, link);
+
+		shooter->h264_recorder =
+			weston_h264_recorder_start(output, filename);
+	}
+}
+
 static void
 authorize_screenshooter(struct wl_listener *l,
 			struct weston_output_capture_attempt *att)
@@ -144,6 +169,9 @@ screenshooter_create(struct weston_compositor *ec)
 					  screenshooter_binding, shooter);
 	weston_compositor_add_key_binding(ec, KEY_R, MODIFIER_SUPER,
 					  recorder_binding, shooter);
+	weston_compositor_add_key_binding(ec, KEY_R,
+					  MODIFIER_SUPER | MODIFIER_SHIFT,
+					  h264_recorder_binding, shooter);
 
 	shooter->compositor_destroy_listener.notify = screenshooter_destroy;
 	wl_signal_add(&ec->destroy_signal,
@@ -522,6 +522,7 @@ shell_configuration(struct desktop_shell *shell)
 	struct weston_config *config;
 	char *s, *client;
 	bool allow_zap;
+	uint32_t occluded_frame_interval;
 
 	config = wet_get_config(shell->compositor);
 	section = weston_config_get_section(config, "shell", NULL, NULL);
@@ -551,6 +552,10 @@ shell_configuration(struct desktop_shell *shell)
 	weston_config_section_get_string(section, "focus-animation", &s, "none");
 	shell->focus_animation_type = get_animation_type(s);
 	free(s);
+	weston_config_section_get_uint(section, "occluded-frame-interval",
+				       &occluded_frame_interval, 0);
+	weston_compositor_set_occluded_frame_interval(shell->compositor,
+						      occluded_frame_interval);
 }
 
 static int
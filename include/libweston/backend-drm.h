@@ -52,6 +52,17 @@ enum weston_drm_backend_output_mode {
 	WESTON_DRM_BACKEND_OUTPUT_PREFERRED,
 };
 
+/** When the output may use a variable refresh rate */
+enum weston_drm_vrr_mode {
+	/** Always refresh at the rate of the mode */
+	WESTON_DRM_VRR_MODE_NEVER,
+	/** Let a single opaque view covering the whole output, like a
+	 * fullscreen video player or game, drive the refresh rate */
+	WESTON_DRM_VRR_MODE_FULLSCREEN,
+	/** Refresh whenever a new frame is ready, whatever is shown */
+	WESTON_DRM_VRR_MODE_ALWAYS,
+};
+
 #define WESTON_DRM_OUTPUT_API_NAME "weston_drm_output_api_v1"
 
 struct weston_drm_output_api {
@@ -104,6 +115,16 @@ struct weston_drm_output_api {
 	 */
 	int (*set_content_type)(struct weston_output *output,
 				const char *content_type);
+
+	/** When to enable a variable refresh rate on the output.
+	 *
+	 * VRR is only enabled when all heads of the output report being
+	 * "vrr_capable" and the CRTC has the "VRR_ENABLED" property. The
+	 * refresh rate of the mode is then the highest rate. The default is
+	 * WESTON_DRM_VRR_MODE_NEVER.
+	 */
+	void (*set_vrr_mode)(struct weston_output *output,
+			     enum weston_drm_vrr_mode mode);
 };
 
 static inline const struct weston_drm_output_api *
@@ -270,6 +291,23 @@ struct weston_drm_backend_config {
 	/** Desktop shell size */
 	uint32_t shell_width;
 	uint32_t shell_height;
+
+	/** Take over what is on screen without a modeset
+	 *
+	 * When an output is enabled on the CRTC and with the mode that were
+	 * already in use, e.g. for a boot splash, keep the framebuffer on
+	 * screen until a client has drawn something for the output, then
+	 * replace it with a page flip.
+	 */
+	bool seamless_takeover;
+
+	/** Scan out fullscreen SHM clients without compositing
+	 *
+	 * When an opaque SHM buffer covers a whole output at its native size,
+	 * copy its damaged region into a dumb buffer and put that on the
+	 * primary plane instead of compositing it with the renderer.
+	 */
+	bool shm_scanout;
 };
 
 #ifdef  __cplusplus
@@ -34,7 +34,18 @@ extern "C" {
 
 #include <libweston/libweston.h>
 
-#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 3
+#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 4
+
+/** When the outputs of the headless backend finish a frame */
+enum weston_headless_pacing {
+	/** On a fixed virtual vblank at the refresh rate */
+	WESTON_HEADLESS_PACING_FIXED = 0,
+	/** As soon as it has been rendered, without throttling */
+	WESTON_HEADLESS_PACING_ASAP,
+	/** As soon as it has been rendered, like a variable refresh rate
+	 * panel going between refresh and vrr_min_refresh */
+	WESTON_HEADLESS_PACING_VRR,
+};
 
 struct weston_headless_backend_config {
 	struct weston_backend_config base;
@@ -44,6 +55,23 @@ struct weston_headless_backend_config {
 
 	/** Use output decorations, requires use_gl = true */
 	bool decorate;
+
+	/** Refresh rate of the outputs in mHz, 0 for the default 60 Hz */
+	int refresh;
+
+	/** Frame pacing of the outputs */
+	enum weston_headless_pacing pacing;
+
+	/** Lowest refresh rate in mHz for WESTON_HEADLESS_PACING_VRR,
+	 * 0 for half of refresh */
+	int vrr_min_refresh;
+
+	/** Render GL outputs into dmabufs instead of pbuffers */
+	bool gl_dmabuf;
+
+	/** DRM render node to allocate the gl_dmabuf buffers from with GBM,
+	 * NULL to allocate them from /dev/udmabuf */
+	const char *render_node;
 };
 
 #ifdef  __cplusplus
@@ -82,10 +82,12 @@ struct weston_buffer;
 struct shell_surface;
 struct weston_seat;
 struct weston_output;
+struct weston_output_scene;
 struct input_method;
 struct weston_pointer;
 struct linux_dmabuf_buffer;
 struct weston_recorder;
+struct weston_h264_recorder;
 struct weston_pointer_constraint;
 struct ro_anonymous_file;
 struct weston_color_profile;
@@ -476,6 +478,10 @@ struct weston_output {
 	 */
 	struct wl_list paint_node_z_order_list;
 
+	/** Compact copy of paint_node_z_order_list for the core repaint
+	 *  passes, only valid during weston_output_repaint() */
+	struct weston_output_scene *scene;
+
 	/** Output area in global coordinates, simple rect */
 	pixman_region32_t region;
 
@@ -1421,6 +1427,12 @@ struct weston_compositor {
 	int idle_time;			/* timeout, s */
 	struct wl_event_source *repaint_timer;
 
+	/* Frame callback throttling of occluded surfaces, see
+	 * weston_compositor_set_occluded_frame_interval() */
+	uint32_t occluded_frame_interval;	/* ms, 0 = disabled */
+	struct wl_event_source *occluded_frame_timer;
+	struct wl_list occluded_surface_list;	/* weston_surface::occluded_link */
+
 	const struct weston_pointer_grab_interface *default_pointer_grab;
 
 	/* Repaint state. */
@@ -1470,6 +1482,22 @@ struct weston_compositor {
 	/* Whether to let the compositor run without any input device. */
 	bool require_input;
 
+	/* Largest selection, in bytes, the clipboard keeps a copy of
+	 * after its owner goes away. 0 means no limit. */
+	size_t clipboard_max_size;
+
+	/* Directory in which renderers may keep compiled shader programs
+	 * across runs, NULL to disable. Set before loading the backend;
+	 * freed by the compositor. With shader_cache_prewarm, all cached
+	 * programs are restored when the renderer starts. */
+	char *shader_cache_dir;
+	bool shader_cache_prewarm;
+
+	/* Hold back surface commits until their acquire fence has
+	 * signalled, and show the newest ready one at repaint time. */
+	bool late_latch;
+	struct wl_list latch_surface_list;	/* weston_surface::latch_link */
+
 	/* Test suite data */
 	struct weston_testsuite_data test_data;
 
@@ -1488,6 +1516,7 @@ struct weston_compositor {
 
 	struct weston_log_context *weston_log_ctx;
 	struct weston_log_scope *debug_scene;
+	struct weston_log_scope *debug_pools;
 	struct weston_log_scope *timeline;
 	struct weston_log_scope *libseat_debug;
 
@@ -1844,6 +1873,17 @@ struct weston_surface {
 
 	struct wl_list frame_callback_list;
 	struct wl_list feedback_list;
+	/* weston_compositor::occluded_surface_list, while frame callbacks
+	 * are held back because the surface is occluded */
+	struct wl_list occluded_link;
+	struct timespec occluded_since;
+
+	/* Commits held back until their acquire fence signals, oldest
+	 * first, with weston_compositor::late_latch */
+	struct wl_list latch_queue;
+	/* weston_compositor::latch_surface_list, while latch_queue is
+	 * not empty */
+	struct wl_list latch_link;
 
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_viewport buffer_viewport;
@@ -1872,6 +1912,13 @@ struct weston_surface {
 	void (*committed)(struct weston_surface *es,
 			  struct weston_coord_surface new_origin);
 	void *committed_private;
+	/*
+	 * Set by roles whose committed hook applies double-buffered state
+	 * of its own, like xdg-shell configures and window geometry. Late
+	 * latching never holds back commits of such surfaces, as the role
+	 * state would not be held back along with them.
+	 */
+	bool role_has_pending_state;
 	int (*get_label)(struct weston_surface *surface, char *buf, size_t len);
 
 	/* Parent's list of its sub-surfaces, weston_subsurface:parent_link.
@@ -1981,6 +2028,9 @@ weston_view_update_transform(struct weston_view *view);
 void
 weston_view_geometry_dirty(struct weston_view *view);
 
+void
+weston_view_set_alpha(struct weston_view *view, float alpha);
+
 struct weston_coord_global __attribute__ ((warn_unused_result))
 weston_coord_surface_to_global(const struct weston_view *view,
 			       struct weston_coord_surface coord);
@@ -2030,11 +2080,17 @@ weston_layer_mask_is_infinite(struct weston_layer *layer);
 #define WP_PRESENTATION_FEEDBACK_INVALID (1U << 31)
 /* Steal another bit from presented_flags for tearing */
 #define WESTON_FINISH_FRAME_TEARING (1U << 30)
+/* And one for a frame shown with a variable refresh rate */
+#define WESTON_FINISH_FRAME_VRR (1U << 29)
 
 void
 weston_output_schedule_repaint(struct weston_output *output);
 void
 weston_compositor_schedule_repaint(struct weston_compositor *compositor);
+
+void
+weston_compositor_set_occluded_frame_interval(struct weston_compositor *compositor,
+					      uint32_t interval_msec);
 void
 weston_compositor_damage_all(struct weston_compositor *compositor);
 void
@@ -2326,6 +2382,10 @@ struct weston_recorder *
 weston_recorder_start(struct weston_output *output, const char *filename);
 void
 weston_recorder_stop(struct weston_recorder *recorder);
+struct weston_h264_recorder *
+weston_h264_recorder_start(struct weston_output *output, const char *filename);
+void
+weston_h264_recorder_stop(struct weston_h264_recorder *recorder);
 
 struct weston_view_animation;
 typedef	void (*weston_view_animation_done_func_t)(struct weston_view_animation *animation, void *data);
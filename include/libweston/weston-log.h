@@ -51,6 +51,17 @@ weston_compositor_is_debug_protocol_enabled(struct weston_compositor *);
 struct weston_log_scope;
 struct weston_debug_stream;
 
+/** What an asynchronous log writer does when its queue is full
+ *
+ * @ingroup log
+ */
+enum weston_log_overflow {
+	/** Drop the oldest queued messages, and report how many */
+	WESTON_LOG_OVERFLOW_DROP_OLDEST = 0,
+	/** Wait for the writer thread to make room */
+	WESTON_LOG_OVERFLOW_BLOCK,
+};
+
 /** weston_log_scope callback
  *
  * @param sub The subscription.
@@ -123,12 +134,30 @@ weston_log_subscribe(struct weston_log_context *log_ctx,
 struct weston_log_subscriber *
 weston_log_subscriber_create_log(FILE *dump_to);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_log_async(FILE *dump_to, size_t queue_size,
+				       enum weston_log_overflow overflow);
+
+void
+weston_log_ctx_set_stream_async(struct weston_log_context *log_ctx,
+				size_t queue_size,
+				enum weston_log_overflow overflow);
+
 struct weston_log_subscriber *
 weston_log_subscriber_create_flight_rec(size_t size);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_mapped(const char *path, size_t size);
+
+int
+weston_log_subscriber_get_flight_rec_fd(struct weston_log_subscriber *sub);
+
 void
 weston_log_subscriber_display_flight_rec(struct weston_log_subscriber *sub);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_timeline_trace(const char *path);
+
 struct weston_log_subscription *
 weston_log_subscription_iterate(struct weston_log_scope *scope,
 				struct weston_log_subscription *sub_iter);
@@ -32,6 +32,8 @@
 #include "ivi-layout-export.h"
 #include <libweston/desktop.h>
 
+struct hash_table;
+
 struct ivi_layout_view {
 	struct wl_list link;	/* ivi_layout::view_list */
 	struct wl_list surf_link;	/*ivi_layout_surface::view_list */
@@ -64,6 +66,10 @@ struct ivi_layout_surface {
 	} pending;
 
 	struct wl_list view_list;	/* ivi_layout_view::surf_link */
+
+	struct wl_list dirty_link;	/* ivi_layout::surface_dirty_list */
+	struct wl_list commit_link;	/* ivi_layout::surface_commit_list */
+	uint64_t create_seq;		/* orders surface_commit_list */
 };
 
 struct ivi_layout_layer {
@@ -89,6 +95,10 @@ struct ivi_layout_layer {
 	} order;
 
 	int32_t ref_count;
+
+	struct wl_list dirty_link;	/* ivi_layout::layer_dirty_list */
+	struct wl_list commit_link;	/* ivi_layout::layer_commit_list */
+	uint64_t create_seq;		/* orders layer_commit_list */
 };
 
 struct ivi_layout {
@@ -99,6 +109,18 @@ struct ivi_layout {
 	struct wl_list screen_list;	/* ivi_layout_screen::link */
 	struct wl_list view_list;	/* ivi_layout_view::link */
 
+	struct hash_table *surface_ids;	/* ivi_layout_surface by id_surface */
+	struct hash_table *layer_ids;	/* ivi_layout_layer by id_layer */
+
+	/* Surfaces and layers with pending changes since the last commit */
+	struct wl_list surface_dirty_list;	/* ivi_layout_surface::dirty_link */
+	struct wl_list layer_dirty_list;	/* ivi_layout_layer::dirty_link */
+
+	/* Surfaces and layers whose properties change in the ongoing commit */
+	struct wl_list surface_commit_list;	/* ivi_layout_surface::commit_link */
+	struct wl_list layer_commit_list;	/* ivi_layout_layer::commit_link */
+	uint64_t create_seq;	/* next ivi_layout_{surface,layer}::create_seq */
+
 	struct {
 		struct wl_signal destroy_signal;
 	} shell_notification;
@@ -143,6 +165,9 @@ struct ivi_layout_transition;
 struct ivi_layout_transition_set {
 	struct wl_event_source  *event_source;
 	struct wl_list          transition_list;
+	struct weston_compositor *compositor;
+	struct timespec         last_frame_time;
+	uint32_t                skipped_frames;
 };
 
 typedef void (*ivi_layout_transition_destroy_user_func)(void *user_data);
@@ -35,6 +35,7 @@
 #include "ivi-shell.h"
 #include "ivi-layout-export.h"
 #include "ivi-layout-private.h"
+#include "shared/timespec-util.h"
 
 struct ivi_layout_transition;
 
@@ -156,6 +157,36 @@ do_transition_frame(struct ivi_layout_transition *transition,
 		layout_transition_destroy(transition);
 }
 
+/*
+ * Number of timer ticks a transition frame may be postponed for while
+ * the previous one has not been repainted yet.
+ */
+#define MAX_SKIPPED_FRAMES 2
+
+/*
+ * The previous transition frame is still waiting to be painted if no
+ * output has presented since it was committed and some output still has
+ * a repaint pending.
+ */
+static bool
+layout_transition_repaint_pending(struct ivi_layout_transition_set *transitions,
+				  struct timespec *frame_time)
+{
+	struct weston_output *output;
+	bool repaint_needed = false;
+
+	*frame_time = (struct timespec) {};
+	wl_list_for_each(output, &transitions->compositor->output_list, link) {
+		if (timespec_sub_to_nsec(&output->frame_time, frame_time) > 0)
+			*frame_time = output->frame_time;
+		if (output->repaint_needed)
+			repaint_needed = true;
+	}
+
+	return repaint_needed &&
+	       timespec_eq(frame_time, &transitions->last_frame_time);
+}
+
 static int32_t
 layout_transition_frame(void *data)
 {
@@ -165,6 +196,7 @@ layout_transition_frame(void *data)
 	uint32_t msec = 0;
 	struct transition_node *node = NULL;
 	struct transition_node *next = NULL;
+	struct timespec frame_time;
 
 	if (wl_list_empty(&transitions->transition_list)) {
 		wl_event_source_timer_update(transitions->event_source, 0);
@@ -173,6 +205,20 @@ layout_transition_frame(void *data)
 
 	wl_event_source_timer_update(transitions->event_source, 1000 / fps);
 
+	/*
+	 * Transitions are evaluated from the current time, so skipping a
+	 * tick while the outputs are still busy with the previous frame
+	 * only drops an intermediate step instead of queueing another
+	 * commit behind it.
+	 */
+	if (layout_transition_repaint_pending(transitions, &frame_time) &&
+	    transitions->skipped_frames < MAX_SKIPPED_FRAMES) {
+		transitions->skipped_frames++;
+		return 1;
+	}
+	transitions->skipped_frames = 0;
+	transitions->last_frame_time = frame_time;
+
 	clock_gettime(CLOCK_MONOTONIC, &timestamp);/* FIXME */
 	msec = (1e+3 * timestamp.tv_sec + 1e-6 * timestamp.tv_nsec);
 
@@ -197,6 +243,9 @@ ivi_layout_transition_set_create(struct weston_compositor *ec)
 	}
 
 	wl_list_init(&transitions->transition_list);
+	transitions->compositor = ec;
+	transitions->last_frame_time = (struct timespec) {};
+	transitions->skipped_frames = 0;
 
 	loop = wl_display_get_event_loop(ec->wl_display);
 	transitions->event_source =
@@ -68,6 +68,7 @@
 #include "ivi-layout-private.h"
 #include "ivi-layout-shell.h"
 
+#include "shared/hash.h"
 #include "shared/helpers.h"
 #include "shared/os-compatibility.h"
 #include "shared/signal.h"
@@ -110,34 +111,130 @@ get_instance(void)
 }
 
 /**
- * Internal API to add/remove an ivi_layer to/from ivi_screen.
+ * Internal API to look up an ivi_surface/ivi_layer by id.
  */
 static struct ivi_layout_surface *
-get_surface(struct wl_list *surf_list, uint32_t id_surface)
+get_surface(struct ivi_layout *layout, uint32_t id_surface)
 {
 	struct ivi_layout_surface *ivisurf;
 
-	wl_list_for_each(ivisurf, surf_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
+	/* Surfaces which have not been given an id yet, e.g. desktop
+	 * surfaces, all share IVI_INVALID_ID and are not indexed. */
+	if (id_surface == IVI_INVALID_ID) {
+		wl_list_for_each(ivisurf, &layout->surface_list, link) {
+			if (ivisurf->id_surface == id_surface)
+				return ivisurf;
 		}
+
+		return NULL;
 	}
 
-	return NULL;
+	return hash_table_lookup(layout->surface_ids, id_surface);
+}
+
+static void
+add_surface_id(struct ivi_layout_surface *ivisurf)
+{
+	struct ivi_layout *layout = ivisurf->layout;
+
+	if (ivisurf->id_surface == IVI_INVALID_ID)
+		return;
+
+	if (hash_table_insert(layout->surface_ids,
+			      ivisurf->id_surface, ivisurf) < 0)
+		abort_oom_if_null(NULL);
+}
+
+static void
+remove_surface_id(struct ivi_layout_surface *ivisurf)
+{
+	struct ivi_layout *layout = ivisurf->layout;
+
+	if (ivisurf->id_surface == IVI_INVALID_ID)
+		return;
+
+	if (hash_table_lookup(layout->surface_ids,
+			      ivisurf->id_surface) == ivisurf)
+		hash_table_remove(layout->surface_ids, ivisurf->id_surface);
 }
 
 static struct ivi_layout_layer *
-get_layer(struct wl_list *layer_list, uint32_t id_layer)
+get_layer(struct ivi_layout *layout, uint32_t id_layer)
 {
-	struct ivi_layout_layer *ivilayer;
+	return hash_table_lookup(layout->layer_ids, id_layer);
+}
+
+/**
+ * Internal API to track ivi_surfaces/ivi_layers which need to be looked at
+ * by the next ivi_layout_commit_changes, so that it does not have to walk
+ * every surface and layer.
+ */
+static void
+surface_mark_dirty(struct ivi_layout_surface *ivisurf)
+{
+	struct ivi_layout *layout = ivisurf->layout;
+
+	if (wl_list_empty(&ivisurf->dirty_link))
+		wl_list_insert(layout->surface_dirty_list.prev,
+			       &ivisurf->dirty_link);
+}
+
+static void
+layer_mark_dirty(struct ivi_layout_layer *ivilayer)
+{
+	struct ivi_layout *layout = ivilayer->layout;
+
+	if (wl_list_empty(&ivilayer->dirty_link))
+		wl_list_insert(layout->layer_dirty_list.prev,
+			       &ivilayer->dirty_link);
+}
+
+/*
+ * The commit lists are kept in creation order, so that notifications go
+ * out oldest first, as they did when send_prop() walked all of
+ * surface_list and layer_list. Only what changed is on them, so the
+ * insertion scan stays short.
+ */
+static void
+surface_mark_committed(struct ivi_layout_surface *ivisurf)
+{
+	struct ivi_layout *layout = ivisurf->layout;
+	struct ivi_layout_surface *prev;
+	struct wl_list *pos = &layout->surface_commit_list;
+
+	if (!wl_list_empty(&ivisurf->commit_link))
+		return;
 
-	wl_list_for_each(ivilayer, layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
+	wl_list_for_each_reverse(prev, &layout->surface_commit_list,
+				 commit_link) {
+		if (prev->create_seq < ivisurf->create_seq) {
+			pos = &prev->commit_link;
+			break;
 		}
 	}
 
-	return NULL;
+	wl_list_insert(pos, &ivisurf->commit_link);
+}
+
+static void
+layer_mark_committed(struct ivi_layout_layer *ivilayer)
+{
+	struct ivi_layout *layout = ivilayer->layout;
+	struct ivi_layout_layer *prev;
+	struct wl_list *pos = &layout->layer_commit_list;
+
+	if (!wl_list_empty(&ivilayer->commit_link))
+		return;
+
+	wl_list_for_each_reverse(prev, &layout->layer_commit_list,
+				 commit_link) {
+		if (prev->create_seq < ivilayer->create_seq) {
+			pos = &prev->commit_link;
+			break;
+		}
+	}
+
+	wl_list_insert(pos, &ivilayer->commit_link);
 }
 
 static bool
@@ -246,6 +343,9 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 	}
 
 	wl_list_remove(&ivisurf->link);
+	wl_list_remove(&ivisurf->dirty_link);
+	wl_list_remove(&ivisurf->commit_link);
+	remove_surface_id(ivisurf);
 
 	wl_list_for_each_safe(ivi_view, next, &ivisurf->view_list, surf_link) {
 		ivi_view_destroy(ivi_view);
@@ -362,15 +462,14 @@ init_surface_properties(struct ivi_layout_surface_properties *prop)
 /**
  * Internal APIs to be called from ivi_layout_commit_changes.
  */
-static void
-update_opacity(struct ivi_layout_layer *ivilayer,
-	       struct ivi_layout_surface *ivisurf,
-	       struct weston_view *view)
+static float
+calc_opacity(struct ivi_layout_layer *ivilayer,
+	     struct ivi_layout_surface *ivisurf)
 {
 	double layer_alpha = wl_fixed_to_double(ivilayer->prop.opacity);
 	double surf_alpha  = wl_fixed_to_double(ivisurf->prop.opacity);
 
-	view->alpha = layer_alpha * surf_alpha;
+	return layer_alpha * surf_alpha;
 }
 
 static void
@@ -598,7 +697,21 @@ update_prop(struct ivi_layout_view *ivi_view)
 	if (!ivilayer->prop.event_mask && !ivisurf->prop.event_mask)
 		return;
 
-	update_opacity(ivilayer, ivisurf, ivi_view->view);
+	/*
+	 * An opacity change alone, e.g. every frame of a fade transition,
+	 * does not move the view: keep the transformation computed by an
+	 * earlier commit and only damage the view.
+	 */
+	if ((ivilayer->prop.event_mask | ivisurf->prop.event_mask) ==
+	    IVI_NOTIFICATION_OPACITY &&
+	    !wl_list_empty(&ivi_view->transform.link)) {
+		weston_view_set_alpha(ivi_view->view,
+				      calc_opacity(ivilayer, ivisurf));
+		ivisurf->update_count++;
+		return;
+	}
+
+	ivi_view->view->alpha = calc_opacity(ivilayer, ivisurf);
 
 	if (ivisurf->prop.source_width == 0 || ivisurf->prop.source_height == 0) {
 		weston_log("ivi-shell: source rectangle is not yet set by ivi_layout_surface_set_source_rectangle\n");
@@ -643,17 +756,32 @@ ivi_view_is_mapped(struct ivi_layout_view *ivi_view)
 static void
 commit_changes(struct ivi_layout *layout)
 {
-	struct ivi_layout_view *ivi_view  = NULL;
+	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_layer *ivilayer;
+	struct ivi_layout_view *ivi_view;
 
-	wl_list_for_each(ivi_view, &layout->view_list, link) {
-		/*
-		 * If the view is not on the currently rendered scenegraph,
-		 * we do not need to update its properties.
-		 */
-		if (!ivi_view_is_mapped(ivi_view))
-			continue;
+	/*
+	 * Only views of surfaces or layers whose properties changed need
+	 * updating. If the view is not on the currently rendered
+	 * scenegraph, we do not need to update its properties either.
+	 */
+	wl_list_for_each(ivisurf, &layout->surface_commit_list, commit_link) {
+		wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
+	}
 
-		update_prop(ivi_view);
+	wl_list_for_each(ivilayer, &layout->layer_commit_list, commit_link) {
+		wl_list_for_each(ivi_view, &ivilayer->order.view_list,
+				 order_link) {
+			/* Already updated through its surface above */
+			if (!wl_list_empty(&ivi_view->ivisurf->commit_link))
+				continue;
+
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
 	}
 }
 
@@ -667,7 +795,13 @@ commit_surface_list(struct ivi_layout *layout)
 	int32_t dest_height = 0;
 	int32_t configured = 0;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
+	while (!wl_list_empty(&layout->surface_dirty_list)) {
+		ivisurf = container_of(layout->surface_dirty_list.next,
+				       struct ivi_layout_surface, dirty_link);
+		wl_list_remove(&ivisurf->dirty_link);
+		wl_list_init(&ivisurf->dirty_link);
+		surface_mark_committed(ivisurf);
+
 		if (ivisurf->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_VIEW_DEFAULT) {
 			dest_x = ivisurf->prop.dest_x;
 			dest_y = ivisurf->prop.dest_y;
@@ -766,7 +900,13 @@ commit_layer_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_view *next     = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
+	while (!wl_list_empty(&layout->layer_dirty_list)) {
+		ivilayer = container_of(layout->layer_dirty_list.next,
+					struct ivi_layout_layer, dirty_link);
+		wl_list_remove(&ivilayer->dirty_link);
+		wl_list_init(&ivilayer->dirty_link);
+		layer_mark_committed(ivilayer);
+
 		if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_MOVE) {
 			ivi_layout_transition_move_layer(ivilayer, ivilayer->pending.prop.dest_x, ivilayer->pending.prop.dest_y, ivilayer->pending.prop.transition_duration);
 		} else if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_FADE) {
@@ -788,6 +928,7 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_init(&ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+			surface_mark_committed(ivi_view->ivisurf);
 		}
 
 		assert(wl_list_empty(&ivilayer->order.view_list));
@@ -797,6 +938,7 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_insert(&ivilayer->order.view_list, &ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_ADD;
+			surface_mark_committed(ivi_view->ivisurf);
 		}
 
 		ivilayer->order.dirty = 0;
@@ -818,6 +960,7 @@ commit_screen_list(struct ivi_layout *layout)
 				wl_list_remove(&ivilayer->order.link);
 				wl_list_init(&ivilayer->order.link);
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+				layer_mark_committed(ivilayer);
 			}
 
 			assert(wl_list_empty(&iviscrn->order.layer_list));
@@ -831,6 +974,7 @@ commit_screen_list(struct ivi_layout *layout)
 					       &ivilayer->order.link);
 				ivilayer->on_screen = iviscrn;
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_ADD;
+				layer_mark_committed(ivilayer);
 			}
 
 			iviscrn->order.dirty = 0;
@@ -904,20 +1048,40 @@ send_layer_prop(struct ivi_layout_layer *ivilayer)
 	ivilayer->pending.prop.event_mask = 0;
 }
 
+/*
+ * Consumes the commit lists, notifying layers and then surfaces, each in
+ * the order they were created. Anything notified here keeps its event_mask
+ * in prop until the next commit, so it is marked dirty again to get that
+ * cleared.
+ */
 static void
 send_prop(struct ivi_layout *layout)
 {
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_surface *ivisurf  = NULL;
 
-	wl_list_for_each_reverse(ivilayer, &layout->layer_list, link) {
-		if (ivilayer->prop.event_mask)
+	while (!wl_list_empty(&layout->layer_commit_list)) {
+		ivilayer = container_of(layout->layer_commit_list.next,
+					struct ivi_layout_layer, commit_link);
+		wl_list_remove(&ivilayer->commit_link);
+		wl_list_init(&ivilayer->commit_link);
+
+		if (ivilayer->prop.event_mask) {
+			layer_mark_dirty(ivilayer);
 			send_layer_prop(ivilayer);
+		}
 	}
 
-	wl_list_for_each_reverse(ivisurf, &layout->surface_list, link) {
-		if (ivisurf->prop.event_mask)
+	while (!wl_list_empty(&layout->surface_commit_list)) {
+		ivisurf = container_of(layout->surface_commit_list.next,
+				       struct ivi_layout_surface, commit_link);
+		wl_list_remove(&ivisurf->commit_link);
+		wl_list_init(&ivisurf->commit_link);
+
+		if (ivisurf->prop.event_mask) {
+			surface_mark_dirty(ivisurf);
 			send_surface_prop(ivisurf);
+		}
 	}
 }
 
@@ -1030,30 +1194,16 @@ static struct ivi_layout_layer *
 ivi_layout_get_layer_from_id(uint32_t id_layer)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_layer *ivilayer = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
-		if (ivilayer->id_layer == id_layer) {
-			return ivilayer;
-		}
-	}
-
-	return NULL;
+	return get_layer(layout, id_layer);
 }
 
 struct ivi_layout_surface *
 ivi_layout_get_surface_from_id(uint32_t id_surface)
 {
 	struct ivi_layout *layout = get_instance();
-	struct ivi_layout_surface *ivisurf = NULL;
-
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
-		if (ivisurf->id_surface == id_surface) {
-			return ivisurf;
-		}
-	}
 
-	return NULL;
+	return get_surface(layout, id_surface);
 }
 
 static void
@@ -1245,7 +1395,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_layer *ivilayer = NULL;
 
-	ivilayer = get_layer(&layout->layer_list, id_layer);
+	ivilayer = get_layer(layout, id_layer);
 	if (ivilayer != NULL) {
 		weston_log("id_layer is already created\n");
 		++ivilayer->ref_count;
@@ -1268,7 +1418,13 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	wl_list_init(&ivilayer->order.view_list);
 	wl_list_init(&ivilayer->order.link);
 
+	wl_list_init(&ivilayer->dirty_link);
+	wl_list_init(&ivilayer->commit_link);
+	ivilayer->create_seq = layout->create_seq++;
+
 	wl_list_insert(&layout->layer_list, &ivilayer->link);
+	if (hash_table_insert(layout->layer_ids, id_layer, ivilayer) < 0)
+		abort_oom_if_null(NULL);
 
 	wl_signal_emit(&layout->layer_notification.created, ivilayer);
 
@@ -1297,6 +1453,9 @@ ivi_layout_layer_destroy(struct ivi_layout_layer *ivilayer)
 	wl_list_remove(&ivilayer->pending.link);
 	wl_list_remove(&ivilayer->order.link);
 	wl_list_remove(&ivilayer->link);
+	wl_list_remove(&ivilayer->dirty_link);
+	wl_list_remove(&ivilayer->commit_link);
+	hash_table_remove(layout->layer_ids, ivilayer->id_layer);
 
 	free(ivilayer);
 }
@@ -1309,6 +1468,8 @@ ivi_layout_layer_set_visibility(struct ivi_layout_layer *ivilayer,
 
 	assert(ivilayer);
 
+	layer_mark_dirty(ivilayer);
+
 	prop = &ivilayer->pending.prop;
 	prop->visibility = newVisibility;
 
@@ -1332,6 +1493,8 @@ ivi_layout_layer_set_opacity(struct ivi_layout_layer *ivilayer,
 		return IVI_FAILED;
 	}
 
+	layer_mark_dirty(ivilayer);
+
 	prop = &ivilayer->pending.prop;
 	prop->opacity = opacity;
 
@@ -1352,6 +1515,8 @@ ivi_layout_layer_set_source_rectangle(struct ivi_layout_layer *ivilayer,
 
 	assert(ivilayer);
 
+	layer_mark_dirty(ivilayer);
+
 	prop = &ivilayer->pending.prop;
 	prop->source_x = x;
 	prop->source_y = y;
@@ -1375,6 +1540,8 @@ ivi_layout_layer_set_destination_rectangle(struct ivi_layout_layer *ivilayer,
 
 	assert(ivilayer);
 
+	layer_mark_dirty(ivilayer);
+
 	prop = &ivilayer->pending.prop;
 	prop->dest_x = x;
 	prop->dest_y = y;
@@ -1413,6 +1580,7 @@ ivi_layout_layer_set_render_order(struct ivi_layout_layer *ivilayer,
 	}
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 }
 
 void
@@ -1423,6 +1591,8 @@ ivi_layout_surface_set_visibility(struct ivi_layout_surface *ivisurf,
 
 	assert(ivisurf);
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->visibility = newVisibility;
 
@@ -1446,6 +1616,8 @@ ivi_layout_surface_set_opacity(struct ivi_layout_surface *ivisurf,
 		return IVI_FAILED;
 	}
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->opacity = opacity;
 
@@ -1466,6 +1638,8 @@ ivi_layout_surface_set_destination_rectangle(struct ivi_layout_surface *ivisurf,
 
 	assert(ivisurf);
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->start_x = prop->dest_x;
 	prop->start_y = prop->dest_y;
@@ -1643,6 +1817,7 @@ ivi_layout_layer_add_surface(struct ivi_layout_layer *ivilayer,
 	wl_list_insert(&ivilayer->pending.view_list, &ivi_view->pending_link);
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 }
 
 static void
@@ -1662,6 +1837,7 @@ ivi_layout_layer_remove_surface(struct ivi_layout_layer *ivilayer,
 		wl_list_init(&ivi_view->pending_link);
 
 		ivilayer->order.dirty = 1;
+		layer_mark_dirty(ivilayer);
 	}
 }
 
@@ -1674,6 +1850,8 @@ ivi_layout_surface_set_source_rectangle(struct ivi_layout_surface *ivisurf,
 
 	assert(ivisurf);
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->source_x = x;
 	prop->source_y = y;
@@ -1710,6 +1888,21 @@ static int32_t
 ivi_layout_commit_current(void)
 {
 	struct ivi_layout *layout = get_instance();
+	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_layer *ivilayer;
+
+	/* Re-apply the current properties, without consuming anything
+	 * pending. */
+	wl_list_for_each(ivisurf, &layout->surface_dirty_list, dirty_link) {
+		if (ivisurf->prop.event_mask)
+			surface_mark_committed(ivisurf);
+	}
+
+	wl_list_for_each(ivilayer, &layout->layer_dirty_list, dirty_link) {
+		if (ivilayer->prop.event_mask)
+			layer_mark_committed(ivilayer);
+	}
+
 	build_view_list(layout);
 	commit_changes(layout);
 	send_prop(layout);
@@ -1723,6 +1916,7 @@ ivi_layout_layer_set_transition(struct ivi_layout_layer *ivilayer,
 {
 	assert(ivilayer);
 
+	layer_mark_dirty(ivilayer);
 	ivilayer->pending.prop.transition_type = type;
 	ivilayer->pending.prop.transition_duration = duration;
 }
@@ -1734,6 +1928,7 @@ ivi_layout_layer_set_fade_info(struct ivi_layout_layer* ivilayer,
 {
 	assert(ivilayer);
 
+	layer_mark_dirty(ivilayer);
 	ivilayer->pending.prop.is_fade_in = is_fade_in;
 	ivilayer->pending.prop.start_alpha = start_alpha;
 	ivilayer->pending.prop.end_alpha = end_alpha;
@@ -1747,6 +1942,8 @@ ivi_layout_surface_set_transition_duration(struct ivi_layout_surface *ivisurf,
 
 	assert(ivisurf);
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->transition_duration = duration*10;
 }
@@ -1771,13 +1968,14 @@ ivi_layout_surface_set_id(struct ivi_layout_surface *ivisurf,
 		return IVI_FAILED;
 	}
 
-	search_ivisurf = get_surface(&layout->surface_list, id_surface);
+	search_ivisurf = get_surface(layout, id_surface);
 	if (search_ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return IVI_FAILED;
 	}
 
 	ivisurf->id_surface = id_surface;
+	add_surface_id(ivisurf);
 
 	wl_signal_emit(&layout->surface_notification.configure_changed,
 		       ivisurf);
@@ -1794,6 +1992,8 @@ ivi_layout_surface_set_transition(struct ivi_layout_surface *ivisurf,
 
 	assert(ivisurf);
 
+	surface_mark_dirty(ivisurf);
+
 	prop = &ivisurf->pending.prop;
 	prop->transition_type = type;
 	prop->transition_duration = duration;
@@ -1843,8 +2043,12 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface,
 	ivisurf->pending.prop = ivisurf->prop;
 
 	wl_list_init(&ivisurf->view_list);
+	wl_list_init(&ivisurf->dirty_link);
+	wl_list_init(&ivisurf->commit_link);
+	ivisurf->create_seq = layout->create_seq++;
 
 	wl_list_insert(&layout->surface_list, &ivisurf->link);
+	add_surface_id(ivisurf);
 
 	return ivisurf;
 }
@@ -1855,6 +2059,7 @@ ivi_layout_desktop_surface_configure(struct ivi_layout_surface *ivisurf,
 {
 	struct ivi_layout *layout = get_instance();
 	ivisurf->prop.event_mask |= IVI_NOTIFICATION_CONFIGURE;
+	surface_mark_dirty(ivisurf);
 
 	/* emit callback which is set by ivi-layout api user */
 	wl_signal_emit(&layout->surface_notification.configure_desktop_changed,
@@ -2004,6 +2209,7 @@ ivi_layout_surface_configure(struct ivi_layout_surface *ivisurf,
 {
 	struct ivi_layout *layout = get_instance();
 	ivisurf->prop.event_mask |= IVI_NOTIFICATION_CONFIGURE;
+	surface_mark_dirty(ivisurf);
 
 	/* emit callback which is set by ivi-layout api user */
 	wl_signal_emit(&layout->surface_notification.configure_changed,
@@ -2017,7 +2223,7 @@ ivi_layout_surface_create(struct weston_surface *wl_surface,
 	struct ivi_layout *layout = get_instance();
 	struct ivi_layout_surface *ivisurf = NULL;
 
-	ivisurf = get_surface(&layout->surface_list, id_surface);
+	ivisurf = get_surface(layout, id_surface);
 	if (ivisurf) {
 		weston_log("id_surface(%d) is already created\n", id_surface);
 		return NULL;
@@ -2055,6 +2261,16 @@ ivi_layout_init(struct weston_compositor *ec, struct ivi_shell *shell)
 	wl_list_init(&layout->screen_list);
 	wl_list_init(&layout->view_list);
 
+	layout->surface_ids = hash_table_create();
+	layout->layer_ids = hash_table_create();
+	abort_oom_if_null(layout->surface_ids);
+	abort_oom_if_null(layout->layer_ids);
+
+	wl_list_init(&layout->surface_dirty_list);
+	wl_list_init(&layout->layer_dirty_list);
+	wl_list_init(&layout->surface_commit_list);
+	wl_list_init(&layout->layer_commit_list);
+
 	wl_signal_init(&layout->layer_notification.created);
 	wl_signal_init(&layout->layer_notification.removed);
 
@@ -2101,6 +2317,9 @@ ivi_layout_fini(void)
 	/* XXX: tear down everything else */
 	wl_list_remove(&layout->output_created.link);
 	wl_list_remove(&layout->output_destroyed.link);
+
+	hash_table_destroy(layout->surface_ids);
+	hash_table_destroy(layout->layer_ids);
 }
 
 static struct ivi_layout_interface ivi_layout_interface = {
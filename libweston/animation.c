@@ -133,6 +133,8 @@ struct weston_view_animation {
 	struct weston_transform transform;
 	struct wl_listener listener;
 	float start, stop;
+	/* frame only changes the view's alpha, not its geometry */
+	bool alpha_only;
 	weston_view_animation_frame_func_t frame;
 	weston_view_animation_frame_func_t reset;
 	weston_view_animation_done_func_t done;
@@ -189,7 +191,8 @@ weston_view_animation_frame(struct weston_animation *base,
 	if (animation->frame)
 		animation->frame(animation);
 
-	weston_view_geometry_dirty(animation->view);
+	if (!animation->alpha_only)
+		weston_view_geometry_dirty(animation->view);
 	weston_view_schedule_repaint(animation->view);
 
 	/* The view's output_mask will be zero if its position is
@@ -235,6 +238,7 @@ weston_view_animation_create(struct weston_view *view,
 	animation->start = start;
 	animation->stop = stop;
 	animation->private = private;
+	animation->alpha_only = false;
 
 	weston_matrix_init(&animation->transform.matrix);
 	wl_list_insert(&view->geometry.transformation_list,
@@ -263,6 +267,8 @@ weston_view_animation_run(struct weston_view_animation *animation)
 	struct timespec zero_time = { 0 };
 
 	animation->animation.frame_counter = 0;
+	/* The animation transform was just added to the view */
+	weston_view_geometry_dirty(animation->view);
 	weston_view_animation_frame(&animation->animation, NULL, &zero_time);
 }
 
@@ -319,15 +325,21 @@ weston_zoom_run(struct weston_view *view, float start, float stop,
 	return zoom;
 }
 
-static void
-fade_frame(struct weston_view_animation *animation)
+static float
+fade_alpha(struct weston_view_animation *animation)
 {
 	if (animation->spring.current > 0.999)
-		animation->view->alpha = 1;
+		return 1;
 	else if (animation->spring.current < 0.001 )
-		animation->view->alpha = 0;
+		return 0;
 	else
-		animation->view->alpha = animation->spring.current;
+		return animation->spring.current;
+}
+
+static void
+fade_frame(struct weston_view_animation *animation)
+{
+	weston_view_set_alpha(animation->view, fade_alpha(animation));
 }
 
 WL_EXPORT struct weston_view_animation *
@@ -346,6 +358,7 @@ weston_fade_run(struct weston_view *view,
 
 	weston_spring_init(&fade->spring, 1000.0, start, end);
 	fade->spring.friction = 4000;
+	fade->alpha_only = true;
 	fade->spring.previous = start - (end - start) * 0.1;
 
 	view->alpha = start;
@@ -367,18 +380,12 @@ stable_fade_frame(struct weston_view_animation *animation)
 {
 	struct weston_view *back_view;
 
-	if (animation->spring.current > 0.999)
-		animation->view->alpha = 1;
-	else if (animation->spring.current < 0.001 )
-		animation->view->alpha = 0;
-	else
-		animation->view->alpha = animation->spring.current;
+	weston_view_set_alpha(animation->view, fade_alpha(animation));
 
 	back_view = (struct weston_view *) animation->private;
-	back_view->alpha =
-		(animation->spring.target - animation->view->alpha) /
-		(1.0 - animation->view->alpha);
-	weston_view_geometry_dirty(back_view);
+	weston_view_set_alpha(back_view,
+			      (animation->spring.target - animation->view->alpha) /
+			      (1.0 - animation->view->alpha));
 }
 
 WL_EXPORT struct weston_view_animation *
@@ -397,9 +404,11 @@ weston_stable_fade_run(struct weston_view *front_view, float start,
 
 	weston_spring_init(&fade->spring, 400, start, end);
 	fade->spring.friction = 1150;
+	fade->alpha_only = true;
 
 	front_view->alpha = start;
 	back_view->alpha = end;
+	weston_view_geometry_dirty(back_view);
 
 	weston_view_animation_run(fade);
 
@@ -219,6 +219,7 @@ enum wdrm_connector_property {
 	WDRM_CONNECTOR_HDR_OUTPUT_METADATA,
 	WDRM_CONNECTOR_MAX_BPC,
 	WDRM_CONNECTOR_CONTENT_TYPE,
+	WDRM_CONNECTOR_VRR_CAPABLE,
 	WDRM_CONNECTOR__COUNT
 };
 
@@ -317,10 +318,16 @@ struct drm_device {
 	} drm;
 
 	/* Track the GEM handles if the device does not have a gbm device, which
-	 * tracks the handles for us.
+	 * tracks the handles for us, and those of imported client dmabufs.
 	 */
 	struct hash_table *gem_handle_refcnt;
 
+	/* drm_fb_cache_entry::link, most recently used first */
+	struct wl_list fb_cache;
+	int fb_cache_len;
+	unsigned int fb_cache_lookups;
+	unsigned int fb_cache_hits;
+
 	/* drm_crtc::link */
 	struct wl_list crtc_list;
 
@@ -394,6 +401,9 @@ struct drm_backend {
 
 	uint32_t pageflip_timeout;
 
+	bool seamless_takeover;
+	bool shm_scanout;
+
 	bool shutting_down;
 
 	struct weston_log_scope *debug;
@@ -486,6 +496,7 @@ struct drm_output_state {
 	enum weston_hdcp_protection protection;
 	struct wl_list plane_list;
 	bool tear;
+	bool vrr;
 };
 
 /**
@@ -640,6 +651,8 @@ struct drm_head {
 	drmModeModeInfo inherited_mode;	/**< Original mode on the connector */
 	uint32_t inherited_max_bpc;	/**< Original max_bpc on the connector */
 	uint32_t inherited_crtc_id;	/**< Original CRTC assignment */
+	uint32_t inherited_fb_id;	/**< Original FB on that CRTC */
+	bool vrr_capable;		/**< Sink can refresh at a variable rate */
 
 	/* drm_output::disable_head */
 	struct wl_list disable_head_link;
@@ -675,6 +688,12 @@ struct drm_output {
 	bool disable_pending;
 	bool dpms_off_pending;
 	bool mode_switch_pending;
+	/* The kernel refused the last commit of this output while taking the
+	 * other outputs; compose the next frame with the renderer only */
+	bool commit_failed;
+	/* Debugging aid: WESTON_DRM_FAIL_COMMIT_OUTPUT names this output,
+	 * every commit including it fails as if the kernel refused it */
+	bool fail_commit;
 
 	uint32_t gbm_cursor_handle[2];
 	struct drm_fb *gbm_cursor_fb[2];
@@ -716,17 +735,36 @@ struct drm_output {
 	int current_image;
 	pixman_region32_t previous_damage;
 
+	/* Dumb buffers a fullscreen SHM view is copied into for scanout,
+	 * and the region of each that does not hold the view's content yet,
+	 * see drm_output_prepare_shm_scanout() */
+	struct drm_fb *shm_scanout_fb[2];
+	pixman_region32_t shm_scanout_stale[2];
+	struct weston_view *shm_scanout_view;
+	struct wl_listener shm_scanout_view_destroy_listener;
+
+	const struct vaapi_recorder_interface *recorder_iface;
 	struct vaapi_recorder *recorder;
 	struct wl_listener recorder_frame_listener;
+	/* The last frame was dropped, so an undamaged one is not a repeat */
+	bool recorder_need_frame;
 
 	struct wl_event_source *pageflip_timer;
 
+	/* Keep the framebuffer inherited at startup on screen until there
+	 * is client content, see drm_output_init_splash_hold() */
+	bool splash_hold;
+	struct wl_event_source *splash_timer;
+	/* Completes the frames skipped while holding */
+	struct wl_event_source *splash_frame_timer;
+
 	bool virtual;
 	void (*virtual_destroy)(struct weston_output *base);
 
 	submit_frame_cb virtual_submit_frame;
 
 	enum wdrm_content_type content_type;
+	enum weston_drm_vrr_mode vrr_mode;
 
 	int (*surface_get_in_fence_fd)(struct gbm_surface *surface);
 };
@@ -907,6 +945,12 @@ drm_fb_get_from_bo(struct gbm_bo *bo, struct drm_device *device,
 void
 drm_output_set_cursor_view(struct drm_output *output, struct weston_view *ev);
 
+void
+drm_output_set_shm_scanout_view(struct drm_output *output,
+				struct weston_view *ev);
+void
+drm_output_fini_shm_scanout(struct drm_output *output);
+
 int
 drm_output_ensure_hdr_output_metadata_blob(struct drm_output *output);
 
@@ -918,6 +962,9 @@ drm_fb_get_from_paint_node(struct drm_output_state *state,
 extern bool
 drm_can_scanout_dmabuf(struct weston_backend *backend,
 		       struct linux_dmabuf_buffer *dmabuf);
+
+void
+drm_fb_cache_fini(struct drm_device *device);
 #else
 static inline struct drm_fb *
 drm_fb_get_from_paint_node(struct drm_output_state *state,
@@ -931,6 +978,11 @@ drm_can_scanout_dmabuf(struct weston_backend *backend,
 {
 	return false;
 }
+
+static inline void
+drm_fb_cache_fini(struct drm_device *device)
+{
+}
 #endif
 
 struct drm_pending_state *
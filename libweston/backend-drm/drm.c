@@ -74,6 +74,9 @@
 
 static const char default_seat[] = "seat0";
 
+/* How long to keep an inherited framebuffer without client content */
+#define DRM_SPLASH_HOLD_TIMEOUT_MS 3000
+
 static void
 drm_backend_create_faked_zpos(struct drm_device *device)
 {
@@ -170,6 +173,130 @@ drm_output_pageflip_timer_create(struct drm_output *output)
 	return 0;
 }
 
+static void
+drm_output_release_splash(struct drm_output *output)
+{
+	output->splash_hold = false;
+
+	if (output->splash_timer)
+		wl_event_source_remove(output->splash_timer);
+	output->splash_timer = NULL;
+}
+
+static int
+splash_timeout(void *data)
+{
+	struct drm_output *output = data;
+
+	weston_log("Output %s: no client content after %d ms, "
+		   "replacing the inherited framebuffer.\n",
+		   output->base.name, DRM_SPLASH_HOLD_TIMEOUT_MS);
+
+	drm_output_release_splash(output);
+	weston_output_damage(&output->base);
+
+	return 0;
+}
+
+static int
+splash_frame_timeout(void *data)
+{
+	struct drm_output *output = data;
+
+	weston_output_finish_frame(&output->base, NULL,
+				   WP_PRESENTATION_FEEDBACK_INVALID);
+
+	return 0;
+}
+
+/* Finish a frame held back from the inherited framebuffer one refresh
+ * later, as if it had been flipped, so that the repaint loop and frame
+ * callbacks keep going. */
+static void
+drm_output_skip_splash_frame(struct drm_output *output)
+{
+	int refresh_msec = 16;
+
+	if (output->base.current_mode->refresh > 0)
+		refresh_msec = millihz_to_nsec(output->base.current_mode->refresh) /
+			       1000000;
+
+	wl_event_source_timer_update(output->splash_frame_timer,
+				     MAX(refresh_msec, 1));
+}
+
+/* Whether the output has something from a client to show, rather than
+ * only compositor-internal surfaces such as a black curtain. */
+static bool
+drm_output_has_client_content(struct drm_output *output)
+{
+	struct weston_paint_node *pnode;
+
+	wl_list_for_each(pnode, &output->base.paint_node_z_order_list,
+			 z_order_link) {
+		if (pnode->surface->resource &&
+		    weston_view_is_mapped(pnode->view))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Set up a seamless takeover of the screen contents
+ *
+ * If the output takes over the CRTC and mode that were already lit up when
+ * the backend started, e.g. by a boot splash, the framebuffer on screen is
+ * left untouched until a client has drawn something for the output, or
+ * until a timeout. The first commit then replaces it with a page flip,
+ * without a modeset, so the screen never blanks.
+ *
+ * Only atomic modesetting can guarantee not to disturb the CRTC meanwhile.
+ */
+static void
+drm_output_init_splash_hold(struct drm_output *output)
+{
+	struct drm_device *device = output->device;
+	struct drm_mode *mode = to_drm_mode(output->base.current_mode);
+	struct weston_head *head_base;
+	struct drm_head *head;
+	struct wl_event_loop *loop;
+
+	if (!device->atomic_modeset)
+		return;
+
+	wl_list_for_each(head_base, &output->base.head_list, output_link) {
+		head = to_drm_head(head_base);
+		if (head->inherited_fb_id == 0 ||
+		    head->inherited_crtc_id != output->crtc->crtc_id ||
+		    memcmp(&head->inherited_mode, &mode->mode_info,
+			   sizeof(mode->mode_info)) != 0)
+			return;
+	}
+
+	loop = wl_display_get_event_loop(output->base.compositor->wl_display);
+	output->splash_frame_timer = wl_event_loop_add_timer(loop,
+							     splash_frame_timeout,
+							     output);
+	if (!output->splash_frame_timer)
+		return;
+
+	output->splash_timer = wl_event_loop_add_timer(loop, splash_timeout,
+						       output);
+	if (!output->splash_timer) {
+		wl_event_source_remove(output->splash_frame_timer);
+		output->splash_frame_timer = NULL;
+		return;
+	}
+
+	wl_event_source_timer_update(output->splash_timer,
+				     DRM_SPLASH_HOLD_TIMEOUT_MS);
+	output->splash_hold = true;
+
+	weston_log("Output %s: keeping the inherited framebuffer until "
+		   "there is client content.\n", output->base.name);
+}
+
 /**
  * Returns true if the plane can be used on the given output for its current
  * repaint cycle.
@@ -326,6 +453,8 @@ drm_output_update_complete(struct drm_output *output, uint32_t flags,
 
 	if (output->state_cur->tear)
 		flags |= WESTON_FINISH_FRAME_TEARING;
+	if (output->state_cur->vrr)
+		flags |= WESTON_FINISH_FRAME_VRR;
 
 	ts.tv_sec = sec;
 	ts.tv_nsec = usec * 1000;
@@ -666,10 +795,26 @@ drm_output_repaint(struct weston_output *output_base, pixman_region32_t *damage)
 	 * hit assign_planes at all, so might not have valid output state
 	 * here. */
 	state = drm_pending_state_get_output(pending_state, output);
-	if (!state)
+
+	/* Leave the inherited framebuffer on screen without failing the
+	 * repaint, which would hold back the other outputs as well. */
+	if (output->splash_hold) {
+		if (!drm_output_has_client_content(output)) {
+			drm_output_state_free(state);
+			drm_output_skip_splash_frame(output);
+			return 0;
+		}
+		drm_output_release_splash(output);
+	}
+
+	if (!state) {
 		state = drm_output_state_duplicate(output->state_cur,
 						   pending_state,
 						   DRM_OUTPUT_STATE_CLEAR_PLANES);
+		/* Surface damage is flushed without assign_planes() having
+		 * seen it. */
+		drm_output_set_shm_scanout_view(output, NULL);
+	}
 	state->dpms = WESTON_DPMS_ON;
 
 	if (output_base->allow_protection)
@@ -767,6 +912,9 @@ drm_output_start_repaint_loop(struct weston_output *output_base)
 		goto finish_frame;
 	}
 
+	if (output->state_cur->vrr)
+		flags |= WESTON_FINISH_FRAME_VRR;
+
 	/* Try to get current msc and timestamp via instant query */
 	vbl.request.type |= drm_waitvblank_pipe(output->crtc);
 	ret = drmWaitVBlank(device->drm.fd, &vbl);
@@ -792,6 +940,11 @@ drm_output_start_repaint_loop(struct weston_output *output_base)
 		}
 	}
 
+	/* With VRR the panel is waiting for the next frame, a page flip
+	 * only to learn the timing would hold it back by a refresh. */
+	if (output->state_cur->vrr)
+		goto finish_frame;
+
 	/* Immediate query didn't provide valid timestamp.
 	 * Use pageflip fallback.
 	 */
@@ -1666,8 +1819,10 @@ drm_head_read_current_setup(struct drm_head *head, struct drm_device *device)
 
 		if (crtc == NULL)
 			return -1;
-		if (crtc->mode_valid)
+		if (crtc->mode_valid) {
 			head->inherited_mode = crtc->mode;
+			head->inherited_fb_id = crtc->buffer_id;
+		}
 		drmModeFreeCrtc(crtc);
 	}
 
@@ -1744,6 +1899,17 @@ drm_output_set_content_type(struct weston_output *base,
 	return -1;
 }
 
+static void
+drm_output_set_vrr_mode(struct weston_output *base,
+			enum weston_drm_vrr_mode mode)
+{
+	struct drm_output *output = to_drm_output(base);
+
+	assert(output);
+
+	output->vrr_mode = mode;
+}
+
 static int
 drm_output_init_gamma_size(struct drm_output *output)
 {
@@ -2177,6 +2343,9 @@ drm_output_enable(struct weston_output *base)
 	if (b->pageflip_timeout)
 		drm_output_pageflip_timer_create(output);
 
+	if (b->seamless_takeover)
+		drm_output_init_splash_hold(output);
+
 	if (b->compositor->renderer->type == WESTON_RENDERER_PIXMAN) {
 		if (drm_output_init_pixman(output, b) < 0) {
 			weston_log("Failed to init output pixman state\n");
@@ -2245,6 +2414,11 @@ drm_output_deinit(struct weston_output *base)
 	else
 		drm_output_fini_egl(output);
 
+	drm_output_release_splash(output);
+	if (output->splash_frame_timer)
+		wl_event_source_remove(output->splash_frame_timer);
+	output->splash_frame_timer = NULL;
+	drm_output_fini_shm_scanout(output);
 	drm_output_deinit_planes(output);
 	drm_output_detach_crtc(output);
 
@@ -2652,6 +2826,7 @@ drm_output_create(struct weston_backend *backend, const char *name)
 	struct drm_backend *b = container_of(backend, struct drm_backend, base);
 	struct drm_device *device;
 	struct drm_output *output;
+	const char *fail_commit;
 
 	device = drm_device_find_by_output(b->compositor, name);
 	if (!device)
@@ -2667,6 +2842,9 @@ drm_output_create(struct weston_backend *backend, const char *name)
 	wl_list_init(&output->disable_head);
 
 	output->max_bpc = 16;
+	output->vrr_mode = WESTON_DRM_VRR_MODE_NEVER;
+	fail_commit = getenv("WESTON_DRM_FAIL_COMMIT_OUTPUT");
+	output->fail_commit = fail_commit && strcmp(fail_commit, name) == 0;
 #ifdef BUILD_DRM_GBM
 	output->gbm_bo_flags = GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING;
 	output->surface_get_in_fence_fd = weston_load_module("libgbm.so", "gbm_surface_get_in_fence_fd", LIBDIR);
@@ -3258,6 +3436,8 @@ drm_destroy(struct weston_backend *backend)
 			      &b->drm->writeback_connector_list, link)
 		drm_writeback_destroy(writeback);
 
+	drm_fb_cache_fini(b->drm);
+
 #ifdef BUILD_DRM_GBM
 	if (b->gbm)
 		gbm_device_destroy(b->gbm);
@@ -3572,7 +3752,7 @@ planes_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 static void
 recorder_destroy(struct drm_output *output)
 {
-	vaapi_recorder_destroy(output->recorder);
+	output->recorder_iface->destroy(output->recorder);
 	output->recorder = NULL;
 
 	weston_output_disable_planes_decr(&output->base);
@@ -3586,6 +3766,7 @@ recorder_frame_notify(struct wl_listener *listener, void *data)
 {
 	struct drm_output *output;
 	struct drm_device *device;
+	pixman_region32_t *damage = data;
 	int fd, ret;
 
 	output = container_of(listener, struct drm_output,
@@ -3595,6 +3776,14 @@ recorder_frame_notify(struct wl_listener *listener, void *data)
 	if (!output->recorder)
 		return;
 
+	/* Nothing changed, let the encoder stretch the previous frame
+	 * instead of converting and encoding an identical one */
+	if (!pixman_region32_not_empty(damage) &&
+	    !output->recorder_need_frame) {
+		output->recorder_iface->repeat_frame(output->recorder);
+		return;
+	}
+
 	ret = drmPrimeHandleToFD(device->drm.fd,
 				 output->scanout_plane->state_cur->fb->handles[0],
 				 DRM_CLOEXEC, &fd);
@@ -3604,17 +3793,21 @@ recorder_frame_notify(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	ret = vaapi_recorder_frame(output->recorder, fd,
-				   output->scanout_plane->state_cur->fb->strides[0]);
+	ret = output->recorder_iface->frame(output->recorder, fd,
+					    output->scanout_plane->state_cur->fb->strides[0]);
 	if (ret < 0) {
 		weston_log("[libva recorder] aborted: %s\n", strerror(errno));
 		recorder_destroy(output);
+		return;
 	}
+
+	output->recorder_need_frame = (ret > 0);
 }
 
-static void *
-create_recorder(struct drm_backend *b, int width, int height,
-		const char *filename)
+static struct vaapi_recorder *
+create_recorder(struct drm_backend *b,
+		const struct vaapi_recorder_interface *recorder_iface,
+		int width, int height, const char *filename)
 {
 	struct drm_device *device = b->drm;
 	int fd;
@@ -3627,7 +3820,9 @@ create_recorder(struct drm_backend *b, int width, int height,
 	drmGetMagic(fd, &magic);
 	drmAuthMagic(device->drm.fd, magic);
 
-	return vaapi_recorder_create(fd, width, height, filename);
+	/* The front buffer is handed over as a dmabuf, which the software
+	 * encoder cannot take */
+	return recorder_iface->create(fd, width, height, filename, false);
 }
 
 static void
@@ -3653,11 +3848,19 @@ recorder_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 			return;
 		}
 
+		output->recorder_iface =
+			weston_load_module("vaapi-recorder.so",
+					   "vaapi_recorder_interface",
+					   LIBWESTON_MODULEDIR);
+		if (!output->recorder_iface)
+			return;
+
 		width = output->base.current_mode->width;
 		height = output->base.current_mode->height;
 
 		output->recorder =
-			create_recorder(b, width, height, "capture.h264");
+			create_recorder(b, output->recorder_iface,
+					width, height, "capture.h264");
 		if (!output->recorder) {
 			weston_log("failed to create vaapi recorder\n");
 			return;
@@ -3665,6 +3868,7 @@ recorder_binding(struct weston_keyboard *keyboard, const struct timespec *time,
 
 		weston_output_disable_planes_incr(&output->base);
 
+		output->recorder_need_frame = true;
 		output->recorder_frame_listener.notify = recorder_frame_notify;
 		wl_signal_add(&output->base.frame_signal,
 			      &output->recorder_frame_listener);
@@ -3701,6 +3905,7 @@ drm_device_create(struct drm_backend *backend, const char *name)
 	device->drm.fd = -1;
 	device->backend = backend;
 	device->gem_handle_refcnt = hash_table_create();
+	wl_list_init(&device->fb_cache);
 
 	udev_device = open_specific_drm_device(backend, device, name);
 	if (!udev_device) {
@@ -3777,6 +3982,7 @@ static const struct weston_drm_output_api api = {
 	drm_output_set_seat,
 	drm_output_set_max_bpc,
 	drm_output_set_content_type,
+	drm_output_set_vrr_mode,
 };
 
 /**
@@ -3951,6 +4157,8 @@ drm_backend_create(struct weston_compositor *compositor,
 	device->clean_hdr_blob = false;
 	device->drm.fd = -1;
 	device->backend = b;
+	device->gem_handle_refcnt = hash_table_create();
+	wl_list_init(&device->fb_cache);
 
 	b->drm = device;
 	wl_list_init(&b->kms_list);
@@ -3963,6 +4171,8 @@ drm_backend_create(struct weston_compositor *compositor,
 	b->shell_width = config->shell_width;
 	b->shell_height = config->shell_height;
 	b->pageflip_timeout = config->pageflip_timeout;
+	b->seamless_takeover = config->seamless_takeover;
+	b->shm_scanout = config->shm_scanout;
 	b->use_pixman_shadow = config->use_pixman_shadow;
 
 	b->debug = weston_compositor_add_log_scope(compositor, "drm-backend",
@@ -30,6 +30,7 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <sys/stat.h>
 
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -401,13 +402,154 @@ drm_close_gem_handle(struct linux_dmabuf_buffer *dmabuf)
 	struct drm_backend *b = to_drm_backend(dmabuf->compositor);
 	int i;
 
-	if (dmabuf->gem_handles[0] != 0) {
-		for (i = 0; i < dmabuf->attributes.n_planes; i++) {
-			struct drm_gem_close arg = { dmabuf->gem_handles[i], };
-			drmIoctl (b->drm->drm.fd, DRM_IOCTL_GEM_CLOSE, &arg);
-			dmabuf->gem_handles[i] = 0;
-		}
+	for (i = 0; i < dmabuf->attributes.n_planes; i++) {
+		gem_handle_put(b->drm, dmabuf->gem_handles[i]);
+		dmabuf->gem_handles[i] = 0;
+	}
+}
+
+/* Clients such as video players often wrap the same few dmabufs in a new
+ * wl_buffer every frame. Framebuffers are kept per device for the last
+ * DRM_FB_CACHE_SIZE dmabufs, so those skip the import and AddFB.
+ *
+ * A dmabuf is identified by the inode behind its fd. The cached fb holds its
+ * own reference to the GEM handles, which keeps the GEM object alive, and with
+ * it any imported dmabuf, so the inode cannot be handed out to another buffer
+ * while the entry exists. Entries are dropped when the client which created
+ * them goes away, so they do not pin the memory of clients which are gone.
+ */
+#define DRM_FB_CACHE_SIZE 32
+
+struct drm_fb_cache_key {
+	dev_t dev[MAX_DMABUF_PLANES];
+	ino_t ino[MAX_DMABUF_PLANES];
+	uint32_t offset[MAX_DMABUF_PLANES];
+	uint32_t stride[MAX_DMABUF_PLANES];
+	int n_planes;
+	int32_t width, height;
+	uint32_t format;
+	uint64_t modifier;
+	uint64_t dtrc_meta;
+	bool is_opaque;
+};
+
+struct drm_fb_cache_entry {
+	struct drm_fb_cache_key key;
+	struct drm_fb *fb;
+	struct drm_device *device;
+	struct wl_listener client_destroy_listener;
+	struct wl_list link; /* drm_device::fb_cache */
+};
+
+static void
+drm_fb_cache_entry_destroy(struct drm_device *device,
+			   struct drm_fb_cache_entry *entry)
+{
+	wl_list_remove(&entry->client_destroy_listener.link);
+	wl_list_remove(&entry->link);
+	device->fb_cache_len--;
+	drm_fb_unref(entry->fb);
+	free(entry);
+}
+
+#ifdef HAVE_GBM_FD_IMPORT
+static void
+drm_fb_cache_entry_client_destroyed(struct wl_listener *listener, void *data)
+{
+	struct drm_fb_cache_entry *entry =
+		container_of(listener, struct drm_fb_cache_entry,
+			     client_destroy_listener);
+
+	drm_fb_cache_entry_destroy(entry->device, entry);
+}
+
+static int
+drm_fb_cache_key_init(struct drm_fb_cache_key *key,
+		      struct linux_dmabuf_buffer *dmabuf, bool is_opaque)
+{
+	struct stat st;
+	int i;
+
+	/* Compared with memcmp(), padding included */
+	memset(key, 0, sizeof *key);
+
+	for (i = 0; i < dmabuf->attributes.n_planes; i++) {
+		if (fstat(dmabuf->attributes.fd[i], &st) < 0)
+			return -1;
+
+		key->dev[i] = st.st_dev;
+		key->ino[i] = st.st_ino;
+		key->offset[i] = dmabuf->attributes.offset[i];
+		key->stride[i] = dmabuf->attributes.stride[i];
+	}
+
+	key->n_planes = dmabuf->attributes.n_planes;
+	key->width = dmabuf->attributes.width;
+	key->height = dmabuf->attributes.height;
+	key->format = dmabuf->attributes.format;
+	key->modifier = dmabuf->attributes.modifier[0];
+	key->dtrc_meta = dmabuf->attributes.dtrc_meta;
+	key->is_opaque = is_opaque;
+
+	return 0;
+}
+
+static struct drm_fb *
+drm_fb_cache_lookup(struct drm_device *device,
+		    const struct drm_fb_cache_key *key)
+{
+	struct drm_fb_cache_entry *entry;
+
+	device->fb_cache_lookups++;
+
+	wl_list_for_each(entry, &device->fb_cache, link) {
+		if (memcmp(&entry->key, key, sizeof *key) != 0)
+			continue;
+
+		wl_list_remove(&entry->link);
+		wl_list_insert(&device->fb_cache, &entry->link);
+		device->fb_cache_hits++;
+
+		return drm_fb_ref(entry->fb);
 	}
+
+	return NULL;
+}
+
+static void
+drm_fb_cache_insert(struct drm_device *device, struct wl_client *client,
+		    const struct drm_fb_cache_key *key, struct drm_fb *fb)
+{
+	struct drm_fb_cache_entry *entry;
+
+	entry = zalloc(sizeof *entry);
+	if (!entry)
+		return;
+
+	if (device->fb_cache_len == DRM_FB_CACHE_SIZE)
+		drm_fb_cache_entry_destroy(device,
+			container_of(device->fb_cache.prev,
+				     struct drm_fb_cache_entry, link));
+
+	entry->key = *key;
+	entry->fb = drm_fb_ref(fb);
+	entry->device = device;
+	entry->client_destroy_listener.notify =
+		drm_fb_cache_entry_client_destroyed;
+	wl_client_add_destroy_listener(client,
+				       &entry->client_destroy_listener);
+	wl_list_insert(&device->fb_cache, &entry->link);
+	device->fb_cache_len++;
+}
+#endif
+
+void
+drm_fb_cache_fini(struct drm_device *device)
+{
+	struct drm_fb_cache_entry *entry, *tmp;
+
+	wl_list_for_each_safe(entry, tmp, &device->fb_cache, link)
+		drm_fb_cache_entry_destroy(device, entry);
 }
 
 static struct drm_fb *
@@ -422,6 +564,8 @@ drm_fb_get_from_dmabuf(struct linux_dmabuf_buffer *dmabuf,
 	return NULL;
 #else
 	struct drm_backend *backend = device->backend;
+	struct drm_fb_cache_key key;
+	bool cacheable;
 	struct drm_fb *fb;
 	int i;
 	uint32_t gem_handle[MAX_DMABUF_PLANES] = {0};
@@ -459,6 +603,20 @@ drm_fb_get_from_dmabuf(struct linux_dmabuf_buffer *dmabuf,
 	if (dmabuf->attributes.flags)
 		return NULL;
 
+	/* Only client buffers are cached, as entries go away with their
+	 * client */
+	cacheable = dmabuf->buffer_resource &&
+		    drm_fb_cache_key_init(&key, dmabuf, is_opaque) == 0;
+	if (cacheable) {
+		fb = drm_fb_cache_lookup(device, &key);
+		drm_debug(backend, "[dmabuf] dmabuf %p, fb cache %s, "
+			  "%u hits in %u lookups\n", dmabuf,
+			  fb ? "hit" : "miss",
+			  device->fb_cache_hits, device->fb_cache_lookups);
+		if (fb)
+			return fb;
+	}
+
 	fb = zalloc(sizeof *fb);
 	if (fb == NULL)
 		return NULL;
@@ -495,6 +653,7 @@ drm_fb_get_from_dmabuf(struct linux_dmabuf_buffer *dmabuf,
 
 	fb->num_planes = dmabuf->attributes.n_planes;
 	if (dmabuf->gem_handles[0] == 0) {
+		linux_dmabuf_buffer_gem_handle_close_cb (dmabuf, drm_close_gem_handle);
 		for (i = 0; i < dmabuf->attributes.n_planes; i++) {
 			int ret;
 			ret = drmPrimeFDToHandle (fb->fd, dmabuf->attributes.fd[i], &gem_handle[i]);
@@ -502,14 +661,18 @@ drm_fb_get_from_dmabuf(struct linux_dmabuf_buffer *dmabuf,
 				weston_log ("got gem_handle %x\n", gem_handle[i]);
 				goto err_free;
 			}
-			fb->handles[i] = dmabuf->gem_handles[i] = gem_handle[i];
+			dmabuf->gem_handles[i] = gem_handle_get(device, gem_handle[i]);
 		}
-		linux_dmabuf_buffer_gem_handle_close_cb (dmabuf, drm_close_gem_handle);
-	} else {
-		for (i = 0; i < dmabuf->attributes.n_planes; i++)
-			fb->handles[i] = dmabuf->gem_handles[i];
 	}
 
+	/* The handles are reference counted, as the kernel hands out the same
+	 * handle for every import of a dmabuf. The fb holds its own
+	 * references, so that it stays valid in the cache after the dmabuf is
+	 * gone. */
+	for (i = 0; i < dmabuf->attributes.n_planes; i++)
+		fb->handles[i] = gem_handle_get(device, dmabuf->gem_handles[i]);
+	fb->scanout_device = device;
+
 	if (fb->handles[0] != 0)
 		goto add_fb;
 
@@ -543,6 +706,11 @@ add_fb:
 		goto err_free;
 	}
 
+	if (cacheable)
+		drm_fb_cache_insert(device,
+				    wl_resource_get_client(dmabuf->buffer_resource),
+				    &key, fb);
+
 	return fb;
 
 err_free:
@@ -191,6 +191,7 @@ const struct drm_property_info connector_props[] = {
 		.enum_values = content_type_enums,
 		.num_enum_values = WDRM_CONTENT_TYPE__COUNT,
 	},
+	[WDRM_CONNECTOR_VRR_CAPABLE] = { .name = "vrr_capable", },
 };
 
 const struct drm_property_info crtc_props[] = {
@@ -1228,7 +1229,8 @@ drm_output_apply_state_atomic(struct drm_output_state *state,
 						     WDRM_CRTC_DEGAMMA_LUT, 0);
 		}
 		ret |= crtc_add_prop_zero_ok(req, crtc, WDRM_CRTC_CTM, 0);
-		ret |= crtc_add_prop_zero_ok(req, crtc, WDRM_CRTC_VRR_ENABLED, 0);
+		ret |= crtc_add_prop_zero_ok(req, crtc, WDRM_CRTC_VRR_ENABLED,
+					     state->vrr);
 
 		/* No need for the DPMS property, since it is implicit in
 		 * routing and CRTC activity. */
@@ -1406,6 +1408,148 @@ drm_pending_state_clear_tearing(struct drm_pending_state *pending_state)
 	}
 }
 
+/* Whether the plane is still scanning out the framebuffer an output has
+ * inherited, and must not be disabled when resetting the state. */
+static bool
+drm_plane_holds_splash(struct drm_backend *b, struct drm_plane *plane)
+{
+	struct weston_output *base;
+
+	wl_list_for_each(base, &b->compositor->output_list, link) {
+		struct drm_output *output = to_drm_output(base);
+
+		if (output && output->splash_hold &&
+		    output->scanout_plane == plane)
+			return true;
+	}
+
+	return false;
+}
+
+static int
+drm_output_states_test(struct drm_device *device,
+		       struct drm_output_state **states, int count)
+{
+	drmModeAtomicReq *req = drmModeAtomicAlloc();
+	uint32_t flags = DRM_MODE_ATOMIC_TEST_ONLY;
+	int ret = 0;
+	int i;
+
+	if (!req)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		if (states[i]->output->fail_commit)
+			ret = -EINVAL;
+		ret |= drm_output_apply_state_atomic(states[i], req, &flags);
+	}
+	if (ret == 0)
+		ret = drmModeAtomicCommit(device->drm.fd, req, flags, device);
+
+	drmModeAtomicFree(req);
+	return ret;
+}
+
+static void
+drm_output_states_bisect(struct drm_device *device,
+			 struct drm_output_state **states, bool *failed,
+			 int count)
+{
+	int half = count / 2;
+
+	if (drm_output_states_test(device, states, count) == 0)
+		return;
+
+	if (count == 1) {
+		failed[0] = true;
+		return;
+	}
+
+	drm_output_states_bisect(device, states, failed, half);
+	drm_output_states_bisect(device, states + half, failed + half,
+				 count - half);
+}
+
+/**
+ * Drop the outputs which keep a pending state from being committed
+ *
+ * After a commit of several outputs failed, bisect the output states with
+ * test commits: a group that passes is kept, a failing one is split in two,
+ * down to single outputs. The states of outputs failing on their own are
+ * freed and the core retries their repaint one frame later, so that the
+ * remaining outputs can still be committed together on time.
+ *
+ * @param pending_state The pending state whose commit failed
+ * @returns The number of outputs dropped from the pending state
+ */
+static int
+drm_pending_state_drop_failed_outputs(struct drm_pending_state *pending_state)
+{
+	struct drm_device *device = pending_state->device;
+	struct drm_backend *b = device->backend;
+	struct drm_output_state *output_state;
+	struct drm_output_state **states;
+	bool *failed;
+	int count = 0;
+	int dropped = 0;
+	int i;
+
+	wl_list_for_each(output_state, &pending_state->output_list, link) {
+		if (!output_state->output->virtual)
+			count++;
+	}
+
+	if (count < 2)
+		return 0;
+
+	states = calloc(count, sizeof(*states));
+	failed = calloc(count, sizeof(*failed));
+	if (!states || !failed) {
+		free(failed);
+		free(states);
+		return 0;
+	}
+
+	i = 0;
+	wl_list_for_each(output_state, &pending_state->output_list, link) {
+		if (!output_state->output->virtual)
+			states[i++] = output_state;
+	}
+
+	/* The whole set has just failed, no need to test it again. */
+	drm_output_states_bisect(device, states, failed, count / 2);
+	drm_output_states_bisect(device, states + count / 2,
+				 failed + count / 2, count - count / 2);
+
+	for (i = 0; i < count; i++) {
+		struct drm_output *output = states[i]->output;
+
+		if (!failed[i])
+			continue;
+
+		weston_log("atomic: output %s fails its commit, "
+			   "committing the other outputs without it\n",
+			   output->base.name);
+		drm_debug(b, "\t\t[atomic] dropping state of output %s (%lu)\n",
+			  output->base.name, (unsigned long) output->base.id);
+
+		if (drm_output_get_writeback_state(output) !=
+		    DRM_OUTPUT_WB_SCREENSHOT_OFF)
+			drm_writeback_fail_screenshot(output->wb_state,
+						      "drm: atomic commit failed");
+
+		drm_output_state_free(states[i]);
+		output->commit_failed = true;
+		weston_output_repaint_dropped(&output->base);
+		dropped++;
+	}
+
+	free(failed);
+	free(states);
+
+	return dropped;
+}
+
 /**
  * Helper function used only by drm_pending_state_apply, with the same
  * guarantees and constraints as that function.
@@ -1421,6 +1565,7 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 	drmModeAtomicReq *req = drmModeAtomicAlloc();
 	uint32_t flags, tear_flag = 0;
 	bool may_tear = true;
+	bool fail_commit = false;
 	int ret = 0;
 	drm_magic_t magic;
 
@@ -1517,6 +1662,13 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 		/* Disable all the planes; planes which are being used will
 		 * override this state in the output-state application. */
 		wl_list_for_each(plane, &device->plane_list, link) {
+			if (drm_plane_holds_splash(b, plane)) {
+				drm_debug(b, "\t\t[atomic] keeping plane %lu "
+					  "with the inherited FB\n",
+					  (unsigned long) plane->plane_id);
+				continue;
+			}
+
 			drm_debug(b, "\t\t[atomic] starting with plane %lu disabled\n",
 				  (unsigned long) plane->plane_id);
 			plane_add_prop(req, plane, WDRM_PLANE_CRTC_ID, 0);
@@ -1532,6 +1684,7 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 		if (mode == DRM_STATE_APPLY_SYNC)
 			assert(output_state->dpms == WESTON_DPMS_OFF);
 		may_tear &= output_state->tear;
+		fail_commit |= output_state->output->fail_commit;
 		ret |= drm_output_apply_state_atomic(output_state, req, &flags);
 	}
 
@@ -1547,9 +1700,14 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 			drmAuthMagic(device->drm.fd, magic) == 0)) {
 		drmSetMaster(device->drm.fd);
 	}
-	ret = drmModeAtomicCommit(device->drm.fd, req, flags | tear_flag,
-				  device);
-	drm_debug(b, "[atomic] drmModeAtomicCommit\n");
+	if (fail_commit && mode != DRM_STATE_TEST_ONLY) {
+		drm_debug(b, "[atomic] failing commit on request\n");
+		ret = -EINVAL;
+	} else {
+		ret = drmModeAtomicCommit(device->drm.fd, req,
+					  flags | tear_flag, device);
+		drm_debug(b, "[atomic] drmModeAtomicCommit\n");
+	}
 	if (ret != 0 && may_tear && mode == DRM_STATE_TEST_ONLY) {
 		/* If we failed trying to set up a tearing commit, try again
 		 * without tearing. If that succeeds, knock the tearing flag
@@ -1567,6 +1725,16 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 		return ret;
 	}
 
+	/* Unless the outputs need a modeset, which has to be done for all of
+	 * them at once, find out which output the kernel refuses and keep
+	 * the others on time. */
+	if (ret != 0 && ret != -EACCES && mode == DRM_STATE_APPLY_ASYNC &&
+	    !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET) &&
+	    drm_pending_state_drop_failed_outputs(pending_state) > 0) {
+		drmModeAtomicFree(req);
+		return drm_pending_state_apply_atomic(pending_state, mode);
+	}
+
 	if (ret != 0) {
 		wl_list_for_each(output_state, &pending_state->output_list, link)
 			if (drm_output_get_writeback_state(output_state->output) != DRM_OUTPUT_WB_SCREENSHOT_OFF)
@@ -607,6 +607,8 @@ update_head_from_connector(struct drm_head *head)
 	weston_head_set_supported_eotf_mask(&head->base, dhi.eotf_mask);
 	weston_head_set_non_desktop(&head->base,
 				    check_non_desktop(connector, props));
+	head->vrr_capable = drm_property_get_value(
+		&connector->props[WDRM_CONNECTOR_VRR_CAPABLE], props, 0);
 	weston_head_set_subpixel(&head->base,
 				 drm_subpixel_to_wayland(conn->subpixel));
 
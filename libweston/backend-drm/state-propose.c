@@ -138,7 +138,11 @@ drm_output_try_paint_node_on_plane(struct drm_plane *plane,
 
 	/* Take a reference on the buffer so that we don't release it
 	 * back to the client until we're done with it; cursor buffers
-	 * don't require a reference since we copy them. */
+	 * and SHM scanout buffers don't require a reference since we copy
+	 * them. */
+	if (fb->type == BUFFER_PIXMAN_DUMB)
+		return state;
+
 	assert(state->fb_ref.buffer.buffer == NULL);
 	assert(state->fb_ref.release.buffer_release == NULL);
 	weston_buffer_reference(&state->fb_ref.buffer,
@@ -296,6 +300,251 @@ drm_output_prepare_cursor_paint_node(struct drm_output_state *output_state,
 }
 #endif
 
+static void
+drm_output_handle_shm_scanout_view_destroy(struct wl_listener *listener,
+					   void *data)
+{
+	struct drm_output *output =
+		container_of(listener, struct drm_output,
+			     shm_scanout_view_destroy_listener);
+
+	drm_output_set_shm_scanout_view(output, NULL);
+}
+
+/** Set the view whose content the SHM scanout buffers of an output hold.
+ *
+ * Only damage of this view is tracked in the stale regions; any other view
+ * has to be copied in full, see drm_output_prepare_shm_scanout().
+ */
+void
+drm_output_set_shm_scanout_view(struct drm_output *output,
+				struct weston_view *ev)
+{
+	if (output->shm_scanout_view == ev)
+		return;
+
+	if (output->shm_scanout_view)
+		wl_list_remove(&output->shm_scanout_view_destroy_listener.link);
+
+	output->shm_scanout_view = ev;
+
+	if (ev) {
+		output->shm_scanout_view_destroy_listener.notify =
+			drm_output_handle_shm_scanout_view_destroy;
+		wl_signal_add(&ev->destroy_signal,
+			      &output->shm_scanout_view_destroy_listener);
+	}
+}
+
+void
+drm_output_fini_shm_scanout(struct drm_output *output)
+{
+	unsigned int i;
+
+	drm_output_set_shm_scanout_view(output, NULL);
+
+	for (i = 0; i < ARRAY_LENGTH(output->shm_scanout_fb); i++) {
+		if (!output->shm_scanout_fb[i])
+			continue;
+
+		drm_fb_unref(output->shm_scanout_fb[i]);
+		output->shm_scanout_fb[i] = NULL;
+		pixman_region32_fini(&output->shm_scanout_stale[i]);
+	}
+}
+
+static bool
+drm_output_is_shm_scanout_fb(struct drm_output *output, struct drm_fb *fb)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(output->shm_scanout_fb); i++) {
+		if (fb && fb == output->shm_scanout_fb[i])
+			return true;
+	}
+
+	return false;
+}
+
+/* Called once per repaint, before the surface damage gets flushed: what the
+ * SHM scanout view changed since the last repaint is now out of date in
+ * every SHM scanout buffer. */
+static void
+drm_output_accumulate_shm_scanout_damage(struct drm_output *output)
+{
+	struct weston_surface *surface;
+	pixman_region32_t damage;
+	unsigned int i;
+
+	if (!output->shm_scanout_view)
+		return;
+
+	surface = output->shm_scanout_view->surface;
+	if (!pixman_region32_not_empty(&surface->damage))
+		return;
+
+	pixman_region32_init(&damage);
+	weston_surface_to_buffer_region(surface, &surface->damage, &damage);
+
+	for (i = 0; i < ARRAY_LENGTH(output->shm_scanout_fb); i++) {
+		if (!output->shm_scanout_fb[i])
+			continue;
+
+		pixman_region32_union(&output->shm_scanout_stale[i],
+				      &output->shm_scanout_stale[i], &damage);
+	}
+
+	pixman_region32_fini(&damage);
+}
+
+static bool
+drm_output_shm_scanout_suitable(struct drm_output *output,
+				struct weston_paint_node *pnode)
+{
+	struct weston_view *ev = pnode->view;
+	struct weston_surface *surface = ev->surface;
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	struct weston_buffer_viewport *viewport = &surface->buffer_viewport;
+	struct weston_mode *mode = output->base.current_mode;
+
+	if (!output->backend->shm_scanout || !output->device->atomic_modeset)
+		return false;
+
+	/* Other views of the surface could flush its damage on other
+	 * outputs before we get to see it. */
+	if (surface->output_mask != (1u << output->base.id))
+		return false;
+
+	/* Only a buffer shown 1:1 on the whole output can be copied as a
+	 * plain series of rows. */
+	if (buffer->width != mode->width || buffer->height != mode->height ||
+	    viewport->buffer.src_width != wl_fixed_from_int(-1) ||
+	    viewport->surface.width != -1 ||
+	    !pnode->valid_transform ||
+	    pnode->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+	    pnode->needs_filtering)
+		return false;
+
+	return weston_view_matches_output_entirely(ev, &output->base) &&
+	       weston_view_is_opaque(ev, &ev->transform.boundingbox);
+}
+
+/** Copy a fullscreen SHM view into a dumb buffer for the scanout plane
+ *
+ * Two dumb buffers alternate, so that the one written to is never the one on
+ * screen. Each keeps the region where it lacks the view's current content,
+ * and only that is copied from the SHM buffer.
+ *
+ * @param state The output state being proposed
+ * @param pnode The paint node of the SHM view
+ * @returns A reference to the dumb buffer, or NULL if the view can't be shown
+ * this way.
+ */
+static struct drm_fb *
+drm_output_prepare_shm_scanout(struct drm_output_state *state,
+			       struct weston_paint_node *pnode)
+{
+	struct drm_output *output = state->output;
+	struct drm_device *device = output->device;
+	struct drm_backend *b = device->backend;
+	struct drm_plane *plane = output->scanout_plane;
+	struct weston_view *ev = pnode->view;
+	struct weston_buffer *buffer = ev->surface->buffer_ref.buffer;
+	struct weston_mode *mode = output->base.current_mode;
+	const struct pixel_format_info *format;
+	struct drm_fb *fb;
+	pixman_region32_t *stale;
+	pixman_box32_t *rects;
+	unsigned int i;
+	int32_t stride, cpp;
+	uint8_t *src;
+	int n, j, y;
+
+	if (!drm_output_shm_scanout_suitable(output, pnode))
+		return NULL;
+
+	format = pixel_format_get_opaque_substitute(buffer->pixel_format);
+	if (!format || !format->bpp ||
+	    !weston_drm_format_array_find_format(&plane->formats,
+						 format->format)) {
+		drm_debug(b, "				[view] not copying SHM view %p for "
+			     "scanout: format %s not supported\n", ev,
+			  buffer->pixel_format->drm_format_name);
+		return NULL;
+	}
+
+	/* Mode or format changed: start over. */
+	for (i = 0; i < ARRAY_LENGTH(output->shm_scanout_fb); i++) {
+		fb = output->shm_scanout_fb[i];
+		if (fb && (fb->width != mode->width ||
+			   fb->height != mode->height ||
+			   fb->format != format)) {
+			drm_output_fini_shm_scanout(output);
+			break;
+		}
+	}
+
+	i = (plane->state_cur->fb &&
+	     plane->state_cur->fb == output->shm_scanout_fb[0]) ? 1 : 0;
+	if (!output->shm_scanout_fb[i]) {
+		fb = drm_fb_create_dumb(device, mode->width, mode->height,
+					format->format);
+		if (!fb) {
+			drm_debug(b, "				[view] not copying SHM view %p "
+				     "for scanout: no dumb buffer\n", ev);
+			return NULL;
+		}
+		output->shm_scanout_fb[i] = fb;
+		pixman_region32_init_rect(&output->shm_scanout_stale[i], 0, 0,
+					  mode->width, mode->height);
+	}
+	fb = output->shm_scanout_fb[i];
+	stale = &output->shm_scanout_stale[i];
+
+	if (ev != output->shm_scanout_view) {
+		unsigned int k;
+
+		for (k = 0; k < ARRAY_LENGTH(output->shm_scanout_fb); k++) {
+			if (!output->shm_scanout_fb[k])
+				continue;
+			pixman_region32_fini(&output->shm_scanout_stale[k]);
+			pixman_region32_init_rect(&output->shm_scanout_stale[k],
+						  0, 0,
+						  mode->width, mode->height);
+		}
+		drm_output_set_shm_scanout_view(output, ev);
+	}
+
+	pixman_region32_intersect_rect(stale, stale, 0, 0,
+				       mode->width, mode->height);
+	rects = pixman_region32_rectangles(stale, &n);
+	if (n > 0) {
+		drm_debug(b, "				[view] copying %d rectangle(s) of SHM "
+			     "view %p for scanout\n", n, ev);
+
+		cpp = format->bpp / 8;
+		stride = wl_shm_buffer_get_stride(buffer->shm_buffer);
+
+		wl_shm_buffer_begin_access(buffer->shm_buffer);
+		src = wl_shm_buffer_get_data(buffer->shm_buffer);
+		for (j = 0; j < n; j++) {
+			size_t len = (rects[j].x2 - rects[j].x1) * cpp;
+
+			for (y = rects[j].y1; y < rects[j].y2; y++) {
+				memcpy((uint8_t *) fb->map +
+				       y * fb->strides[0] + rects[j].x1 * cpp,
+				       src + y * stride + rects[j].x1 * cpp,
+				       len);
+			}
+		}
+		wl_shm_buffer_end_access(buffer->shm_buffer);
+
+		pixman_region32_clear(stale);
+	}
+
+	return drm_fb_ref(fb);
+}
+
 static void
 drm_output_check_zpos_plane_states(struct drm_output_state *state)
 {
@@ -462,11 +711,25 @@ drm_output_find_plane_for_view(struct drm_output_state *state,
 		return NULL;
 	}
 
+	scanout_has_view_assigned =
+		drm_output_check_plane_has_view_assigned(output->scanout_plane,
+							 state);
+
+	/* Don't copy SHM content for a scanout plane we can't have. */
 	buffer = ev->surface->buffer_ref.buffer;
+	if (buffer->type == WESTON_BUFFER_SHM &&
+	    mode == DRM_OUTPUT_PROPOSE_STATE_PLANES_ONLY &&
+	    !scanout_has_view_assigned &&
+	    drm_plane_is_available(output->scanout_plane, output))
+		fb = drm_output_prepare_shm_scanout(state, pnode);
+
 	if (buffer->type == WESTON_BUFFER_SOLID) {
 		pnode->try_view_on_plane_failure_reasons |=
 			FAILURE_REASONS_FB_FORMAT_INCOMPATIBLE;
 		return NULL;
+	} else if (fb) {
+		/* SHM content copied for the scanout plane */
+		possible_plane_mask = (1 << output->scanout_plane->plane_idx);
 	} else if (buffer->type == WESTON_BUFFER_SHM) {
 		if (!output->cursor_plane || device->cursors_are_broken) {
 			pnode->try_view_on_plane_failure_reasons |=
@@ -529,9 +792,6 @@ drm_output_find_plane_for_view(struct drm_output_state *state,
 
 	view_matches_entire_output =
 		weston_view_matches_output_entirely(ev, &output->base);
-	scanout_has_view_assigned =
-		drm_output_check_plane_has_view_assigned(output->scanout_plane,
-							 state);
 
 	/* assemble a list with possible candidates */
 	wl_list_for_each(plane, &device->plane_list, link) {
@@ -657,6 +917,49 @@ drm_output_find_plane_for_view(struct drm_output_state *state,
 	return ps;
 }
 
+/* Whether the next frame should be shown with a variable refresh rate. In
+ * fullscreen mode, only a single opaque view covering the whole output may
+ * drive the refresh, the cursor aside: anything else shown with it would be
+ * updated at the pace of that one client. */
+static bool
+drm_output_want_vrr(struct drm_output *output)
+{
+	struct weston_compositor *compositor = output->base.compositor;
+	struct weston_paint_node *pnode;
+	struct drm_head *head;
+
+	if (output->vrr_mode == WESTON_DRM_VRR_MODE_NEVER)
+		return false;
+
+	if (!output->device->atomic_modeset || !output->crtc ||
+	    output->crtc->props_crtc[WDRM_CRTC_VRR_ENABLED].prop_id == 0)
+		return false;
+
+	wl_list_for_each(head, &output->base.head_list, base.output_link) {
+		if (!head->vrr_capable)
+			return false;
+	}
+
+	if (output->vrr_mode == WESTON_DRM_VRR_MODE_ALWAYS)
+		return true;
+
+	wl_list_for_each(pnode, &output->base.paint_node_z_order_list,
+			 z_order_link) {
+		struct weston_view *ev = pnode->view;
+
+		if (!(ev->output_mask & (1u << output->base.id)))
+			continue;
+
+		if (ev->layer_link.layer == &compositor->cursor_layer)
+			continue;
+
+		return weston_view_matches_output_entirely(ev, &output->base) &&
+		       weston_view_is_opaque(ev, &ev->transform.boundingbox);
+	}
+
+	return false;
+}
+
 static struct drm_output_state *
 drm_output_propose_state(struct weston_output *output_base,
 			 struct drm_pending_state *pending_state,
@@ -670,7 +973,6 @@ drm_output_propose_state(struct weston_output *output_base,
 	struct drm_plane_state *scanout_state = NULL;
 
 	pixman_region32_t bottom_region;
-	pixman_region32_t occluded_region;
 
 	bool renderer_ok = (mode != DRM_OUTPUT_PROPOSE_STATE_PLANES_ONLY);
 	int ret;
@@ -694,6 +996,8 @@ drm_output_propose_state(struct weston_output *output_base,
 	state->tear = device->tearing_supported &&
 		      mode == DRM_OUTPUT_PROPOSE_STATE_PLANES_ONLY;
 
+	state->vrr = drm_output_want_vrr(output);
+
 	/* We implement mixed mode by progressively creating and testing
 	 * incremental states, of scanout + overlay + cursor. Since we
 	 * walk our views top to bottom, the scanout plane is last, however
@@ -750,17 +1054,9 @@ drm_output_propose_state(struct weston_output *output_base,
 				scanout_state->zpos);
 	}
 
-	/* - bottom_region contains the total region which which will be
-	 *   covered by the renderer and underlay region.
-	 * - occluded_region contains the total region which which will be
-	 *   covered by the renderer and hardware planes, where the view's
-	 *   visible-and-opaque region is added in both cases (the view's
-	 *   opaque region  accumulates there for each view); it is being used
-	 *   to skip the view, if it is completely occluded; includes the
-	 *   situation where occluded_region covers entire output's region.
-	 */
+	/* bottom_region contains the total region which which will be
+	 * covered by the renderer and underlay region. */
 	pixman_region32_init(&bottom_region);
-	pixman_region32_init(&occluded_region);
 
 	wl_list_for_each(pnode, &output->base.paint_node_z_order_list,
 			 z_order_link) {
@@ -769,7 +1065,6 @@ drm_output_propose_state(struct weston_output *output_base,
 		bool force_renderer = false;
 		pixman_region32_t clipped_view;
 		pixman_region32_t surface_overlap;
-		bool totally_occluded = false;
 
 		drm_debug(b, "\t\t\t[view] evaluating view %p for "
 		             "output %s (%lu)\n",
@@ -796,26 +1091,21 @@ drm_output_propose_state(struct weston_output *output_base,
 			continue;
 		}
 
-		/* Ignore views we know to be totally occluded. */
+		/* Ignore views the core found to be totally occluded,
+		 * including the case where opaque views cover the entire
+		 * output. */
+		if (pnode->occluded) {
+			drm_debug(b, "\t\t\t\t[view] ignoring view %p "
+			             "(occluded on our output)\n", ev);
+			continue;
+		}
+
 		pixman_region32_init(&clipped_view);
 		pixman_region32_intersect(&clipped_view,
 					  &ev->transform.boundingbox,
 					  &output->base.region);
 
 		pixman_region32_init(&surface_overlap);
-		pixman_region32_subtract(&surface_overlap, &clipped_view,
-					 &occluded_region);
-		/* if the view is completely occluded then ignore that
-		 * view; includes the case where occluded_region covers
-		 * the entire output */
-		totally_occluded = !pixman_region32_not_empty(&surface_overlap);
-		if (totally_occluded) {
-			drm_debug(b, "\t\t\t\t[view] ignoring view %p "
-			             "(occluded on our output)\n", ev);
-			pixman_region32_fini(&surface_overlap);
-			pixman_region32_fini(&clipped_view);
-			continue;
-		}
 
 		/* We only assign planes to views which are exclusively present
 		 * on our output. */
@@ -921,24 +1211,10 @@ drm_output_propose_state(struct weston_output *output_base,
 					      &clipped_view);
 		}
 
-		/* Opaque areas of our clipped view occlude areas behind it;
-		 * however, anything not in the opaque region (which is the
-		 * entire clipped area if the whole view is known to be
-		 * opaque) does not necessarily occlude what's behind it, as
-		 * it could be alpha-blended. */
-		if (!weston_view_is_opaque(ev, &clipped_view))
-			pixman_region32_intersect(&clipped_view,
-						  &clipped_view,
-						  &ev->transform.opaque);
-		pixman_region32_union(&occluded_region,
-				      &occluded_region,
-				      &clipped_view);
-
 		pixman_region32_fini(&clipped_view);
 	}
 
 	pixman_region32_fini(&bottom_region);
-	pixman_region32_fini(&occluded_region);
 
 	/* In renderer-only mode, we can't test the state as we don't have a
 	 * renderer buffer yet. */
@@ -969,7 +1245,6 @@ drm_output_propose_state(struct weston_output *output_base,
 
 err_region:
 	pixman_region32_fini(&bottom_region);
-	pixman_region32_fini(&occluded_region);
 err:
 	drm_output_state_free(state);
 	return NULL;
@@ -994,7 +1269,13 @@ drm_assign_planes(struct weston_output *output_base)
 	drm_debug(b, "\t[repaint] preparing state for output %s (%lu)\n",
 		  output_base->name, (unsigned long) output_base->id);
 
-	if (!device->sprites_are_broken && !output->virtual && b->gbm) {
+	drm_output_accumulate_shm_scanout_damage(output);
+
+	if (output->commit_failed) {
+		drm_debug(b, "\t[repaint] last commit failed, not using "
+			     "planes\n");
+		output->commit_failed = false;
+	} else if (!device->sprites_are_broken && !output->virtual && b->gbm) {
 		drm_debug(b, "\t[repaint] trying planes-only build state\n");
 		state = drm_output_propose_state(output_base, pending_state, mode);
 		if (!state) {
@@ -1038,6 +1319,7 @@ drm_assign_planes(struct weston_output *output_base)
 			 z_order_link) {
 		struct weston_view *ev = pnode->view;
 		struct drm_plane *target_plane = NULL;
+		bool copied = false;
 
 		/* If this view doesn't touch our output at all, there's no
 		 * reason to do anything with it. */
@@ -1064,6 +1346,11 @@ drm_assign_planes(struct weston_output *output_base)
 				 (ev->surface->width <= device->cursor_width &&
 		       		  ev->surface->height <= device->cursor_height))
 				ev->surface->keep_buffer = true;
+			else if (buffer->type == WESTON_BUFFER_SHM &&
+				 b->shm_scanout &&
+				 buffer->width == output_base->current_mode->width &&
+				 buffer->height == output_base->current_mode->height)
+				ev->surface->keep_buffer = true;
 		}
 
 		/* This is a bit unpleasant, but lacking a temporary place to
@@ -1075,6 +1362,8 @@ drm_assign_planes(struct weston_output *output_base)
 			if (plane_state->ev == ev) {
 				plane_state->ev = NULL;
 				target_plane = plane_state->plane;
+				copied = drm_output_is_shm_scanout_fb(output,
+								      plane_state->fb);
 				break;
 			}
 		}
@@ -1091,9 +1380,9 @@ drm_assign_planes(struct weston_output *output_base)
 			pnode->need_through_hole = false;
 		}
 
-		if (!target_plane ||
+		if (!target_plane || copied ||
 		    target_plane->type == WDRM_PLANE_TYPE_CURSOR) {
-			/* cursor plane & renderer involve a copy */
+			/* cursor plane, SHM scanout & renderer involve a copy */
 			ev->psf_flags = 0;
 		} else {
 			/* All other planes are a direct scanout of a
@@ -1117,6 +1406,17 @@ drm_assign_planes(struct weston_output *output_base)
 			drm_output_set_cursor_view(output, NULL);
 	}
 
+	/* Likewise, damage of the SHM scanout view is only tracked while it
+	 * is on the scanout plane. */
+	if (output->shm_scanout_view) {
+		plane_state =
+			drm_output_state_get_existing_plane(state,
+							    output->scanout_plane);
+		if (!plane_state ||
+		    !drm_output_is_shm_scanout_fb(output, plane_state->fb))
+			drm_output_set_shm_scanout_view(output, NULL);
+	}
+
 	if (drm_output_get_writeback_state(output) == DRM_OUTPUT_WB_SCREENSHOT_PREPARE_COMMIT)
 		drm_writeback_reference_planes(wb_state, &state->plane_list);
 }
@@ -29,15 +29,28 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/time.h>
 #include <stdbool.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_UDMABUF_H
+#include <linux/udmabuf.h>
+#endif
+
+#ifdef BUILD_HEADLESS_GBM
+#include <gbm.h>
+#endif
 
 #include <libweston/libweston.h>
 #include <libweston/backend-headless.h>
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
 #include "linux-explicit-synchronization.h"
 #include "pixel-formats.h"
 #include "pixman-renderer.h"
@@ -46,6 +59,7 @@
 #include "shared/weston-drm-fourcc.h"
 #include "shared/weston-egl-ext.h"
 #include "shared/cairo-util.h"
+#include "shared/timespec-util.h"
 #include "shared/xalloc.h"
 #include "linux-dmabuf.h"
 #include "output-capture.h"
@@ -63,6 +77,29 @@ struct headless_backend {
 
 	const struct pixel_format_info **formats;
 	unsigned int formats_count;
+
+	int refresh;			/* mHz */
+	enum weston_headless_pacing pacing;
+	int64_t min_period_nsec;	/* of the refresh rate */
+	int64_t max_period_nsec;	/* of the VRR minimum refresh rate */
+
+	/* Allocator of the GL dmabuf renderbuffers, when in use */
+	bool gl_dmabuf;
+	int dmabuf_dev_fd;		/* render node or /dev/udmabuf */
+#ifdef BUILD_HEADLESS_GBM
+	struct gbm_device *gbm;
+#endif
+};
+
+/* Enough that the GPU can work on one frame while the next is recorded */
+#define HEADLESS_DMABUF_COUNT 3
+
+struct headless_dmabuf {
+	struct dmabuf_attributes attributes;
+	struct weston_renderbuffer *renderbuffer;
+#ifdef BUILD_HEADLESS_GBM
+	struct gbm_bo *bo;
+#endif
 };
 
 struct headless_head {
@@ -75,11 +112,21 @@ struct headless_output {
 
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
+	struct wl_event_source *finish_frame_idle;
 	struct weston_renderbuffer *renderbuffer;
 
+	/* The last virtual vblank, and the one the frame in flight is
+	 * going to be finished at */
+	struct timespec vblank;
+	struct timespec pending_vblank;
+	uint32_t pending_flags;
+
 	struct frame *frame;
 	struct {
 		struct weston_gl_borders borders;
+		struct headless_dmabuf dmabufs[HEADLESS_DMABUF_COUNT];
+		int dmabuf_count;
+		int current_dmabuf;
 	} gl;
 };
 
@@ -116,29 +163,147 @@ to_headless_backend(struct weston_backend *base)
 	return container_of(base, struct headless_backend, base);
 }
 
+/* The latest virtual vblank at or before now, on the grid of the
+ * refresh period that started with the first one */
+static void
+headless_output_vblank_before(struct headless_output *output,
+			      const struct timespec *now,
+			      struct timespec *vblank)
+{
+	int64_t period = output->backend->min_period_nsec;
+	int64_t since;
+
+	if (!timespec_is_zero(&output->vblank)) {
+		since = timespec_sub_to_nsec(now, &output->vblank);
+		if (since >= 0) {
+			timespec_add_nsec(vblank, &output->vblank,
+					  since - since % period);
+			return;
+		}
+	}
+
+	*vblank = *now;
+}
+
 static int
-headless_output_start_repaint_loop(struct weston_output *output)
+headless_output_start_repaint_loop(struct weston_output *output_base)
 {
+	struct headless_output *output = to_headless_output(output_base);
 	struct timespec ts;
 
-	weston_compositor_read_presentation_clock(output->compositor, &ts);
-	weston_output_finish_frame(output, &ts, WP_PRESENTATION_FEEDBACK_INVALID);
+	assert(output);
+
+	/* Without a fixed vblank, there is nothing to wait for */
+	if (output->backend->pacing != WESTON_HEADLESS_PACING_FIXED) {
+		weston_output_finish_frame(output_base, NULL,
+					   WP_PRESENTATION_FEEDBACK_INVALID);
+		return 0;
+	}
+
+	weston_compositor_read_presentation_clock(output_base->compositor, &ts);
+	headless_output_vblank_before(output, &ts, &output->vblank);
+	weston_output_finish_frame(output_base, &output->vblank,
+				   WP_PRESENTATION_FEEDBACK_INVALID);
 
 	return 0;
 }
 
+static void
+headless_output_finish_pending(struct headless_output *output)
+{
+	output->vblank = output->pending_vblank;
+	weston_output_finish_frame(&output->base, &output->vblank,
+				   output->pending_flags);
+}
+
 static int
 finish_frame_handler(void *data)
 {
 	struct headless_output *output = data;
-	struct timespec ts;
 
-	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
-	weston_output_finish_frame(&output->base, &ts, 0);
+	headless_output_finish_pending(output);
 
 	return 1;
 }
 
+static void
+finish_frame_idle_handler(void *data)
+{
+	struct headless_output *output = data;
+
+	output->finish_frame_idle = NULL;
+	headless_output_finish_pending(output);
+}
+
+/* Finish the frame in flight at the given virtual vblank. The event loop
+ * timers tick in milliseconds, so they round up and the stamp is never
+ * later than the moment the frame gets finished. */
+static void
+headless_output_finish_at(struct headless_output *output,
+			  const struct timespec *vblank, uint32_t flags)
+{
+	struct weston_compositor *ec = output->base.compositor;
+	struct wl_event_loop *loop;
+	struct timespec now;
+	int64_t delay;
+
+	output->pending_vblank = *vblank;
+	output->pending_flags = flags;
+
+	weston_compositor_read_presentation_clock(ec, &now);
+	delay = timespec_sub_to_nsec(vblank, &now);
+	if (delay > 0) {
+		wl_event_source_timer_update(output->finish_frame_timer,
+					     (delay + 999999) / 1000000);
+		return;
+	}
+
+	loop = wl_display_get_event_loop(ec->wl_display);
+	output->finish_frame_idle =
+		wl_event_loop_add_idle(loop, finish_frame_idle_handler, output);
+}
+
+static void
+headless_output_schedule_finish(struct headless_output *output)
+{
+	struct headless_backend *b = output->backend;
+	struct timespec now, vblank;
+	int64_t since;
+
+	weston_compositor_read_presentation_clock(b->compositor, &now);
+
+	switch (b->pacing) {
+	case WESTON_HEADLESS_PACING_FIXED:
+		/* On the next vblank of the grid */
+		headless_output_vblank_before(output, &now, &vblank);
+		timespec_add_nsec(&vblank, &vblank, b->min_period_nsec);
+		headless_output_finish_at(output, &vblank, 0);
+		break;
+	case WESTON_HEADLESS_PACING_ASAP:
+		headless_output_finish_at(output, &now,
+					  WESTON_FINISH_FRAME_TEARING);
+		break;
+	case WESTON_HEADLESS_PACING_VRR:
+		/* A panel idle for longer than the longest period has
+		 * started refreshing the old frame again, at the last
+		 * multiple of it, and has to finish that scanout first. */
+		vblank = output->vblank;
+		since = timespec_sub_to_nsec(&now, &vblank);
+		if (since > b->max_period_nsec)
+			timespec_add_nsec(&vblank, &vblank,
+					  since - since % b->max_period_nsec);
+		timespec_add_nsec(&vblank, &vblank, b->min_period_nsec);
+		if (timespec_sub_to_nsec(&vblank, &now) < 0)
+			vblank = now;
+
+		/* Not waiting on a fixed vblank, repaint as soon as there
+		 * is something new */
+		headless_output_finish_at(output, &vblank,
+					  WESTON_FINISH_FRAME_TEARING);
+		break;
+	}
+}
+
 static void
 headless_output_update_gl_border(struct headless_output *output)
 {
@@ -156,33 +321,201 @@ headless_output_repaint(struct weston_output *output_base,
 		       pixman_region32_t *damage)
 {
 	struct headless_output *output = to_headless_output(output_base);
+	struct weston_renderbuffer *renderbuffer;
 	struct weston_compositor *ec;
 
 	assert(output);
 
 	ec = output->base.compositor;
+	renderbuffer = output->renderbuffer;
 
 	headless_output_update_gl_border(output);
 
-	ec->renderer->repaint_output(&output->base, damage,
-				     output->renderbuffer);
+	/* Nothing waits for the GPU here, the dmabufs take turns instead */
+	if (output->gl.dmabuf_count > 0) {
+		output->gl.current_dmabuf = (output->gl.current_dmabuf + 1) %
+					    output->gl.dmabuf_count;
+		renderbuffer =
+			output->gl.dmabufs[output->gl.current_dmabuf].renderbuffer;
+	}
+
+	ec->renderer->repaint_output(&output->base, damage, renderbuffer);
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	headless_output_schedule_finish(output);
 
 	return 0;
 }
 
+static void
+headless_dmabuf_fini(struct headless_dmabuf *dmabuf)
+{
+	if (dmabuf->renderbuffer) {
+		weston_renderbuffer_unref(dmabuf->renderbuffer);
+		dmabuf->renderbuffer = NULL;
+	}
+
+	if (dmabuf->attributes.n_planes > 0) {
+		close(dmabuf->attributes.fd[0]);
+		dmabuf->attributes.n_planes = 0;
+	}
+
+#ifdef BUILD_HEADLESS_GBM
+	if (dmabuf->bo) {
+		gbm_bo_destroy(dmabuf->bo);
+		dmabuf->bo = NULL;
+	}
+#endif
+}
+
+#ifdef BUILD_HEADLESS_GBM
+static int
+headless_dmabuf_alloc_gbm(struct headless_backend *b,
+			  struct headless_dmabuf *dmabuf)
+{
+	struct dmabuf_attributes *attr = &dmabuf->attributes;
+	int fd;
+
+	/* Linear, so that whoever gets the dmabuf can also map it */
+	dmabuf->bo = gbm_bo_create(b->gbm, attr->width, attr->height,
+				   attr->format,
+				   GBM_BO_USE_RENDERING | GBM_BO_USE_LINEAR);
+	if (!dmabuf->bo) {
+		weston_log("failed to create gbm bo: %s\n", strerror(errno));
+		return -1;
+	}
+
+	fd = gbm_bo_get_fd(dmabuf->bo);
+	if (fd < 0) {
+		weston_log("failed to export gbm bo\n");
+		return -1;
+	}
+
+	attr->n_planes = 1;
+	attr->fd[0] = fd;
+	attr->offset[0] = 0;
+	attr->stride[0] = gbm_bo_get_stride(dmabuf->bo);
+	attr->modifier[0] = DRM_FORMAT_MOD_LINEAR;
+
+	return 0;
+}
+#endif
+
+static int
+headless_dmabuf_alloc_udmabuf(struct headless_backend *b,
+			      struct headless_dmabuf *dmabuf)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	struct dmabuf_attributes *attr = &dmabuf->attributes;
+	const struct pixel_format_info *pfmt;
+	struct udmabuf_create create = { 0 };
+	long page_size = sysconf(_SC_PAGESIZE);
+	uint32_t stride;
+	off_t size;
+	int memfd;
+	int fd;
+
+	pfmt = pixel_format_get_info(attr->format);
+	assert(pfmt && pfmt->bpp);
+
+	stride = attr->width * (pfmt->bpp / 8);
+	size = (off_t) stride * attr->height;
+	size = (size + page_size - 1) & ~((off_t) page_size - 1);
+
+	/* Sealed against shrinking, as udmabuf requires */
+	memfd = os_create_anonymous_file(size);
+	if (memfd < 0) {
+		weston_log("failed to create udmabuf backing: %s\n",
+			   strerror(errno));
+		return -1;
+	}
+
+	create.memfd = memfd;
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.offset = 0;
+	create.size = size;
+	fd = ioctl(b->dmabuf_dev_fd, UDMABUF_CREATE, &create);
+
+	/* The udmabuf keeps the pages */
+	close(memfd);
+
+	if (fd < 0) {
+		weston_log("failed to create udmabuf: %s\n", strerror(errno));
+		return -1;
+	}
+
+	attr->n_planes = 1;
+	attr->fd[0] = fd;
+	attr->offset[0] = 0;
+	attr->stride[0] = stride;
+	attr->modifier[0] = DRM_FORMAT_MOD_LINEAR;
+
+	return 0;
+#else
+	weston_log("udmabuf support was not built in\n");
+	return -1;
+#endif
+}
+
+static int
+headless_output_create_dmabufs(struct headless_output *output,
+			       const struct weston_size *fb_size)
+{
+	struct headless_backend *b = output->backend;
+	const struct weston_renderer *renderer = b->compositor->renderer;
+	int i, ret;
+
+	for (i = 0; i < HEADLESS_DMABUF_COUNT; i++) {
+		struct headless_dmabuf *dmabuf = &output->gl.dmabufs[i];
+
+		dmabuf->attributes.width = fb_size->width;
+		dmabuf->attributes.height = fb_size->height;
+		dmabuf->attributes.format = b->formats[0]->format;
+
+#ifdef BUILD_HEADLESS_GBM
+		if (b->gbm)
+			ret = headless_dmabuf_alloc_gbm(b, dmabuf);
+		else
+#endif
+			ret = headless_dmabuf_alloc_udmabuf(b, dmabuf);
+		if (ret < 0)
+			goto err;
+
+		dmabuf->renderbuffer =
+			renderer->gl->create_renderbuffer_dmabuf(&output->base,
+								 &dmabuf->attributes);
+		if (!dmabuf->renderbuffer)
+			goto err;
+
+		output->gl.dmabuf_count++;
+	}
+	output->gl.current_dmabuf = 0;
+
+	return 0;
+
+err:
+	for (i = 0; i < HEADLESS_DMABUF_COUNT; i++)
+		headless_dmabuf_fini(&output->gl.dmabufs[i]);
+	output->gl.dmabuf_count = 0;
+
+	return -1;
+}
+
 static void
 headless_output_disable_gl(struct headless_output *output)
 {
 	struct weston_compositor *compositor = output->base.compositor;
 	const struct weston_renderer *renderer = compositor->renderer;
+	int i;
 
 	weston_gl_borders_fini(&output->gl.borders, &output->base);
 
+	for (i = 0; i < HEADLESS_DMABUF_COUNT; i++)
+		headless_dmabuf_fini(&output->gl.dmabufs[i]);
+	output->gl.dmabuf_count = 0;
+
 	renderer->gl->output_destroy(&output->base);
 
 	if (output->frame) {
@@ -215,6 +548,10 @@ headless_output_disable(struct weston_output *base)
 	b = output->backend;
 
 	wl_event_source_remove(output->finish_frame_timer);
+	if (output->finish_frame_idle) {
+		wl_event_source_remove(output->finish_frame_idle);
+		output->finish_frame_idle = NULL;
+	}
 
 	switch (b->compositor->renderer->type) {
 	case WESTON_RENDERER_GL:
@@ -256,6 +593,7 @@ headless_output_enable_gl(struct headless_output *output)
 		.formats = b->formats,
 		.formats_count = b->formats_count,
 	};
+	int ret;
 
 	if (b->decorate) {
 		/*
@@ -283,16 +621,39 @@ headless_output_enable_gl(struct headless_output *output)
 		options.fb_size.height = mode->height;
 	}
 
-	if (renderer->gl->output_pbuffer_create(&output->base, &options) < 0) {
+	if (b->gl_dmabuf) {
+		const struct gl_renderer_fbo_options fbo_options = {
+			.fb_size = options.fb_size,
+			.area = options.area,
+		};
+
+		ret = renderer->gl->output_fbo_create(&output->base,
+						      &fbo_options);
+	} else {
+		ret = renderer->gl->output_pbuffer_create(&output->base,
+							  &options);
+	}
+
+	if (ret < 0) {
 		weston_log("failed to create gl renderer output state\n");
-		if (output->frame) {
-			frame_destroy(output->frame);
-			output->frame = NULL;
-		}
-		return -1;
+		goto err_frame;
+	}
+
+	if (b->gl_dmabuf &&
+	    headless_output_create_dmabufs(output, &options.fb_size) < 0) {
+		weston_log("failed to create dmabuf renderbuffers\n");
+		renderer->gl->output_destroy(&output->base);
+		goto err_frame;
 	}
 
 	return 0;
+
+err_frame:
+	if (output->frame) {
+		frame_destroy(output->frame);
+		output->frame = NULL;
+	}
+	return -1;
 }
 
 static int
@@ -402,7 +763,7 @@ headless_output_set_size(struct weston_output *base,
 		WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED;
 	output->mode.width = output_width;
 	output->mode.height = output_height;
-	output->mode.refresh = 60000;
+	output->mode.refresh = output->backend->refresh;
 	wl_list_insert(&output->base.mode_list, &output->mode.link);
 
 	output->base.current_mode = &output->mode;
@@ -488,6 +849,61 @@ headless_head_destroy(struct weston_head *base)
 	free(head);
 }
 
+static int
+headless_backend_init_dmabuf(struct headless_backend *b,
+			     const char *render_node)
+{
+	const char *path = render_node ? render_node : "/dev/udmabuf";
+
+	b->dmabuf_dev_fd = open(path, O_RDWR | O_CLOEXEC);
+	if (b->dmabuf_dev_fd < 0) {
+		weston_log("Error: could not open %s: %s\n",
+			   path, strerror(errno));
+		return -1;
+	}
+
+	if (render_node) {
+#ifdef BUILD_HEADLESS_GBM
+		b->gbm = gbm_create_device(b->dmabuf_dev_fd);
+		if (!b->gbm) {
+			weston_log("Error: could not create gbm device on %s\n",
+				   path);
+			close(b->dmabuf_dev_fd);
+			b->dmabuf_dev_fd = -1;
+			return -1;
+		}
+#else
+		weston_log("Error: allocating from a render node needs gbm, "
+			   "which was not built in\n");
+		close(b->dmabuf_dev_fd);
+		b->dmabuf_dev_fd = -1;
+		return -1;
+#endif
+	}
+
+	weston_log("Headless GL outputs render into dmabufs from %s\n", path);
+	b->gl_dmabuf = true;
+
+	return 0;
+}
+
+static void
+headless_backend_fini_dmabuf(struct headless_backend *b)
+{
+#ifdef BUILD_HEADLESS_GBM
+	if (b->gbm) {
+		gbm_device_destroy(b->gbm);
+		b->gbm = NULL;
+	}
+#endif
+
+	if (b->dmabuf_dev_fd >= 0) {
+		close(b->dmabuf_dev_fd);
+		b->dmabuf_dev_fd = -1;
+	}
+	b->gl_dmabuf = false;
+}
+
 static void
 headless_destroy(struct weston_backend *backend)
 {
@@ -505,6 +921,8 @@ headless_destroy(struct weston_backend *backend)
 	if (b->theme)
 		theme_destroy(b->theme);
 
+	headless_backend_fini_dmabuf(b);
+
 	free(b->formats);
 	free(b);
 
@@ -529,6 +947,7 @@ headless_backend_create(struct weston_compositor *compositor,
 
 	b->compositor = compositor;
 	compositor->backend = &b->base;
+	b->dmabuf_dev_fd = -1;
 
 	if (weston_compositor_set_presentation_clock_software(compositor) < 0)
 		goto err_free;
@@ -536,6 +955,22 @@ headless_backend_create(struct weston_compositor *compositor,
 	b->base.destroy = headless_destroy;
 	b->base.create_output = headless_output_create;
 
+	b->pacing = config->pacing;
+	b->refresh = config->refresh > 0 ? config->refresh : 60000;
+	b->min_period_nsec = 1000000000000LL / b->refresh;
+	if (b->pacing == WESTON_HEADLESS_PACING_VRR) {
+		int min_refresh = config->vrr_min_refresh > 0 ?
+				  config->vrr_min_refresh : b->refresh / 2;
+
+		if (min_refresh > b->refresh) {
+			weston_log("Error: VRR minimum refresh rate %d mHz is "
+				   "above the refresh rate %d mHz.\n",
+				   min_refresh, b->refresh);
+			goto err_free;
+		}
+		b->max_period_nsec = 1000000000000LL / min_refresh;
+	}
+
 	b->decorate = config->decorate;
 	if (b->decorate) {
 		b->theme = theme_create();
@@ -587,6 +1022,15 @@ headless_backend_create(struct weston_compositor *compositor,
 	if (ret < 0)
 		goto err_input;
 
+	if (config->gl_dmabuf) {
+		if (config->renderer != WESTON_RENDERER_GL) {
+			weston_log("Error: dmabuf renderbuffers need the GL renderer.\n");
+			goto err_input;
+		}
+		if (headless_backend_init_dmabuf(b, config->render_node) < 0)
+			goto err_input;
+	}
+
 	if (compositor->renderer->import_dmabuf) {
 		if (linux_dmabuf_setup(compositor) < 0) {
 			weston_log("Error: dmabuf protocol setup failed.\n");
@@ -610,6 +1054,7 @@ headless_backend_create(struct weston_compositor *compositor,
 	return b;
 
 err_input:
+	headless_backend_fini_dmabuf(b);
 	if (b->theme)
 		theme_destroy(b->theme);
 
@@ -60,8 +60,12 @@
 #include "shared/xalloc.h"
 #include "fullscreen-shell-unstable-v1-client-protocol.h"
 #include "xdg-shell-client-protocol.h"
+#include "presentation-time-client-protocol.h"
 #include "presentation-time-server-protocol.h"
+#include "viewporter-client-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
 #include "linux-dmabuf.h"
+#include "libweston-internal.h"
 #include <libweston/pixel-formats.h>
 #include <libweston/windowed-output-api.h>
 
@@ -73,6 +77,9 @@
 #define WINDOW_MAX_WIDTH 8192
 #define WINDOW_MAX_HEIGHT 8192
 
+/* Client buffers forwarded to the parent as subsurfaces, per output */
+#define WAYLAND_MAX_PLANES 8
+
 static const uint32_t wayland_formats[] = {
 	DRM_FORMAT_ARGB8888,
 };
@@ -88,6 +95,12 @@ struct wayland_backend {
 		struct xdg_wm_base *xdg_wm_base;
 		struct zwp_fullscreen_shell_v1 *fshell;
 		struct wl_shm *shm;
+		struct wl_subcompositor *subcompositor;
+		struct wp_viewporter *viewporter;
+		struct zwp_linux_dmabuf_v1 *dmabuf;
+		struct weston_drm_format_array dmabuf_formats;
+		/* only kept if its clock matches ours */
+		struct wp_presentation *presentation;
 
 		struct wl_list output_list;
 
@@ -110,6 +123,10 @@ struct wayland_backend {
 
 	const struct pixel_format_info **formats;
 	unsigned int formats_count;
+
+	/* parent wl_buffers wrapping client dmabufs,
+	 * struct wayland_plane_buffer::link */
+	struct wl_list dmabuf_buffer_list;
 };
 
 struct wayland_output {
@@ -148,6 +165,10 @@ struct wayland_output {
 	struct weston_mode native_mode;
 
 	struct wl_callback *frame_cb;
+	struct wp_presentation_feedback *feedback;
+
+	/* struct wayland_plane::link, the ones in use first, bottom to top */
+	struct wl_list plane_list;
 };
 
 struct wayland_parent_output {
@@ -198,6 +219,53 @@ struct wayland_shm_buffer {
 	cairo_surface_t *c_surface;
 };
 
+/** A parent wl_buffer showing client content on a wayland_plane
+ *
+ * Client dmabufs are wrapped as they are and cached on the weston_buffer
+ * for as long as it lives. Client SHM buffers cannot be shared with the
+ * parent, wl_shm_buffer does not expose its pool fd, so their content is
+ * copied into SHM buffers owned by the plane.
+ */
+struct wayland_plane_buffer {
+	struct wayland_backend *backend;
+	struct wl_list link;
+	struct wl_buffer *parent_buffer;
+	bool busy;	/**< attached by the parent, waiting for release */
+
+	/* dmabuf: the client buffer, referenced while busy */
+	struct weston_buffer *buffer;
+	struct wl_listener buffer_destroy_listener;
+	struct weston_buffer_reference buffer_ref;
+	struct weston_buffer_release_reference buffer_release_ref;
+
+	/* SHM copy */
+	void *data;
+	size_t size;
+	int width, height, stride;
+	uint32_t format;
+};
+
+/** A parent subsurface that shows one view without composition */
+struct wayland_plane {
+	struct weston_plane base;
+	struct wayland_output *output;
+	struct wl_list link;
+
+	struct wl_surface *surface;
+	struct wl_subsurface *subsurface;
+	struct wp_viewport *viewport;
+
+	struct weston_view *view;	/**< assigned in this repaint */
+	struct wayland_plane_buffer *dmabuf;	/**< for view, if dmabuf */
+
+	/* What the parent has been sent */
+	struct weston_view *shown_view;
+	struct weston_buffer *shown_buffer;
+	pixman_box32_t shown_dest;
+
+	struct wl_list shm_buffers;	/**< wayland_plane_buffer::link */
+};
+
 struct wayland_input {
 	struct weston_seat base;
 	struct wayland_backend *backend;
@@ -439,6 +507,626 @@ static const struct wl_callback_listener frame_listener = {
 	frame_done
 };
 
+static void
+feedback_sync_output(void *data,
+		     struct wp_presentation_feedback *feedback,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data,
+		   struct wp_presentation_feedback *feedback,
+		   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+		   uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct wayland_output *output = data;
+	struct timespec ts;
+
+	assert(feedback == output->feedback);
+	wp_presentation_feedback_destroy(feedback);
+	output->feedback = NULL;
+
+	/* The parent clock is ours, so its timestamp and flags carry over.
+	 * Zero-copy is about our parent surface, the core decides that per
+	 * view for our own clients. */
+	ts.tv_sec = ((uint64_t)tv_sec_hi << 32) + tv_sec_lo;
+	ts.tv_nsec = tv_nsec;
+	weston_output_finish_frame(&output->base, &ts,
+				   flags & ~WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY);
+}
+
+static void
+feedback_discarded(void *data,
+		   struct wp_presentation_feedback *feedback)
+{
+	struct wayland_output *output = data;
+	struct timespec ts;
+
+	assert(feedback == output->feedback);
+	wp_presentation_feedback_destroy(feedback);
+	output->feedback = NULL;
+
+	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
+	weston_output_finish_frame(&output->base, &ts, 0);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded,
+};
+
+/* Ask the parent to tell us when the next commit of the output surface
+ * is shown, preferring real presentation timings over frame callbacks */
+static void
+wayland_output_request_frame(struct wayland_output *output)
+{
+	struct wayland_backend *b = output->backend;
+
+	if (b->parent.presentation) {
+		output->feedback =
+			wp_presentation_feedback(b->parent.presentation,
+						 output->parent.surface);
+		wp_presentation_feedback_add_listener(output->feedback,
+						      &feedback_listener,
+						      output);
+		return;
+	}
+
+	output->frame_cb = wl_surface_frame(output->parent.surface);
+	wl_callback_add_listener(output->frame_cb, &frame_listener, output);
+}
+
+static void
+wayland_plane_buffer_destroy(struct wayland_plane_buffer *pb)
+{
+	/* Before dropping the reference, which may destroy the buffer */
+	if (pb->buffer) {
+		wl_list_remove(&pb->buffer_destroy_listener.link);
+		pb->buffer->backend_private = NULL;
+	}
+
+	weston_buffer_release_reference(&pb->buffer_release_ref, NULL);
+	if (pb->buffer_ref.buffer)
+		weston_buffer_reference(&pb->buffer_ref, NULL,
+					BUFFER_WILL_NOT_BE_ACCESSED);
+
+	if (pb->data)
+		munmap(pb->data, pb->size);
+
+	wl_buffer_destroy(pb->parent_buffer);
+	wl_list_remove(&pb->link);
+	free(pb);
+}
+
+static void
+plane_buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct wayland_plane_buffer *pb = data;
+
+	pb->busy = false;
+
+	/* Dropping the last reference may destroy the weston_buffer, and
+	 * with it pb, so this comes last. */
+	weston_buffer_release_reference(&pb->buffer_release_ref, NULL);
+	if (pb->buffer_ref.buffer)
+		weston_buffer_reference(&pb->buffer_ref, NULL,
+					BUFFER_WILL_NOT_BE_ACCESSED);
+}
+
+static const struct wl_buffer_listener plane_buffer_listener = {
+	plane_buffer_release
+};
+
+static void
+plane_buffer_handle_buffer_destroy(struct wl_listener *listener, void *data)
+{
+	struct wayland_plane_buffer *pb =
+		container_of(listener, struct wayland_plane_buffer,
+			     buffer_destroy_listener);
+
+	/* The last reference is gone, so the parent is done with it */
+	assert(!pb->busy);
+	wayland_plane_buffer_destroy(pb);
+}
+
+static struct wayland_plane_buffer *
+wayland_backend_get_dmabuf_buffer(struct wayland_backend *b,
+				  struct weston_buffer *buffer)
+{
+	struct linux_dmabuf_buffer *dmabuf = buffer->dmabuf;
+	const struct dmabuf_attributes *attr = &dmabuf->attributes;
+	struct zwp_linux_buffer_params_v1 *params;
+	struct weston_drm_format *fmt;
+	struct wayland_plane_buffer *pb;
+	int i;
+
+	if (buffer->backend_private)
+		return buffer->backend_private;
+
+	fmt = weston_drm_format_array_find_format(&b->parent.dmabuf_formats,
+						  attr->format);
+	if (!fmt || !weston_drm_format_has_modifier(fmt, attr->modifier[0]))
+		return NULL;
+
+	pb = zalloc(sizeof *pb);
+	if (!pb)
+		return NULL;
+
+	params = zwp_linux_dmabuf_v1_create_params(b->parent.dmabuf);
+	for (i = 0; i < attr->n_planes; i++)
+		zwp_linux_buffer_params_v1_add(params, attr->fd[i], i,
+					       attr->offset[i],
+					       attr->stride[i],
+					       attr->modifier[i] >> 32,
+					       attr->modifier[i] & 0xffffffff);
+	pb->parent_buffer =
+		zwp_linux_buffer_params_v1_create_immed(params,
+							attr->width,
+							attr->height,
+							attr->format,
+							attr->flags);
+	zwp_linux_buffer_params_v1_destroy(params);
+
+	pb->backend = b;
+	pb->buffer = buffer;
+	wl_buffer_add_listener(pb->parent_buffer, &plane_buffer_listener, pb);
+	pb->buffer_destroy_listener.notify = plane_buffer_handle_buffer_destroy;
+	wl_signal_add(&buffer->destroy_signal, &pb->buffer_destroy_listener);
+	wl_list_insert(&b->dmabuf_buffer_list, &pb->link);
+	buffer->backend_private = pb;
+
+	return pb;
+}
+
+static struct wayland_plane_buffer *
+wayland_plane_get_shm_buffer(struct wayland_plane *plane,
+			     int width, int height, uint32_t format)
+{
+	struct wayland_backend *b = plane->output->backend;
+	struct wayland_plane_buffer *pb, *tmp;
+	struct wl_shm_pool *pool;
+	int stride = width * 4;
+	int fd;
+
+	wl_list_for_each_safe(pb, tmp, &plane->shm_buffers, link) {
+		if (pb->busy)
+			continue;
+		if (pb->width == width && pb->height == height &&
+		    pb->format == format)
+			return pb;
+		wayland_plane_buffer_destroy(pb);
+	}
+
+	pb = zalloc(sizeof *pb);
+	if (!pb)
+		return NULL;
+
+	pb->size = (size_t)stride * height;
+	fd = os_create_anonymous_file(pb->size);
+	if (fd < 0) {
+		free(pb);
+		return NULL;
+	}
+
+	pb->data = mmap(NULL, pb->size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (pb->data == MAP_FAILED) {
+		close(fd);
+		free(pb);
+		return NULL;
+	}
+
+	pool = wl_shm_create_pool(b->parent.shm, fd, pb->size);
+	pb->parent_buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+						      stride, format);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	pb->backend = b;
+	pb->width = width;
+	pb->height = height;
+	pb->stride = stride;
+	pb->format = format;
+	wl_buffer_add_listener(pb->parent_buffer, &plane_buffer_listener, pb);
+	wl_list_insert(&plane->shm_buffers, &pb->link);
+
+	return pb;
+}
+
+static struct wayland_plane_buffer *
+wayland_plane_copy_shm(struct wayland_plane *plane,
+		       struct weston_buffer *buffer)
+{
+	struct wl_shm_buffer *shm = buffer->shm_buffer;
+	struct wayland_plane_buffer *pb;
+	uint8_t *src, *dst;
+	int src_stride, y;
+
+	if (!shm)
+		return NULL;
+
+	pb = wayland_plane_get_shm_buffer(plane, buffer->width, buffer->height,
+					  pixel_format_get_shm_format(buffer->pixel_format));
+	if (!pb)
+		return NULL;
+
+	src_stride = wl_shm_buffer_get_stride(shm);
+	dst = pb->data;
+
+	wl_shm_buffer_begin_access(shm);
+	src = wl_shm_buffer_get_data(shm);
+	for (y = 0; y < pb->height; y++)
+		memcpy(dst + y * pb->stride, src + y * src_stride, pb->stride);
+	wl_shm_buffer_end_access(shm);
+
+	return pb;
+}
+
+static struct wayland_plane *
+wayland_plane_create(struct wayland_output *output)
+{
+	struct wayland_backend *b = output->backend;
+	struct wayland_plane *plane;
+	struct wl_region *region;
+
+	plane = zalloc(sizeof *plane);
+	if (!plane)
+		return NULL;
+
+	plane->output = output;
+	wl_list_init(&plane->shm_buffers);
+
+	plane->surface = wl_compositor_create_surface(b->parent.compositor);
+	plane->subsurface =
+		wl_subcompositor_get_subsurface(b->parent.subcompositor,
+						plane->surface,
+						output->parent.surface);
+	plane->viewport = wp_viewporter_get_viewport(b->parent.viewporter,
+						     plane->surface);
+
+	/* Input goes to the output surface underneath */
+	region = wl_compositor_create_region(b->parent.compositor);
+	wl_surface_set_input_region(plane->surface, region);
+	wl_region_destroy(region);
+
+	weston_plane_init(&plane->base, b->compositor);
+	weston_compositor_stack_plane(b->compositor, &plane->base, NULL);
+	wl_list_insert(output->plane_list.prev, &plane->link);
+
+	return plane;
+}
+
+static void
+wayland_plane_destroy(struct wayland_plane *plane)
+{
+	struct wayland_plane_buffer *pb, *tmp;
+
+	wl_list_for_each_safe(pb, tmp, &plane->shm_buffers, link)
+		wayland_plane_buffer_destroy(pb);
+
+	weston_plane_release(&plane->base);
+	wp_viewport_destroy(plane->viewport);
+	wl_subsurface_destroy(plane->subsurface);
+	wl_surface_destroy(plane->surface);
+	wl_list_remove(&plane->link);
+	free(plane);
+}
+
+static struct wayland_plane *
+wayland_output_get_free_plane(struct wayland_output *output)
+{
+	struct wayland_plane *plane;
+	int count = 0;
+
+	wl_list_for_each(plane, &output->plane_list, link) {
+		if (!plane->view)
+			return plane;
+		count++;
+	}
+
+	if (count >= WAYLAND_MAX_PLANES)
+		return NULL;
+
+	return wayland_plane_create(output);
+}
+
+/* Where the view lands in parent surface coordinates, which are output
+ * buffer coordinates offset by the decorations at ix, iy */
+static void
+wayland_output_view_dest(struct wayland_output *output,
+			 struct weston_view *view, int32_t ix, int32_t iy,
+			 pixman_box32_t *dest)
+{
+	const pixman_box32_t *bbox =
+		pixman_region32_extents(&view->transform.boundingbox);
+	int32_t scale = output->base.current_scale;
+
+	dest->x1 = (bbox->x1 - output->base.x) * scale + ix;
+	dest->y1 = (bbox->y1 - output->base.y) * scale + iy;
+	dest->x2 = (bbox->x2 - output->base.x) * scale + ix;
+	dest->y2 = (bbox->y2 - output->base.y) * scale + iy;
+}
+
+static bool
+wayland_output_can_forward(struct wayland_output *output,
+			   struct weston_paint_node *pnode)
+{
+	struct wayland_backend *b = output->backend;
+	struct weston_view *ev = pnode->view;
+	struct weston_surface *surface = ev->surface;
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	const struct weston_buffer_viewport *vp = &surface->buffer_viewport;
+	uint32_t format;
+
+	if (ev->output_mask != (1u << output->base.id))
+		return false;
+
+	if (output->base.transform != WL_OUTPUT_TRANSFORM_NORMAL)
+		return false;
+
+	if (!weston_view_has_valid_buffer(ev))
+		return false;
+
+	if (ev->alpha != 1.0f || ev->geometry.scissor_enabled)
+		return false;
+
+	if (ev->transform.enabled &&
+	    (ev->transform.matrix.type & (WESTON_MATRIX_TRANSFORM_ROTATE |
+					  WESTON_MATRIX_TRANSFORM_OTHER)))
+		return false;
+
+	if (vp->buffer.transform != WL_OUTPUT_TRANSFORM_NORMAL)
+		return false;
+
+	if (pnode->surf_xform.transform != NULL ||
+	    !pnode->surf_xform.identity_pipeline)
+		return false;
+
+	if (surface->protection_mode == WESTON_SURFACE_PROTECTION_MODE_ENFORCED &&
+	    surface->desired_protection > output->base.current_protection)
+		return false;
+
+	/* Partly off the output, the parent would show it outside */
+	if (!pixman_region32_contains_rectangle(&output->base.region,
+			pixman_region32_extents(&ev->transform.boundingbox)))
+		return false;
+
+	switch (buffer->type) {
+	case WESTON_BUFFER_DMABUF:
+		return b->parent.dmabuf != NULL;
+	case WESTON_BUFFER_SHM:
+		/* The formats every wl_shm supports */
+		format = buffer->pixel_format->format;
+		return format == DRM_FORMAT_ARGB8888 ||
+		       format == DRM_FORMAT_XRGB8888;
+	default:
+		return false;
+	}
+}
+
+/* Views are forwarded top down until something the renderer draws
+ * overlaps them, as the output surface is at the bottom of the stack. */
+static void
+wayland_output_assign_planes(struct weston_output *output_base)
+{
+	struct wayland_output *output = to_wayland_output(output_base);
+	struct wayland_backend *b;
+	struct weston_compositor *ec = output_base->compositor;
+	struct weston_paint_node *pnode;
+	struct wayland_plane *plane;
+	pixman_region32_t renderer_region;
+
+	assert(output);
+	b = output->backend;
+
+	wl_list_for_each(plane, &output->plane_list, link) {
+		plane->view = NULL;
+		plane->dmabuf = NULL;
+	}
+
+	pixman_region32_init(&renderer_region);
+
+	wl_list_for_each(pnode, &output_base->paint_node_z_order_list,
+			 z_order_link) {
+		struct weston_view *ev = pnode->view;
+		struct weston_buffer *buffer = ev->surface->buffer_ref.buffer;
+		struct wayland_plane_buffer *dmabuf = NULL;
+		pixman_region32_t overlap;
+		bool forward;
+
+		/* TODO: turn this into assert once z_order_list is pruned. */
+		if (!(ev->output_mask & (1u << output_base->id)))
+			continue;
+
+		ev->psf_flags = 0;
+		ev->surface->keep_buffer = false;
+
+		if (!pnode->surf_xform_valid || pnode->occluded) {
+			weston_view_move_to_plane(ev, &ec->primary_plane);
+			continue;
+		}
+
+		forward = wayland_output_can_forward(output, pnode);
+		if (forward) {
+			/* The renderer may need it again if the view moves
+			 * back, and SHM is only copied at repaint */
+			ev->surface->keep_buffer = true;
+
+			pixman_region32_init(&overlap);
+			pixman_region32_intersect(&overlap, &renderer_region,
+						  &ev->transform.boundingbox);
+			forward = !pixman_region32_not_empty(&overlap);
+			pixman_region32_fini(&overlap);
+		}
+
+		if (forward && buffer->type == WESTON_BUFFER_DMABUF) {
+			dmabuf = wayland_backend_get_dmabuf_buffer(b, buffer);
+			forward = dmabuf != NULL;
+		}
+
+		plane = forward ? wayland_output_get_free_plane(output) : NULL;
+		if (!plane) {
+			weston_view_move_to_plane(ev, &ec->primary_plane);
+			pixman_region32_union(&renderer_region,
+					      &renderer_region,
+					      &ev->transform.boundingbox);
+			continue;
+		}
+
+		plane->view = ev;
+		plane->dmabuf = dmabuf;
+		weston_view_move_to_plane(ev, &plane->base);
+
+		/* SHM content is copied on the way */
+		if (dmabuf)
+			ev->psf_flags = WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY;
+
+		/* Top down, so each one goes below the previous */
+		wl_list_remove(&plane->link);
+		wl_list_insert(&output->plane_list, &plane->link);
+	}
+
+	pixman_region32_fini(&renderer_region);
+}
+
+static void
+wayland_plane_set_source(struct wayland_plane *plane)
+{
+	struct weston_surface *surface = plane->view->surface;
+	const struct weston_buffer_viewport *vp = &surface->buffer_viewport;
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	int32_t scale = vp->buffer.scale;
+
+	if (vp->buffer.src_width == wl_fixed_from_int(-1)) {
+		wp_viewport_set_source(plane->viewport,
+				       wl_fixed_from_int(0),
+				       wl_fixed_from_int(0),
+				       wl_fixed_from_int(buffer->width),
+				       wl_fixed_from_int(buffer->height));
+		return;
+	}
+
+	wp_viewport_set_source(plane->viewport,
+			       vp->buffer.src_x * scale,
+			       vp->buffer.src_y * scale,
+			       vp->buffer.src_width * scale,
+			       vp->buffer.src_height * scale);
+}
+
+/* Send the parent what assign_planes() decided. The subsurfaces are in
+ * synchronized mode, so all of it lands with the next commit of the
+ * output surface, together with the composited part. */
+static void
+wayland_output_update_planes(struct wayland_output *output)
+{
+	struct wl_surface *below = output->parent.surface;
+	struct wayland_plane *plane;
+	pixman_region32_t damage;
+	int32_t ix = 0, iy = 0;
+
+	if (output->frame)
+		frame_interior(output->frame, &ix, &iy, NULL, NULL);
+
+	pixman_region32_init(&damage);
+
+	wl_list_for_each(plane, &output->plane_list, link) {
+		struct weston_view *ev = plane->view;
+		struct weston_buffer *buffer;
+		struct wayland_plane_buffer *pb;
+		pixman_box32_t dest;
+		bool moved, changed;
+
+		if (!ev) {
+			if (plane->shown_view) {
+				wl_surface_attach(plane->surface, NULL, 0, 0);
+				wl_surface_commit(plane->surface);
+				plane->shown_view = NULL;
+				plane->shown_buffer = NULL;
+			}
+			pixman_region32_clear(&plane->base.damage);
+			continue;
+		}
+
+		buffer = ev->surface->buffer_ref.buffer;
+		wayland_output_view_dest(output, ev, ix, iy, &dest);
+
+		wl_subsurface_place_above(plane->subsurface, below);
+		below = plane->surface;
+
+		moved = plane->shown_view != ev ||
+			memcmp(&dest, &plane->shown_dest, sizeof dest) != 0;
+		changed = moved || plane->shown_buffer != buffer ||
+			  pixman_region32_not_empty(&plane->base.damage);
+
+		if (moved) {
+			wl_subsurface_set_position(plane->subsurface,
+						   dest.x1, dest.y1);
+			wp_viewport_set_destination(plane->viewport,
+						    dest.x2 - dest.x1,
+						    dest.y2 - dest.y1);
+		}
+
+		if (!changed)
+			continue;
+
+		if (plane->dmabuf)
+			pb = plane->dmabuf;
+		else
+			pb = wayland_plane_copy_shm(plane, buffer);
+
+		if (pb) {
+			wayland_plane_set_source(plane);
+			wl_surface_attach(plane->surface, pb->parent_buffer,
+					  0, 0);
+			pb->busy = true;
+			if (pb->buffer) {
+				struct weston_buffer_release *release =
+					ev->surface->buffer_release_ref.buffer_release;
+
+				weston_buffer_reference(&pb->buffer_ref, buffer,
+							BUFFER_MAY_BE_ACCESSED);
+				weston_buffer_release_reference(&pb->buffer_release_ref,
+								release);
+			}
+		}
+
+		/* Damage is against what the subsurface showed before, no
+		 * matter which buffer that came from */
+		if (moved) {
+			wl_surface_damage(plane->surface, 0, 0,
+					  INT32_MAX, INT32_MAX);
+		} else {
+			pixman_box32_t *rects;
+			int i, n;
+
+			/* From global to the subsurface, which is where the
+			 * view is in output coordinates */
+			weston_region_global_to_output(&damage, &output->base,
+						       &plane->base.damage);
+			pixman_region32_translate(&damage, ix - dest.x1,
+						  iy - dest.y1);
+			rects = pixman_region32_rectangles(&damage, &n);
+			for (i = 0; i < n; i++)
+				wl_surface_damage(plane->surface,
+						  rects[i].x1, rects[i].y1,
+						  rects[i].x2 - rects[i].x1,
+						  rects[i].y2 - rects[i].y1);
+		}
+
+		wl_surface_commit(plane->surface);
+
+		plane->shown_view = ev;
+		plane->shown_buffer = buffer;
+		plane->shown_dest = dest;
+		pixman_region32_clear(&plane->base.damage);
+	}
+
+	pixman_region32_fini(&damage);
+}
+
 static void
 draw_initial_frame(struct wayland_output *output)
 {
@@ -491,8 +1179,7 @@ wayland_output_start_repaint_loop(struct weston_output *output_base)
 		draw_initial_frame(output);
 	}
 
-	output->frame_cb = wl_surface_frame(output->parent.surface);
-	wl_callback_add_listener(output->frame_cb, &frame_listener, output);
+	wayland_output_request_frame(output);
 	wl_surface_commit(output->parent.surface);
 	wl_display_flush(wb->parent.wl_display);
 
@@ -511,10 +1198,10 @@ wayland_output_repaint_gl(struct weston_output *output_base,
 
 	ec = output->base.compositor;
 
-	output->frame_cb = wl_surface_frame(output->parent.surface);
-	wl_callback_add_listener(output->frame_cb, &frame_listener, output);
+	wayland_output_request_frame(output);
 
 	wayland_output_update_gl_border(output);
+	wayland_output_update_planes(output);
 
 	ec->renderer->repaint_output(&output->base, damage, NULL);
 
@@ -635,9 +1322,9 @@ wayland_output_repaint_pixman(struct weston_output *output_base,
 						sb->renderbuffer);
 
 	wayland_shm_buffer_attach(sb);
+	wayland_output_update_planes(output);
 
-	output->frame_cb = wl_surface_frame(output->parent.surface);
-	wl_callback_add_listener(output->frame_cb, &frame_listener, output);
+	wayland_output_request_frame(output);
 	wl_surface_commit(output->parent.surface);
 	wl_display_flush(b->parent.wl_display);
 
@@ -692,12 +1379,16 @@ wayland_output_disable(struct weston_output *base)
 {
 	const struct weston_renderer *renderer = base->compositor->renderer;
 	struct wayland_output *output = to_wayland_output(base);
+	struct wayland_plane *plane, *tmp;
 
 	assert(output);
 
 	if (!output->base.enabled)
 		return 0;
 
+	wl_list_for_each_safe(plane, tmp, &output->plane_list, link)
+		wayland_plane_destroy(plane);
+
 	wayland_output_destroy_shm_buffers(output);
 
 	if (renderer->type == WESTON_RENDERER_PIXMAN) {
@@ -733,6 +1424,9 @@ wayland_output_destroy(struct weston_output *base)
 	if (output->frame_cb)
 		wl_callback_destroy(output->frame_cb);
 
+	if (output->feedback)
+		wp_presentation_feedback_destroy(output->feedback);
+
 	free(output->title);
 	free(output);
 }
@@ -1263,6 +1957,7 @@ wayland_output_enable(struct weston_output *base)
 
 	wl_list_init(&output->shm.buffers);
 	wl_list_init(&output->shm.free_buffers);
+	wl_list_init(&output->plane_list);
 
 	weston_log("Creating %dx%d wayland output at (%d, %d)\n",
 		   output->base.current_mode->width,
@@ -1290,7 +1985,10 @@ wayland_output_enable(struct weston_output *base)
 	}
 
 	output->base.start_repaint_loop = wayland_output_start_repaint_loop;
-	output->base.assign_planes = NULL;
+	if (b->parent.subcompositor && b->parent.viewporter)
+		output->base.assign_planes = wayland_output_assign_planes;
+	else
+		output->base.assign_planes = NULL;
 	output->base.set_backlight = NULL;
 	output->base.set_dpms = NULL;
 	output->base.switch_mode = wayland_output_switch_mode;
@@ -2666,6 +3364,54 @@ static const struct xdg_wm_base_listener wm_base_listener = {
 	xdg_wm_base_ping,
 };
 
+static void
+dmabuf_format(void *data, struct zwp_linux_dmabuf_v1 *dmabuf, uint32_t format)
+{
+	/* Superseded by the modifier event */
+}
+
+static void
+dmabuf_modifier(void *data, struct zwp_linux_dmabuf_v1 *dmabuf,
+		uint32_t format, uint32_t modifier_hi, uint32_t modifier_lo)
+{
+	struct wayland_backend *b = data;
+	uint64_t modifier = ((uint64_t)modifier_hi << 32) | modifier_lo;
+	struct weston_drm_format *fmt;
+
+	fmt = weston_drm_format_array_find_format(&b->parent.dmabuf_formats,
+						  format);
+	if (!fmt)
+		fmt = weston_drm_format_array_add_format(&b->parent.dmabuf_formats,
+							 format);
+	if (fmt)
+		weston_drm_format_add_modifier(fmt, modifier);
+}
+
+static const struct zwp_linux_dmabuf_v1_listener dmabuf_listener = {
+	dmabuf_format,
+	dmabuf_modifier,
+};
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct wayland_backend *b = data;
+
+	/* Parent timestamps are only of use in our own clock domain */
+	if (clk_id == (uint32_t)b->compositor->presentation_clock)
+		return;
+
+	weston_log("wayland-backend: parent presentation clock differs "
+		   "from ours, using frame callbacks\n");
+	wp_presentation_destroy(presentation);
+	b->parent.presentation = NULL;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id,
+};
+
 static void
 registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
 		       const char *interface, uint32_t version)
@@ -2694,6 +3440,28 @@ registry_handle_global(void *data, struct wl_registry *registry, uint32_t name,
 	} else if (strcmp(interface, "wl_shm") == 0) {
 		b->parent.shm =
 			wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, "wl_subcompositor") == 0) {
+		b->parent.subcompositor =
+			wl_registry_bind(registry, name,
+					 &wl_subcompositor_interface, 1);
+	} else if (strcmp(interface, "wp_viewporter") == 0) {
+		b->parent.viewporter =
+			wl_registry_bind(registry, name,
+					 &wp_viewporter_interface, 1);
+	} else if (strcmp(interface, "zwp_linux_dmabuf_v1") == 0 &&
+		   version >= 3) {
+		/* Version 3 for the modifier events */
+		b->parent.dmabuf =
+			wl_registry_bind(registry, name,
+					 &zwp_linux_dmabuf_v1_interface, 3);
+		zwp_linux_dmabuf_v1_add_listener(b->parent.dmabuf,
+						 &dmabuf_listener, b);
+	} else if (strcmp(interface, "wp_presentation") == 0) {
+		b->parent.presentation =
+			wl_registry_bind(registry, name,
+					 &wp_presentation_interface, 1);
+		wp_presentation_add_listener(b->parent.presentation,
+					     &presentation_listener, b);
 	}
 }
 
@@ -2753,6 +3521,7 @@ wayland_destroy(struct weston_backend *backend)
 	struct weston_head *base, *next;
 	struct wayland_parent_output *output, *next_output;
 	struct wayland_input *input, *next_input;
+	struct wayland_plane_buffer *pb, *next_pb;
 
 	wl_event_source_remove(b->parent.wl_source);
 
@@ -2772,6 +3541,23 @@ wayland_destroy(struct weston_backend *backend)
 	wl_list_for_each_safe(input, next_input, &b->pending_input_list, link)
 		wayland_input_destroy(input);
 
+	/* The client buffers outlive us, the proxies must not */
+	wl_list_for_each_safe(pb, next_pb, &b->dmabuf_buffer_list, link)
+		wayland_plane_buffer_destroy(pb);
+	weston_drm_format_array_fini(&b->parent.dmabuf_formats);
+
+	if (b->parent.dmabuf)
+		zwp_linux_dmabuf_v1_destroy(b->parent.dmabuf);
+
+	if (b->parent.presentation)
+		wp_presentation_destroy(b->parent.presentation);
+
+	if (b->parent.viewporter)
+		wp_viewporter_destroy(b->parent.viewporter);
+
+	if (b->parent.subcompositor)
+		wl_subcompositor_destroy(b->parent.subcompositor);
+
 	if (b->parent.shm)
 		wl_shm_destroy(b->parent.shm);
 
@@ -2886,10 +3672,16 @@ wayland_backend_create(struct weston_compositor *compositor,
 	wl_list_init(&b->parent.output_list);
 	wl_list_init(&b->input_list);
 	wl_list_init(&b->pending_input_list);
+	wl_list_init(&b->dmabuf_buffer_list);
+	weston_drm_format_array_init(&b->parent.dmabuf_formats);
 	b->parent.registry = wl_display_get_registry(b->parent.wl_display);
 	wl_registry_add_listener(b->parent.registry, &registry_listener, b);
 	wl_display_roundtrip(b->parent.wl_display);
 
+	/* For the dmabuf formats and the presentation clock */
+	if (b->parent.dmabuf || b->parent.presentation)
+		wl_display_roundtrip(b->parent.wl_display);
+
 	if (b->parent.shm == NULL) {
 		weston_log("Error: Failed to retrieve wl_shm from parent Wayland compositor\n");
 		goto err_display;
@@ -2956,6 +3748,7 @@ wayland_backend_create(struct weston_compositor *compositor,
 
 	return b;
 err_display:
+	weston_drm_format_array_fini(&b->parent.dmabuf_formats);
 	wl_display_disconnect(b->parent.wl_display);
 err_compositor:
 	weston_compositor_shutdown(compositor);
@@ -92,6 +92,7 @@ struct x11_backend {
 	struct xkb_keymap	*xkb_keymap;
 	unsigned int		 has_xkb;
 	uint8_t			 xkb_event_base;
+	uint8_t			 shm_event_base;
 	int			 fullscreen;
 	int			 no_input;
 
@@ -139,10 +140,16 @@ struct x11_output {
 	struct wl_event_source *finish_frame_timer;
 
 	xcb_gc_t		gc;
-	xcb_shm_seg_t		segment;
-	struct weston_renderbuffer *renderbuffer;
-	int			shm_id;
-	void		       *buf;
+	struct x11_shm_buffer {
+		xcb_shm_seg_t		segment;
+		struct weston_renderbuffer *renderbuffer;
+		int			shm_id;
+		void		       *buf;
+		/* Sequence of the put that owes us a completion event */
+		unsigned int		put_sequence;
+		bool			busy;
+	} shm[2];
+	int			shm_current;
 	uint8_t			depth;
 	int32_t                 scale;
 	bool			resize_pending;
@@ -448,101 +455,132 @@ x11_output_repaint_gl(struct weston_output *output_base,
 	return 0;
 }
 
+/* Above this many damage rectangles, one put of the extents is cheaper
+ * than a request per rectangle. */
+#define X11_SHM_MAX_PUT_RECTS 16
+
 static void
-set_clip_for_output(struct weston_output *output_base, pixman_region32_t *region)
+x11_output_wait_shm(struct x11_output *output, struct x11_shm_buffer *sb)
 {
-	struct x11_output *output = to_x11_output(output_base);
-	struct x11_backend *b;
+	struct x11_backend *b = output->backend;
+
+	/* The server handles requests in order, so once any reply comes
+	 * back every earlier put has read the segment. */
+	free(xcb_get_input_focus_reply(b->conn,
+				       xcb_get_input_focus(b->conn), NULL));
+	sb->busy = false;
+}
+
+static void
+x11_output_put_shm(struct x11_output *output, struct x11_shm_buffer *sb,
+		   pixman_region32_t *damage)
+{
+	struct x11_backend *b = output->backend;
+	const struct weston_renderer *renderer =
+		output->base.compositor->renderer;
+	pixman_image_t *image;
 	pixman_region32_t transformed_region;
 	pixman_box32_t *rects;
-	xcb_rectangle_t *output_rects;
 	xcb_void_cookie_t cookie;
 	int nrects, i;
-	xcb_generic_error_t *err;
-
-	if (!output)
-		return;
 
-	b = output->backend;
+	image = renderer->pixman->renderbuffer_get_image(sb->renderbuffer);
 
 	pixman_region32_init(&transformed_region);
 	weston_region_global_to_output(&transformed_region,
-				       output_base,
-				       region);
+				       &output->base, damage);
+	pixman_region32_intersect_rect(&transformed_region,
+				       &transformed_region, 0, 0,
+				       pixman_image_get_width(image),
+				       pixman_image_get_height(image));
 
 	rects = pixman_region32_rectangles(&transformed_region, &nrects);
-	output_rects = calloc(nrects, sizeof(xcb_rectangle_t));
-
-	if (output_rects == NULL) {
-		pixman_region32_fini(&transformed_region);
-		return;
+	if (nrects > X11_SHM_MAX_PUT_RECTS) {
+		rects = pixman_region32_extents(&transformed_region);
+		nrects = 1;
 	}
 
+	/* Only the last put asks for a completion event: the server reads
+	 * the segment in request order, so that one event retires the
+	 * whole frame. Errors come back asynchronously through the event
+	 * loop instead of a round trip per put. */
 	for (i = 0; i < nrects; i++) {
-		output_rects[i].x = rects[i].x1;
-		output_rects[i].y = rects[i].y1;
-		output_rects[i].width = rects[i].x2 - rects[i].x1;
-		output_rects[i].height = rects[i].y2 - rects[i].y1;
+		cookie = xcb_shm_put_image(b->conn, output->window, output->gc,
+					   pixman_image_get_width(image),
+					   pixman_image_get_height(image),
+					   rects[i].x1, rects[i].y1,
+					   rects[i].x2 - rects[i].x1,
+					   rects[i].y2 - rects[i].y1,
+					   rects[i].x1, rects[i].y1,
+					   output->depth,
+					   XCB_IMAGE_FORMAT_Z_PIXMAP,
+					   i == nrects - 1, sb->segment, 0);
+		if (i == nrects - 1) {
+			sb->put_sequence = cookie.sequence;
+			sb->busy = true;
+		}
 	}
 
 	pixman_region32_fini(&transformed_region);
-
-	cookie = xcb_set_clip_rectangles_checked(b->conn, XCB_CLIP_ORDERING_UNSORTED,
-					output->gc,
-					0, 0, nrects,
-					output_rects);
-	err = xcb_request_check(b->conn, cookie);
-	if (err != NULL) {
-		weston_log("Failed to set clip rects, err: %d\n", err->error_code);
-		free(err);
-	}
-	free(output_rects);
+	xcb_flush(b->conn);
 }
 
-
 static int
 x11_output_repaint_shm(struct weston_output *output_base,
 		       pixman_region32_t *damage)
 {
 	struct x11_output *output = to_x11_output(output_base);
-	const struct weston_renderer *renderer;
-	pixman_image_t *image;
 	struct weston_compositor *ec;
-	struct x11_backend *b;
-	xcb_void_cookie_t cookie;
-	xcb_generic_error_t *err;
+	struct x11_shm_buffer *sb;
 
 	assert(output);
 
 	ec = output->base.compositor;
-	renderer = ec->renderer;
-	b = output->backend;
 
-	image = renderer->pixman->renderbuffer_get_image(output->renderbuffer);
+	/* Render into the buffer the server is not reading from. The
+	 * pixman renderer tracks damage per renderbuffer, so each one
+	 * gets repainted with what changed since it was last shown. */
+	sb = &output->shm[output->shm_current];
+	if (sb->busy)
+		x11_output_wait_shm(output, sb);
 
-	ec->renderer->repaint_output(output_base, damage, output->renderbuffer);
+	ec->renderer->repaint_output(output_base, damage, sb->renderbuffer);
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
-	set_clip_for_output(output_base, damage);
-	cookie = xcb_shm_put_image_checked(b->conn, output->window, output->gc,
-					pixman_image_get_width(image),
-					pixman_image_get_height(image),
-					0, 0,
-					pixman_image_get_width(image),
-					pixman_image_get_height(image),
-					0, 0, output->depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					0, output->segment, 0);
-	err = xcb_request_check(b->conn, cookie);
-	if (err != NULL) {
-		weston_log("Failed to put shm image, err: %d\n", err->error_code);
-		free(err);
-	}
+
+	x11_output_put_shm(output, sb, damage);
+	output->shm_current ^= 1;
 
 	wl_event_source_timer_update(output->finish_frame_timer, 10);
 	return 0;
 }
 
+static void
+x11_backend_handle_shm_completion(struct x11_backend *b,
+				  xcb_shm_completion_event_t *completion)
+{
+	struct weston_output *base;
+	struct x11_output *output;
+	unsigned int i;
+
+	wl_list_for_each(base, &b->compositor->output_list, link) {
+		output = to_x11_output(base);
+		if (!output)
+			continue;
+
+		for (i = 0; i < ARRAY_LENGTH(output->shm); i++) {
+			struct x11_shm_buffer *sb = &output->shm[i];
+
+			/* A stale completion for a put we already waited
+			 * out must not retire the newer one. */
+			if (sb->busy && sb->segment == completion->shmseg &&
+			    (uint16_t) sb->put_sequence == completion->sequence)
+				sb->busy = false;
+		}
+	}
+}
+
 static int
 finish_frame_handler(void *data)
 {
@@ -556,21 +594,46 @@ finish_frame_handler(void *data)
 }
 
 static void
-x11_output_deinit_shm(struct x11_backend *b, struct x11_output *output)
+x11_shm_buffer_fini(struct x11_backend *b, struct x11_shm_buffer *sb)
 {
 	xcb_void_cookie_t cookie;
 	xcb_generic_error_t *err;
-	xcb_free_gc(b->conn, output->gc);
 
-	weston_renderbuffer_unref(output->renderbuffer);
-	output->renderbuffer = NULL;
-	cookie = xcb_shm_detach_checked(b->conn, output->segment);
-	err = xcb_request_check(b->conn, cookie);
-	if (err) {
-		weston_log("xcb_shm_detach failed, error %d\n", err->error_code);
-		free(err);
+	if (sb->renderbuffer) {
+		weston_renderbuffer_unref(sb->renderbuffer);
+		sb->renderbuffer = NULL;
 	}
-	shmdt(output->buf);
+
+	if (sb->segment) {
+		cookie = xcb_shm_detach_checked(b->conn, sb->segment);
+		err = xcb_request_check(b->conn, cookie);
+		if (err) {
+			weston_log("xcb_shm_detach failed, error %d\n",
+				   err->error_code);
+			free(err);
+		}
+		sb->segment = 0;
+	}
+
+	if (sb->buf) {
+		shmdt(sb->buf);
+		sb->buf = NULL;
+	}
+
+	sb->busy = false;
+}
+
+static void
+x11_output_deinit_shm(struct x11_backend *b, struct x11_output *output)
+{
+	unsigned int i;
+
+	xcb_free_gc(b->conn, output->gc);
+
+	/* The checked detach round trips, so no put is in flight after
+	 * the first one. */
+	for (i = 0; i < ARRAY_LENGTH(output->shm); i++)
+		x11_shm_buffer_fini(b, &output->shm[i]);
 }
 
 static void
@@ -741,6 +804,7 @@ x11_output_get_shm_pixel_format(struct x11_output *output)
 		errno = ENOENT;
 		return NULL;
 	}
+	b->shm_event_base = ext->first_event;
 
 	screen = x11_compositor_get_default_screen(b);
 	visual_type = find_visual_by_id(screen, screen->root_visual);
@@ -788,43 +852,69 @@ x11_output_get_shm_pixel_format(struct x11_output *output)
 }
 
 static int
-x11_output_init_shm(struct x11_backend *b, struct x11_output *output,
+x11_shm_buffer_init(struct x11_backend *b, struct x11_output *output,
+		    struct x11_shm_buffer *sb,
 		    const struct pixel_format_info *pfmt, int width, int height)
 {
 	struct weston_renderer *renderer = output->base.compositor->renderer;
 	int bitsperpixel = pfmt->bpp;
 	xcb_void_cookie_t cookie;
 	xcb_generic_error_t *err;
+	void *buf;
 
 	/* Create SHM segment and attach it */
-	output->shm_id = shmget(IPC_PRIVATE, width * height * (bitsperpixel / 8), IPC_CREAT | S_IRWXU);
-	if (output->shm_id == -1) {
+	sb->shm_id = shmget(IPC_PRIVATE, width * height * (bitsperpixel / 8), IPC_CREAT | S_IRWXU);
+	if (sb->shm_id == -1) {
 		weston_log("x11shm: failed to allocate SHM segment\n");
 		return -1;
 	}
-	output->buf = shmat(output->shm_id, NULL, 0 /* read/write */);
-	if (-1 == (long)output->buf) {
+	buf = shmat(sb->shm_id, NULL, 0 /* read/write */);
+	if (-1 == (long)buf) {
 		weston_log("x11shm: failed to attach SHM segment\n");
+		shmctl(sb->shm_id, IPC_RMID, NULL);
 		return -1;
 	}
-	output->segment = xcb_generate_id(b->conn);
-	cookie = xcb_shm_attach_checked(b->conn, output->segment, output->shm_id, 1);
+	sb->buf = buf;
+	sb->segment = xcb_generate_id(b->conn);
+	cookie = xcb_shm_attach_checked(b->conn, sb->segment, sb->shm_id, 1);
 	err = xcb_request_check(b->conn, cookie);
+	shmctl(sb->shm_id, IPC_RMID, NULL);
 	if (err) {
 		weston_log("x11shm: xcb_shm_attach error %d, op code %d, resource id %d\n",
 			   err->error_code, err->major_code, err->minor_code);
 		free(err);
+		sb->segment = 0;
 		return -1;
 	}
 
-	shmctl(output->shm_id, IPC_RMID, NULL);
-
 	/* Now create pixman image */
-	output->renderbuffer =
+	sb->renderbuffer =
 		renderer->pixman->create_image_from_ptr(&output->base,
 							pfmt, width, height,
-							output->buf,
+							sb->buf,
 							width * (bitsperpixel / 8));
+	sb->busy = false;
+
+	return 0;
+}
+
+static int
+x11_output_init_shm(struct x11_backend *b, struct x11_output *output,
+		    const struct pixel_format_info *pfmt, int width, int height)
+{
+	unsigned int i;
+
+	/* Two segments, so the next frame can be rendered while the
+	 * server is still reading the previous one. */
+	for (i = 0; i < ARRAY_LENGTH(output->shm); i++) {
+		if (x11_shm_buffer_init(b, output, &output->shm[i],
+					pfmt, width, height) < 0) {
+			for (i = 0; i < ARRAY_LENGTH(output->shm); i++)
+				x11_shm_buffer_fini(b, &output->shm[i]);
+			return -1;
+		}
+	}
+	output->shm_current = 0;
 
 	output->gc = xcb_generate_id(b->conn);
 	xcb_create_gc(b->conn, output->gc, output->window, 0, NULL);
@@ -1701,6 +1791,17 @@ x11_backend_handle_event(int fd, uint32_t mask, void *data)
 			notify_keyboard_focus_out(&b->core_seat);
 			break;
 
+		case 0: {
+			xcb_generic_error_t *err = (xcb_generic_error_t *) event;
+
+			/* Unchecked requests, such as the SHM puts,
+			 * report failure here. */
+			weston_log("X11 error %d, op code %d, minor %d\n",
+				   err->error_code, err->major_code,
+				   err->minor_code);
+			break;
+		}
+
 		default:
 			break;
 		}
@@ -1723,6 +1824,11 @@ x11_backend_handle_event(int fd, uint32_t mask, void *data)
 		}
 #endif
 
+		if (b->shm_event_base &&
+		    response_type == b->shm_event_base + XCB_SHM_COMPLETION)
+			x11_backend_handle_shm_completion(b,
+				(xcb_shm_completion_event_t *) event);
+
 		count++;
 		if (b->prev_event != event)
 			free(event);
@@ -167,6 +167,9 @@ weston_output_finish_frame(struct weston_output *output,
 void
 weston_output_repaint_failed(struct weston_output *output);
 
+void
+weston_output_repaint_dropped(struct weston_output *output);
+
 int
 weston_output_mode_set_native(struct weston_output *output,
 			      struct weston_mode *mode,
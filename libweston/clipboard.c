@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <linux/input.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/uio.h>
@@ -36,15 +37,23 @@
 #include <libweston/libweston.h>
 #include "libweston-internal.h"
 #include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+
+/* Largest amount of data moved per event loop dispatch, in either
+ * direction. Anything bigger is streamed over several dispatches, so a
+ * huge selection never stalls the compositor. */
+static const size_t clipboard_chunk_size = 64 * 1024;
 
 struct clipboard_source {
 	struct weston_data_source base;
-	struct wl_array contents;
+	int data_fd;		/* anonymous file holding the contents */
+	size_t size;		/* bytes of contents stored in data_fd */
 	struct clipboard *clipboard;
 	struct wl_event_source *event_source;
 	uint32_t serial;
 	int refcount;
 	int fd;
+	struct wl_list client_list;	/* clipboard_client::link */
 };
 
 struct clipboard {
@@ -54,8 +63,27 @@ struct clipboard {
 	struct clipboard_source *source;
 };
 
+struct clipboard_client {
+	struct wl_event_source *event_source;
+	loff_t offset;
+	struct clipboard_source *source;
+	struct wl_list link;	/* clipboard_source::client_list */
+};
+
 static void clipboard_client_create(struct clipboard_source *source, int fd);
 
+/* Clients that caught up with a source still being read wait for more
+ * data without polling their fd, let them go on. */
+static void
+clipboard_source_wake_clients(struct clipboard_source *source)
+{
+	struct clipboard_client *client;
+
+	wl_list_for_each(client, &source->client_list, link)
+		wl_event_source_fd_update(client->event_source,
+					  WL_EVENT_WRITABLE);
+}
+
 static void
 clipboard_source_unref(struct clipboard_source *source)
 {
@@ -74,35 +102,82 @@ clipboard_source_unref(struct clipboard_source *source)
 	s = source->base.mime_types.data;
 	free(*s);
 	wl_array_release(&source->base.mime_types);
-	wl_array_release(&source->contents);
+	close(source->data_fd);
 	free(source);
 }
 
+static void
+clipboard_source_stop_reading(struct clipboard_source *source)
+{
+	wl_event_source_remove(source->event_source);
+	close(source->fd);
+	source->event_source = NULL;
+	clipboard_source_wake_clients(source);
+}
+
+/* Append up to len bytes from the source pipe to the contents file.
+ * The data is spliced through the kernel when possible, so it is never
+ * copied into compositor memory.
+ */
+static ssize_t
+clipboard_source_fill(struct clipboard_source *source, size_t len)
+{
+	char buf[4096];
+	loff_t offset = source->size;
+	ssize_t ret, written, n;
+
+	ret = splice(source->fd, NULL, source->data_fd, &offset, len,
+		     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (ret >= 0 || (errno != EINVAL && errno != ENOSYS))
+		return ret;
+
+	ret = read(source->fd, buf, MIN(len, sizeof buf));
+	for (written = 0; written < ret; written += n) {
+		n = pwrite(source->data_fd, buf + written, ret - written,
+			   source->size + written);
+		if (n < 0)
+			return -1;
+	}
+
+	return ret;
+}
+
 static int
 clipboard_source_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_source *source = data;
 	struct clipboard *clipboard = source->clipboard;
-	char *p;
-	int len, size;
-
-	if (source->contents.alloc - source->contents.size < 1024) {
-		wl_array_add(&source->contents, 1024);
-		source->contents.size -= 1024;
+	struct weston_compositor *compositor = clipboard->seat->compositor;
+	size_t max_size = compositor->clipboard_max_size;
+	size_t len = clipboard_chunk_size;
+	ssize_t ret;
+
+	/* Ask for one byte past the cap, so that a selection of exactly
+	 * the maximum size still reaches EOF. */
+	if (max_size > 0)
+		len = MIN(len, max_size - source->size + 1);
+
+	ret = clipboard_source_fill(source, len);
+	if (ret == 0) {
+		clipboard_source_stop_reading(source);
+	} else if (ret < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 1;
+		clipboard_source_stop_reading(source);
+		clipboard_source_unref(source);
+		clipboard->source = NULL;
+		return 1;
+	} else {
+		source->size += ret;
+		clipboard_source_wake_clients(source);
 	}
 
-	p = source->contents.data + source->contents.size;
-	size = source->contents.alloc - source->contents.size;
-	len = read(fd, p, size);
-	if (len == 0) {
-		wl_event_source_remove(source->event_source);
-		close(fd);
-		source->event_source = NULL;
-	} else if (len < 0) {
+	if (max_size > 0 && source->size > max_size) {
+		weston_log("clipboard: selection exceeds %zu bytes, "
+			   "not keeping a copy\n", max_size);
+		clipboard_source_stop_reading(source);
 		clipboard_source_unref(source);
 		clipboard->source = NULL;
-	} else {
-		source->contents.size += len;
 	}
 
 	return 1;
@@ -147,7 +222,10 @@ clipboard_source_create(struct clipboard *clipboard,
 	if (source == NULL)
 		return NULL;
 
-	wl_array_init(&source->contents);
+	source->data_fd = os_create_anonymous_file(clipboard_chunk_size);
+	if (source->data_fd < 0)
+		goto err_data;
+
 	wl_array_init(&source->base.mime_types);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
@@ -158,6 +236,7 @@ clipboard_source_create(struct clipboard *clipboard,
 	source->clipboard = clipboard;
 	source->serial = serial;
 	source->fd = fd;
+	wl_list_init(&source->client_list);
 
 	s = wl_array_add(&source->base.mime_types, sizeof *s);
 	if (s == NULL)
@@ -178,34 +257,67 @@ clipboard_source_create(struct clipboard *clipboard,
  err_strdup:
 	wl_array_release(&source->base.mime_types);
  err_add:
+	close(source->data_fd);
+ err_data:
 	free(source);
 
 	return NULL;
 }
 
-struct clipboard_client {
-	struct wl_event_source *event_source;
-	size_t offset;
-	struct clipboard_source *source;
-};
+/* Send up to len bytes of the contents file to a client, starting at
+ * client->offset. Splicing only works when the client handed us a
+ * pipe; for anything else, bounce through a small buffer.
+ */
+static ssize_t
+clipboard_client_flush(struct clipboard_client *client, int fd, size_t len)
+{
+	char buf[4096];
+	ssize_t ret;
+
+	ret = splice(client->source->data_fd, &client->offset, fd, NULL, len,
+		     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (ret >= 0 || (errno != EINVAL && errno != ENOSYS))
+		return ret;
+
+	ret = pread(client->source->data_fd, buf, MIN(len, sizeof buf),
+		    client->offset);
+	if (ret <= 0)
+		return ret;
+
+	ret = write(fd, buf, ret);
+	if (ret > 0)
+		client->offset += ret;
+
+	return ret;
+}
 
 static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
-	char *p;
 	size_t size;
-	int len;
+	ssize_t len;
+
+	size = client->source->size;
 
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
-		client->offset += len;
+	/* The owner went away before we got all of the selection, wait
+	 * for the rest instead of cutting the transfer short. */
+	if ((size_t) client->offset == size && client->source->event_source) {
+		wl_event_source_fd_update(client->event_source, 0);
+		return 1;
+	}
+
+	len = clipboard_client_flush(client, fd,
+				     MIN(size - client->offset,
+					 clipboard_chunk_size));
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 1;
 
-	if (client->offset == size || len <= 0) {
+	if (((size_t) client->offset == size &&
+	     !client->source->event_source) || len <= 0) {
 		close(fd);
 		wl_event_source_remove(client->event_source);
+		wl_list_remove(&client->link);
 		clipboard_source_unref(client->source);
 		free(client);
 	}
@@ -222,11 +334,18 @@ clipboard_client_create(struct clipboard_source *source, int fd)
 		wl_display_get_event_loop(seat->compositor->wl_display);
 
 	client = zalloc(sizeof *client);
-	if (client == NULL)
+	if (client == NULL) {
+		close(fd);
 		return;
+	}
+
+	/* Never let a slow reader block the compositor: write only what
+	 * the receiving end can take, and wait for it to drain. */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
 	client->source = source;
 	source->refcount++;
+	wl_list_insert(&source->client_list, &client->link);
 	client->event_source =
 		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
 				     clipboard_client_data, client);
@@ -263,6 +382,10 @@ clipboard_set_selection(struct wl_listener *listener, void *data)
 	if (!mime_types || pipe2(p, O_CLOEXEC) == -1)
 		return;
 
+	/* Only our end is non-blocking, the source client may well
+	 * expect blocking writes. */
+	fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+
 	source->send(source, mime_types[0], p[1]);
 
 	clipboard->source =
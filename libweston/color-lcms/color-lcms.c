@@ -385,6 +385,8 @@ cmlcms_destroy(struct weston_color_manager *cm_base)
 		cmlcms_color_profile_destroy(cm->sRGB_profile);
 	assert(wl_list_empty(&cm->color_transform_list));
 	assert(wl_list_empty(&cm->color_profile_list));
+	hash_table_destroy(cm->color_transform_index);
+	hash_table_destroy(cm->color_profile_index);
 
 	cmsDeleteContext(cm->lcms_ctx);
 
@@ -462,6 +464,11 @@ weston_color_manager_create(struct weston_compositor *compositor)
 	wl_list_init(&cm->color_transform_list);
 	wl_list_init(&cm->color_profile_list);
 
+	cm->color_transform_index = hash_table_create();
+	cm->color_profile_index = hash_table_create();
+	if (!cm->color_transform_index || !cm->color_profile_index)
+		goto err;
+
 	cm->transforms_scope =
 		weston_compositor_add_log_scope(compositor, "color-lcms-transformations",
 						"Color transformation creation and destruction.\n",
@@ -485,6 +492,8 @@ err:
 	weston_log_scope_destroy(cm->transforms_scope);
 	weston_log_scope_destroy(cm->optimizer_scope);
 	weston_log_scope_destroy(cm->profiles_scope);
+	hash_table_destroy(cm->color_transform_index);
+	hash_table_destroy(cm->color_profile_index);
 	free(cm);
 	return NULL;
 }
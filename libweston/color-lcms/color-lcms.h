@@ -32,6 +32,7 @@
 #include <libweston/weston-log.h>
 
 #include "color.h"
+#include "shared/hash.h"
 #include "shared/helpers.h"
 
 struct weston_color_manager_lcms {
@@ -43,6 +44,11 @@ struct weston_color_manager_lcms {
 
 	struct wl_list color_transform_list; /* cmlcms_color_transform::link */
 	struct wl_list color_profile_list; /* cmlcms_color_profile::link */
+
+	/* cmlcms_color_transform by search_hash, chained by hash_next */
+	struct hash_table *color_transform_index;
+	/* cmlcms_color_profile by md5sum, chained by md5_next */
+	struct hash_table *color_profile_index;
 	struct cmlcms_color_profile *sRGB_profile; /* stock profile */
 };
 
@@ -65,6 +71,9 @@ struct cmlcms_color_profile {
 	cmsHPROFILE profile;
 	struct cmlcms_md5_sum md5sum;
 
+	/* weston_color_manager_lcms::color_profile_index */
+	struct cmlcms_color_profile *md5_next;
+
 	/** The curves to decode an electrical signal
 	 *
 	 * For ICC profiles, if the profile type is matrix-shaper, then eotf
@@ -154,6 +163,10 @@ struct cmlcms_color_transform {
 
 	struct cmlcms_color_transform_search_param search_key;
 
+	/* weston_color_manager_lcms::color_transform_index */
+	uint32_t search_hash;
+	struct cmlcms_color_transform *hash_next;
+
 	/*
 	 * Cached data in case weston_color_transform needs them.
 	 * Pre-curve and post-curve refer to the weston_color_transform
@@ -284,13 +284,25 @@ validate_icc_profile(cmsHPROFILE profile, char **errmsg)
 	return true;
 }
 
+/* The MD5 sum is as good a hash as any, take 32 bits of it */
+static uint32_t
+md5_hash(const struct cmlcms_md5_sum *md5sum)
+{
+	uint32_t hash;
+
+	memcpy(&hash, md5sum->bytes, sizeof hash);
+
+	return hash;
+}
+
 static struct cmlcms_color_profile *
 cmlcms_find_color_profile_by_md5(const struct weston_color_manager_lcms *cm,
 				 const struct cmlcms_md5_sum *md5sum)
 {
 	struct cmlcms_color_profile *cprof;
 
-	wl_list_for_each(cprof, &cm->color_profile_list, link) {
+	cprof = hash_table_lookup(cm->color_profile_index, md5_hash(md5sum));
+	for (; cprof; cprof = cprof->md5_next) {
 		if (memcmp(cprof->md5sum.bytes,
 			   md5sum->bytes, sizeof(md5sum->bytes)) == 0)
 			return cprof;
@@ -299,6 +311,49 @@ cmlcms_find_color_profile_by_md5(const struct weston_color_manager_lcms *cm,
 	return NULL;
 }
 
+static int
+color_profile_index_add(struct weston_color_manager_lcms *cm,
+			struct cmlcms_color_profile *cprof)
+{
+	uint32_t hash = md5_hash(&cprof->md5sum);
+	struct cmlcms_color_profile *head;
+
+	head = hash_table_lookup(cm->color_profile_index, hash);
+	if (head) {
+		cprof->md5_next = head->md5_next;
+		head->md5_next = cprof;
+		return 0;
+	}
+
+	return hash_table_insert(cm->color_profile_index, hash, cprof);
+}
+
+static void
+color_profile_index_remove(struct weston_color_manager_lcms *cm,
+			   struct cmlcms_color_profile *cprof)
+{
+	uint32_t hash = md5_hash(&cprof->md5sum);
+	struct cmlcms_color_profile *prev;
+
+	prev = hash_table_lookup(cm->color_profile_index, hash);
+	if (prev == cprof) {
+		hash_table_remove(cm->color_profile_index, hash);
+		/* If this fails, the rest of the chain is merely no longer
+		 * found for deduplication. */
+		if (cprof->md5_next)
+			hash_table_insert(cm->color_profile_index, hash,
+					  cprof->md5_next);
+		return;
+	}
+
+	for (; prev; prev = prev->md5_next) {
+		if (prev->md5_next == cprof) {
+			prev->md5_next = cprof->md5_next;
+			return;
+		}
+	}
+}
+
 char *
 cmlcms_color_profile_print(const struct cmlcms_color_profile *cprof)
 {
@@ -327,6 +382,10 @@ cmlcms_color_profile_create(struct weston_color_manager_lcms *cm,
 	cprof->base.description = desc;
 	cprof->profile = profile;
 	cmsGetHeaderProfileID(profile, cprof->md5sum.bytes);
+	if (color_profile_index_add(cm, cprof) < 0) {
+		free(cprof);
+		return NULL;
+	}
 	wl_list_insert(&cm->color_profile_list, &cprof->link);
 
 	weston_log_scope_printf(cm->profiles_scope,
@@ -345,6 +404,7 @@ cmlcms_color_profile_destroy(struct cmlcms_color_profile *cprof)
 	struct weston_color_manager_lcms *cm = get_cmlcms(cprof->base.cm);
 
 	wl_list_remove(&cprof->link);
+	color_profile_index_remove(cm, cprof);
 	cmsFreeToneCurveTriple(cprof->vcgt);
 	cmsFreeToneCurveTriple(cprof->eotf);
 	cmsFreeToneCurveTriple(cprof->output_inv_eotf_vcgt);
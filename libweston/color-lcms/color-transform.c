@@ -134,29 +134,110 @@ cmlcms_fill_in_3dlut(struct weston_color_transform *xform_base,
 		     float *lut, unsigned int len)
 {
 	struct cmlcms_color_transform *xform = get_xform(xform_base);
-	float rgb_in[3];
-	float rgb_out[3];
-	unsigned int index;
+	unsigned int npoints = len * len * len;
+	float *grid;
+	float *p;
+	unsigned int i;
 	unsigned int value_b, value_r, value_g;
 	float divider = len - 1;
 
 	assert(xform->search_key.category == CMLCMS_CATEGORY_INPUT_TO_BLEND ||
 	       xform->search_key.category == CMLCMS_CATEGORY_INPUT_TO_OUTPUT);
 
+	/*
+	 * Lay out the whole input grid in LUT order and transform it with a
+	 * single call, instead of paying the per-call overhead of
+	 * cmsDoTransform() for every LUT element.
+	 */
+	grid = xzalloc(3 * npoints * sizeof *grid);
+	p = grid;
 	for (value_b = 0; value_b < len; value_b++) {
 		for (value_g = 0; value_g < len; value_g++) {
 			for (value_r = 0; value_r < len; value_r++) {
-				rgb_in[0] = (float)value_r / divider;
-				rgb_in[1] = (float)value_g / divider;
-				rgb_in[2] = (float)value_b / divider;
+				*p++ = (float)value_r / divider;
+				*p++ = (float)value_g / divider;
+				*p++ = (float)value_b / divider;
+			}
+		}
+	}
 
-				cmsDoTransform(xform->cmap_3dlut, rgb_in, rgb_out, 1);
+	cmsDoTransform(xform->cmap_3dlut, grid, lut, npoints);
 
-				index = 3 * (value_r + len * (value_g + len * value_b));
-				lut[index    ] = ensure_unorm(rgb_out[0]);
-				lut[index + 1] = ensure_unorm(rgb_out[1]);
-				lut[index + 2] = ensure_unorm(rgb_out[2]);
-			}
+	for (i = 0; i < 3 * npoints; i++)
+		lut[i] = ensure_unorm(lut[i]);
+
+	free(grid);
+}
+
+/* FNV-1a over the search parameters */
+static uint32_t
+search_param_hash(const struct cmlcms_color_transform_search_param *param)
+{
+	const struct {
+		uintptr_t input_profile;
+		uintptr_t output_profile;
+		uint32_t category;
+		uint32_t intent_output;
+	} key = {
+		.input_profile = (uintptr_t)param->input_profile,
+		.output_profile = (uintptr_t)param->output_profile,
+		.category = param->category,
+		.intent_output = param->intent_output,
+	};
+	const uint8_t *bytes = (const uint8_t *)&key;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < sizeof key; i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static int
+color_transform_index_add(struct weston_color_manager_lcms *cm,
+			  struct cmlcms_color_transform *xform)
+{
+	struct cmlcms_color_transform *head;
+
+	head = hash_table_lookup(cm->color_transform_index,
+				 xform->search_hash);
+	if (head) {
+		xform->hash_next = head->hash_next;
+		head->hash_next = xform;
+		return 0;
+	}
+
+	return hash_table_insert(cm->color_transform_index,
+				 xform->search_hash, xform);
+}
+
+static void
+color_transform_index_remove(struct weston_color_manager_lcms *cm,
+			     struct cmlcms_color_transform *xform)
+{
+	struct cmlcms_color_transform *prev;
+
+	prev = hash_table_lookup(cm->color_transform_index,
+				 xform->search_hash);
+	if (prev == xform) {
+		hash_table_remove(cm->color_transform_index,
+				  xform->search_hash);
+		/* If this fails, the rest of the chain is merely no longer
+		 * found and gets recreated on demand. */
+		if (xform->hash_next)
+			hash_table_insert(cm->color_transform_index,
+					  xform->search_hash,
+					  xform->hash_next);
+		return;
+	}
+
+	for (; prev; prev = prev->hash_next) {
+		if (prev->hash_next == xform) {
+			prev->hash_next = xform->hash_next;
+			return;
 		}
 	}
 }
@@ -167,6 +248,7 @@ cmlcms_color_transform_destroy(struct cmlcms_color_transform *xform)
 	struct weston_color_manager_lcms *cm = get_cmlcms(xform->base.cm);
 
 	wl_list_remove(&xform->link);
+	color_transform_index_remove(cm, xform);
 
 	cmsFreeToneCurveTriple(xform->pre_curve);
 
@@ -967,6 +1049,7 @@ cmlcms_color_transform_create(struct weston_color_manager_lcms *cm,
 	xform->search_key = *search_param;
 	xform->search_key.input_profile = ref_cprof(search_param->input_profile);
 	xform->search_key.output_profile = ref_cprof(search_param->output_profile);
+	xform->search_hash = search_param_hash(search_param);
 
 	weston_log_scope_printf(cm->transforms_scope,
 				"New color transformation: %p\n", xform);
@@ -1009,6 +1092,10 @@ cmlcms_color_transform_create(struct weston_color_manager_lcms *cm,
 		break;
 	}
 
+	if (color_transform_index_add(cm, xform) < 0) {
+		err_msg = "out of memory";
+		goto error;
+	}
 	wl_list_insert(&cm->color_transform_list, &xform->link);
 	assert(xform->status != CMLCMS_TRANSFORM_FAILED);
 
@@ -1046,7 +1133,9 @@ cmlcms_color_transform_get(struct weston_color_manager_lcms *cm,
 {
 	struct cmlcms_color_transform *xform;
 
-	wl_list_for_each(xform, &cm->color_transform_list, link) {
+	xform = hash_table_lookup(cm->color_transform_index,
+				  search_param_hash(param));
+	for (; xform; xform = xform->hash_next) {
 		if (transform_matches_params(xform, param)) {
 			weston_color_transform_ref(&xform->base);
 			return xform;
@@ -65,6 +65,7 @@
 #include "xdg-output-unstable-v1-server-protocol.h"
 #include "linux-explicit-synchronization-unstable-v1-server-protocol.h"
 #include "linux-explicit-synchronization.h"
+#include "linux-sync-file.h"
 #include "single-pixel-buffer-v1-server-protocol.h"
 #include "shared/fd-util.h"
 #include "shared/helpers.h"
@@ -167,6 +168,13 @@ paint_node_update(struct weston_paint_node *pnode)
 
 }
 
+/* Paint nodes come and go as views move between outputs and layers, and
+ * weston_buffers and presentation feedback (below) with client frames. */
+static struct weston_pool paint_node_pool =
+	WESTON_POOL_INIT(struct weston_paint_node, 256);
+static struct weston_pool buffer_pool =
+	WESTON_POOL_INIT(struct weston_buffer, 128);
+
 static struct weston_paint_node *
 weston_paint_node_create(struct weston_surface *surface,
 			 struct weston_view *view,
@@ -177,7 +185,7 @@ weston_paint_node_create(struct weston_surface *surface,
 
 	assert(view->surface == surface);
 
-	pnode = zalloc(sizeof *pnode);
+	pnode = weston_pool_zalloc(&paint_node_pool);
 	if (!pnode)
 		return NULL;
 
@@ -225,7 +233,7 @@ weston_paint_node_destroy(struct weston_paint_node *pnode)
 	wl_list_remove(&pnode->z_order_link);
 	assert(pnode->surf_xform_valid || !pnode->surf_xform.transform);
 	weston_surface_color_transform_fini(&pnode->surf_xform);
-	free(pnode);
+	weston_pool_free(&paint_node_pool, pnode);
 }
 
 /** Send wl_output events for mode and scale changes
@@ -509,6 +517,9 @@ struct weston_presentation_feedback {
 	uint32_t psf_flags;
 };
 
+static struct weston_pool feedback_pool =
+	WESTON_POOL_INIT(struct weston_presentation_feedback, 64);
+
 static void
 weston_presentation_feedback_discard(
 		struct weston_presentation_feedback *feedback)
@@ -696,6 +707,9 @@ weston_surface_create(struct weston_compositor *compositor)
 
 	wl_list_init(&surface->frame_callback_list);
 	wl_list_init(&surface->feedback_list);
+	wl_list_init(&surface->occluded_link);
+	wl_list_init(&surface->latch_queue);
+	wl_list_init(&surface->latch_link);
 
 	wl_list_init(&surface->subsurface_list);
 	wl_list_init(&surface->subsurface_list_pending);
@@ -1512,6 +1526,37 @@ weston_view_geometry_dirty(struct weston_view *view)
 	weston_view_dirty_paint_nodes(view);
 }
 
+/** Set the opacity of a view
+ *
+ * \param view The view.
+ * \param alpha The new opacity, in the range [0, 1].
+ *
+ * The transformed opaque region of a view only depends on its alpha when
+ * it becomes or stops being 1.0. For any other change, e.g. the frames of
+ * a fade, the transform is left alone and the area covered by the view is
+ * damaged instead.
+ *
+ * A repaint is scheduled for this view.
+ */
+WL_EXPORT void
+weston_view_set_alpha(struct weston_view *view, float alpha)
+{
+	bool opaque_changed = (view->alpha == 1.0) != (alpha == 1.0);
+
+	if (view->alpha == alpha)
+		return;
+
+	view->alpha = alpha;
+
+	if (view->transform.dirty || opaque_changed) {
+		weston_view_geometry_dirty(view);
+		weston_view_schedule_repaint(view);
+		return;
+	}
+
+	weston_view_damage_below(view);
+}
+
 /**
  * \param surface  The surface to be repainted
  *
@@ -2131,6 +2176,9 @@ weston_surface_ref(struct weston_surface *surface)
 	return surface;
 }
 
+static void
+weston_surface_discard_latched_commits(struct weston_surface *surface);
+
 WL_EXPORT void
 weston_surface_unref(struct weston_surface *surface)
 {
@@ -2164,6 +2212,7 @@ weston_surface_unref(struct weston_surface *surface)
 		weston_paint_node_destroy(pnode);
 	}
 
+	weston_surface_discard_latched_commits(surface);
 	weston_surface_state_fini(&surface->pending);
 
 	weston_buffer_reference(&surface->buffer_ref, NULL,
@@ -2178,6 +2227,7 @@ weston_surface_unref(struct weston_surface *surface)
 		wl_resource_destroy(cb);
 
 	weston_presentation_feedback_discard_list(&surface->feedback_list);
+	wl_list_remove(&surface->occluded_link);
 
 	wl_list_for_each_safe(constraint, next_constraint,
 			      &surface->pointer_constraints,
@@ -2231,7 +2281,7 @@ weston_buffer_destroy_handler(struct wl_listener *listener, void *data)
 		return;
 
 	weston_signal_emit_mutable(&buffer->destroy_signal, buffer);
-	free(buffer);
+	weston_pool_free(&buffer_pool, buffer);
 }
 
 WL_EXPORT struct weston_buffer *
@@ -2251,7 +2301,7 @@ weston_buffer_from_resource(struct weston_compositor *ec,
 		return container_of(listener, struct weston_buffer,
 				    destroy_listener);
 
-	buffer = zalloc(sizeof *buffer);
+	buffer = weston_pool_zalloc(&buffer_pool);
 	if (buffer == NULL)
 		return NULL;
 
@@ -2320,7 +2370,7 @@ weston_buffer_from_resource(struct weston_compositor *ec,
 
 fail:
 	wl_list_remove(&buffer->destroy_listener.link);
-	free(buffer);
+	weston_pool_free(&buffer_pool, buffer);
 	return NULL;
 }
 
@@ -2377,7 +2427,7 @@ weston_buffer_reference(struct weston_buffer_reference *ref,
 	    !old_ref.buffer->resource) {
 		weston_signal_emit_mutable(&old_ref.buffer->destroy_signal,
 					   old_ref.buffer);
-		free(old_ref.buffer);
+		weston_pool_free(&buffer_pool, old_ref.buffer);
 	}
 }
 
@@ -2453,7 +2503,7 @@ weston_buffer_create_solid_rgba(struct weston_compositor *compositor,
 	if (!ret)
 		return NULL;
 
-	buffer = zalloc(sizeof(*buffer));
+	buffer = weston_pool_zalloc(&buffer_pool);
 	if (!buffer) {
 		free(ret);
 		return NULL;
@@ -2690,6 +2740,184 @@ surface_flush_damage(struct weston_surface *surface, struct weston_output *outpu
 	pixman_region32_clear(&surface->damage);
 }
 
+static void
+output_scene_reserve(struct weston_output_scene *scene, unsigned int count)
+{
+	unsigned int alloc;
+
+	if (count <= scene->alloc)
+		return;
+
+	alloc = scene->alloc ? scene->alloc : 32;
+	while (alloc < count)
+		alloc *= 2;
+
+	scene->pnode = xrealloc(scene->pnode, alloc * sizeof *scene->pnode);
+	scene->plane = xrealloc(scene->plane, alloc * sizeof *scene->plane);
+	scene->bbox = xrealloc(scene->bbox, alloc * sizeof *scene->bbox);
+	scene->flags = xrealloc(scene->flags, alloc * sizeof *scene->flags);
+	scene->protection = xrealloc(scene->protection,
+				     alloc * sizeof *scene->protection);
+	scene->alloc = alloc;
+}
+
+static void
+output_scene_destroy(struct weston_output_scene *scene)
+{
+	if (!scene)
+		return;
+
+	free(scene->pnode);
+	free(scene->plane);
+	free(scene->bbox);
+	free(scene->flags);
+	free(scene->protection);
+	free(scene);
+}
+
+/* Take the one pass over paint_node_z_order_list that every repaint needs
+ * anyway, and copy out what the later core passes read. */
+static struct weston_output_scene *
+output_build_scene(struct weston_output *output)
+{
+	struct weston_output_scene *scene;
+	struct weston_paint_node *pnode;
+	uint32_t bit = 1u << output->id;
+	unsigned int i = 0;
+
+	if (!output->scene)
+		output->scene = xzalloc(sizeof *output->scene);
+	scene = output->scene;
+
+	wl_list_for_each(pnode, &output->paint_node_z_order_list,
+			 z_order_link) {
+		struct weston_view *view = pnode->view;
+		struct weston_surface *surface = pnode->surface;
+		const struct weston_matrix *matrix = &view->transform.matrix;
+		uint8_t flags = 0;
+		bool exact_bbox;
+
+		if (i == scene->alloc)
+			output_scene_reserve(scene, i + 1);
+
+		if (view->output_mask & bit)
+			flags |= WESTON_SCENE_VIEW_ON_OUTPUT;
+		if (surface->output_mask & bit)
+			flags |= WESTON_SCENE_SURFACE_ON_OUTPUT;
+		if (surface->output == output)
+			flags |= WESTON_SCENE_SURFACE_PRIMARY;
+		if (pnode->surf_xform_valid)
+			flags |= WESTON_SCENE_XFORM_VALID;
+
+		/* weston_view_is_opaque() trusts an opaque buffer under any
+		 * transform, but the bounding box of a rotated, scaled or
+		 * sheared view is only an estimate of what it covers. */
+		exact_bbox = !view->transform.enabled ||
+			     matrix->type == WESTON_MATRIX_TRANSFORM_TRANSLATE;
+		if (exact_bbox &&
+		    weston_view_is_opaque(view, &view->transform.boundingbox))
+			flags |= WESTON_SCENE_OPAQUE_BBOX;
+
+		scene->pnode[i] = pnode;
+		scene->plane[i] = view->plane;
+		scene->bbox[i] = *pixman_region32_extents(&view->transform.boundingbox);
+		scene->flags[i] = flags;
+		scene->protection[i] = surface->desired_protection;
+		i++;
+	}
+	scene->count = i;
+
+	return scene;
+}
+
+/* assign_planes() moves views between planes, pick up where they went */
+static void
+output_scene_update_planes(struct weston_output_scene *scene)
+{
+	unsigned int i;
+
+	for (i = 0; i < scene->count; i++)
+		scene->plane[i] = scene->pnode[i]->view->plane;
+}
+
+static bool
+box_outside(const pixman_box32_t *a, const pixman_box32_t *b)
+{
+	return a->x2 <= b->x1 || a->x1 >= b->x2 ||
+	       a->y2 <= b->y1 || a->y1 >= b->y2;
+}
+
+/* Mark paint nodes which are entirely covered by opaque views above them
+ * as occluded, so the renderer does not upload their contents and the
+ * backend does not try to put them on a plane. */
+static void
+output_update_occlusion(struct weston_output *output,
+			struct weston_output_scene *scene)
+{
+	const pixman_box32_t *output_box = pixman_region32_extents(&output->region);
+	pixman_region32_t occluded, visible, opaque;
+	unsigned int i;
+
+	pixman_region32_init(&occluded);
+	pixman_region32_init(&visible);
+	pixman_region32_init(&opaque);
+
+	for (i = 0; i < scene->count; i++) {
+		struct weston_paint_node *pnode = scene->pnode[i];
+		const pixman_box32_t *bbox = &scene->bbox[i];
+
+		/* Most hidden nodes are off the output or wholly under one
+		 * opaque window, decide those from the extents alone. */
+		if (box_outside(bbox, output_box) ||
+		    pixman_region32_contains_rectangle(&occluded,
+						       (pixman_box32_t *)bbox) ==
+		    PIXMAN_REGION_IN) {
+			pnode->occluded = true;
+		} else {
+			pixman_region32_intersect(&visible,
+						  &pnode->view->transform.boundingbox,
+						  &output->region);
+			pixman_region32_subtract(&visible, &visible, &occluded);
+			pnode->occluded = !pixman_region32_not_empty(&visible);
+		}
+
+		if (pnode->occluded) {
+			scene->flags[i] |= WESTON_SCENE_OCCLUDED;
+			continue;
+		}
+
+		/* Nodes without a color transform are not drawn at all */
+		if (!(scene->flags[i] & WESTON_SCENE_XFORM_VALID))
+			continue;
+
+		if (scene->flags[i] & WESTON_SCENE_OPAQUE_BBOX) {
+			pixman_region32_union(&occluded, &occluded, &visible);
+		} else {
+			pixman_region32_intersect(&opaque, &visible,
+						  &pnode->view->transform.opaque);
+			pixman_region32_union(&occluded, &occluded, &opaque);
+		}
+	}
+
+	pixman_region32_fini(&opaque);
+	pixman_region32_fini(&visible);
+	pixman_region32_fini(&occluded);
+}
+
+/* Rebuild the view list and the scene of the output, and find out which
+ * of its paint nodes are occluded. */
+WESTON_EXPORT_FOR_TESTS struct weston_output_scene *
+weston_output_update_scene(struct weston_output *output)
+{
+	struct weston_output_scene *scene;
+
+	weston_compositor_build_view_list(output->compositor, output);
+	scene = output_build_scene(output);
+	output_update_occlusion(output, scene);
+
+	return scene;
+}
+
 static void
 view_accumulate_damage(struct weston_view *view,
 		       pixman_region32_t *opaque)
@@ -2721,13 +2949,14 @@ view_accumulate_damage(struct weston_view *view,
 	pixman_region32_union(opaque, opaque, &view->transform.opaque);
 }
 
-static void
-output_accumulate_damage(struct weston_output *output)
+WESTON_EXPORT_FOR_TESTS void
+weston_output_accumulate_damage(struct weston_output *output,
+				struct weston_output_scene *scene)
 {
 	struct weston_compositor *ec = output->compositor;
 	struct weston_plane *plane;
-	struct weston_paint_node *pnode;
 	pixman_region32_t opaque, clip;
+	unsigned int i;
 
 	pixman_region32_init(&clip);
 
@@ -2736,12 +2965,11 @@ output_accumulate_damage(struct weston_output *output)
 
 		pixman_region32_init(&opaque);
 
-		wl_list_for_each(pnode, &output->paint_node_z_order_list,
-				 z_order_link) {
-			if (pnode->view->plane != plane)
+		for (i = 0; i < scene->count; i++) {
+			if (scene->plane[i] != plane)
 				continue;
 
-			view_accumulate_damage(pnode->view, &opaque);
+			view_accumulate_damage(scene->pnode[i]->view, &opaque);
 		}
 
 		pixman_region32_union(&clip, &clip, &opaque);
@@ -2750,22 +2978,27 @@ output_accumulate_damage(struct weston_output *output)
 
 	pixman_region32_fini(&clip);
 
-	wl_list_for_each(pnode, &output->paint_node_z_order_list,
-			 z_order_link) {
-		pnode->surface->touched = false;
-	}
+	for (i = 0; i < scene->count; i++)
+		scene->pnode[i]->surface->touched = false;
+
+	for (i = 0; i < scene->count; i++) {
+		struct weston_surface *surface;
 
-	wl_list_for_each(pnode, &output->paint_node_z_order_list,
-			 z_order_link) {
 		/* Ignore views not visible on the current output */
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if (!(pnode->view->output_mask & (1u << output->id)))
+		if (!(scene->flags[i] & WESTON_SCENE_VIEW_ON_OUTPUT))
+			continue;
+		/* Keep the damage and the buffer of hidden surfaces until
+		 * they become visible again */
+		if (scene->flags[i] & WESTON_SCENE_OCCLUDED)
 			continue;
-		if (pnode->surface->touched)
+
+		surface = scene->pnode[i]->surface;
+		if (surface->touched)
 			continue;
-		pnode->surface->touched = true;
+		surface->touched = true;
 
-		surface_flush_damage(pnode->surface, output);
+		surface_flush_damage(surface, output);
 
 		/* Both the renderer and the backend have seen the buffer
 		 * by now. If renderer needs the buffer, it has its own
@@ -2775,12 +3008,12 @@ output_accumulate_damage(struct weston_output *output)
 		 * reference now, and allow early buffer release. This enables
 		 * clients to use single-buffering.
 		 */
-		if (!pnode->surface->keep_buffer) {
-			weston_buffer_reference(&pnode->surface->buffer_ref,
-						pnode->surface->buffer_ref.buffer,
+		if (!surface->keep_buffer) {
+			weston_buffer_reference(&surface->buffer_ref,
+						surface->buffer_ref.buffer,
 						BUFFER_WILL_NOT_BE_ACCESSED);
 			weston_buffer_release_reference(
-				&pnode->surface->buffer_release_ref, NULL);
+				&surface->buffer_release_ref, NULL);
 		}
 	}
 }
@@ -3016,11 +3249,163 @@ weston_output_take_feedback_list(struct weston_output *output,
 	wl_list_init(&surface->feedback_list);
 }
 
+static bool
+surface_is_occluded_on_output(struct weston_surface *surface,
+			      struct weston_output *output)
+{
+	struct weston_paint_node *pnode;
+
+	wl_list_for_each(pnode, &surface->paint_node_list, surface_link) {
+		if (pnode->output == output && !pnode->occluded)
+			return false;
+	}
+
+	return true;
+}
+
+/* Arm the occluded frame timer for the surface whose held frame callbacks
+ * are due first. Each surface is held for the current interval since it
+ * started being throttled, and the list is in that order. */
+static void
+occluded_frame_timer_arm(struct weston_compositor *ec,
+			 const struct timespec *now)
+{
+	struct weston_surface *first;
+	int64_t delay;
+
+	if (wl_list_empty(&ec->occluded_surface_list)) {
+		wl_event_source_timer_update(ec->occluded_frame_timer, 0);
+		return;
+	}
+
+	first = wl_container_of(ec->occluded_surface_list.next,
+				first, occluded_link);
+	delay = ec->occluded_frame_interval -
+		timespec_sub_to_msec(now, &first->occluded_since);
+
+	/* A delay of 0 would disarm the timer */
+	wl_event_source_timer_update(ec->occluded_frame_timer,
+				     MAX(delay, 1));
+}
+
+/* Hold back the frame callbacks and presentation feedback of a surface
+ * which is completely occluded on the output it is synced to. They are
+ * released by occluded_frame_timer_handler() instead of the repaint. */
+static bool
+surface_throttle_frame(struct weston_surface *surface,
+		       struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	bool was_empty;
+
+	if (ec->occluded_frame_interval == 0)
+		return false;
+
+	if (!surface_is_occluded_on_output(surface, output)) {
+		wl_list_remove(&surface->occluded_link);
+		wl_list_init(&surface->occluded_link);
+		return false;
+	}
+
+	if (!wl_list_empty(&surface->occluded_link))
+		return true;
+
+	was_empty = wl_list_empty(&ec->occluded_surface_list);
+	weston_compositor_read_presentation_clock(ec, &surface->occluded_since);
+	wl_list_insert(ec->occluded_surface_list.prev,
+		       &surface->occluded_link);
+
+	/* Otherwise it is due after the surfaces already held back */
+	if (was_empty)
+		occluded_frame_timer_arm(ec, &surface->occluded_since);
+
+	return true;
+}
+
+static void
+occluded_surface_release(struct weston_surface *surface, uint32_t now_msec)
+{
+	struct wl_resource *cb, *cnext;
+
+	wl_resource_for_each_safe(cb, cnext, &surface->frame_callback_list) {
+		wl_callback_send_done(cb, now_msec);
+		wl_resource_destroy(cb);
+	}
+
+	/* Nothing of this content update was ever shown */
+	weston_presentation_feedback_discard_list(&surface->feedback_list);
+
+	wl_list_remove(&surface->occluded_link);
+	wl_list_init(&surface->occluded_link);
+}
+
+static int
+occluded_frame_timer_handler(void *data)
+{
+	struct weston_compositor *ec = data;
+	struct weston_surface *surface, *next;
+	struct timespec now;
+	uint32_t now_msec;
+
+	weston_compositor_read_presentation_clock(ec, &now);
+	now_msec = timespec_to_msec(&now);
+
+	wl_list_for_each_safe(surface, next, &ec->occluded_surface_list,
+			      occluded_link) {
+		if (ec->occluded_frame_interval != 0 &&
+		    timespec_sub_to_msec(&now, &surface->occluded_since) <
+		    ec->occluded_frame_interval)
+			break;
+
+		occluded_surface_release(surface, now_msec);
+	}
+
+	occluded_frame_timer_arm(ec, &now);
+
+	return 0;
+}
+
+/** Throttle frame callbacks of occluded surfaces
+ *
+ * \param compositor The compositor.
+ * \param interval_msec The minimum time between two frame callbacks of an
+ * occluded surface, in milliseconds, or 0 to disable throttling.
+ *
+ * A surface which is completely hidden behind opaque views on the output
+ * it is synced to does not get its frame callbacks released by the
+ * repaint of that output. They are sent after \c interval_msec instead,
+ * and its presentation feedback is discarded, so that clients which are
+ * not visible stop drawing at the output refresh rate.
+ *
+ * Surfaces which are not part of any output's scene graph, e.g. minimized
+ * ones or those on disabled outputs, never receive frame callbacks and
+ * are not affected.
+ *
+ * This is meant to be configured by the shell.
+ *
+ * \ingroup compositor
+ */
+WL_EXPORT void
+weston_compositor_set_occluded_frame_interval(struct weston_compositor *compositor,
+					      uint32_t interval_msec)
+{
+	if (compositor->occluded_frame_interval == interval_msec)
+		return;
+
+	compositor->occluded_frame_interval = interval_msec;
+
+	/* Releases whatever is due under the new interval, which is
+	 * everything when throttling gets disabled, and re-arms the timer
+	 * for the rest. */
+	if (!wl_list_empty(&compositor->occluded_surface_list))
+		occluded_frame_timer_handler(compositor);
+}
+
 static int
 weston_output_repaint(struct weston_output *output)
 {
 	struct weston_compositor *ec = output->compositor;
-	struct weston_paint_node *pnode;
+	struct weston_output_scene *scene;
 	struct weston_animation *animation, *next;
 	struct wl_resource *cb, *cnext;
 	struct wl_list frame_callback_list;
@@ -3028,6 +3413,7 @@ weston_output_repaint(struct weston_output *output)
 	int r;
 	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
+	unsigned int i;
 
 	if (output->destroying)
 		return 0;
@@ -3035,13 +3421,12 @@ weston_output_repaint(struct weston_output *output)
 	TL_POINT(ec, "core_repaint_begin", TLP_OUTPUT(output), TLP_END);
 
 	/* Rebuild the surface list and update surface transforms up front. */
-	weston_compositor_build_view_list(ec, output);
+	scene = weston_output_update_scene(output);
 
 	/* Find the highest protection desired for an output */
-	wl_list_for_each(pnode, &output->paint_node_z_order_list,
-			 z_order_link) {
+	for (i = 0; i < scene->count; i++) {
 		/* TODO: turn this into assert once z_order_list is pruned. */
-		if ((pnode->surface->output_mask & (1u << output->id)) == 0)
+		if (!(scene->flags[i] & WESTON_SCENE_SURFACE_ON_OUTPUT))
 			continue;
 
 		/*
@@ -3050,8 +3435,8 @@ weston_output_repaint(struct weston_output *output)
 		 * that are displayed on that output, to avoid
 		 * reducing the protection for existing surfaces.
 		 */
-		if (pnode->surface->desired_protection > highest_requested)
-			highest_requested = pnode->surface->desired_protection;
+		if (scene->protection[i] > highest_requested)
+			highest_requested = scene->protection[i];
 	}
 
 	output->desired_protection = highest_requested;
@@ -3059,33 +3444,41 @@ weston_output_repaint(struct weston_output *output)
 	if (output->assign_planes && !output->disable_planes) {
 		output->assign_planes(output);
 	} else {
-		wl_list_for_each(pnode, &output->paint_node_z_order_list,
-				 z_order_link) {
+		for (i = 0; i < scene->count; i++) {
+			struct weston_view *view = scene->pnode[i]->view;
+
 			/* TODO: turn this into assert once z_order_list is pruned. */
-			if ((pnode->view->output_mask & (1u << output->id)) == 0)
+			if (!(scene->flags[i] & WESTON_SCENE_VIEW_ON_OUTPUT))
 				continue;
 
-			weston_view_move_to_plane(pnode->view, &ec->primary_plane);
-			pnode->view->psf_flags = 0;
+			weston_view_move_to_plane(view, &ec->primary_plane);
+			view->psf_flags = 0;
 		}
 	}
+	output_scene_update_planes(scene);
 
 	wl_list_init(&frame_callback_list);
-	wl_list_for_each(pnode, &output->paint_node_z_order_list,
-			 z_order_link) {
+	for (i = 0; i < scene->count; i++) {
+		struct weston_surface *surface;
+
 		/* Note: This operation is safe to do multiple times on the
 		 * same surface.
 		 */
-		if (pnode->surface->output == output) {
-			wl_list_insert_list(&frame_callback_list,
-					    &pnode->surface->frame_callback_list);
-			wl_list_init(&pnode->surface->frame_callback_list);
+		if (!(scene->flags[i] & WESTON_SCENE_SURFACE_PRIMARY))
+			continue;
 
-			weston_output_take_feedback_list(output, pnode->surface);
-		}
+		surface = scene->pnode[i]->surface;
+		if (surface_throttle_frame(surface, output))
+			continue;
+
+		wl_list_insert_list(&frame_callback_list,
+				    &surface->frame_callback_list);
+		wl_list_init(&surface->frame_callback_list);
+
+		weston_output_take_feedback_list(output, surface);
 	}
 
-	output_accumulate_damage(output);
+	weston_output_accumulate_damage(output, scene);
 
 	pixman_region32_init(&output_damage);
 	pixman_region32_intersect(&output_damage,
@@ -3097,6 +3490,9 @@ weston_output_repaint(struct weston_output *output)
 
 	pixman_region32_fini(&output_damage);
 
+	/* The nodes may be gone by the next repaint */
+	scene->count = 0;
+
 	output->repaint_needed = false;
 	if (r == 0)
 		output->repaint_status = REPAINT_AWAITING_COMPLETION;
@@ -3230,14 +3626,44 @@ weston_output_schedule_repaint_restart(struct weston_output *output)
 	weston_output_damage(output);
 }
 
+/** Drop an output update the backend left out of its repaint flush
+ *
+ * \param output The output whose update was dropped.
+ *
+ * For backends which, from their repaint_flush hook, present the updates
+ * of some outputs while leaving out an output whose update cannot be
+ * presented. The output no longer takes part in the result of the flush and
+ * gets a full repaint one frame later.
+ *
+ * \ingroup output
+ * \internal
+ */
+WL_EXPORT void
+weston_output_repaint_dropped(struct weston_output *output)
+{
+	assert(output->repainted);
+	output->repainted = false;
+	weston_output_schedule_repaint_restart(output);
+}
+
+static void
+weston_surface_latch(struct weston_surface *surface);
+
 static int
 output_repaint_timer_handler(void *data)
 {
 	struct weston_compositor *compositor = data;
 	struct weston_output *output;
+	struct weston_surface *surface, *next;
 	struct timespec now;
 	int ret = 0;
 
+	/* Late latching: show whatever has become ready by now, even if
+	 * the fence event has not been dispatched yet. */
+	wl_list_for_each_safe(surface, next, &compositor->latch_surface_list,
+			      latch_link)
+		weston_surface_latch(surface);
+
 	weston_compositor_read_presentation_clock(compositor, &now);
 	compositor->last_repaint_start = now;
 
@@ -3352,10 +3778,15 @@ weston_output_finish_frame(struct weston_output *output,
 		 TLP_VBLANK(&vblank_monotonic), TLP_END);
 
 	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+
+	/* The protocol reports a variable refresh rate as zero */
 	weston_presentation_feedback_present_list(&output->feedback_list,
-						  output, refresh_nsec, stamp,
+						  output,
+						  (presented_flags & WESTON_FINISH_FRAME_VRR) ?
+							0 : refresh_nsec,
+						  stamp,
 						  output->msc,
-						  presented_flags);
+						  presented_flags & ~WESTON_FINISH_FRAME_VRR);
 
 	output->frame_time = *stamp;
 
@@ -3380,6 +3811,15 @@ weston_output_finish_frame(struct weston_output *output,
 		output->next_repaint = now;
 	}
 
+	/* With a variable refresh rate there is no vblank grid to line up
+	 * with. The earliest deadline above is the panel's highest rate; if
+	 * it has passed already, the panel is waiting for us. */
+	if (presented_flags & WESTON_FINISH_FRAME_VRR) {
+		if (msec_rel < 0)
+			output->next_repaint = now;
+		goto out;
+	}
+
 	/* Called from restart_repaint_loop and restart happens already after
 	 * the deadline given by repaint_msec? In that case we delay until
 	 * the deadline of the next frame, to give clients a more predictable
@@ -4097,6 +4537,266 @@ weston_surface_commit(struct weston_surface *surface)
 	weston_surface_schedule_repaint(surface);
 }
 
+/* Move the pending state of a surface into another state, on top of what
+ * that one already holds, as for a commit that is not applied yet. */
+static void
+weston_surface_state_merge_pending(struct weston_surface *surface,
+				   struct weston_surface_state *state,
+				   struct weston_buffer_reference *buffer_ref)
+{
+	/*
+	 * If this commit would cause the surface to move by the
+	 * attach(dx, dy) parameters, the old damage region must be
+	 * translated to correspond to the new surface coordinate system
+	 * origin.
+	 */
+	pixman_region32_translate(&state->damage_surface,
+				  -surface->pending.sx, -surface->pending.sy);
+	pixman_region32_union(&state->damage_surface,
+			      &state->damage_surface,
+			      &surface->pending.damage_surface);
+	pixman_region32_clear(&surface->pending.damage_surface);
+
+	pixman_region32_union(&state->damage_buffer,
+			      &state->damage_buffer,
+			      &surface->pending.damage_buffer);
+	pixman_region32_clear(&surface->pending.damage_buffer);
+
+	if (surface->pending.newly_attached) {
+		state->newly_attached = 1;
+		weston_surface_state_set_buffer(state,
+						surface->pending.buffer);
+		weston_buffer_reference(buffer_ref,
+					surface->pending.buffer,
+					surface->pending.buffer ?
+						BUFFER_MAY_BE_ACCESSED :
+						BUFFER_WILL_NOT_BE_ACCESSED);
+		weston_presentation_feedback_discard_list(
+					&state->feedback_list);
+		/* zwp_surface_synchronization_v1.set_acquire_fence */
+		fd_move(&state->acquire_fence_fd,
+			&surface->pending.acquire_fence_fd);
+		/* zwp_surface_synchronization_v1.get_release */
+		weston_buffer_release_move(&state->buffer_release_ref,
+					   &surface->pending.buffer_release_ref);
+	}
+	state->desired_protection = surface->pending.desired_protection;
+	state->protection_mode = surface->pending.protection_mode;
+	assert(surface->pending.acquire_fence_fd == -1);
+	assert(surface->pending.buffer_release_ref.buffer_release == NULL);
+	state->sx += surface->pending.sx;
+	state->sy += surface->pending.sy;
+
+	state->buffer_viewport.changed |=
+		surface->pending.buffer_viewport.changed;
+	state->buffer_viewport.buffer =
+		surface->pending.buffer_viewport.buffer;
+	state->buffer_viewport.surface =
+		surface->pending.buffer_viewport.surface;
+
+	weston_surface_reset_pending_buffer(surface);
+
+	surface->pending.sx = 0;
+	surface->pending.sy = 0;
+
+	pixman_region32_copy(&state->opaque, &surface->pending.opaque);
+
+	pixman_region32_copy(&state->input, &surface->pending.input);
+
+	wl_list_insert_list(&state->frame_callback_list,
+			    &surface->pending.frame_callback_list);
+	wl_list_init(&surface->pending.frame_callback_list);
+
+	wl_list_insert_list(&state->feedback_list,
+			    &surface->pending.feedback_list);
+	wl_list_init(&surface->pending.feedback_list);
+}
+
+/** A wl_surface.commit held back until its acquire fence has signalled */
+struct weston_latched_commit {
+	struct weston_surface *surface;
+	struct wl_list link;	/* weston_surface::latch_queue */
+
+	struct weston_surface_state state;
+	/* Keeps the buffer from being released to the client meanwhile */
+	struct weston_buffer_reference buffer_ref;
+
+	struct wl_event_source *fence_source;
+	bool fence_signaled;
+};
+
+static void
+weston_latched_commit_destroy(struct weston_latched_commit *commit)
+{
+	if (commit->fence_source)
+		wl_event_source_remove(commit->fence_source);
+
+	weston_buffer_reference(&commit->buffer_ref, NULL,
+				BUFFER_WILL_NOT_BE_ACCESSED);
+	weston_surface_state_fini(&commit->state);
+	wl_list_remove(&commit->link);
+	free(commit);
+}
+
+static bool
+weston_latched_commit_is_ready(struct weston_latched_commit *commit)
+{
+	if (commit->fence_signaled)
+		return true;
+
+	if (commit->state.acquire_fence_fd >= 0 &&
+	    !linux_sync_file_is_signaled(commit->state.acquire_fence_fd))
+		return false;
+
+	commit->fence_signaled = true;
+	if (commit->fence_source) {
+		wl_event_source_remove(commit->fence_source);
+		commit->fence_source = NULL;
+	}
+
+	return true;
+}
+
+/** Apply the newest held back commit of a surface which can be shown
+ *
+ * A commit attaching a buffer can be shown once the buffer's acquire fence
+ * has signalled. A commit without a new buffer can be applied as soon as
+ * the one before it. The newest commit which can be applied is, along with
+ * all the commits before it: buffers attached by those are replaced without
+ * ever being shown, so that the content is as recent as possible.
+ */
+static void
+weston_surface_latch(struct weston_surface *surface)
+{
+	struct weston_latched_commit *commit, *tmp, *last = NULL;
+	bool ready = true;
+
+	wl_list_for_each(commit, &surface->latch_queue, link) {
+		if (commit->state.newly_attached)
+			ready = weston_latched_commit_is_ready(commit);
+		if (ready)
+			last = commit;
+	}
+
+	if (!last)
+		return;
+
+	wl_list_for_each_safe(commit, tmp, &surface->latch_queue, link) {
+		bool done = (commit == last);
+
+		weston_surface_commit_state(surface, &commit->state);
+		weston_latched_commit_destroy(commit);
+		if (done)
+			break;
+	}
+
+	if (wl_list_empty(&surface->latch_queue)) {
+		wl_list_remove(&surface->latch_link);
+		wl_list_init(&surface->latch_link);
+	}
+
+	weston_surface_schedule_repaint(surface);
+}
+
+static int
+latched_commit_fence_handler(int fd, uint32_t mask, void *data)
+{
+	struct weston_latched_commit *commit = data;
+
+	wl_event_source_remove(commit->fence_source);
+	commit->fence_source = NULL;
+	commit->fence_signaled = true;
+
+	weston_surface_latch(commit->surface);
+
+	return 0;
+}
+
+static void
+weston_surface_latch_all(struct weston_surface *surface)
+{
+	struct weston_latched_commit *commit, *tmp;
+
+	wl_list_for_each_safe(commit, tmp, &surface->latch_queue, link) {
+		weston_surface_commit_state(surface, &commit->state);
+		weston_latched_commit_destroy(commit);
+	}
+
+	wl_list_remove(&surface->latch_link);
+	wl_list_init(&surface->latch_link);
+}
+
+static void
+weston_surface_discard_latched_commits(struct weston_surface *surface)
+{
+	struct weston_latched_commit *commit, *tmp;
+
+	wl_list_for_each_safe(commit, tmp, &surface->latch_queue, link)
+		weston_latched_commit_destroy(commit);
+
+	wl_list_remove(&surface->latch_link);
+	wl_list_init(&surface->latch_link);
+}
+
+/** Hold back the pending state of a surface until its buffer is ready
+ *
+ * With late latching, a commit whose acquire fence has not signalled yet
+ * is queued instead of applied, and so is every commit after it, to keep
+ * them in order. Parent surfaces are not held back, as their synchronized
+ * subsurfaces would have to be as well, and neither are surfaces whose
+ * role keeps double-buffered state outside of weston_surface_state.
+ *
+ * \return true if the commit was queued, false if it is to be applied
+ * right away.
+ */
+static bool
+weston_surface_queue_commit(struct weston_surface *surface)
+{
+	struct weston_compositor *compositor = surface->compositor;
+	struct wl_event_loop *loop;
+	struct weston_latched_commit *commit;
+	bool apply_now = surface->role_has_pending_state ||
+			 !wl_list_empty(&surface->subsurface_list) ||
+			 !wl_list_empty(&surface->subsurface_list_pending);
+
+	if (wl_list_empty(&surface->latch_queue)) {
+		if (!compositor->late_latch || apply_now ||
+		    surface->pending.acquire_fence_fd < 0 ||
+		    linux_sync_file_is_signaled(surface->pending.acquire_fence_fd))
+			return false;
+	} else if (apply_now) {
+		weston_surface_latch_all(surface);
+		return false;
+	}
+
+	commit = xzalloc(sizeof *commit);
+	commit->surface = surface;
+	weston_surface_state_init(&commit->state);
+	weston_surface_state_merge_pending(surface, &commit->state,
+					   &commit->buffer_ref);
+
+	if (commit->state.acquire_fence_fd >= 0) {
+		loop = wl_display_get_event_loop(compositor->wl_display);
+		commit->fence_source =
+			wl_event_loop_add_fd(loop, commit->state.acquire_fence_fd,
+					     WL_EVENT_READABLE,
+					     latched_commit_fence_handler,
+					     commit);
+		if (!commit->fence_source)
+			commit->fence_signaled = true;
+	}
+
+	if (wl_list_empty(&surface->latch_queue))
+		wl_list_insert(compositor->latch_surface_list.prev,
+			       &surface->latch_link);
+	wl_list_insert(surface->latch_queue.prev, &commit->link);
+
+	/* A commit queued behind a held back one may already be ready. */
+	weston_surface_latch(surface);
+
+	return true;
+}
+
 static void
 weston_subsurface_commit(struct weston_subsurface *sub);
 
@@ -4168,6 +4868,9 @@ surface_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	if (weston_surface_queue_commit(surface))
+		return;
+
 	wl_list_for_each(sub, &surface->subsurface_list, parent_link) {
 		if (sub->surface != surface)
 			weston_subsurface_parent_commit(sub, 0);
@@ -4362,74 +5065,8 @@ weston_subsurface_commit_from_cache(struct weston_subsurface *sub)
 static void
 weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
 {
-	struct weston_surface *surface = sub->surface;
-
-	/*
-	 * If this commit would cause the surface to move by the
-	 * attach(dx, dy) parameters, the old damage region must be
-	 * translated to correspond to the new surface coordinate system
-	 * origin.
-	 */
-	pixman_region32_translate(&sub->cached.damage_surface,
-				  -surface->pending.sx, -surface->pending.sy);
-	pixman_region32_union(&sub->cached.damage_surface,
-			      &sub->cached.damage_surface,
-			      &surface->pending.damage_surface);
-	pixman_region32_clear(&surface->pending.damage_surface);
-
-	pixman_region32_union(&sub->cached.damage_buffer,
-			      &sub->cached.damage_buffer,
-			      &surface->pending.damage_buffer);
-	pixman_region32_clear(&surface->pending.damage_buffer);
-
-	if (surface->pending.newly_attached) {
-		sub->cached.newly_attached = 1;
-		weston_surface_state_set_buffer(&sub->cached,
-						surface->pending.buffer);
-		weston_buffer_reference(&sub->cached_buffer_ref,
-					surface->pending.buffer,
-					surface->pending.buffer ?
-						BUFFER_MAY_BE_ACCESSED :
-						BUFFER_WILL_NOT_BE_ACCESSED);
-		weston_presentation_feedback_discard_list(
-					&sub->cached.feedback_list);
-		/* zwp_surface_synchronization_v1.set_acquire_fence */
-		fd_move(&sub->cached.acquire_fence_fd,
-			&surface->pending.acquire_fence_fd);
-		/* zwp_surface_synchronization_v1.get_release */
-		weston_buffer_release_move(&sub->cached.buffer_release_ref,
-					   &surface->pending.buffer_release_ref);
-	}
-	sub->cached.desired_protection = surface->pending.desired_protection;
-	sub->cached.protection_mode = surface->pending.protection_mode;
-	assert(surface->pending.acquire_fence_fd == -1);
-	assert(surface->pending.buffer_release_ref.buffer_release == NULL);
-	sub->cached.sx += surface->pending.sx;
-	sub->cached.sy += surface->pending.sy;
-
-	sub->cached.buffer_viewport.changed |=
-		surface->pending.buffer_viewport.changed;
-	sub->cached.buffer_viewport.buffer =
-		surface->pending.buffer_viewport.buffer;
-	sub->cached.buffer_viewport.surface =
-		surface->pending.buffer_viewport.surface;
-
-	weston_surface_reset_pending_buffer(surface);
-
-	surface->pending.sx = 0;
-	surface->pending.sy = 0;
-
-	pixman_region32_copy(&sub->cached.opaque, &surface->pending.opaque);
-
-	pixman_region32_copy(&sub->cached.input, &surface->pending.input);
-
-	wl_list_insert_list(&sub->cached.frame_callback_list,
-			    &surface->pending.frame_callback_list);
-	wl_list_init(&surface->pending.frame_callback_list);
-
-	wl_list_insert_list(&sub->cached.feedback_list,
-			    &surface->pending.feedback_list);
-	wl_list_init(&surface->pending.feedback_list);
+	weston_surface_state_merge_pending(sub->surface, &sub->cached,
+					   &sub->cached_buffer_ref);
 
 	sub->has_cached_data = 1;
 }
@@ -7464,6 +8101,9 @@ weston_output_release(struct weston_output *output)
 	weston_color_profile_unref(output->color_profile);
 	assert(output->color_outcome == NULL);
 
+	output_scene_destroy(output->scene);
+	output->scene = NULL;
+
 	pixman_region32_fini(&output->region);
 	wl_list_remove(&output->link);
 
@@ -7950,7 +8590,7 @@ destroy_presentation_feedback(struct wl_resource *feedback_resource)
 	feedback = wl_resource_get_user_data(feedback_resource);
 
 	wl_list_remove(&feedback->link);
-	free(feedback);
+	weston_pool_free(&feedback_pool, feedback);
 }
 
 static void
@@ -7970,7 +8610,7 @@ presentation_feedback(struct wl_client *client,
 
 	surface = wl_resource_get_user_data(surface_resource);
 
-	feedback = zalloc(sizeof *feedback);
+	feedback = weston_pool_zalloc(&feedback_pool);
 	if (feedback == NULL)
 		goto err_calloc;
 
@@ -7988,7 +8628,7 @@ presentation_feedback(struct wl_client *client,
 	return;
 
 err_create:
-	free(feedback);
+	weston_pool_free(&feedback_pool, feedback);
 
 err_calloc:
 	wl_client_post_no_memory(client);
@@ -8430,6 +9070,30 @@ debug_scene_graph_cb(struct weston_log_subscription *sub, void *data)
 	weston_log_subscription_complete(sub);
 }
 
+/**
+ * Called when the 'object-pools' debug scope is bound by a client. This
+ * one-shot weston-debug scope prints the object pool statistics when bound,
+ * and then terminates the stream.
+ */
+static void
+debug_pools_cb(struct weston_log_subscription *sub, void *data)
+{
+	char *str;
+	size_t len;
+	FILE *fp;
+
+	fp = open_memstream(&str, &len);
+	if (!fp)
+		return;
+
+	weston_pools_print_stats(fp);
+	fclose(fp);
+
+	weston_log_subscription_printf(sub, "%s", str);
+	free(str);
+	weston_log_subscription_complete(sub);
+}
+
 /** Retrieve testsuite data from compositor
  *
  * The testsuite data can be defined by the test suite of projects that uses
@@ -8578,6 +9242,11 @@ weston_compositor_create(struct wl_display *display,
 	ec->repaint_timer =
 		wl_event_loop_add_timer(loop, output_repaint_timer_handler,
 					ec);
+	ec->occluded_frame_timer =
+		wl_event_loop_add_timer(loop, occluded_frame_timer_handler,
+					ec);
+	wl_list_init(&ec->occluded_surface_list);
+	wl_list_init(&ec->latch_surface_list);
 
 	weston_layer_init(&ec->fade_layer, ec);
 	weston_layer_init(&ec->cursor_layer, ec);
@@ -8592,6 +9261,12 @@ weston_compositor_create(struct wl_display *display,
 						debug_scene_graph_cb, NULL,
 						ec);
 
+	ec->debug_pools =
+		weston_compositor_add_log_scope(ec, "object-pools",
+						"Object pool statistics\n",
+						debug_pools_cb, NULL,
+						ec);
+
 	ec->timeline =
 		weston_compositor_add_log_scope(ec, "timeline",
 						"Timeline event points\n",
@@ -8619,6 +9294,7 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 
 	wl_event_source_remove(ec->idle_source);
 	wl_event_source_remove(ec->repaint_timer);
+	wl_event_source_remove(ec->occluded_frame_timer);
 
 	if (ec->touch_calibration)
 		weston_compositor_destroy_touch_calibrator(ec);
@@ -9005,6 +9681,9 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 	weston_log_scope_destroy(compositor->debug_scene);
 	compositor->debug_scene = NULL;
 
+	weston_log_scope_destroy(compositor->debug_pools);
+	compositor->debug_pools = NULL;
+
 	weston_log_scope_destroy(compositor->timeline);
 	compositor->timeline = NULL;
 
@@ -9016,7 +9695,10 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 		weston_dmabuf_feedback_format_table_destroy(compositor->dmabuf_feedback_format_table);
 	}
 
+	free(compositor->shader_cache_dir);
 	free(compositor);
+
+	weston_pools_trim();
 }
 
 /** Instruct the compositor to exit.
@@ -149,6 +149,7 @@ weston_desktop_surface_destroy(struct weston_desktop_surface *surface)
 
 	surface->surface->committed = NULL;
 	surface->surface->committed_private = NULL;
+	surface->surface->role_has_pending_state = false;
 
 	weston_desktop_surface_unset_relative_to(surface);
 	wl_list_remove(&surface->client_link);
@@ -273,6 +274,7 @@ weston_desktop_surface_create(struct weston_desktop *desktop,
 
 	wsurface->committed = weston_desktop_surface_committed;
 	wsurface->committed_private = surface;
+	wsurface->role_has_pending_state = true;
 
 	surface->pid = -1;
 
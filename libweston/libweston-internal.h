@@ -556,16 +556,83 @@ struct weston_paint_node {
 	uint32_t try_view_on_plane_failure_reasons;
 
 	bool need_through_hole;
+
+	/* Completely hidden by opaque views above it on this output,
+	 * updated at the start of every weston_output_repaint() */
+	bool occluded;
 };
 
 struct weston_paint_node *
 weston_view_find_paint_node(struct weston_view *view,
 			    struct weston_output *output);
 
+/* Per-node flags of struct weston_output_scene */
+enum weston_scene_flag {
+	WESTON_SCENE_VIEW_ON_OUTPUT	= 1 << 0, /* view->output_mask */
+	WESTON_SCENE_SURFACE_ON_OUTPUT	= 1 << 1, /* surface->output_mask */
+	WESTON_SCENE_SURFACE_PRIMARY	= 1 << 2, /* surface->output is ours */
+	WESTON_SCENE_XFORM_VALID	= 1 << 3, /* pnode->surf_xform_valid */
+	WESTON_SCENE_OPAQUE_BBOX	= 1 << 4, /* opaque over the whole bbox */
+	WESTON_SCENE_OCCLUDED		= 1 << 5, /* pnode->occluded */
+};
+
+/** The hot per-node data of an output in z-order, as parallel arrays
+ *
+ * Rebuilt from weston_output::paint_node_z_order_list at the start of
+ * every weston_output_repaint(), so that the core passes over the scene
+ * are linear scans over small arrays instead of list walks through paint
+ * nodes, views and surfaces. Index i of every array is the same node.
+ */
+struct weston_output_scene {
+	unsigned int count;
+	unsigned int alloc;
+
+	struct weston_paint_node **pnode;
+	struct weston_plane **plane;	/* refreshed after assign_planes */
+	pixman_box32_t *bbox;		/* view bounding box extents */
+	uint8_t *flags;			/* enum weston_scene_flag */
+	uint8_t *protection;		/* surface desired_protection */
+};
+
 /* others */
 int
 wl_data_device_manager_init(struct wl_display *display);
 
+/* object pools, see object-pool.c */
+
+struct weston_pool_stats {
+	uint64_t hits;		/**< allocations served from the free list */
+	uint64_t misses;	/**< allocations that went to malloc */
+	unsigned int live;	/**< objects currently allocated */
+	unsigned int peak;	/**< highest live count seen */
+};
+
+struct weston_pool {
+	const char *name;
+	size_t size;
+	unsigned int max_free;
+	void *free_list;
+	unsigned int free_count;
+	struct weston_pool_stats stats;
+	bool registered;
+	struct wl_list link;	/**< in the list of pools, once used */
+};
+
+#define WESTON_POOL_INIT(type, max) \
+	{ .name = #type, .size = sizeof(type), .max_free = (max) }
+
+void *
+weston_pool_zalloc(struct weston_pool *pool);
+
+void
+weston_pool_free(struct weston_pool *pool, void *ptr);
+
+void
+weston_pools_trim(void);
+
+void
+weston_pools_print_stats(FILE *fp);
+
 /* Exclusively for unit tests */
 
 bool
@@ -578,6 +645,13 @@ weston_surface_build_buffer_matrix(const struct weston_surface *surface,
 void
 weston_output_update_matrix(struct weston_output *output);
 
+struct weston_output_scene *
+weston_output_update_scene(struct weston_output *output);
+
+void
+weston_output_accumulate_damage(struct weston_output *output,
+				struct weston_output_scene *scene);
+
 void
 convert_size_by_transform_scale(int32_t *width_out, int32_t *height_out,
 				int32_t width, int32_t height,
@@ -57,6 +57,26 @@ linux_sync_file_is_valid(int fd)
 	return file_info.num_fences > 0;
 }
 
+/* Check whether a sync file has signalled, without blocking
+ *
+ * \param fd[in] a file descriptor for a sync file
+ * \return true if the fences have signalled or the state can't be read,
+ * false if they are still pending
+ */
+bool
+linux_sync_file_is_signaled(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	do {
+		ret = poll(&pfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	/* On error, don't hold anything back waiting for it */
+	return ret != 0;
+}
+
 /* Read the timestamp stored in a sync file
  *
  * \param fd[in] fd a file descriptor for a sync file
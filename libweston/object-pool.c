@@ -0,0 +1,152 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+
+/*
+ * Object pools
+ *
+ * Objects that are created and destroyed at frame rate, such as paint nodes
+ * and presentation feedback, are recycled through a free list instead of
+ * going back to malloc. Each pool keeps at most max_free objects around.
+ *
+ * The pools are process-wide rather than per compositor, because objects
+ * tied to client resources can be freed after the compositor, while
+ * wl_display_destroy() destroys the clients. Like the rest of libweston,
+ * they must only be used from the main thread.
+ */
+
+struct pool_free_obj {
+	struct pool_free_obj *next;
+};
+
+static struct wl_list pool_list = { &pool_list, &pool_list };
+
+/** Allocate a zeroed object from a pool
+ *
+ * \param pool The pool, defined with WESTON_POOL_INIT().
+ * \return A zeroed object of the pool's size, or NULL on failure.
+ */
+void *
+weston_pool_zalloc(struct weston_pool *pool)
+{
+	struct pool_free_obj *obj;
+
+	if (!pool->registered) {
+		wl_list_insert(pool_list.prev, &pool->link);
+		pool->registered = true;
+	}
+
+	obj = pool->free_list;
+	if (obj) {
+		pool->free_list = obj->next;
+		pool->free_count--;
+		pool->stats.hits++;
+		memset(obj, 0, pool->size);
+	} else {
+		obj = zalloc(pool->size);
+		if (!obj)
+			return NULL;
+		pool->stats.misses++;
+	}
+
+	pool->stats.live++;
+	if (pool->stats.live > pool->stats.peak)
+		pool->stats.peak = pool->stats.live;
+
+	return obj;
+}
+
+/** Return an object to its pool
+ *
+ * \param pool The pool the object was allocated from.
+ * \param ptr The object, may be NULL.
+ */
+void
+weston_pool_free(struct weston_pool *pool, void *ptr)
+{
+	struct pool_free_obj *obj = ptr;
+
+	if (!obj)
+		return;
+
+	assert(pool->stats.live > 0);
+	pool->stats.live--;
+
+	if (pool->free_count >= pool->max_free) {
+		free(obj);
+		return;
+	}
+
+	obj->next = pool->free_list;
+	pool->free_list = obj;
+	pool->free_count++;
+}
+
+/** Give all the free objects of all pools back to malloc */
+void
+weston_pools_trim(void)
+{
+	struct weston_pool *pool;
+	struct pool_free_obj *obj;
+
+	wl_list_for_each(pool, &pool_list, link) {
+		while ((obj = pool->free_list)) {
+			pool->free_list = obj->next;
+			free(obj);
+		}
+		pool->free_count = 0;
+	}
+}
+
+/** Print the statistics of all pools that have been used */
+void
+weston_pools_print_stats(FILE *fp)
+{
+	struct weston_pool *pool;
+	uint64_t total;
+
+	fprintf(fp, "%-24s %6s %8s %8s %6s %6s %6s %6s\n",
+		"pool", "size", "allocs", "reused", "hit%", "live",
+		"peak", "free");
+
+	wl_list_for_each(pool, &pool_list, link) {
+		total = pool->stats.hits + pool->stats.misses;
+		fprintf(fp, "%-24s %6zu %8" PRIu64 " %8" PRIu64 " %5.1f%% "
+			"%6u %6u %6u\n",
+			pool->name, pool->size, total, pool->stats.hits,
+			total ? 100.0 * pool->stats.hits / total : 0.0,
+			pool->stats.live, pool->stats.peak, pool->free_count);
+	}
+}
@@ -0,0 +1,692 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+#include "color.h"
+#include "pixman-renderer-internal.h"
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SIMD_F32X4 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_SIMD_F32X4 1
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH 1
+#endif
+
+/*
+ * Pixels are converted in spans, stored as planar floats so that the
+ * per-channel arithmetic is done on 4 (SSE2, NEON) or 8 (AVX2) pixels at
+ * a time. The LUT lookups are gathers, they stay scalar.
+ */
+#define SPAN_LEN 256
+
+struct color_span {
+	float r[SPAN_LEN] __attribute__((aligned(32)));
+	float g[SPAN_LEN] __attribute__((aligned(32)));
+	float b[SPAN_LEN] __attribute__((aligned(32)));
+	float a[SPAN_LEN] __attribute__((aligned(32)));
+};
+
+struct pixman_color_curve {
+	enum weston_color_curve_type type;
+	unsigned len;
+	float *lut; /* R, then G, then B channel, len elements each */
+};
+
+struct pixman_color_mapping {
+	enum weston_color_mapping_type type;
+	union {
+		struct {
+			unsigned len;
+			float *lut; /* 3 * len^3 elements */
+		} lut3d;
+		struct weston_color_mapping_matrix mat;
+	};
+};
+
+struct pixman_color_transform {
+	struct weston_color_transform *owner;
+	struct wl_listener destroy_listener;
+	struct pixman_color_curve pre_curve;
+	struct pixman_color_mapping mapping;
+	struct pixman_color_curve post_curve;
+};
+
+#if defined(HAVE_SIMD_F32X4) && defined(__SSE2__)
+typedef __m128 f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return _mm_load_ps(p); }
+static inline void f32x4_store(float *p, f32x4 v) { _mm_store_ps(p, v); }
+static inline f32x4 f32x4_splat(float x) { return _mm_set1_ps(x); }
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return _mm_add_ps(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return _mm_mul_ps(a, b); }
+
+/* 1 / a, or 0 where a is not positive */
+static inline f32x4
+f32x4_recip_or_zero(f32x4 a)
+{
+	__m128 positive = _mm_cmpgt_ps(a, _mm_setzero_ps());
+
+	return _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), a), positive);
+}
+#elif defined(HAVE_SIMD_F32X4)
+typedef float32x4_t f32x4;
+
+static inline f32x4 f32x4_load(const float *p) { return vld1q_f32(p); }
+static inline void f32x4_store(float *p, f32x4 v) { vst1q_f32(p, v); }
+static inline f32x4 f32x4_splat(float x) { return vdupq_n_f32(x); }
+static inline f32x4 f32x4_add(f32x4 a, f32x4 b) { return vaddq_f32(a, b); }
+static inline f32x4 f32x4_mul(f32x4 a, f32x4 b) { return vmulq_f32(a, b); }
+
+/* 1 / a, or 0 where a is not positive */
+static inline f32x4
+f32x4_recip_or_zero(f32x4 a)
+{
+	uint32x4_t positive = vcgtq_f32(a, vdupq_n_f32(0.0f));
+	f32x4 recip = vdivq_f32(vdupq_n_f32(1.0f), a);
+
+	return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(recip),
+					       positive));
+}
+#endif
+
+static void
+pixman_color_transform_destroy(struct pixman_color_transform *pxform)
+{
+	free(pxform->pre_curve.lut);
+	free(pxform->post_curve.lut);
+	if (pxform->mapping.type == WESTON_COLOR_MAPPING_TYPE_3D_LUT)
+		free(pxform->mapping.lut3d.lut);
+	wl_list_remove(&pxform->destroy_listener.link);
+	free(pxform);
+}
+
+static void
+color_transform_destroy_handler(struct wl_listener *l, void *data)
+{
+	struct pixman_color_transform *pxform;
+
+	pxform = wl_container_of(l, pxform, destroy_listener);
+	assert(pxform->owner == data);
+
+	pixman_color_transform_destroy(pxform);
+}
+
+static bool
+pixman_color_curve_init(struct pixman_color_curve *pcurve,
+			const struct weston_color_curve *curve,
+			struct weston_color_transform *xform)
+{
+	pcurve->type = curve->type;
+
+	switch (curve->type) {
+	case WESTON_COLOR_CURVE_TYPE_IDENTITY:
+		return true;
+	case WESTON_COLOR_CURVE_TYPE_LUT_3x1D:
+		pcurve->len = curve->u.lut_3x1d.optimal_len;
+		if (pcurve->len < 2)
+			return false;
+
+		pcurve->lut = calloc(3 * pcurve->len, sizeof *pcurve->lut);
+		if (!pcurve->lut)
+			return false;
+
+		curve->u.lut_3x1d.fill_in(xform, pcurve->lut, pcurve->len);
+		return true;
+	}
+
+	return false;
+}
+
+static bool
+pixman_color_mapping_init(struct pixman_color_mapping *pmapping,
+			  struct weston_color_transform *xform)
+{
+	const struct weston_color_mapping *mapping = &xform->mapping;
+	unsigned len;
+
+	pmapping->type = mapping->type;
+
+	switch (mapping->type) {
+	case WESTON_COLOR_MAPPING_TYPE_IDENTITY:
+		return true;
+	case WESTON_COLOR_MAPPING_TYPE_3D_LUT:
+		len = mapping->u.lut3d.optimal_len;
+		if (len < 2)
+			return false;
+
+		pmapping->lut3d.len = len;
+		pmapping->lut3d.lut = calloc(3 * len * len * len,
+					     sizeof *pmapping->lut3d.lut);
+		if (!pmapping->lut3d.lut)
+			return false;
+
+		mapping->u.lut3d.fill_in(xform, pmapping->lut3d.lut, len);
+		return true;
+	case WESTON_COLOR_MAPPING_TYPE_MATRIX:
+		pmapping->mat = mapping->u.mat;
+		return true;
+	}
+
+	return false;
+}
+
+/** Get the pixman renderer state of a color transformation
+ *
+ * \param xform The color transformation.
+ * \return The LUTs and parameters realizing \c xform, or NULL on failure.
+ *
+ * The state is created on first use and cached until \c xform is destroyed.
+ */
+struct pixman_color_transform *
+pixman_color_transform_get(struct weston_color_transform *xform)
+{
+	struct pixman_color_transform *pxform;
+	struct wl_listener *l;
+
+	l = wl_signal_get(&xform->destroy_signal,
+			  color_transform_destroy_handler);
+	if (l)
+		return container_of(l, struct pixman_color_transform,
+				    destroy_listener);
+
+	pxform = zalloc(sizeof *pxform);
+	if (!pxform)
+		return NULL;
+
+	pxform->owner = xform;
+	pxform->destroy_listener.notify = color_transform_destroy_handler;
+	wl_signal_add(&xform->destroy_signal, &pxform->destroy_listener);
+
+	if (!pixman_color_curve_init(&pxform->pre_curve,
+				     &xform->pre_curve, xform) ||
+	    !pixman_color_mapping_init(&pxform->mapping, xform) ||
+	    !pixman_color_curve_init(&pxform->post_curve,
+				     &xform->post_curve, xform)) {
+		pixman_color_transform_destroy(pxform);
+		return NULL;
+	}
+
+	return pxform;
+}
+
+/*
+ * Map x in [0.0, 1.0] to the LUT element to interpolate from and the
+ * interpolation factor. The first element corresponds to 0.0 and the last
+ * one to 1.0, like GL_LINEAR sampling between the first and last texel
+ * centers does in fragment.glsl.
+ */
+static inline unsigned
+lut_index(float x, unsigned len, float *frac)
+{
+	float pos = fminf(fmaxf(x, 0.0f), 1.0f) * (len - 1);
+	unsigned i = MIN((unsigned)pos, len - 2);
+
+	*frac = pos - i;
+
+	return i;
+}
+
+static inline float
+lut_1d_sample(const float *lut, unsigned len, float x)
+{
+	float f;
+	unsigned i = lut_index(x, len, &f);
+
+	return lut[i] + (lut[i + 1] - lut[i]) * f;
+}
+
+static void
+color_curve_apply(const struct pixman_color_curve *curve,
+		  struct color_span *span, int n)
+{
+	const unsigned len = curve->len;
+	const float *lut_r = curve->lut;
+	const float *lut_g = lut_r + len;
+	const float *lut_b = lut_g + len;
+	int i;
+
+	if (curve->type == WESTON_COLOR_CURVE_TYPE_IDENTITY)
+		return;
+
+	for (i = 0; i < n; i++) {
+		span->r[i] = lut_1d_sample(lut_r, len, span->r[i]);
+		span->g[i] = lut_1d_sample(lut_g, len, span->g[i]);
+		span->b[i] = lut_1d_sample(lut_b, len, span->b[i]);
+	}
+}
+
+/*
+ * Trilinear interpolation between the 8 corners of the LUT cell, which is
+ * what GL texture3D() does with linear filtering in fragment.glsl, so that
+ * both renderers give the same results.
+ */
+static inline void
+lut_3d_sample(const float *lut, unsigned len,
+	      float r, float g, float b, float out[3])
+{
+	const unsigned dr = 3;
+	const unsigned dg = 3 * len;
+	const unsigned db = 3 * len * len;
+	const float *p;
+	float fr, fg, fb;
+	float c00, c01, c10, c11, c0, c1;
+	unsigned ri, gi, bi;
+	int c;
+
+	ri = lut_index(r, len, &fr);
+	gi = lut_index(g, len, &fg);
+	bi = lut_index(b, len, &fb);
+	p = lut + bi * db + gi * dg + ri * dr;
+
+	for (c = 0; c < 3; c++) {
+		c00 = p[c] + (p[dr + c] - p[c]) * fr;
+		c10 = p[dg + c] + (p[dg + dr + c] - p[dg + c]) * fr;
+		c01 = p[db + c] + (p[db + dr + c] - p[db + c]) * fr;
+		c11 = p[db + dg + c] +
+		      (p[db + dg + dr + c] - p[db + dg + c]) * fr;
+
+		c0 = c00 + (c10 - c00) * fg;
+		c1 = c01 + (c11 - c01) * fg;
+
+		out[c] = c0 + (c1 - c0) * fb;
+	}
+}
+
+#ifdef HAVE_AVX2_DISPATCH
+/* Returns the number of pixels done, a multiple of 8 */
+__attribute__((target("avx2,fma")))
+static int
+matrix_apply_avx2(const float *m, struct color_span *span, int n)
+{
+	__m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]);
+	__m256 m2 = _mm256_set1_ps(m[2]), m3 = _mm256_set1_ps(m[3]);
+	__m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]);
+	__m256 m6 = _mm256_set1_ps(m[6]), m7 = _mm256_set1_ps(m[7]);
+	__m256 m8 = _mm256_set1_ps(m[8]);
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256 r = _mm256_load_ps(&span->r[i]);
+		__m256 g = _mm256_load_ps(&span->g[i]);
+		__m256 b = _mm256_load_ps(&span->b[i]);
+
+		_mm256_store_ps(&span->r[i],
+				_mm256_fmadd_ps(m6, b,
+				_mm256_fmadd_ps(m3, g, _mm256_mul_ps(m0, r))));
+		_mm256_store_ps(&span->g[i],
+				_mm256_fmadd_ps(m7, b,
+				_mm256_fmadd_ps(m4, g, _mm256_mul_ps(m1, r))));
+		_mm256_store_ps(&span->b[i],
+				_mm256_fmadd_ps(m8, b,
+				_mm256_fmadd_ps(m5, g, _mm256_mul_ps(m2, r))));
+	}
+
+	return i;
+}
+
+static bool
+cpu_has_avx2(void)
+{
+	static int has_avx2 = -1;
+
+	if (has_avx2 < 0)
+		has_avx2 = __builtin_cpu_supports("avx2") &&
+			   __builtin_cpu_supports("fma");
+
+	return has_avx2;
+}
+#endif
+
+/* Multiply by a 3x3 matrix, column-major as uploaded to the GL shader */
+static void
+matrix_apply(const float *m, struct color_span *span, int n)
+{
+	int i = 0;
+
+#ifdef HAVE_AVX2_DISPATCH
+	if (cpu_has_avx2())
+		i = matrix_apply_avx2(m, span, n);
+#endif
+
+#ifdef HAVE_SIMD_F32X4
+	for (; i + 4 <= n; i += 4) {
+		f32x4 r = f32x4_load(&span->r[i]);
+		f32x4 g = f32x4_load(&span->g[i]);
+		f32x4 b = f32x4_load(&span->b[i]);
+
+		f32x4_store(&span->r[i],
+			    f32x4_add(f32x4_add(f32x4_mul(f32x4_splat(m[0]), r),
+						f32x4_mul(f32x4_splat(m[3]), g)),
+				      f32x4_mul(f32x4_splat(m[6]), b)));
+		f32x4_store(&span->g[i],
+			    f32x4_add(f32x4_add(f32x4_mul(f32x4_splat(m[1]), r),
+						f32x4_mul(f32x4_splat(m[4]), g)),
+				      f32x4_mul(f32x4_splat(m[7]), b)));
+		f32x4_store(&span->b[i],
+			    f32x4_add(f32x4_add(f32x4_mul(f32x4_splat(m[2]), r),
+						f32x4_mul(f32x4_splat(m[5]), g)),
+				      f32x4_mul(f32x4_splat(m[8]), b)));
+	}
+#endif
+
+	for (; i < n; i++) {
+		float r = span->r[i];
+		float g = span->g[i];
+		float b = span->b[i];
+
+		span->r[i] = m[0] * r + m[3] * g + m[6] * b;
+		span->g[i] = m[1] * r + m[4] * g + m[7] * b;
+		span->b[i] = m[2] * r + m[5] * g + m[8] * b;
+	}
+}
+
+static void
+color_mapping_apply(const struct pixman_color_mapping *mapping,
+		    struct color_span *span, int n)
+{
+	float out[3];
+	int i;
+
+	switch (mapping->type) {
+	case WESTON_COLOR_MAPPING_TYPE_IDENTITY:
+		break;
+	case WESTON_COLOR_MAPPING_TYPE_3D_LUT:
+		for (i = 0; i < n; i++) {
+			lut_3d_sample(mapping->lut3d.lut, mapping->lut3d.len,
+				      span->r[i], span->g[i], span->b[i], out);
+			span->r[i] = out[0];
+			span->g[i] = out[1];
+			span->b[i] = out[2];
+		}
+		break;
+	case WESTON_COLOR_MAPPING_TYPE_MATRIX:
+		matrix_apply(mapping->mat.matrix, span, n);
+		break;
+	}
+}
+
+static void
+span_unpremultiply(struct color_span *span, int n)
+{
+	int i = 0;
+
+#ifdef HAVE_SIMD_F32X4
+	for (; i + 4 <= n; i += 4) {
+		f32x4 inv = f32x4_recip_or_zero(f32x4_load(&span->a[i]));
+
+		f32x4_store(&span->r[i], f32x4_mul(f32x4_load(&span->r[i]), inv));
+		f32x4_store(&span->g[i], f32x4_mul(f32x4_load(&span->g[i]), inv));
+		f32x4_store(&span->b[i], f32x4_mul(f32x4_load(&span->b[i]), inv));
+	}
+#endif
+
+	for (; i < n; i++) {
+		float inv = span->a[i] > 0.0f ? 1.0f / span->a[i] : 0.0f;
+
+		span->r[i] *= inv;
+		span->g[i] *= inv;
+		span->b[i] *= inv;
+	}
+}
+
+static void
+span_premultiply(struct color_span *span, int n)
+{
+	int i = 0;
+
+#ifdef HAVE_SIMD_F32X4
+	for (; i + 4 <= n; i += 4) {
+		f32x4 a = f32x4_load(&span->a[i]);
+
+		f32x4_store(&span->r[i], f32x4_mul(f32x4_load(&span->r[i]), a));
+		f32x4_store(&span->g[i], f32x4_mul(f32x4_load(&span->g[i]), a));
+		f32x4_store(&span->b[i], f32x4_mul(f32x4_load(&span->b[i]), a));
+	}
+#endif
+
+	for (; i < n; i++) {
+		span->r[i] *= span->a[i];
+		span->g[i] *= span->a[i];
+		span->b[i] *= span->a[i];
+	}
+}
+
+static inline uint32_t
+to_unorm(float x, float max)
+{
+	return fminf(fmaxf(x, 0.0f), 1.0f) * max + 0.5f;
+}
+
+/* Formats read and written in place, everything else goes through pixman */
+static bool
+format_is_direct(pixman_format_code_t format)
+{
+	return format == PIXMAN_a8r8g8b8 ||
+	       format == PIXMAN_x8r8g8b8 ||
+	       format == PIXMAN_x2r10g10b10 ||
+	       format == PIXMAN_XFORM_FORMAT ||
+	       format == PIXMAN_XFORM_FORMAT_OPAQUE;
+}
+
+#if PIXMAN_VERSION >= PIXMAN_VERSION_ENCODE(0, 36, 0)
+/* Floats in R, G, B(, A) order, premultiplied like every pixman format */
+static void
+span_decode_float(struct color_span *span, const float *pixels, int n,
+		  pixman_format_code_t format)
+{
+	int channels = format == PIXMAN_rgba_float ? 4 : 3;
+	int i;
+
+	for (i = 0; i < n; i++, pixels += channels) {
+		span->r[i] = pixels[0];
+		span->g[i] = pixels[1];
+		span->b[i] = pixels[2];
+		span->a[i] = channels == 4 ? pixels[3] : 1.0f;
+	}
+}
+
+static void
+span_encode_float(const struct color_span *span, float *pixels, int n,
+		  pixman_format_code_t format)
+{
+	int channels = format == PIXMAN_rgba_float ? 4 : 3;
+	int i;
+
+	for (i = 0; i < n; i++, pixels += channels) {
+		pixels[0] = span->r[i];
+		pixels[1] = span->g[i];
+		pixels[2] = span->b[i];
+		if (channels == 4)
+			pixels[3] = span->a[i];
+	}
+}
+#endif
+
+static void
+span_decode(struct color_span *span, const void *data, int n,
+	    pixman_format_code_t format)
+{
+	const uint32_t *pixels = data;
+	int i;
+
+#if PIXMAN_VERSION >= PIXMAN_VERSION_ENCODE(0, 36, 0)
+	if (format == PIXMAN_rgba_float || format == PIXMAN_rgb_float) {
+		span_decode_float(span, data, n, format);
+		return;
+	}
+#endif
+
+	if (format == PIXMAN_x2r10g10b10) {
+		for (i = 0; i < n; i++) {
+			span->r[i] = ((pixels[i] >> 20) & 0x3ff) / 1023.0f;
+			span->g[i] = ((pixels[i] >> 10) & 0x3ff) / 1023.0f;
+			span->b[i] = (pixels[i] & 0x3ff) / 1023.0f;
+			span->a[i] = 1.0f;
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		span->r[i] = ((pixels[i] >> 16) & 0xff) / 255.0f;
+		span->g[i] = ((pixels[i] >> 8) & 0xff) / 255.0f;
+		span->b[i] = (pixels[i] & 0xff) / 255.0f;
+		span->a[i] = format == PIXMAN_x8r8g8b8 ?
+			     1.0f : (pixels[i] >> 24) / 255.0f;
+	}
+}
+
+static void
+span_encode(const struct color_span *span, void *data, int n,
+	    pixman_format_code_t format)
+{
+	uint32_t *pixels = data;
+	int i;
+
+#if PIXMAN_VERSION >= PIXMAN_VERSION_ENCODE(0, 36, 0)
+	if (format == PIXMAN_rgba_float || format == PIXMAN_rgb_float) {
+		span_encode_float(span, data, n, format);
+		return;
+	}
+#endif
+
+	if (format == PIXMAN_x2r10g10b10) {
+		for (i = 0; i < n; i++) {
+			pixels[i] = 0xc0000000 |
+				    to_unorm(span->r[i], 1023.0f) << 20 |
+				    to_unorm(span->g[i], 1023.0f) << 10 |
+				    to_unorm(span->b[i], 1023.0f);
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		pixels[i] = to_unorm(span->a[i], 255.0f) << 24 |
+			    to_unorm(span->r[i], 255.0f) << 16 |
+			    to_unorm(span->g[i], 255.0f) << 8 |
+			    to_unorm(span->b[i], 255.0f);
+	}
+}
+
+static void *
+image_pixel(pixman_image_t *image, int x, int y)
+{
+	uint8_t *data = (uint8_t *)pixman_image_get_data(image);
+	int bpp = PIXMAN_FORMAT_BPP(pixman_image_get_format(image));
+
+	return data + y * pixman_image_get_stride(image) + x * bpp / 8;
+}
+
+static void
+convert_span(const struct pixman_color_transform *pxform,
+	     pixman_image_t *src, pixman_image_t *dst,
+	     pixman_image_t *scratch, int x, int y, int n)
+{
+	pixman_format_code_t src_format = pixman_image_get_format(src);
+	pixman_format_code_t dst_format = pixman_image_get_format(dst);
+	uint32_t *scratch_pixels = pixman_image_get_data(scratch);
+	struct color_span span;
+
+	if (pixman_image_get_data(src) && format_is_direct(src_format)) {
+		span_decode(&span, image_pixel(src, x, y), n, src_format);
+	} else {
+		pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, scratch,
+					 x, y, 0, 0, 0, 0, n, 1);
+		span_decode(&span, scratch_pixels, n, PIXMAN_a8r8g8b8);
+	}
+
+	/* The curves and the mapping operate on straight alpha */
+	span_unpremultiply(&span, n);
+	color_curve_apply(&pxform->pre_curve, &span, n);
+	color_mapping_apply(&pxform->mapping, &span, n);
+	color_curve_apply(&pxform->post_curve, &span, n);
+	span_premultiply(&span, n);
+
+	if (format_is_direct(dst_format)) {
+		span_encode(&span, image_pixel(dst, x, y), n, dst_format);
+	} else {
+		span_encode(&span, scratch_pixels, n, PIXMAN_a8r8g8b8);
+		pixman_image_composite32(PIXMAN_OP_SRC, scratch, NULL, dst,
+					 0, 0, 0, 0, x, y, n, 1);
+	}
+}
+
+/** Apply a color transformation to a region of an image
+ *
+ * \param pxform The color transformation, from pixman_color_transform_get().
+ * \param src The image to read, any format pixman can use as a source.
+ * \param dst The image to write, of the same size as \c src.
+ * \param region The pixels to convert, in image coordinates.
+ *
+ * Only the pixels in \c region are read and written. The source image must
+ * not have a transformation set.
+ */
+void
+pixman_color_transform_convert(const struct pixman_color_transform *pxform,
+			       pixman_image_t *src, pixman_image_t *dst,
+			       pixman_region32_t *region)
+{
+	pixman_region32_t clipped;
+	pixman_image_t *scratch;
+	pixman_box32_t *boxes;
+	int n_boxes, i, x, y;
+
+	pixman_region32_init_rect(&clipped, 0, 0,
+				  pixman_image_get_width(dst),
+				  pixman_image_get_height(dst));
+	pixman_region32_intersect(&clipped, &clipped, region);
+
+	scratch = pixman_image_create_bits_no_clear(PIXMAN_a8r8g8b8,
+						    SPAN_LEN, 1, NULL, 0);
+	abort_oom_if_null(scratch);
+
+	boxes = pixman_region32_rectangles(&clipped, &n_boxes);
+	for (i = 0; i < n_boxes; i++) {
+		for (y = boxes[i].y1; y < boxes[i].y2; y++) {
+			for (x = boxes[i].x1; x < boxes[i].x2; x += SPAN_LEN) {
+				convert_span(pxform, src, dst, scratch, x, y,
+					     MIN(boxes[i].x2 - x, SPAN_LEN));
+			}
+		}
+	}
+
+	pixman_image_unref(scratch);
+	pixman_region32_fini(&clipped);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PIXMAN_RENDERER_INTERNAL_H
+#define PIXMAN_RENDERER_INTERNAL_H
+
+#include "pixman.h"
+
+struct weston_color_transform;
+struct pixman_color_transform;
+
+/*
+ * Formats for images holding color transformed pixels: surface images
+ * converted to the blending space and the blending buffer of outputs that
+ * are converted from it. Blending spaces are linear, 8 or 10 bits per
+ * channel lose too much of the darks there.
+ */
+#if PIXMAN_VERSION >= PIXMAN_VERSION_ENCODE(0, 36, 0)
+#define PIXMAN_XFORM_FORMAT PIXMAN_rgba_float
+#define PIXMAN_XFORM_FORMAT_OPAQUE PIXMAN_rgb_float
+#else
+#define PIXMAN_XFORM_FORMAT PIXMAN_a8r8g8b8
+#define PIXMAN_XFORM_FORMAT_OPAQUE PIXMAN_x2r10g10b10
+#endif
+
+struct pixman_color_transform *
+pixman_color_transform_get(struct weston_color_transform *xform);
+
+void
+pixman_color_transform_convert(const struct pixman_color_transform *pxform,
+			       pixman_image_t *src, pixman_image_t *dst,
+			       pixman_region32_t *region);
+
+#endif /* PIXMAN_RENDERER_INTERNAL_H */
@@ -33,6 +33,7 @@
 #include <assert.h>
 
 #include "pixman-renderer.h"
+#include "pixman-renderer-internal.h"
 #include "color.h"
 #include "pixel-formats.h"
 #include "output-capture.h"
@@ -52,6 +53,19 @@ struct pixman_output_state {
 	struct wl_list renderbuffer_list;
 };
 
+/* Color transformed images kept per surface, so that outputs with different
+ * color profiles do not keep reconverting the whole surface */
+#define PIXMAN_XFORM_IMAGES_MAX 4
+
+/* A surface image converted by a color transformation */
+struct pixman_xform_image {
+	struct wl_list link; /* pixman_surface_state::xform_images */
+	struct weston_color_transform *xform;
+	pixman_image_t *image;
+	/* the part of the image that is out of date, in buffer coordinates */
+	pixman_region32_t damage;
+};
+
 struct pixman_surface_state {
 	struct weston_surface *surface;
 
@@ -59,6 +73,9 @@ struct pixman_surface_state {
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_release_reference buffer_release_ref;
 
+	/* pixman_xform_image::link, most recently used first */
+	struct wl_list xform_images;
+
 	struct wl_listener buffer_destroy_listener;
 	struct wl_listener surface_destroy_listener;
 	struct wl_listener renderer_destroy_listener;
@@ -307,6 +324,24 @@ composite_clipped(struct weston_output *output,
 	}
 }
 
+static pixman_image_t *
+paint_node_source_image(struct weston_paint_node *pnode)
+{
+	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+
+	struct pixman_xform_image *xi;
+
+	if (!pnode->surf_xform.transform)
+		return ps->image;
+
+	wl_list_for_each(xi, &ps->xform_images, link) {
+		if (xi->xform == pnode->surf_xform.transform)
+			return xi->image;
+	}
+
+	return NULL;
+}
+
 /** Paint an intersected region
  *
  * \param pnode The paint node to be painted.
@@ -327,6 +362,7 @@ repaint_region(struct weston_paint_node *pnode,
 		(struct pixman_renderer *) output->compositor->renderer;
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	struct pixman_output_state *po = get_output_state(output);
+	pixman_image_t *source_image = paint_node_source_image(pnode);
 	pixman_image_t *target_image;
 	pixman_transform_t transform;
 	pixman_filter_t filter;
@@ -360,10 +396,10 @@ repaint_region(struct weston_paint_node *pnode,
 	}
 
 	if (source_clip)
-		composite_clipped(output, ps->image, mask_image, target_image,
+		composite_clipped(output, source_image, mask_image, target_image,
 				  &transform, filter, source_clip);
 	else
-		composite_whole(pixman_op, ps->image, mask_image,
+		composite_whole(pixman_op, source_image, mask_image,
 				target_image, &transform, filter);
 
 	if (mask_image)
@@ -477,6 +513,125 @@ draw_node_source_clipped(struct weston_paint_node *pnode,
 	pixman_region32_fini(&surf_region);
 }
 
+static void
+xform_image_destroy(struct pixman_xform_image *xi)
+{
+	wl_list_remove(&xi->link);
+	pixman_image_unref(xi->image);
+	weston_color_transform_unref(xi->xform);
+	pixman_region32_fini(&xi->damage);
+	free(xi);
+}
+
+static void
+surface_state_drop_xform_images(struct pixman_surface_state *ps)
+{
+	struct pixman_xform_image *xi, *tmp;
+
+	wl_list_for_each_safe(xi, tmp, &ps->xform_images, link)
+		xform_image_destroy(xi);
+}
+
+/*
+ * Bring the copy of the surface image converted by a color transformation
+ * up to date. Only the damaged part of the buffer is converted, unless the
+ * image has to be (re)created.
+ */
+static bool
+surface_state_update_xform_image(struct pixman_surface_state *ps,
+				 struct weston_color_transform *xform)
+{
+	struct pixman_color_transform *pxform;
+	struct pixman_xform_image *xi, *found = NULL;
+	struct wl_shm_buffer *shm_buffer = NULL;
+	pixman_format_code_t format = PIXMAN_XFORM_FORMAT;
+	int width = 1;
+	int height = 1;
+
+	pxform = pixman_color_transform_get(xform);
+	if (!pxform)
+		return false;
+
+	if (pixman_image_get_data(ps->image)) {
+		width = pixman_image_get_width(ps->image);
+		height = pixman_image_get_height(ps->image);
+
+		if (PIXMAN_FORMAT_A(pixman_image_get_format(ps->image)) == 0)
+			format = PIXMAN_XFORM_FORMAT_OPAQUE;
+	}
+
+	wl_list_for_each(xi, &ps->xform_images, link) {
+		if (xi->xform == xform) {
+			found = xi;
+			break;
+		}
+	}
+
+	if (found &&
+	    (pixman_image_get_width(found->image) != width ||
+	     pixman_image_get_height(found->image) != height ||
+	     pixman_image_get_format(found->image) != format)) {
+		xform_image_destroy(found);
+		found = NULL;
+	}
+
+	if (!found) {
+		found = zalloc(sizeof *found);
+		if (!found)
+			return false;
+
+		found->image = pixman_image_create_bits_no_clear(format,
+								 width, height,
+								 NULL, 0);
+		if (!found->image) {
+			free(found);
+			return false;
+		}
+
+		found->xform = weston_color_transform_ref(xform);
+		pixman_region32_init_rect(&found->damage, 0, 0, width, height);
+		wl_list_insert(&ps->xform_images, &found->link);
+
+		if (wl_list_length(&ps->xform_images) > PIXMAN_XFORM_IMAGES_MAX) {
+			xi = container_of(ps->xform_images.prev,
+					  struct pixman_xform_image, link);
+			xform_image_destroy(xi);
+		}
+	} else {
+		wl_list_remove(&found->link);
+		wl_list_insert(&ps->xform_images, &found->link);
+	}
+
+	/* Solid color surfaces have no damage tracking, but are tiny */
+	if (!pixman_image_get_data(ps->image))
+		pixman_region32_union_rect(&found->damage, &found->damage,
+					   0, 0, width, height);
+
+	if (!pixman_region32_not_empty(&found->damage))
+		return true;
+
+	if (ps->buffer_ref.buffer)
+		shm_buffer = ps->buffer_ref.buffer->shm_buffer;
+
+	if (shm_buffer)
+		wl_shm_buffer_begin_access(shm_buffer);
+
+	/* Left over from the previous repaint */
+	pixman_image_set_transform(ps->image, NULL);
+	pixman_image_set_filter(ps->image, PIXMAN_FILTER_NEAREST, NULL, 0);
+	pixman_image_set_repeat(ps->image, PIXMAN_REPEAT_NONE);
+
+	pixman_color_transform_convert(pxform, ps->image, found->image,
+				       &found->damage);
+
+	if (shm_buffer)
+		wl_shm_buffer_end_access(shm_buffer);
+
+	pixman_region32_clear(&found->damage);
+
+	return true;
+}
+
 static void
 draw_paint_node(struct weston_paint_node *pnode,
 		pixman_region32_t *damage /* in global coordinates */)
@@ -488,8 +643,6 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (!pnode->surf_xform_valid)
 		return;
 
-	assert(pnode->surf_xform.transform == NULL);
-
 	/* No buffer attached */
 	if (!ps->image)
 		return;
@@ -504,6 +657,7 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (ps->buffer_ref.buffer && !ps->buffer_ref.buffer->shm_buffer) {
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
+		surface_state_drop_xform_images(ps);
 		return;
 	}
 
@@ -515,6 +669,10 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (!pixman_region32_not_empty(&repaint))
 		goto out;
 
+	if (pnode->surf_xform.transform &&
+	    !surface_state_update_xform_image(ps, pnode->surf_xform.transform))
+		goto out;
+
 	if (view_transformation_is_translation(pnode->view)) {
 		/* The simple case: The surface regions opaque, non-opaque,
 		 * etc. are convertible to global coordinate space.
@@ -546,6 +704,9 @@ repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
 
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
+		if (pnode->occluded)
+			continue;
+
 		if (pnode->view->plane == &compositor->primary_plane)
 			draw_paint_node(pnode, damage);
 	}
@@ -555,6 +716,9 @@ static void
 copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
 {
 	struct pixman_output_state *po = get_output_state(output);
+	struct weston_color_transform *xform =
+		output->color_outcome->from_blend_to_output;
+	struct pixman_color_transform *pxform = NULL;
 	pixman_region32_t output_region;
 
 	pixman_region32_init(&output_region);
@@ -562,6 +726,16 @@ copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
 
 	weston_region_global_to_output(&output_region, output, &output_region);
 
+	if (xform && !output->from_blend_to_output_by_backend)
+		pxform = pixman_color_transform_get(xform);
+
+	if (pxform) {
+		pixman_color_transform_convert(pxform, po->shadow_image,
+					       po->hw_buffer, &output_region);
+		pixman_region32_fini(&output_region);
+		return;
+	}
+
 	pixman_image_set_clip_region32 (po->hw_buffer, &output_region);
 	pixman_region32_fini(&output_region);
 
@@ -639,6 +813,9 @@ static void
 pixman_renderer_output_set_buffer(struct weston_output *output,
 				  pixman_image_t *buffer);
 
+static bool
+pixman_renderer_output_update_shadow(struct weston_output *output);
+
 static void
 pixman_renderer_repaint_output(struct weston_output *output,
 			       pixman_region32_t *output_damage,
@@ -646,6 +823,7 @@ pixman_renderer_repaint_output(struct weston_output *output,
 {
 	struct pixman_output_state *po = get_output_state(output);
 	struct pixman_renderbuffer *rb;
+	pixman_region32_t full_damage;
 
 	assert(renderbuffer);
 
@@ -653,12 +831,21 @@ pixman_renderer_repaint_output(struct weston_output *output,
 
 	pixman_renderer_output_set_buffer(output, rb->image);
 
-	assert(output->from_blend_to_output_by_backend ||
-	       output->color_outcome->from_blend_to_output == NULL);
-
 	if (!po->hw_buffer)
  		return;
 
+	pixman_region32_init(&full_damage);
+	if (pixman_renderer_output_update_shadow(output)) {
+		pixman_region32_copy(&full_damage, &output->region);
+		output_damage = &full_damage;
+	}
+
+	/* The color transformation to the output is applied when copying
+	 * the shadow buffer to the hardware buffer. */
+	assert(output->from_blend_to_output_by_backend ||
+	       output->color_outcome->from_blend_to_output == NULL ||
+	       po->shadow_format->format == DRM_FORMAT_XRGB2101010);
+
 	/* Accumulate damage in all renderbuffers */
 	wl_list_for_each(rb, &po->renderbuffer_list, link) {
 		pixman_region32_union(&rb->base.damage,
@@ -681,6 +868,7 @@ pixman_renderer_repaint_output(struct weston_output *output,
 	pixman_region32_clear(&renderbuffer->damage);
 
 	wl_signal_emit(&output->frame_signal, output_damage);
+	pixman_region32_fini(&full_damage);
 
 	/* Actual flip should be done by caller */
 }
@@ -689,7 +877,22 @@ static void
 pixman_renderer_flush_damage(struct weston_surface *surface,
 			     struct weston_buffer *buffer)
 {
-	/* No-op for pixman renderer */
+	struct pixman_surface_state *ps = get_surface_state(surface);
+	struct pixman_xform_image *xi;
+	pixman_region32_t buffer_damage;
+
+	/* The buffer is sampled directly, only color transformed copies of
+	 * it need updating. */
+	if (wl_list_empty(&ps->xform_images))
+		return;
+
+	pixman_region32_init(&buffer_damage);
+	weston_surface_to_buffer_region(surface, &surface->damage,
+					&buffer_damage);
+	wl_list_for_each(xi, &ps->xform_images, link)
+		pixman_region32_union(&xi->damage, &xi->damage,
+				      &buffer_damage);
+	pixman_region32_fini(&buffer_damage);
 }
 
 static void
@@ -704,6 +907,7 @@ buffer_state_handle_buffer_destroy(struct wl_listener *listener, void *data)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	surface_state_drop_xform_images(ps);
 
 	ps->buffer_destroy_listener.notify = NULL;
 }
@@ -751,8 +955,10 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		ps->image = NULL;
 	}
 
-	if (!buffer)
+	if (!buffer) {
+		surface_state_drop_xform_images(ps);
 		return;
+	}
 
 	if (buffer->type == WESTON_BUFFER_SOLID) {
 		pixman_renderer_surface_set_color(es,
@@ -767,6 +973,7 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 	}
 
 	if (buffer->type != WESTON_BUFFER_SHM) {
+		surface_state_drop_xform_images(ps);
 		weston_log("Pixman renderer supports only SHM buffers\n");
 		weston_buffer_reference(&ps->buffer_ref, NULL,
 					BUFFER_WILL_NOT_BE_ACCESSED);
@@ -815,6 +1022,7 @@ pixman_renderer_surface_state_destroy(struct pixman_surface_state *ps)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	surface_state_drop_xform_images(ps);
 	weston_buffer_reference(&ps->buffer_ref, NULL,
 				BUFFER_WILL_NOT_BE_ACCESSED);
 	weston_buffer_release_reference(&ps->buffer_release_ref, NULL);
@@ -856,6 +1064,7 @@ pixman_renderer_create_surface(struct weston_surface *surface)
 	surface->renderer_state = ps;
 
 	ps->surface = surface;
+	wl_list_init(&ps->xform_images);
 
 	ps->surface_destroy_listener.notify =
 		surface_state_handle_surface_destroy;
@@ -914,6 +1123,83 @@ pixman_renderer_surface_copy_content(struct weston_surface *surface,
 	return 0;
 }
 
+/*
+ * Blending happens in a deeper shadow buffer when the renderer has to color
+ * transform it to the output.
+ */
+static const struct pixel_format_info *
+pixman_renderer_output_shadow_format(struct weston_output *output,
+				     bool use_shadow)
+{
+	if (output->color_outcome->from_blend_to_output != NULL &&
+	    !output->from_blend_to_output_by_backend)
+		return pixel_format_get_info(DRM_FORMAT_XRGB2101010);
+
+	if (use_shadow)
+		return pixel_format_get_info(DRM_FORMAT_XRGB8888);
+
+	return NULL;
+}
+
+static bool
+pixman_renderer_output_create_shadow(struct weston_output *output)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	pixman_format_code_t format;
+
+	if (!po->shadow_format)
+		return true;
+
+	/* The 10-bit format is what the blending buffer of a color
+	 * transformed output is captured as, blending needs more. */
+	format = po->shadow_format->pixman_format;
+	if (po->shadow_format->format == DRM_FORMAT_XRGB2101010)
+		format = PIXMAN_XFORM_FORMAT_OPAQUE;
+
+	if (po->shadow_image)
+		pixman_image_unref(po->shadow_image);
+
+	po->shadow_image =
+		pixman_image_create_bits_no_clear(format,
+						  po->fb_size.width,
+						  po->fb_size.height,
+						  NULL, 0);
+
+	weston_output_update_capture_info(output,
+					  WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
+					  po->fb_size.width,
+					  po->fb_size.height,
+					  po->shadow_format);
+
+	return !!po->shadow_image;
+}
+
+/*
+ * The color outcome of an output can change after it was enabled, e.g.
+ * with a new color profile. Switch the shadow buffer to the format the
+ * outcome needs. Once there is a shadow buffer, it is kept.
+ *
+ * Returns true if everything needs to be repainted.
+ */
+static bool
+pixman_renderer_output_update_shadow(struct weston_output *output)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	const struct pixel_format_info *shadow_format;
+
+	shadow_format =
+		pixman_renderer_output_shadow_format(output,
+						     po->shadow_format != NULL);
+	if (shadow_format == po->shadow_format)
+		return false;
+
+	po->shadow_format = shadow_format;
+	pixman_renderer_output_create_shadow(output);
+	abort_oom_if_null(po->shadow_image);
+
+	return true;
+}
+
 static bool
 pixman_renderer_resize_output(struct weston_output *output,
 			      const struct weston_size *fb_size,
@@ -954,24 +1240,7 @@ pixman_renderer_resize_output(struct weston_output *output,
 						  po->hw_format);
 	}
 
-	if (!po->shadow_format)
-		return true;
-
-	if (po->shadow_image)
-		pixman_image_unref(po->shadow_image);
-
-	po->shadow_image =
-		pixman_image_create_bits_no_clear(po->shadow_format->pixman_format,
-						  fb_size->width, fb_size->height,
-						  NULL, 0);
-
-	weston_output_update_capture_info(output,
-					  WESTON_OUTPUT_CAPTURE_SOURCE_BLENDING,
-					  po->fb_size.width,
-					  po->fb_size.height,
-					  po->shadow_format);
-
-	return !!po->shadow_image;
+	return pixman_renderer_output_create_shadow(output);
 }
 
 static void
@@ -1023,6 +1292,7 @@ pixman_renderer_init(struct weston_compositor *ec)
 	ec->renderer = &renderer->base;
 	ec->capabilities |= WESTON_CAP_ROTATION_ANY;
 	ec->capabilities |= WESTON_CAP_VIEW_CLIP_MASK;
+	ec->capabilities |= WESTON_CAP_COLOR_OPS;
 
 	renderer->debug_binding =
 		weston_compositor_add_debug_binding(ec, KEY_R,
@@ -1103,8 +1373,9 @@ pixman_renderer_output_create(struct weston_output *output,
 
 	output->renderer_state = po;
 
-	if (options->use_shadow)
-		po->shadow_format = pixel_format_get_info(DRM_FORMAT_XRGB8888);
+	po->shadow_format =
+		pixman_renderer_output_shadow_format(output,
+						     options->use_shadow);
 
 	wl_list_init(&po->renderbuffer_list);
 
@@ -93,6 +93,7 @@ static_assert(sizeof(struct gl_shader_requirements) ==
 	      "struct gl_shader_requirements must not contain implicit padding");
 
 struct gl_shader;
+struct gl_shader_cache;
 struct weston_color_transform;
 
 #define GL_SHADER_INPUT_TEX_MAX 3
@@ -218,6 +219,9 @@ struct gl_renderer {
 	 */
 	struct wl_list shader_list;
 	struct weston_log_scope *shader_scope;
+
+	/** On-disk cache of linked programs, NULL if disabled */
+	struct gl_shader_cache *shader_cache;
 };
 
 static inline struct gl_renderer *
@@ -276,6 +280,34 @@ gl_renderer_use_program(struct gl_renderer *gr,
 struct weston_log_scope *
 gl_shader_scope_create(struct gl_renderer *gr);
 
+void
+gl_renderer_shader_cache_init(struct gl_renderer *gr, const char *extensions);
+
+struct gl_shader_cache *
+gl_shader_cache_create(const char *dir, const char *extensions,
+		       uint32_t gl_version,
+		       const char *vertex_source,
+		       const char *fragment_source);
+
+void
+gl_shader_cache_destroy(struct gl_shader_cache *cache);
+
+bool
+gl_shader_cache_load(struct gl_shader_cache *cache,
+		     const struct gl_shader_requirements *req,
+		     const char *conf, GLuint program);
+
+void
+gl_shader_cache_store(struct gl_shader_cache *cache,
+		      const struct gl_shader_requirements *req,
+		      const char *conf, GLuint program);
+
+void
+gl_shader_cache_for_each(struct gl_shader_cache *cache,
+			 void (*func)(const struct gl_shader_requirements *req,
+				      void *data),
+			 void *data);
+
 bool
 gl_shader_config_set_color_transform(struct gl_shader_config *sconf,
 				     struct weston_color_transform *xform);
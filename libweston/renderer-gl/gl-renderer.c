@@ -112,6 +112,21 @@ struct gl_output_state {
 
 	const struct pixel_format_info *shadow_format;
 	struct gl_fbo_texture shadow;
+
+	/* struct gl_renderbuffer::link, for outputs without an EGLSurface */
+	struct wl_list renderbuffer_list;
+	/* What the last repaint drew into, for read_pixels */
+	struct gl_renderbuffer *current_rb;
+};
+
+struct gl_renderbuffer {
+	struct weston_renderbuffer base;
+	struct gl_renderer *gr;
+	enum gl_border_status border_damage;
+	EGLImageKHR image;
+	GLuint tex;
+	GLuint fbo;
+	struct wl_list link;
 };
 
 struct gl_renderer;
@@ -1322,6 +1337,9 @@ repaint_views(struct weston_output *output, pixman_region32_t *damage)
 
 	wl_list_for_each_reverse(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
+		if (pnode->occluded)
+			continue;
+
 		if (pnode->view->plane == &compositor->primary_plane)
 			draw_paint_node(pnode, damage);
 		else if (pnode->need_through_hole)
@@ -1652,6 +1670,37 @@ output_rotate_damage(struct weston_output *output,
 	go->border_damage[go->buffer_damage_index] = border_status;
 }
 
+/* The renderbuffer equivalent of output_get_damage() and
+ * output_rotate_damage(): each renderbuffer accumulates what changed
+ * since it was last drawn into, however many others are in flight. */
+static void
+output_get_renderbuffer_damage(struct weston_output *output,
+			       struct gl_renderbuffer *rb,
+			       pixman_region32_t *output_damage,
+			       pixman_region32_t *buffer_damage,
+			       uint32_t *border_damage)
+{
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_renderbuffer *tmp;
+
+	wl_list_for_each(tmp, &go->renderbuffer_list, link) {
+		pixman_region32_union(&tmp->base.damage, &tmp->base.damage,
+				      output_damage);
+		tmp->border_damage |= go->border_status;
+	}
+
+	if (rb->border_damage & BORDER_SIZE_CHANGED) {
+		*border_damage |= BORDER_ALL_DIRTY;
+		pixman_region32_copy(buffer_damage, &output->region);
+	} else {
+		*border_damage |= rb->border_damage;
+		pixman_region32_copy(buffer_damage, &rb->base.damage);
+	}
+
+	pixman_region32_clear(&rb->base.damage);
+	rb->border_damage = BORDER_STATUS_CLEAN;
+}
+
 /**
  * Given a region in Weston's (top-left-origin) global co-ordinate space,
  * translate it to the co-ordinate space used by GL for our output
@@ -1811,6 +1860,8 @@ gl_renderer_repaint_output(struct weston_output *output,
 	struct gl_output_state *go = get_output_state(output);
 	struct weston_compositor *compositor = output->compositor;
 	struct gl_renderer *gr = get_renderer(compositor);
+	struct gl_renderbuffer *rb = NULL;
+	GLuint fbo = 0;
 	EGLBoolean ret;
 	static int errored;
 	/* areas we've damaged since we last used this buffer */
@@ -1826,6 +1877,13 @@ gl_renderer_repaint_output(struct weston_output *output,
 	       output->color_outcome->from_blend_to_output == NULL ||
 	       shadow_exists(go));
 
+	/* Outputs without an EGLSurface draw into the given renderbuffer */
+	if (renderbuffer) {
+		rb = container_of(renderbuffer, struct gl_renderbuffer, base);
+		fbo = rb->fbo;
+	}
+	assert((rb != NULL) == (go->egl_surface == EGL_NO_SURFACE));
+
 	if (use_output(output) < 0)
 		return;
 
@@ -1856,7 +1914,7 @@ gl_renderer_repaint_output(struct weston_output *output,
 		glBindFramebuffer(GL_FRAMEBUFFER, go->shadow.fbo);
 		glViewport(0, 0, go->area.width, go->area.height);
 	} else {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 		glViewport(go->area.x, area_inv_y,
 			   go->area.width, go->area.height);
 	}
@@ -1883,8 +1941,13 @@ gl_renderer_repaint_output(struct weston_output *output,
 
 	/* Update previous_damage using buffer_age (if available), and store
 	 * current damaged region for future use. */
-	output_get_damage(output, &previous_damage, &border_status);
-	output_rotate_damage(output, output_damage, go->border_status);
+	if (rb) {
+		output_get_renderbuffer_damage(output, rb, output_damage,
+					       &previous_damage, &border_status);
+	} else {
+		output_get_damage(output, &previous_damage, &border_status);
+		output_rotate_damage(output, output_damage, go->border_status);
+	}
 
 	/* Redraw both areas which have changed since we last used this buffer,
 	 * as well as the areas we now want to repaint, to make sure the
@@ -1892,7 +1955,7 @@ gl_renderer_repaint_output(struct weston_output *output,
 	pixman_region32_union(&total_damage, &previous_damage, output_damage);
 	border_status |= go->border_status;
 
-	if (gr->has_egl_partial_update && !gr->fan_debug) {
+	if (gr->has_egl_partial_update && !gr->fan_debug && !rb) {
 		int n_egl_rects;
 		EGLint *egl_rects;
 
@@ -1913,7 +1976,7 @@ gl_renderer_repaint_output(struct weston_output *output,
 		else
 			repaint_views(output, output_damage);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 		glViewport(go->area.x, area_inv_y,
 			   go->area.width, go->area.height);
 		blit_shadow_to_output(output, &total_damage);
@@ -1937,8 +2000,15 @@ gl_renderer_repaint_output(struct weston_output *output,
 	if (go->render_sync != EGL_NO_SYNC_KHR)
 		gr->destroy_sync(gr->egl_display, go->render_sync);
 	go->render_sync = create_render_sync(gr);
-
-	if (gr->swap_buffers_with_damage && !gr->fan_debug) {
+	go->current_rb = rb;
+
+	if (rb) {
+		/* Nothing to swap: the renderbuffer is ready once the render
+		 * sync signals. The flush gives the sync its fence fd without
+		 * waiting for the GPU. */
+		glFlush();
+		ret = EGL_TRUE;
+	} else if (gr->swap_buffers_with_damage && !gr->fan_debug) {
 		int n_egl_rects;
 		EGLint *egl_rects;
 
@@ -1989,9 +2059,15 @@ gl_renderer_read_pixels(struct weston_output *output,
 	if (format->gl_format == 0 || format->gl_type == 0)
 		return -1;
 
+	if (go->egl_surface == EGL_NO_SURFACE && !go->current_rb)
+		return -1;
+
 	if (use_output(output) < 0)
 		return -1;
 
+	glBindFramebuffer(GL_FRAMEBUFFER,
+			  go->current_rb ? go->current_rb->fbo : 0);
+
 	if (gr->has_pack_reverse)
 		glPixelStorei(GL_PACK_REVERSE_ROW_ORDER_ANGLE, GL_FALSE);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
@@ -3597,6 +3673,7 @@ gl_renderer_output_create(struct weston_output *output,
 		return -1;
 
 	go->egl_surface = surface;
+	wl_list_init(&go->renderbuffer_list);
 
 	for (i = 0; i < BUFFER_DAMAGE_COUNT; i++)
 		pixman_region32_init(&go->buffer_damage[i]);
@@ -3717,12 +3794,108 @@ gl_renderer_output_pbuffer_create(struct weston_output *output,
 	return ret;
 }
 
+static int
+gl_renderer_output_fbo_create(struct weston_output *output,
+			      const struct gl_renderer_fbo_options *options)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+
+	if (!gr->has_surfaceless_context || !gr->has_dmabuf_import) {
+		weston_log("Output %s: rendering without an EGLSurface needs "
+			   "EGL_KHR_surfaceless_context and "
+			   "EGL_EXT_image_dma_buf_import.\n", output->name);
+		return -1;
+	}
+
+	return gl_renderer_output_create(output, EGL_NO_SURFACE,
+					 &options->fb_size, &options->area);
+}
+
+static void
+gl_renderer_renderbuffer_destroy(struct weston_renderbuffer *renderbuffer);
+
+static struct weston_renderbuffer *
+gl_renderer_create_renderbuffer_dmabuf(struct weston_output *output,
+				       const struct dmabuf_attributes *attributes)
+{
+	struct gl_output_state *go = get_output_state(output);
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_renderbuffer *rb;
+	GLenum status;
+
+	assert(go);
+	assert(go->egl_surface == EGL_NO_SURFACE);
+
+	if (use_output(output) < 0)
+		return NULL;
+
+	rb = xzalloc(sizeof(*rb));
+	rb->gr = gr;
+
+	rb->image = import_simple_dmabuf(gr, attributes);
+	if (rb->image == EGL_NO_IMAGE_KHR) {
+		weston_log("Output %s: failed to import dmabuf renderbuffer.\n",
+			   output->name);
+		gl_renderer_print_egl_error_state();
+		free(rb);
+		return NULL;
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glGenTextures(1, &rb->tex);
+	glBindTexture(GL_TEXTURE_2D, rb->tex);
+	gr->image_target_texture_2d(GL_TEXTURE_2D, rb->image);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &rb->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, rb->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, rb->tex, 0);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		weston_log("Output %s: dmabuf renderbuffer fbo error: %#x\n",
+			   output->name, status);
+		glDeleteFramebuffers(1, &rb->fbo);
+		glDeleteTextures(1, &rb->tex);
+		gr->destroy_image(gr->egl_display, rb->image);
+		free(rb);
+		return NULL;
+	}
+
+	/* Never drawn into, so everything is stale */
+	pixman_region32_init(&rb->base.damage);
+	pixman_region32_copy(&rb->base.damage, &output->region);
+	rb->border_damage = BORDER_ALL_DIRTY;
+	rb->base.refcount = 2;
+	rb->base.destroy = gl_renderer_renderbuffer_destroy;
+	wl_list_insert(&go->renderbuffer_list, &rb->link);
+
+	return &rb->base;
+}
+
+static void
+gl_renderer_renderbuffer_destroy(struct weston_renderbuffer *renderbuffer)
+{
+	struct gl_renderbuffer *rb =
+		container_of(renderbuffer, struct gl_renderbuffer, base);
+	struct gl_renderer *gr = rb->gr;
+
+	glDeleteFramebuffers(1, &rb->fbo);
+	glDeleteTextures(1, &rb->tex);
+	gr->destroy_image(gr->egl_display, rb->image);
+	pixman_region32_fini(&rb->base.damage);
+	free(rb);
+}
+
 static void
 gl_renderer_output_destroy(struct weston_output *output)
 {
 	struct gl_renderer *gr = get_renderer(output->compositor);
 	struct gl_output_state *go = get_output_state(output);
 	struct timeline_render_point *trp, *tmp;
+	struct gl_renderbuffer *rb, *tmp_rb;
 	int i;
 
 	for (i = 0; i < 2; i++)
@@ -3734,7 +3907,14 @@ gl_renderer_output_destroy(struct weston_output *output)
 	eglMakeCurrent(gr->egl_display,
 		       gr->dummy_surface, gr->dummy_surface, gr->egl_context);
 
-	weston_platform_destroy_egl_surface(gr->egl_display, go->egl_surface);
+	wl_list_for_each_safe(rb, tmp_rb, &go->renderbuffer_list, link) {
+		wl_list_remove(&rb->link);
+		weston_renderbuffer_unref(&rb->base);
+	}
+
+	if (go->egl_surface != EGL_NO_SURFACE)
+		weston_platform_destroy_egl_surface(gr->egl_display,
+						    go->egl_surface);
 
 	if (!wl_list_empty(&go->timeline_render_point_list))
 		weston_log("warning: discarding pending timeline render"
@@ -3783,6 +3963,7 @@ gl_renderer_destroy(struct weston_compositor *ec)
 	gl_renderer_shader_list_destroy(gr);
 	if (gr->fallback_shader)
 		gl_shader_destroy(gr, gr->fallback_shader);
+	gl_shader_cache_destroy(gr->shader_cache);
 
 	/* Work around crash in egl_dri2.c's dri2_make_current() - when does this apply? */
 	eglMakeCurrent(gr->egl_display,
@@ -4242,6 +4423,8 @@ gl_renderer_setup(struct weston_compositor *ec, EGLSurface egl_surface)
 
 	glActiveTexture(GL_TEXTURE0);
 
+	gl_renderer_shader_cache_init(gr, extensions);
+
 	gr->fallback_shader = gl_renderer_create_fallback_shader(gr);
 	if (!gr->fallback_shader) {
 		weston_log("Error: compiling fallback shader failed.\n");
@@ -4282,6 +4465,8 @@ WL_EXPORT struct gl_renderer_interface gl_renderer_interface = {
 	.display_create = gl_renderer_display_create,
 	.output_window_create = gl_renderer_output_window_create,
 	.output_pbuffer_create = gl_renderer_output_pbuffer_create,
+	.output_fbo_create = gl_renderer_output_fbo_create,
+	.create_renderbuffer_dmabuf = gl_renderer_create_renderbuffer_dmabuf,
 	.output_destroy = gl_renderer_output_destroy,
 	.output_set_border = gl_renderer_output_set_border,
 	.create_fence_fd = gl_renderer_create_fence_fd,
@@ -53,6 +53,8 @@ typedef intptr_t EGLNativeWindowType;
 
 #endif /* ENABLE_EGL */
 
+struct dmabuf_attributes;
+
 enum gl_renderer_border_side {
 	GL_RENDERER_BORDER_TOP = 0,
 	GL_RENDERER_BORDER_LEFT = 1,
@@ -105,6 +107,13 @@ struct gl_renderer_pbuffer_options {
 	unsigned formats_count;
 };
 
+struct gl_renderer_fbo_options {
+	/** Size of the framebuffer in pixels, including borders */
+	struct weston_size fb_size;
+	/** Area inside the framebuffer in pixels for composited content */
+	struct weston_geometry area;
+};
+
 struct gl_renderer_interface {
 	/**
 	 * Initialize GL-renderer with the given EGL platform and native display
@@ -185,6 +194,39 @@ struct gl_renderer_interface {
 	int (*output_pbuffer_create)(struct weston_output *output,
 				     const struct gl_renderer_pbuffer_options *options);
 
+	/**
+	 * Attach GL-renderer to the output without any rendering surface
+	 *
+	 * \param output The output to create a rendering state for.
+	 * \param options The options struct describing the framebuffer
+	 * \return 0 on success, -1 on failure.
+	 *
+	 * The output has no EGLSurface. Every repaint_output() call must be
+	 * given a renderbuffer from \c create_renderbuffer_dmabuf, and the
+	 * repaint results are drawn into it. Nothing is swapped: a repaint
+	 * only flushes, and \c create_fence_fd tells when it is done.
+	 *
+	 * This function needs EGL_KHR_surfaceless_context and
+	 * EGL_EXT_image_dma_buf_import.
+	 */
+	int (*output_fbo_create)(struct weston_output *output,
+				 const struct gl_renderer_fbo_options *options);
+
+	/**
+	 * Create a renderbuffer drawing into a dmabuf
+	 *
+	 * \param output The output, created with \c output_fbo_create.
+	 * \param attributes The dmabuf, of the output framebuffer size.
+	 * \return The renderbuffer, or NULL on failure.
+	 *
+	 * The renderer does not take ownership of the dmabuf fds. The
+	 * returned reference belongs to the caller; the renderbuffer lives
+	 * on until the output is destroyed as well.
+	 */
+	struct weston_renderbuffer *
+	(*create_renderbuffer_dmabuf)(struct weston_output *output,
+				      const struct dmabuf_attributes *attributes);
+
 	void (*output_destroy)(struct weston_output *output);
 
 	/* Sets the output border.
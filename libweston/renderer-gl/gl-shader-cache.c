@@ -0,0 +1,537 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <libweston/libweston.h>
+#include <libweston/zalloc.h>
+
+#include "gl-renderer.h"
+#include "gl-renderer-internal.h"
+#include "shared/helpers.h"
+#include "shared/platform.h"
+
+/*
+ * Linked shader programs are stored with glGetProgramBinaryOES(), one file
+ * per program, so that later runs can skip compiling and linking them.
+ * Entries are only valid for the driver and shader sources that produced
+ * them, which is what the driver hash in their header is about.
+ *
+ * Programs are linked in the middle of a repaint, so storing them only
+ * copies the binary out of GL there. A writer thread puts the files on
+ * disk. Its state is protected by gl_shader_cache::mutex.
+ */
+
+#define CACHE_MAGIC "WGLPROG1"
+#define CACHE_SUFFIX ".bin"
+
+struct gl_shader_cache_header {
+	char magic[8];
+	uint64_t driver_hash;
+	struct gl_shader_requirements key;
+	uint32_t binary_format;
+	uint32_t binary_length;
+};
+
+struct gl_shader_cache_job {
+	struct wl_list link;	/**< gl_shader_cache::jobs */
+	char *path;
+	struct gl_shader_cache_header header;
+	char binary[];
+};
+
+struct gl_shader_cache {
+	char *dir;
+	uint64_t driver_hash;
+
+	PFNGLGETPROGRAMBINARYOESPROC get_program_binary;
+	PFNGLPROGRAMBINARYOESPROC program_binary;
+
+	pthread_t writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t work;	/**< jobs queued or quitting */
+	struct wl_list jobs;	/**< gl_shader_cache_job::link */
+	bool quit;
+	int write_error;	/**< errno of a failed write, or 0 */
+	char *write_error_path;
+};
+
+/* 64-bit FNV-1a, continuing from hash */
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint64_t
+hash_string(uint64_t hash, const char *str)
+{
+	/* include the terminator so that concatenations differ */
+	return hash_bytes(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+static char *
+cache_entry_path(struct gl_shader_cache *cache, const char *conf)
+{
+	uint64_t hash = hash_string(cache->driver_hash, conf);
+	char *path;
+
+	if (asprintf(&path, "%s/%016" PRIx64 CACHE_SUFFIX,
+		     cache->dir, hash) < 0)
+		return NULL;
+
+	return path;
+}
+
+/* Write aside and rename, so that readers never see partial files.
+ * Returns 0 or an errno. */
+static int
+cache_job_write(struct gl_shader_cache_job *job)
+{
+	size_t length = job->header.binary_length;
+	char *tmp;
+	int ret = 0;
+	int fd;
+
+	if (asprintf(&tmp, "%s.XXXXXX", job->path) < 0)
+		return ENOMEM;
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		ret = errno;
+		goto out;
+	}
+
+	errno = 0;
+	if (write(fd, &job->header, sizeof job->header) !=
+	    sizeof job->header ||
+	    write(fd, job->binary, length) != (ssize_t) length ||
+	    rename(tmp, job->path) < 0) {
+		ret = errno ? errno : EIO;
+		unlink(tmp);
+	}
+
+	close(fd);
+out:
+	free(tmp);
+
+	return ret;
+}
+
+static void *
+cache_writer_thread(void *data)
+{
+	struct gl_shader_cache *cache = data;
+	struct gl_shader_cache_job *job;
+	int ret;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	for (;;) {
+		while (wl_list_empty(&cache->jobs) && !cache->quit)
+			pthread_cond_wait(&cache->work, &cache->mutex);
+
+		/* Drain the queue before quitting, nothing is lost */
+		if (wl_list_empty(&cache->jobs))
+			break;
+
+		job = wl_container_of(cache->jobs.next, job, link);
+		wl_list_remove(&job->link);
+
+		pthread_mutex_unlock(&cache->mutex);
+		ret = cache_job_write(job);
+		pthread_mutex_lock(&cache->mutex);
+
+		/* weston_log() is not thread-safe, leave it to the
+		 * compositor thread. */
+		if (ret != 0 && cache->write_error == 0) {
+			cache->write_error = ret;
+			cache->write_error_path = job->path;
+			job->path = NULL;
+		}
+
+		free(job->path);
+		free(job);
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return NULL;
+}
+
+static bool
+cache_writer_start(struct gl_shader_cache *cache)
+{
+	sigset_t set, old;
+	int ret;
+
+	pthread_mutex_init(&cache->mutex, NULL);
+	pthread_cond_init(&cache->work, NULL);
+	wl_list_init(&cache->jobs);
+
+	/* Leave signal handling to the compositor thread */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	ret = pthread_create(&cache->writer, NULL, cache_writer_thread, cache);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret != 0) {
+		pthread_cond_destroy(&cache->work);
+		pthread_mutex_destroy(&cache->mutex);
+		return false;
+	}
+
+	return true;
+}
+
+/* Called on the compositor thread only */
+static void
+cache_report_write_error(struct gl_shader_cache *cache)
+{
+	char *path;
+	int error;
+
+	pthread_mutex_lock(&cache->mutex);
+	error = cache->write_error;
+	path = cache->write_error_path;
+	cache->write_error = 0;
+	cache->write_error_path = NULL;
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (error == 0)
+		return;
+
+	weston_log("GL program cache: failed to write '%s': %s\n",
+		   path, strerror(error));
+	free(path);
+}
+
+static bool
+ensure_dir(const char *dir)
+{
+	struct stat st;
+
+	if (mkdir(dir, 0700) == 0)
+		return true;
+
+	return errno == EEXIST && stat(dir, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/** Set up the on-disk program binary cache
+ *
+ * \param dir The directory to keep the cache in, created if missing.
+ * \param extensions The GL extension string.
+ * \param gl_version The GL ES version, as from gr_gl_version().
+ * \param vertex_source The vertex shader source.
+ * \param fragment_source The fragment shader source.
+ * \return The cache, or NULL if not supported.
+ *
+ * Must be called with the renderer's GL context current.
+ */
+struct gl_shader_cache *
+gl_shader_cache_create(const char *dir, const char *extensions,
+		       uint32_t gl_version,
+		       const char *vertex_source,
+		       const char *fragment_source)
+{
+	struct gl_shader_cache *cache;
+	GLint num_formats = 0;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	if (!weston_check_egl_extension(extensions, "GL_OES_get_program_binary")) {
+		weston_log("GL program cache disabled: "
+			   "GL_OES_get_program_binary not available\n");
+		return NULL;
+	}
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &num_formats);
+	if (num_formats < 1) {
+		weston_log("GL program cache disabled: "
+			   "driver has no program binary formats\n");
+		return NULL;
+	}
+
+	if (!ensure_dir(dir)) {
+		weston_log("GL program cache disabled: "
+			   "cannot use directory '%s': %s\n",
+			   dir, strerror(errno));
+		return NULL;
+	}
+
+	cache = zalloc(sizeof *cache);
+	if (!cache)
+		return NULL;
+
+	cache->get_program_binary =
+		(void *) eglGetProcAddress("glGetProgramBinaryOES");
+	cache->program_binary =
+		(void *) eglGetProcAddress("glProgramBinaryOES");
+	cache->dir = strdup(dir);
+	if (!cache->get_program_binary || !cache->program_binary ||
+	    !cache->dir) {
+		free(cache->dir);
+		free(cache);
+		return NULL;
+	}
+
+	hash = hash_string(hash, (const char *) glGetString(GL_VENDOR));
+	hash = hash_string(hash, (const char *) glGetString(GL_RENDERER));
+	hash = hash_string(hash, (const char *) glGetString(GL_VERSION));
+	hash = hash_bytes(hash, &gl_version, sizeof gl_version);
+	hash = hash_string(hash, vertex_source);
+	hash = hash_string(hash, fragment_source);
+	cache->driver_hash = hash;
+
+	if (!cache_writer_start(cache)) {
+		weston_log("GL program cache disabled: "
+			   "cannot start the writer thread\n");
+		free(cache->dir);
+		free(cache);
+		return NULL;
+	}
+
+	weston_log("GL program cache in '%s'\n", dir);
+
+	return cache;
+}
+
+void
+gl_shader_cache_destroy(struct gl_shader_cache *cache)
+{
+	if (!cache)
+		return;
+
+	/* Let the writer finish what is queued */
+	pthread_mutex_lock(&cache->mutex);
+	cache->quit = true;
+	pthread_cond_signal(&cache->work);
+	pthread_mutex_unlock(&cache->mutex);
+	pthread_join(cache->writer, NULL);
+
+	cache_report_write_error(cache);
+
+	pthread_cond_destroy(&cache->work);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache->dir);
+	free(cache);
+}
+
+static bool
+read_header(int fd, struct gl_shader_cache *cache,
+	    struct gl_shader_cache_header *header)
+{
+	if (read(fd, header, sizeof *header) != sizeof *header)
+		return false;
+
+	return memcmp(header->magic, CACHE_MAGIC, sizeof header->magic) == 0 &&
+	       header->driver_hash == cache->driver_hash;
+}
+
+/** Load a program from the cache
+ *
+ * \param cache The cache, may be NULL.
+ * \param req The requirements the program was built for.
+ * \param conf The shader config string of \c req.
+ * \param program The program object to load into.
+ * \return True if \c program was loaded and linked successfully.
+ *
+ * On failure \c program is left without a linked executable and can still
+ * be built from source. Entries the driver rejects are removed.
+ */
+bool
+gl_shader_cache_load(struct gl_shader_cache *cache,
+		     const struct gl_shader_requirements *req,
+		     const char *conf, GLuint program)
+{
+	struct gl_shader_cache_header header;
+	void *binary = NULL;
+	GLint status = GL_FALSE;
+	char *path;
+	int fd;
+
+	if (!cache)
+		return false;
+
+	path = cache_entry_path(cache, conf);
+	if (!path)
+		return false;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto out;
+
+	if (!read_header(fd, cache, &header) ||
+	    memcmp(&header.key, req, sizeof *req) != 0 ||
+	    header.binary_length == 0)
+		goto out_invalid;
+
+	binary = malloc(header.binary_length);
+	if (!binary ||
+	    read(fd, binary, header.binary_length) !=
+	    (ssize_t) header.binary_length)
+		goto out_invalid;
+
+	cache->program_binary(program, header.binary_format,
+			      binary, header.binary_length);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status)
+		goto out;
+
+out_invalid:
+	/* Stale or corrupt, let it be rebuilt and stored again. */
+	unlink(path);
+out:
+	if (fd >= 0)
+		close(fd);
+	free(binary);
+	free(path);
+
+	return status;
+}
+
+/** Store a linked program in the cache
+ *
+ * \param cache The cache, may be NULL.
+ * \param req The requirements the program was built for.
+ * \param conf The shader config string of \c req.
+ * \param program The successfully linked program object.
+ *
+ * Only the binary is fetched here, the file is written by the writer
+ * thread. Failures are not fatal, the program is just compiled again next
+ * time.
+ */
+void
+gl_shader_cache_store(struct gl_shader_cache *cache,
+		      const struct gl_shader_requirements *req,
+		      const char *conf, GLuint program)
+{
+	struct gl_shader_cache_job *job;
+	GLint length = 0;
+	GLenum format;
+
+	if (!cache)
+		return;
+
+	cache_report_write_error(cache);
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0)
+		return;
+
+	job = zalloc(sizeof *job + length);
+	if (!job)
+		return;
+
+	cache->get_program_binary(program, length, &length, &format,
+				  job->binary);
+	job->path = cache_entry_path(cache, conf);
+	if (length <= 0 || !job->path) {
+		free(job->path);
+		free(job);
+		return;
+	}
+
+	memcpy(job->header.magic, CACHE_MAGIC, sizeof job->header.magic);
+	job->header.driver_hash = cache->driver_hash;
+	job->header.key = *req;
+	job->header.binary_format = format;
+	job->header.binary_length = length;
+
+	pthread_mutex_lock(&cache->mutex);
+	wl_list_insert(cache->jobs.prev, &job->link);
+	pthread_cond_signal(&cache->work);
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/** Call a function for every program in the cache
+ *
+ * \param cache The cache, may be NULL.
+ * \param func Called with the requirements of each valid entry.
+ * \param data User data for \c func.
+ *
+ * Entries made for other drivers or shader sources are skipped.
+ */
+void
+gl_shader_cache_for_each(struct gl_shader_cache *cache,
+			 void (*func)(const struct gl_shader_requirements *req,
+				      void *data),
+			 void *data)
+{
+	struct gl_shader_cache_header header;
+	struct dirent *ent;
+	size_t len;
+	DIR *dir;
+	int fd;
+
+	if (!cache)
+		return;
+
+	dir = opendir(cache->dir);
+	if (!dir)
+		return;
+
+	while ((ent = readdir(dir))) {
+		len = strlen(ent->d_name);
+		if (len <= strlen(CACHE_SUFFIX) ||
+		    strcmp(ent->d_name + len - strlen(CACHE_SUFFIX),
+			   CACHE_SUFFIX) != 0)
+			continue;
+
+		fd = openat(dirfd(dir), ent->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		if (read_header(fd, cache, &header))
+			func(&header.key, data);
+
+		close(fd);
+	}
+
+	closedir(dir);
+}
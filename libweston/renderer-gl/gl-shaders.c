@@ -72,6 +72,7 @@ struct gl_shader {
 	GLint color_post_curve_lut_scale_offset_uniform;
 	struct wl_list link; /* gl_renderer::shader_list */
 	struct timespec last_used;
+	bool prewarmed; /* loaded from the cache, not used yet */
 };
 
 static const char *
@@ -222,54 +223,29 @@ create_shader_config_string(const struct gl_shader_requirements *req)
 	return str;
 }
 
-static struct gl_shader *
-gl_shader_create(struct gl_renderer *gr,
-		 const struct gl_shader_requirements *requirements)
+/* Compile and link shader->program from source */
+static bool
+gl_shader_build(struct gl_shader *shader, const char *conf)
 {
-	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
-	struct gl_shader *shader = NULL;
 	char msg[512];
 	GLint status;
 	const char *sources[3];
-	char *conf = NULL;
-
-	shader = zalloc(sizeof *shader);
-	if (!shader) {
-		weston_log("could not create shader\n");
-		goto error_vertex;
-	}
-
-	wl_list_init(&shader->link);
-	shader->key = *requirements;
-
-	if (verbose) {
-		char *desc;
-
-		desc = create_shader_description_string(requirements);
-		weston_log_scope_printf(gr->shader_scope,
-					"Compiling shader program for: %s\n",
-					desc);
-		free(desc);
-	}
 
 	sources[0] = vertex_shader;
 	shader->vertex_shader = compile_shader(GL_VERTEX_SHADER, 1, sources);
 	if (shader->vertex_shader == GL_NONE)
-		goto error_vertex;
-
-	conf = create_shader_config_string(&shader->key);
-	if (!conf)
-		goto error_fragment;
+		return false;
 
 	sources[0] = "#version 100\n";
 	sources[1] = conf;
 	sources[2] = fragment_shader;
 	shader->fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
 						 3, sources);
-	if (shader->fragment_shader == GL_NONE)
-		goto error_fragment;
+	if (shader->fragment_shader == GL_NONE) {
+		glDeleteShader(shader->vertex_shader);
+		return false;
+	}
 
-	shader->program = glCreateProgram();
 	glAttachShader(shader->program, shader->vertex_shader);
 	glAttachShader(shader->program, shader->fragment_shader);
 	glBindAttribLocation(shader->program, 0, "position");
@@ -280,12 +256,66 @@ gl_shader_create(struct gl_renderer *gr,
 	if (!status) {
 		glGetProgramInfoLog(shader->program, sizeof msg, NULL, msg);
 		weston_log("link info: %s\n", msg);
-		goto error_link;
 	}
 
 	glDeleteShader(shader->vertex_shader);
 	glDeleteShader(shader->fragment_shader);
 
+	return status;
+}
+
+static struct gl_shader *
+gl_shader_create(struct gl_renderer *gr,
+		 const struct gl_shader_requirements *requirements)
+{
+	bool verbose = weston_log_scope_is_enabled(gr->shader_scope);
+	struct gl_shader *shader = NULL;
+	char *conf = NULL;
+
+	shader = zalloc(sizeof *shader);
+	if (!shader) {
+		weston_log("could not create shader\n");
+		goto error;
+	}
+
+	wl_list_init(&shader->link);
+	shader->key = *requirements;
+
+	conf = create_shader_config_string(&shader->key);
+	if (!conf)
+		goto error;
+
+	shader->program = glCreateProgram();
+
+	if (gl_shader_cache_load(gr->shader_cache, requirements,
+				 conf, shader->program)) {
+		if (verbose) {
+			char *desc;
+
+			desc = create_shader_description_string(requirements);
+			weston_log_scope_printf(gr->shader_scope,
+						"Loaded cached shader program for: %s\n",
+						desc);
+			free(desc);
+		}
+	} else {
+		if (verbose) {
+			char *desc;
+
+			desc = create_shader_description_string(requirements);
+			weston_log_scope_printf(gr->shader_scope,
+						"Compiling shader program for: %s\n",
+						desc);
+			free(desc);
+		}
+
+		if (!gl_shader_build(shader, conf))
+			goto error_link;
+
+		gl_shader_cache_store(gr->shader_cache, requirements,
+				      conf, shader->program);
+	}
+
 	shader->proj_uniform = glGetUniformLocation(shader->program, "proj");
 	shader->tex_uniforms[0] = glGetUniformLocation(shader->program, "tex");
 	shader->tex_uniforms[1] = glGetUniformLocation(shader->program, "tex1");
@@ -333,12 +363,8 @@ gl_shader_create(struct gl_renderer *gr,
 
 error_link:
 	glDeleteProgram(shader->program);
-	glDeleteShader(shader->fragment_shader);
-
-error_fragment:
-	glDeleteShader(shader->vertex_shader);
 
-error_vertex:
+error:
 	free(conf);
 	free(shader);
 	return NULL;
@@ -480,6 +506,48 @@ gl_renderer_get_program(struct gl_renderer *gr,
 	return NULL;
 }
 
+static void
+prewarm_program(const struct gl_shader_requirements *req, void *data)
+{
+	struct gl_renderer *gr = data;
+	struct gl_shader *shader;
+
+	/* Only load what this build could have stored */
+	if (req->pad_bits_ != 0 || req->green_tint)
+		return;
+
+	/* Kept from garbage collection until it is first used, however
+	 * long that takes. */
+	shader = gl_renderer_get_program(gr, req);
+	if (shader)
+		shader->prewarmed = true;
+}
+
+/** Enable the on-disk program cache, if configured
+ *
+ * With weston_compositor::shader_cache_prewarm set, every program found in
+ * the cache is linked right away, so that neither the first frame nor the
+ * first use of a color profile or buffer format has to wait for the shader
+ * compiler.
+ */
+void
+gl_renderer_shader_cache_init(struct gl_renderer *gr, const char *extensions)
+{
+	struct weston_compositor *ec = gr->compositor;
+
+	if (!ec->shader_cache_dir)
+		return;
+
+	gr->shader_cache = gl_shader_cache_create(ec->shader_cache_dir,
+						  extensions, gr->gl_version,
+						  vertex_shader,
+						  fragment_shader);
+
+	if (ec->shader_cache_prewarm)
+		gl_shader_cache_for_each(gr->shader_cache,
+					 prewarm_program, gr);
+}
+
 void
 gl_renderer_garbage_collect_programs(struct gl_renderer *gr)
 {
@@ -487,6 +555,10 @@ gl_renderer_garbage_collect_programs(struct gl_renderer *gr)
 	unsigned count = 0;
 
 	wl_list_for_each_safe(shader, tmp, &gr->shader_list, link) {
+		/* Keep what was loaded ahead of time until it is used. */
+		if (shader->prewarmed)
+			continue;
+
 		/* Keep the 10 most recently used always. */
 		if (count++ < 10)
 			continue;
@@ -651,6 +723,7 @@ gl_renderer_use_program(struct gl_renderer *gr,
 		wl_list_insert(&gr->shader_list, &shader->link);
 	}
 	shader->last_used = gr->compositor->last_repaint_start;
+	shader->prewarmed = false;
 
 	if (gr->current_shader != shader) {
 		glUseProgram(shader->program);
@@ -44,6 +44,10 @@
 
 #include "wcap/wcap-decode.h"
 
+#ifdef BUILD_VAAPI_RECORDER
+#include "vaapi-recorder.h"
+#endif
+
 struct screenshooter_frame_listener {
 	struct wl_listener frame_listener;
 	struct wl_listener buffer_destroy_listener;
@@ -515,3 +519,285 @@ weston_recorder_stop(struct weston_recorder *recorder)
 	recorder->destroying = 1;
 	weston_output_schedule_repaint(recorder->output);
 }
+
+#ifdef BUILD_VAAPI_RECORDER
+struct weston_h264_recorder {
+	/* NULL once the recording has ended without being stopped */
+	struct weston_output *output;
+	const struct vaapi_recorder_interface *encoder;
+	struct vaapi_recorder *vaapi;
+	/* The output contents top-down, only damaged areas are read back */
+	uint32_t *frame, *rect;
+	int width, height;
+	uint32_t format;
+	struct wl_listener frame_listener;
+	struct wl_listener output_destroy_listener;
+	struct wl_event_source *repaint_idle;
+	/* The last frame was dropped, so an undamaged one is not a repeat */
+	bool need_frame;
+	bool failed;
+	int count, repeats, dropped, destroying;
+};
+
+/* Finishes the recording. The recorder itself stays around until its owner
+ * stops it. */
+static void
+weston_h264_recorder_end(struct weston_h264_recorder *recorder)
+{
+	wl_list_remove(&recorder->frame_listener.link);
+	wl_list_remove(&recorder->output_destroy_listener.link);
+	if (recorder->repaint_idle)
+		wl_event_source_remove(recorder->repaint_idle);
+	recorder->repaint_idle = NULL;
+	recorder->encoder->destroy(recorder->vaapi);
+	recorder->vaapi = NULL;
+	weston_output_disable_planes_decr(recorder->output);
+	recorder->output = NULL;
+
+	weston_log("H.264 recorder done, %d frames, %d repeated, %d dropped\n",
+		   recorder->count, recorder->repeats, recorder->dropped);
+
+	free(recorder->rect);
+	free(recorder->frame);
+	recorder->rect = NULL;
+	recorder->frame = NULL;
+}
+
+static void
+weston_h264_recorder_destroy(struct weston_h264_recorder *recorder)
+{
+	if (recorder->output)
+		weston_h264_recorder_end(recorder);
+	free(recorder);
+}
+
+/* The frame buffers and the encoder are sized for the mode the recording
+ * started with, so it ends when the output goes away or changes mode. */
+static void
+weston_h264_recorder_abort(struct weston_h264_recorder *recorder,
+			   const char *reason)
+{
+	weston_log("H.264 recorder on output %s stopped: %s\n",
+		   recorder->output->name, reason);
+
+	if (recorder->destroying)
+		weston_h264_recorder_destroy(recorder);
+	else
+		weston_h264_recorder_end(recorder);
+}
+
+static void
+weston_h264_recorder_output_destroy(struct wl_listener *listener, void *data)
+{
+	struct weston_h264_recorder *recorder =
+		container_of(listener, struct weston_h264_recorder,
+			     output_destroy_listener);
+
+	weston_h264_recorder_abort(recorder, "output removed");
+}
+
+/* Repaint every frame period while recording, so that the stream keeps
+ * the output timing even when nothing changes */
+static void
+weston_h264_recorder_repaint_idle(void *data)
+{
+	struct weston_h264_recorder *recorder = data;
+
+	recorder->repaint_idle = NULL;
+	weston_output_schedule_repaint(recorder->output);
+}
+
+static void
+weston_h264_recorder_frame_notify(struct wl_listener *listener, void *data)
+{
+	struct weston_h264_recorder *recorder =
+		container_of(listener, struct weston_h264_recorder,
+			     frame_listener);
+	struct weston_output *output = recorder->output;
+	struct weston_compositor *compositor = output->compositor;
+	struct wl_event_loop *loop;
+	pixman_region32_t damage, transformed_damage;
+	pixman_box32_t *r;
+	int i, j, n, width, height, stride, y_orig, ret;
+	uint32_t *s, *d;
+	int do_yflip;
+
+	if (output->current_mode->width != recorder->width ||
+	    output->current_mode->height != recorder->height) {
+		weston_h264_recorder_abort(recorder, "output mode changed");
+		return;
+	}
+
+	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	stride = recorder->width;
+
+	pixman_region32_init(&damage);
+	pixman_region32_init(&transformed_damage);
+	pixman_region32_intersect(&damage, &output->region, data);
+	weston_region_global_to_output(&transformed_damage,
+				       output,
+				       &damage);
+	pixman_region32_fini(&damage);
+
+	r = pixman_region32_rectangles(&transformed_damage, &n);
+	if (recorder->failed)
+		goto out;
+
+	if (n == 0 && !recorder->need_frame) {
+		recorder->encoder->repeat_frame(recorder->vaapi);
+		recorder->repeats++;
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		width = r[i].x2 - r[i].x1;
+		height = r[i].y2 - r[i].y1;
+
+		if (do_yflip)
+			y_orig = recorder->height - r[i].y2;
+		else
+			y_orig = r[i].y1;
+
+		compositor->renderer->read_pixels(output,
+				compositor->read_format, recorder->rect,
+				r[i].x1, y_orig, width, height);
+
+		for (j = 0; j < height; j++) {
+			if (do_yflip)
+				s = recorder->rect + width * (height - j - 1);
+			else
+				s = recorder->rect + width * j;
+			d = recorder->frame + stride * (r[i].y1 + j) + r[i].x1;
+			memcpy(d, s, width * 4);
+		}
+	}
+
+	ret = recorder->encoder->frame_pixels(recorder->vaapi, recorder->frame,
+					      recorder->format);
+	if (ret < 0) {
+		/* Destroyed once the owner stops it */
+		weston_log("H.264 recorder aborted: %s\n", strerror(errno));
+		recorder->failed = true;
+		goto out;
+	}
+
+	recorder->need_frame = (ret > 0);
+	if (ret > 0)
+		recorder->dropped++;
+	else
+		recorder->count++;
+
+out:
+	pixman_region32_fini(&transformed_damage);
+
+	if (recorder->destroying) {
+		weston_h264_recorder_destroy(recorder);
+		return;
+	}
+
+	if (!recorder->failed && !recorder->repaint_idle) {
+		loop = wl_display_get_event_loop(compositor->wl_display);
+		recorder->repaint_idle =
+			wl_event_loop_add_idle(loop,
+					       weston_h264_recorder_repaint_idle,
+					       recorder);
+	}
+}
+
+WL_EXPORT struct weston_h264_recorder *
+weston_h264_recorder_start(struct weston_output *output, const char *filename)
+{
+	struct weston_compositor *compositor = output->compositor;
+	const struct vaapi_recorder_interface *encoder;
+	struct weston_h264_recorder *recorder;
+	struct wl_listener *listener;
+	int width, height;
+	size_t size;
+
+	listener = wl_signal_get(&output->frame_signal,
+				 weston_h264_recorder_frame_notify);
+	if (listener) {
+		weston_log("an H.264 recorder on output %s is already running\n",
+			   output->name);
+		return NULL;
+	}
+
+	encoder = weston_load_module("vaapi-recorder.so",
+				     "vaapi_recorder_interface",
+				     LIBWESTON_MODULEDIR);
+	if (!encoder)
+		return NULL;
+
+	recorder = zalloc(sizeof *recorder);
+	if (recorder == NULL) {
+		weston_log("%s: out of memory\n", __func__);
+		return NULL;
+	}
+
+	width = output->current_mode->width;
+	height = output->current_mode->height;
+	size = (size_t) width * height * 4;
+	recorder->output = output;
+	recorder->encoder = encoder;
+	recorder->width = width;
+	recorder->height = height;
+	recorder->format = compositor->read_format->format;
+	recorder->frame = zalloc(size);
+	recorder->rect = malloc(size);
+	if (recorder->frame == NULL || recorder->rect == NULL) {
+		weston_log("%s: out of memory\n", __func__);
+		goto err_recorder;
+	}
+
+	recorder->vaapi = encoder->create(-1, width, height, filename, true);
+	if (recorder->vaapi == NULL) {
+		weston_log("failed to create H.264 recorder\n");
+		goto err_recorder;
+	}
+
+	weston_log("starting H.264 recorder for output %s, file %s\n",
+		   output->name, filename);
+
+	recorder->need_frame = true;
+	recorder->frame_listener.notify = weston_h264_recorder_frame_notify;
+	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
+	recorder->output_destroy_listener.notify =
+		weston_h264_recorder_output_destroy;
+	wl_signal_add(&output->destroy_signal,
+		      &recorder->output_destroy_listener);
+	weston_output_disable_planes_incr(output);
+	weston_output_damage(output);
+
+	return recorder;
+
+err_recorder:
+	free(recorder->rect);
+	free(recorder->frame);
+	free(recorder);
+	return NULL;
+}
+
+WL_EXPORT void
+weston_h264_recorder_stop(struct weston_h264_recorder *recorder)
+{
+	if (!recorder->output) {
+		weston_h264_recorder_destroy(recorder);
+		return;
+	}
+
+	recorder->destroying = 1;
+	weston_output_schedule_repaint(recorder->output);
+}
+#else
+WL_EXPORT struct weston_h264_recorder *
+weston_h264_recorder_start(struct weston_output *output, const char *filename)
+{
+	weston_log("Compiled without VA-API or x264 support\n");
+	return NULL;
+}
+
+WL_EXPORT void
+weston_h264_recorder_stop(struct weston_h264_recorder *recorder)
+{
+}
+#endif
@@ -36,6 +36,8 @@
 #include <libweston/weston-log.h>
 #include "timeline.h"
 #include "weston-log-internal.h"
+#include "shared/hash.h"
+#include "shared/timespec-util.h"
 
 /**
  * Timeline itself is not a subscriber but a scope (a producer of data), and it
@@ -95,6 +97,18 @@ weston_timeline_create_subscription(struct weston_log_subscription *sub,
 	weston_log_subscription_set_data(sub, tl_sub);
 }
 
+static void
+weston_timeline_name_free(void *element, void *data)
+{
+	struct weston_timeline_name *tl_name = element;
+	struct weston_timeline_name *next;
+
+	for (; tl_name; tl_name = next) {
+		next = tl_name->next;
+		free(tl_name);
+	}
+}
+
 static void
 weston_timeline_destroy_subscription_object(struct weston_timeline_subscription_object *sub_obj)
 {
@@ -128,6 +142,11 @@ weston_timeline_destroy_subscription(struct weston_log_subscription *sub,
 			      &tl_sub->objects, subscription_link)
 		weston_timeline_destroy_subscription_object(sub_obj);
 
+	if (tl_sub->names) {
+		hash_table_for_each(tl_sub->names,
+				    weston_timeline_name_free, NULL);
+		hash_table_destroy(tl_sub->names);
+	}
 	free(tl_sub);
 }
 
@@ -381,6 +400,160 @@ weston_timeline_refresh_subscription_objects(struct weston_compositor *wc,
 	}
 }
 
+/* Write a record followed by a string padded to a multiple of 8 bytes */
+static void
+write_record_with_string(struct weston_log_subscription *sub,
+			 struct weston_timeline_record *rec, const char *str)
+{
+	char buf[sizeof(*rec) + 256] = { 0 };
+	size_t len = str ? strnlen(str, 255) : 0;
+
+	rec->len = (len + 1 + 7) & ~7u;
+	memcpy(buf, rec, sizeof(*rec));
+	if (len)
+		memcpy(buf + sizeof(*rec), str, len);
+
+	weston_log_subscription_write_record(sub, buf, sizeof(*rec) + rec->len);
+}
+
+static uint32_t
+name_hash(const char *name)
+{
+	uintptr_t addr = (uintptr_t)name;
+
+	return (uint32_t)(addr ^ ((uint64_t)addr >> 32));
+}
+
+/* Return the id of a point name, defining it on first use */
+static uint32_t
+record_name_id(struct weston_log_subscription *sub,
+	       struct weston_timeline_subscription *tl_sub, const char *name)
+{
+	struct weston_timeline_record rec = { .type = WTR_NAME };
+	struct weston_timeline_name *head, *tl_name;
+	uint32_t hash = name_hash(name);
+
+	if (!tl_sub->names) {
+		tl_sub->names = hash_table_create();
+		if (!tl_sub->names)
+			return 0;
+	}
+
+	/* Point names are string literals, compare them by address. */
+	head = hash_table_lookup(tl_sub->names, hash);
+	for (tl_name = head; tl_name; tl_name = tl_name->next) {
+		if (tl_name->name == name)
+			return tl_name->id;
+	}
+
+	tl_name = zalloc(sizeof *tl_name);
+	if (!tl_name)
+		return 0;
+
+	tl_name->name = name;
+	tl_name->id = ++tl_sub->name_count;
+	if (head) {
+		tl_name->next = head->next;
+		head->next = tl_name;
+	} else if (hash_table_insert(tl_sub->names, hash, tl_name) < 0) {
+		tl_sub->name_count--;
+		free(tl_name);
+		return 0;
+	}
+
+	rec.id = tl_name->id;
+	write_record_with_string(sub, &rec, name);
+
+	return tl_name->id;
+}
+
+static uint32_t
+record_output(struct weston_log_subscription *sub,
+	      struct weston_timeline_subscription *tl_sub,
+	      struct weston_output *output)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+	struct weston_timeline_record rec = { .type = WTR_OUTPUT };
+
+	sub_obj = weston_timeline_subscription_output_ensure(tl_sub, output);
+	if (weston_timeline_check_object_refresh(sub_obj)) {
+		rec.id = sub_obj->id;
+		write_record_with_string(sub, &rec, output->name);
+	}
+
+	return sub_obj->id;
+}
+
+static uint32_t
+record_surface(struct weston_log_subscription *sub,
+	       struct weston_timeline_subscription *tl_sub,
+	       struct weston_surface *surface)
+{
+	struct weston_timeline_subscription_object *sub_obj;
+	struct weston_timeline_record rec = { .type = WTR_SURFACE };
+	struct weston_surface *mains;
+	char d[256];
+
+	sub_obj = weston_timeline_subscription_surface_ensure(tl_sub, surface);
+	if (!weston_timeline_check_object_refresh(sub_obj))
+		return sub_obj->id;
+
+	mains = weston_surface_get_main_surface(surface);
+	if (mains != surface)
+		rec.output = record_surface(sub, tl_sub, mains);
+
+	if (!surface->get_label ||
+	    surface->get_label(surface, d, sizeof(d)) < 0)
+		d[0] = '\0';
+
+	rec.id = sub_obj->id;
+	write_record_with_string(sub, &rec, d);
+
+	return sub_obj->id;
+}
+
+/* The binary counterpart of the JSON in weston_timeline_point() */
+static void
+weston_timeline_point_record(struct weston_log_subscription *sub,
+			     const struct timespec *ts, const char *name,
+			     va_list argp)
+{
+	struct weston_timeline_subscription *tl_sub;
+	struct weston_timeline_record rec = { .type = WTR_POINT };
+	enum timeline_type otype;
+	void *obj;
+
+	tl_sub = weston_log_subscription_get_data(sub);
+	if (!tl_sub)
+		return;
+
+	rec.id = record_name_id(sub, tl_sub, name);
+	rec.time_ns = timespec_to_nsec(ts);
+
+	while ((otype = va_arg(argp, enum timeline_type)) != TLT_END) {
+		obj = va_arg(argp, void *);
+
+		switch (otype) {
+		case TLT_OUTPUT:
+			rec.output = record_output(sub, tl_sub, obj);
+			break;
+		case TLT_SURFACE:
+			rec.surface = record_surface(sub, tl_sub, obj);
+			break;
+		case TLT_VBLANK:
+			rec.vblank_ns = timespec_to_nsec(obj);
+			break;
+		case TLT_GPU:
+			rec.gpu_ns = timespec_to_nsec(obj);
+			break;
+		case TLT_END:
+			break;
+		}
+	}
+
+	weston_log_subscription_write_record(sub, &rec, sizeof rec);
+}
+
 typedef int (*type_func)(struct timeline_emit_context *ctx, void *obj);
 
 static const type_func type_dispatch[] = {
@@ -421,6 +594,13 @@ weston_timeline_point(struct weston_log_scope *timeline_scope,
 		va_list argp;
 		struct timeline_emit_context ctx = {};
 
+		if (weston_log_subscription_takes_records(sub)) {
+			va_start(argp, name);
+			weston_timeline_point_record(sub, &ts, name, argp);
+			va_end(argp);
+			continue;
+		}
+
 		memset(buf, 0, sizeof(buf));
 		ctx.cur = fmemopen(buf, sizeof(buf), "w");
 		ctx.subscription = sub;
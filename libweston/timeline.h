@@ -29,6 +29,7 @@
 
 #include <wayland-util.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <libweston/weston-log.h>
 #include <wayland-server-core.h>
@@ -53,6 +54,56 @@ enum timeline_type {
 struct weston_timeline_subscription {
 	unsigned int next_id;
 	struct wl_list objects; /**< weston_timeline_subscription_object::subscription_link */
+	struct hash_table *names; /**< weston_timeline_name by name address */
+	uint32_t name_count;
+};
+
+/** A point name interned for a binary timeline trace
+ *
+ * @ingroup internal-log
+ */
+struct weston_timeline_name {
+	const char *name;	/**< a string literal, compared by address */
+	uint32_t id;
+	struct weston_timeline_name *next; /**< same hash */
+};
+
+/** Binary timeline trace
+ *
+ * Subscribers created by weston_log_subscriber_create_timeline_trace()
+ * receive timeline points as fixed-size records instead of JSON text. The
+ * stream starts with WESTON_TIMELINE_TRACE_MAGIC, followed by records in
+ * host byte order. Point names and object descriptions are sent once, in
+ * definition records, and referred to by id afterwards.
+ *
+ * tools/timeline-trace-to-json.py converts a trace to the Chrome trace
+ * event format understood by Perfetto.
+ *
+ * @ingroup internal-log
+ */
+#define WESTON_TIMELINE_TRACE_MAGIC "WTLTRC01"
+
+enum weston_timeline_record_type {
+	/** A timeline point, id is the name */
+	WTR_POINT = 1,
+	/** Defines point name id, the name follows */
+	WTR_NAME,
+	/** Defines output id, the output name follows */
+	WTR_OUTPUT,
+	/** Defines surface id, output is the main surface id or 0, the
+	 * surface label follows */
+	WTR_SURFACE,
+};
+
+struct weston_timeline_record {
+	uint16_t type;		/**< enum weston_timeline_record_type */
+	uint16_t len;		/**< bytes following, a multiple of 8 */
+	uint32_t id;
+	uint64_t time_ns;	/**< CLOCK_MONOTONIC */
+	uint32_t output;	/**< output id, 0 for none */
+	uint32_t surface;	/**< surface id, 0 for none */
+	uint64_t vblank_ns;	/**< TLP_VBLANK, 0 for none */
+	uint64_t gpu_ns;	/**< TLP_GPU, 0 for none */
 };
 
 /**
@@ -26,6 +26,8 @@
 
 #include "config.h"
 
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -39,14 +41,21 @@
 
 #include <pthread.h>
 
+#ifdef HAVE_LIBVA
 #include <va/va.h>
 #include <va/va_drm.h>
 #include <va/va_drmcommon.h>
 #include <va/va_enc_h264.h>
 #include <va/va_vpp.h>
+#endif
+
+#ifdef HAVE_X264
+#include <x264.h>
+#endif
 
 #include <libweston/libweston.h>
 #include "vaapi-recorder.h"
+#include "shared/weston-drm-fourcc.h"
 
 #define NAL_REF_IDC_NONE        0
 #define NAL_REF_IDC_LOW         1
@@ -70,6 +79,28 @@
 #define PROFILE_IDC_MAIN        77
 #define PROFILE_IDC_HIGH        100
 
+/* Frames queued for the worker thread, the compositor never waits for
+ * the encoder unless all of them are taken */
+#define RECORDER_QUEUE_LENGTH 3
+
+enum recorder_input_type {
+	RECORDER_INPUT_DMABUF,
+	RECORDER_INPUT_PIXELS,
+};
+
+struct recorder_input {
+	enum recorder_input_type type;
+	/* Frames the one before this was shown for in addition */
+	int repeats_before;
+
+	/* RECORDER_INPUT_DMABUF, the fd is owned by the queue */
+	int prime_fd, stride;
+
+	/* RECORDER_INPUT_PIXELS, width * height, stride width * 4 */
+	uint32_t *pixels;
+	uint32_t format;
+};
+
 struct vaapi_recorder {
 	int drm_fd, output_fd;
 	int width, height;
@@ -81,11 +112,17 @@ struct vaapi_recorder {
 	pthread_mutex_t mutex;
 	pthread_cond_t input_cond;
 
-	struct {
-		int valid;
-		int prime_fd, stride;
-	} input;
+	/* Protected by the mutex. The worker pops an input only once it is
+	 * done reading it, so the slot is not reused under its feet. */
+	struct recorder_input queue[RECORDER_QUEUE_LENGTH];
+	int queue_head, queue_count;
+	int pending_repeats;
+
+	/* Worker only, copied to error under the mutex after each frame */
+	int encode_error;
 
+#ifdef HAVE_LIBVA
+	/* NULL when encoding in software */
 	VADisplay va_dpy;
 
 	/* video post processing is used for colorspace conversion */
@@ -93,7 +130,12 @@ struct vaapi_recorder {
 		VAConfigID cfg;
 		VAContextID ctx;
 		VABufferID pipeline_buf;
-		VASurfaceID output;
+		/* One per queue slot, so converting a frame does not wait
+		 * for the previous one to be encoded */
+		VASurfaceID output[RECORDER_QUEUE_LENGTH];
+		/* RGB upload targets for RECORDER_INPUT_PIXELS */
+		VASurfaceID upload[RECORDER_QUEUE_LENGTH];
+		uint32_t upload_format;
 	} vpp;
 
 	struct {
@@ -110,12 +152,41 @@ struct vaapi_recorder {
 			VAEncPictureParameterBufferH264 pic;
 			VAEncSliceParameterBufferH264 slice;
 		} param;
+
+		/* The frame submitted to the hardware and not written out */
+		struct {
+			bool active;
+			VASurfaceID input;
+			int frame;
+			VABufferID buffers[8];
+			int count;
+			VABufferID output_buf;
+		} pending;
 	} encoder;
+#endif
+
+#ifdef HAVE_X264
+	struct {
+		x264_t *enc;
+		x264_picture_t pic;
+	} sw;
+#endif
 };
 
 static void *
 worker_thread_function(void *);
 
+static bool
+recorder_is_hardware(struct vaapi_recorder *r)
+{
+#ifdef HAVE_LIBVA
+	return r->va_dpy != NULL;
+#else
+	return false;
+#endif
+}
+
+#ifdef HAVE_LIBVA
 /* bitstream code used for writing the packed headers */
 
 #define BITSTREAM_ALLOCATE_STEPPING	 4096
@@ -340,26 +411,26 @@ encoder_init_pic_parameters(struct vaapi_recorder *r)
 
 static VABufferID
 encoder_update_pic_parameters(struct vaapi_recorder *r,
-			      VABufferID output_buf)
+			      VABufferID output_buf, int frame)
 {
 	VAEncPictureParameterBufferH264 *pic = &r->encoder.param.pic;
 	VAStatus status;
 	VABufferID pic_param_buf;
 	VASurfaceID curr_pic, pic0;
 
-	curr_pic = r->encoder.reference_picture[r->frame_count % 2];
-	pic0 = r->encoder.reference_picture[(r->frame_count + 1) % 2];
+	curr_pic = r->encoder.reference_picture[frame % 2];
+	pic0 = r->encoder.reference_picture[(frame + 1) % 2];
 
 	pic->CurrPic.picture_id = curr_pic;
-	pic->CurrPic.TopFieldOrderCnt = r->frame_count * 2;
+	pic->CurrPic.TopFieldOrderCnt = frame * 2;
 	pic->ReferenceFrames[0].picture_id = pic0;
 	pic->ReferenceFrames[1].picture_id = r->encoder.reference_picture[2];
 	pic->ReferenceFrames[2].picture_id = VA_INVALID_ID;
 
 	pic->coded_buf = output_buf;
-	pic->frame_num = r->frame_count;
+	pic->frame_num = frame;
 
-	pic->pic_fields.bits.idr_pic_flag = (r->frame_count == 0);
+	pic->pic_fields.bits.idr_pic_flag = (frame == 0);
 	pic->pic_fields.bits.reference_pic_flag = 1;
 
 	status = vaCreateBuffer(r->va_dpy, r->encoder.ctx,
@@ -722,11 +793,7 @@ encoder_render_picture(struct vaapi_recorder *r, VASurfaceID input,
 	if (status != VA_STATUS_SUCCESS)
 		return status;
 
-	status = vaEndPicture(r->va_dpy, r->encoder.ctx);
-	if (status != VA_STATUS_SUCCESS)
-		return status;
-
-	return vaSyncSurface(r->va_dpy, input);
+	return vaEndPicture(r->va_dpy, r->encoder.ctx);
 }
 
 static VABufferID
@@ -778,16 +845,37 @@ encoder_write_output(struct vaapi_recorder *r, VABufferID output_buf)
 }
 
 static void
-encoder_encode(struct vaapi_recorder *r, VASurfaceID input)
+encoder_release_pending(struct vaapi_recorder *r)
 {
-	VABufferID output_buf = VA_INVALID_ID;
+	int i;
 
-	VABufferID buffers[8];
-	int count = 0;
-	int i, slice_type;
-	enum output_write_status ret;
+	for (i = 0; i < r->encoder.pending.count; i++)
+		vaDestroyBuffer(r->va_dpy, r->encoder.pending.buffers[i]);
+	if (r->encoder.pending.output_buf != VA_INVALID_ID)
+		vaDestroyBuffer(r->va_dpy, r->encoder.pending.output_buf);
+
+	r->encoder.pending.count = 0;
+	r->encoder.pending.output_buf = VA_INVALID_ID;
+	r->encoder.pending.active = false;
+}
+
+/* Submits the frame to the hardware without waiting for it, so that the
+ * next frame can be converted while this one is being encoded. */
+static int
+encoder_begin_frame(struct vaapi_recorder *r, VASurfaceID input, int frame)
+{
+	VABufferID *buffers = r->encoder.pending.buffers;
+	VABufferID pic_buf;
+	int i, count = 0;
+	int slice_type;
+
+	assert(!r->encoder.pending.active);
+
+	r->encoder.pending.input = input;
+	r->encoder.pending.frame = frame;
+	r->encoder.pending.output_buf = VA_INVALID_ID;
 
-	if ((r->frame_count % r->encoder.intra_period) == 0)
+	if ((frame % r->encoder.intra_period) == 0)
 		slice_type = SLICE_TYPE_I;
 	else
 		slice_type = SLICE_TYPE_P;
@@ -795,49 +883,68 @@ encoder_encode(struct vaapi_recorder *r, VASurfaceID input)
 	buffers[count++] = encoder_update_seq_parameters(r);
 	buffers[count++] = encoder_update_misc_hdr_parameter(r);
 	buffers[count++] = encoder_update_slice_parameter(r, slice_type);
+	r->encoder.pending.count = count;
 
 	for (i = 0; i < count; i++)
 		if (buffers[i] == VA_INVALID_ID)
 			goto bail;
 
-	if (r->frame_count == 0)
+	if (frame == 0)
 		count += encoder_prepare_headers(r, buffers + count);
+	r->encoder.pending.count = count;
 
-	do {
-		output_buf = encoder_create_output_buffer(r);
-		if (output_buf == VA_INVALID_ID)
-			goto bail;
+	r->encoder.pending.output_buf = encoder_create_output_buffer(r);
+	if (r->encoder.pending.output_buf == VA_INVALID_ID)
+		goto bail;
 
-		buffers[count++] =
-			encoder_update_pic_parameters(r, output_buf);
-		if (buffers[count - 1] == VA_INVALID_ID)
-			goto bail;
+	pic_buf = encoder_update_pic_parameters(r,
+						r->encoder.pending.output_buf,
+						frame);
+	if (pic_buf == VA_INVALID_ID)
+		goto bail;
+	buffers[count++] = pic_buf;
+	r->encoder.pending.count = count;
 
-		encoder_render_picture(r, input, buffers, count);
-		ret = encoder_write_output(r, output_buf);
+	if (encoder_render_picture(r, input, buffers, count) !=
+	    VA_STATUS_SUCCESS)
+		goto bail;
 
-		vaDestroyBuffer(r->va_dpy, output_buf);
-		output_buf = VA_INVALID_ID;
+	r->encoder.pending.active = true;
+	return 0;
 
-		vaDestroyBuffer(r->va_dpy, buffers[--count]);
-	} while (ret == OUTPUT_WRITE_OVERFLOW);
+bail:
+	encoder_release_pending(r);
+	return -1;
+}
 
-	if (ret == OUTPUT_WRITE_FATAL)
-		r->error = errno;
+/* Waits for the frame submitted by encoder_begin_frame() and writes it to
+ * the output file. */
+static void
+encoder_end_frame(struct vaapi_recorder *r)
+{
+	enum output_write_status ret;
+	VASurfaceID input;
+	int frame;
 
-	for (i = 0; i < count; i++)
-		vaDestroyBuffer(r->va_dpy, buffers[i]);
+	if (!r->encoder.pending.active)
+		return;
 
-	r->frame_count++;
-	return;
+	input = r->encoder.pending.input;
+	frame = r->encoder.pending.frame;
 
-bail:
-	for (i = 0; i < count; i++)
-		vaDestroyBuffer(r->va_dpy, buffers[i]);
-	if (output_buf != VA_INVALID_ID)
-		vaDestroyBuffer(r->va_dpy, output_buf);
-}
+	vaSyncSurface(r->va_dpy, input);
+	ret = encoder_write_output(r, r->encoder.pending.output_buf);
+	if (ret == OUTPUT_WRITE_FATAL)
+		r->encode_error = errno;
 
+	encoder_release_pending(r);
+
+	/* The output buffer has grown, encode the same frame again. The
+	 * input surface is not reused before this returns. */
+	if (ret == OUTPUT_WRITE_OVERFLOW &&
+	    encoder_begin_frame(r, input, frame) == 0)
+		encoder_end_frame(r);
+}
 
 static int
 setup_vpp(struct vaapi_recorder *r)
@@ -869,10 +976,10 @@ setup_vpp(struct vaapi_recorder *r)
 	}
 
 	status = vaCreateSurfaces(r->va_dpy, VA_RT_FORMAT_YUV420,
-				  r->width, r->height, &r->vpp.output, 1,
-				  NULL, 0);
+				  r->width, r->height, r->vpp.output,
+				  RECORDER_QUEUE_LENGTH, NULL, 0);
 	if (status != VA_STATUS_SUCCESS) {
-		weston_log("vaapi: failed to create YUV surface\n");
+		weston_log("vaapi: failed to create YUV surfaces\n");
 		goto err_buf;
 	}
 
@@ -891,12 +998,344 @@ err_cfg:
 static void
 vpp_destroy(struct vaapi_recorder *r)
 {
-	vaDestroySurfaces(r->va_dpy, &r->vpp.output, 1);
+	if (r->vpp.upload_format)
+		vaDestroySurfaces(r->va_dpy, r->vpp.upload,
+				  RECORDER_QUEUE_LENGTH);
+	vaDestroySurfaces(r->va_dpy, r->vpp.output, RECORDER_QUEUE_LENGTH);
 	vaDestroyBuffer(r->va_dpy, r->vpp.pipeline_buf);
 	vaDestroyConfig(r->va_dpy, r->vpp.ctx);
 	vaDestroyConfig(r->va_dpy, r->vpp.cfg);
 }
 
+static unsigned int
+va_fourcc_from_drm_format(uint32_t format)
+{
+	switch (format) {
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ARGB8888:
+		return VA_FOURCC_BGRX;
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_ABGR8888:
+		return VA_FOURCC_RGBX;
+	default:
+		return 0;
+	}
+}
+
+static int
+vpp_setup_upload(struct vaapi_recorder *r, uint32_t format)
+{
+	VASurfaceAttrib attrib;
+	VAStatus status;
+
+	if (r->vpp.upload_format == format)
+		return 0;
+
+	if (r->vpp.upload_format)
+		vaDestroySurfaces(r->va_dpy, r->vpp.upload,
+				  RECORDER_QUEUE_LENGTH);
+	r->vpp.upload_format = 0;
+
+	attrib.type = VASurfaceAttribPixelFormat;
+	attrib.flags = VA_SURFACE_ATTRIB_SETTABLE;
+	attrib.value.type = VAGenericValueTypeInteger;
+	attrib.value.value.i = va_fourcc_from_drm_format(format);
+
+	status = vaCreateSurfaces(r->va_dpy, VA_RT_FORMAT_RGB32,
+				  r->width, r->height, r->vpp.upload,
+				  RECORDER_QUEUE_LENGTH, &attrib, 1);
+	if (status != VA_STATUS_SUCCESS)
+		return -1;
+
+	r->vpp.upload_format = format;
+
+	return 0;
+}
+
+static VAStatus
+upload_pixels(struct vaapi_recorder *r, VASurfaceID surface,
+	      const uint32_t *pixels)
+{
+	VAImage image;
+	VAStatus status;
+	uint8_t *data;
+	int y;
+
+	status = vaDeriveImage(r->va_dpy, surface, &image);
+	if (status != VA_STATUS_SUCCESS)
+		return status;
+
+	status = vaMapBuffer(r->va_dpy, image.buf, (void **) &data);
+	if (status == VA_STATUS_SUCCESS) {
+		for (y = 0; y < r->height; y++)
+			memcpy(data + image.offsets[0] + y * image.pitches[0],
+			       pixels + y * r->width, r->width * 4);
+		vaUnmapBuffer(r->va_dpy, image.buf);
+	}
+
+	vaDestroyImage(r->va_dpy, image.image_id);
+
+	return status;
+}
+
+static int
+setup_hardware(struct vaapi_recorder *r)
+{
+	VAStatus status;
+	int major, minor;
+
+	r->va_dpy = vaGetDisplayDRM(r->drm_fd);
+	if (!r->va_dpy) {
+		weston_log("failed to create VA display\n");
+		return -1;
+	}
+
+	status = vaInitialize(r->va_dpy, &major, &minor);
+	if (status != VA_STATUS_SUCCESS) {
+		weston_log("vaapi: failed to initialize display\n");
+		goto err_va_dpy;
+	}
+
+	if (setup_vpp(r) < 0) {
+		weston_log("vaapi: failed to initialize VPP pipeline\n");
+		goto err_va_dpy;
+	}
+
+	if (setup_encoder(r) < 0)
+		goto err_vpp;
+
+	r->encoder.pending.output_buf = VA_INVALID_ID;
+
+	return 0;
+
+err_vpp:
+	vpp_destroy(r);
+err_va_dpy:
+	vaTerminate(r->va_dpy);
+	r->va_dpy = NULL;
+
+	return -1;
+}
+
+static int
+open_render_node(void)
+{
+	char path[64];
+	int i, fd;
+
+	for (i = 128; i < 192; i++) {
+		snprintf(path, sizeof path, "/dev/dri/renderD%d", i);
+		fd = open(path, O_RDWR | O_CLOEXEC);
+		if (fd >= 0)
+			return fd;
+	}
+
+	return -1;
+}
+#endif
+
+/* Unregistered user data SEI payload marking how many frame periods the
+ * previous picture stays on screen in addition to its own. The encoder
+ * uses CABAC, so emitting real skipped pictures would need a full slice
+ * writer; players ignore this, tools can use it to restore the timing. */
+static const uint8_t repeat_marker_uuid[16] = {
+	'w', 'e', 's', 't', 'o', 'n', '-', 'r',
+	'e', 'p', 'e', 'a', 't', '-', 'v', '1',
+};
+
+static void
+recorder_write_repeat_marker(struct vaapi_recorder *r, int repeats)
+{
+	uint8_t nal[64];
+	char text[16];
+	int len, n = 0;
+
+	/* None of the payload bytes are zero, so the RBSP needs no
+	 * emulation prevention */
+	len = snprintf(text, sizeof text, "%d", repeats);
+
+	nal[n++] = 0x00;
+	nal[n++] = 0x00;
+	nal[n++] = 0x00;
+	nal[n++] = 0x01;
+	nal[n++] = (NAL_REF_IDC_NONE << 5) | NAL_SEI;
+	nal[n++] = 5; /* user_data_unregistered */
+	nal[n++] = sizeof repeat_marker_uuid + len;
+	memcpy(nal + n, repeat_marker_uuid, sizeof repeat_marker_uuid);
+	n += sizeof repeat_marker_uuid;
+	memcpy(nal + n, text, len);
+	n += len;
+	nal[n++] = 0x80; /* rbsp_trailing_bits */
+
+	if (write(r->output_fd, nal, n) < 0)
+		r->encode_error = errno;
+}
+
+static bool
+recorder_format_supported(uint32_t format)
+{
+	switch (format) {
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ARGB8888:
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_ABGR8888:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#ifdef HAVE_X264
+/* BT.601 limited range, matching what the VA-API post processing does */
+static void
+convert_pixels_to_i420(const uint32_t *pixels, uint32_t format,
+		       int width, int height, uint8_t **planes,
+		       const int *strides)
+{
+	int r_shift, b_shift;
+	int x, y, i, j;
+	int r, g, b;
+	uint32_t p;
+
+	if (format == DRM_FORMAT_XBGR8888 || format == DRM_FORMAT_ABGR8888) {
+		r_shift = 0;
+		b_shift = 16;
+	} else {
+		r_shift = 16;
+		b_shift = 0;
+	}
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			p = pixels[y * width + x];
+			r = (p >> r_shift) & 0xff;
+			g = (p >> 8) & 0xff;
+			b = (p >> b_shift) & 0xff;
+
+			planes[0][y * strides[0] + x] =
+				((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+		}
+	}
+
+	for (y = 0; y < height; y += 2) {
+		for (x = 0; x < width; x += 2) {
+			r = g = b = 0;
+			for (j = 0; j < 2; j++) {
+				for (i = 0; i < 2; i++) {
+					p = pixels[(y + j) * width + x + i];
+					r += (p >> r_shift) & 0xff;
+					g += (p >> 8) & 0xff;
+					b += (p >> b_shift) & 0xff;
+				}
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+
+			planes[1][y / 2 * strides[1] + x / 2] =
+				((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			planes[2][y / 2 * strides[2] + x / 2] =
+				((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+		}
+	}
+}
+
+static int
+setup_software(struct vaapi_recorder *r)
+{
+	x264_param_t param;
+
+	/* 4:2:0 chroma subsampling */
+	if (r->width % 2 || r->height % 2) {
+		weston_log("x264: frame size %dx%d is not even\n",
+			   r->width, r->height);
+		return -1;
+	}
+
+	if (x264_param_default_preset(&param, "veryfast", "zerolatency") < 0)
+		return -1;
+
+	param.i_width = r->width;
+	param.i_height = r->height;
+	param.i_csp = X264_CSP_I420;
+	param.i_fps_num = 60;
+	param.i_fps_den = 1;
+	param.i_keyint_max = 30;
+	param.b_annexb = 1;
+	param.b_repeat_headers = 1;
+	param.i_log_level = X264_LOG_WARNING;
+	param.rc.i_rc_method = X264_RC_CRF;
+	param.rc.f_rf_constant = 23;
+
+	if (x264_param_apply_profile(&param, "main") < 0)
+		return -1;
+
+	r->sw.enc = x264_encoder_open(&param);
+	if (!r->sw.enc) {
+		weston_log("x264: failed to open encoder\n");
+		return -1;
+	}
+
+	if (x264_picture_alloc(&r->sw.pic, X264_CSP_I420,
+			       r->width, r->height) < 0) {
+		x264_encoder_close(r->sw.enc);
+		r->sw.enc = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+software_write(struct vaapi_recorder *r, x264_nal_t *nals, int size)
+{
+	/* The payloads of all NALs returned by one call are contiguous */
+	if (size > 0 && write(r->output_fd, nals[0].p_payload, size) < 0)
+		r->encode_error = errno;
+}
+
+static void
+software_encode(struct vaapi_recorder *r, const uint32_t *pixels,
+		uint32_t format, int64_t pts)
+{
+	x264_picture_t out;
+	x264_nal_t *nals;
+	int count, size;
+
+	convert_pixels_to_i420(pixels, format, r->width, r->height,
+			       r->sw.pic.img.plane, r->sw.pic.img.i_stride);
+	r->sw.pic.i_pts = pts;
+
+	size = x264_encoder_encode(r->sw.enc, &nals, &count,
+				   &r->sw.pic, &out);
+	if (size < 0) {
+		r->encode_error = EIO;
+		return;
+	}
+
+	software_write(r, nals, size);
+}
+
+static void
+software_destroy(struct vaapi_recorder *r)
+{
+	x264_picture_t out;
+	x264_nal_t *nals;
+	int count, size;
+
+	while (x264_encoder_delayed_frames(r->sw.enc) > 0) {
+		size = x264_encoder_encode(r->sw.enc, &nals, &count,
+					   NULL, &out);
+		if (size < 0)
+			break;
+		software_write(r, nals, size);
+	}
+
+	x264_picture_clean(&r->sw.pic);
+	x264_encoder_close(r->sw.enc);
+}
+#endif
+
 static int
 setup_worker_thread(struct vaapi_recorder *r)
 {
@@ -912,7 +1351,8 @@ destroy_worker_thread(struct vaapi_recorder *r)
 {
 	pthread_mutex_lock(&r->mutex);
 
-	/* Make sure the worker thread finishes */
+	/* Make sure the worker thread finishes, it encodes the frames
+	 * still in the queue first */
 	r->destroying = 1;
 	pthread_cond_signal(&r->input_cond);
 
@@ -924,83 +1364,106 @@ destroy_worker_thread(struct vaapi_recorder *r)
 	pthread_cond_destroy(&r->input_cond);
 }
 
-struct vaapi_recorder *
-vaapi_recorder_create(int drm_fd, int width, int height, const char *filename)
+static struct vaapi_recorder *
+vaapi_recorder_create(int drm_fd, int width, int height, const char *filename,
+		      bool allow_software)
 {
 	struct vaapi_recorder *r;
-	VAStatus status;
-	int major, minor;
 	int flags;
 
 	r = zalloc(sizeof *r);
-	if (r == NULL)
+	if (r == NULL) {
+		if (drm_fd >= 0)
+			close(drm_fd);
 		return NULL;
+	}
 
 	r->width = width;
 	r->height = height;
 	r->drm_fd = drm_fd;
-
-	if (setup_worker_thread(r) < 0)
-		goto err_free;
+#ifdef HAVE_LIBVA
+	/* Tests ask for x264 even where a VA-API encoder is available */
+	if (r->drm_fd < 0 && !getenv("WESTON_RECORDER_FORCE_X264"))
+		r->drm_fd = open_render_node();
+#endif
 
 	flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
 	r->output_fd = open(filename, flags, 0644);
 	if (r->output_fd < 0)
-		goto err_thread;
+		goto err_free;
 
-	r->va_dpy = vaGetDisplayDRM(drm_fd);
-	if (!r->va_dpy) {
-		weston_log("failed to create VA display\n");
+#ifdef HAVE_LIBVA
+	if (r->drm_fd >= 0 && setup_hardware(r) == 0)
+		goto done;
+#endif
+
+	if (!allow_software)
 		goto err_fd;
-	}
 
-	status = vaInitialize(r->va_dpy, &major, &minor);
-	if (status != VA_STATUS_SUCCESS) {
-		weston_log("vaapi: failed to initialize display\n");
+#ifdef HAVE_X264
+	if (setup_software(r) < 0)
 		goto err_fd;
-	}
 
-	if (setup_vpp(r) < 0) {
-		weston_log("vaapi: failed to initialize VPP pipeline\n");
-		goto err_va_dpy;
-	}
+	weston_log("[libva recorder] VA-API unavailable, "
+		   "encoding with x264\n");
+	goto done;
+#else
+	weston_log("[libva recorder] VA-API unavailable, "
+		   "and built without x264\n");
+	goto err_fd;
+#endif
 
-	if (setup_encoder(r) < 0) {
-		goto err_vpp;
-	}
+done:
+	if (setup_worker_thread(r) < 0)
+		goto err_fd;
 
 	return r;
 
-err_vpp:
-	vpp_destroy(r);
-err_va_dpy:
-	vaTerminate(r->va_dpy);
 err_fd:
 	close(r->output_fd);
-err_thread:
-	destroy_worker_thread(r);
 err_free:
+	if (r->drm_fd >= 0)
+		close(r->drm_fd);
 	free(r);
 
 	return NULL;
 }
 
-void
+static void
 vaapi_recorder_destroy(struct vaapi_recorder *r)
 {
+	int i;
+
 	destroy_worker_thread(r);
 
-	encoder_destroy(r);
-	vpp_destroy(r);
+	/* Repeats after the last frame have no picture to mark, the
+	 * recording simply ends with it. */
 
-	vaTerminate(r->va_dpy);
+#ifdef HAVE_LIBVA
+	if (r->va_dpy) {
+		encoder_end_frame(r);
+		encoder_destroy(r);
+		vpp_destroy(r);
+		vaTerminate(r->va_dpy);
+	}
+#endif
+
+#ifdef HAVE_X264
+	if (r->sw.enc)
+		software_destroy(r);
+#endif
+
+	for (i = 0; i < RECORDER_QUEUE_LENGTH; i++)
+		free(r->queue[i].pixels);
 
 	close(r->output_fd);
-	close(r->drm_fd);
+	if (r->drm_fd >= 0)
+		close(r->drm_fd);
 
 	free(r);
 }
 
+#ifdef HAVE_LIBVA
 static VAStatus
 create_surface_from_fd(struct vaapi_recorder *r, int prime_fd,
 		       int stride, VASurfaceID *surface)
@@ -1041,7 +1504,8 @@ create_surface_from_fd(struct vaapi_recorder *r, int prime_fd,
 }
 
 static VAStatus
-convert_rgb_to_yuv(struct vaapi_recorder *r, VASurfaceID rgb_surface)
+convert_rgb_to_yuv(struct vaapi_recorder *r, VASurfaceID rgb_surface,
+		   VASurfaceID output)
 {
 	VAProcPipelineParameterBuffer *pipeline_param;
 	VAStatus status;
@@ -1063,7 +1527,7 @@ convert_rgb_to_yuv(struct vaapi_recorder *r, VASurfaceID rgb_surface)
 	if (status != VA_STATUS_SUCCESS)
 		return status;
 
-	status = vaBeginPicture(r->va_dpy, r->vpp.ctx, r->vpp.output);
+	status = vaBeginPicture(r->va_dpy, r->vpp.ctx, output);
 	if (status != VA_STATUS_SUCCESS)
 		return status;
 
@@ -1076,55 +1540,140 @@ convert_rgb_to_yuv(struct vaapi_recorder *r, VASurfaceID rgb_surface)
 	if (status != VA_STATUS_SUCCESS)
 		return status;
 
-	return status;
+	/* The pipeline buffer is reused for the next frame */
+	return vaSyncSurface(r->va_dpy, output);
 }
 
-static void
-recorder_frame(struct vaapi_recorder *r)
+/* Converts the input in queue slot @slot into that slot's YUV surface */
+static VASurfaceID
+recorder_convert(struct vaapi_recorder *r, struct recorder_input *input,
+		 int slot)
 {
-	VASurfaceID rgb_surface;
+	VASurfaceID rgb_surface, yuv_surface = r->vpp.output[slot];
 	VAStatus status;
 
-	status = create_surface_from_fd(r, r->input.prime_fd,
-					r->input.stride, &rgb_surface);
-	if (status != VA_STATUS_SUCCESS) {
-		weston_log("[libva recorder] "
-			   "failed to create surface from bo\n");
-		return;
+	if (input->type == RECORDER_INPUT_DMABUF) {
+		status = create_surface_from_fd(r, input->prime_fd,
+						input->stride, &rgb_surface);
+		if (status != VA_STATUS_SUCCESS) {
+			weston_log("[libva recorder] "
+				   "failed to create surface from bo\n");
+			return VA_INVALID_SURFACE;
+		}
+	} else {
+		if (vpp_setup_upload(r, input->format) < 0) {
+			weston_log("[libva recorder] "
+				   "failed to create upload surfaces\n");
+			return VA_INVALID_SURFACE;
+		}
+
+		rgb_surface = r->vpp.upload[slot];
+		status = upload_pixels(r, rgb_surface, input->pixels);
+		if (status != VA_STATUS_SUCCESS) {
+			weston_log("[libva recorder] "
+				   "failed to upload frame\n");
+			return VA_INVALID_SURFACE;
+		}
 	}
 
-	close(r->input.prime_fd);
+	status = convert_rgb_to_yuv(r, rgb_surface, yuv_surface);
+
+	if (input->type == RECORDER_INPUT_DMABUF)
+		vaDestroySurfaces(r->va_dpy, &rgb_surface, 1);
 
-	status = convert_rgb_to_yuv(r, rgb_surface);
 	if (status != VA_STATUS_SUCCESS) {
 		weston_log("[libva recorder] "
 			   "color space conversion failed\n");
-		return;
+		return VA_INVALID_SURFACE;
 	}
 
-	encoder_encode(r, r->vpp.output);
+	return yuv_surface;
+}
+
+static void
+recorder_frame_hardware(struct vaapi_recorder *r,
+			struct recorder_input *input, int slot)
+{
+	VASurfaceID yuv_surface;
+
+	yuv_surface = recorder_convert(r, input, slot);
 
-	vaDestroySurfaces(r->va_dpy, &rgb_surface, 1);
+	/* The previous frame was being encoded meanwhile, write it out
+	 * before anything that follows it in the stream */
+	encoder_end_frame(r);
+
+	if (yuv_surface == VA_INVALID_SURFACE)
+		return;
+
+	if (input->repeats_before > 0)
+		recorder_write_repeat_marker(r, input->repeats_before);
+
+	if (encoder_begin_frame(r, yuv_surface, r->frame_count) == 0)
+		r->frame_count++;
+}
+#endif
+
+static void
+recorder_frame(struct vaapi_recorder *r, struct recorder_input *input,
+	       int slot)
+{
+#ifdef HAVE_LIBVA
+	if (r->va_dpy) {
+		recorder_frame_hardware(r, input, slot);
+		return;
+	}
+#endif
+
+#ifdef HAVE_X264
+	if (input->repeats_before > 0)
+		recorder_write_repeat_marker(r, input->repeats_before);
+	software_encode(r, input->pixels, input->format,
+			r->frame_count + input->repeats_before);
+	r->frame_count += 1 + input->repeats_before;
+#endif
+}
+
+static void
+recorder_input_fini(struct recorder_input *input)
+{
+	if (input->type == RECORDER_INPUT_DMABUF && input->prime_fd >= 0) {
+		close(input->prime_fd);
+		input->prime_fd = -1;
+	}
 }
 
 static void *
 worker_thread_function(void *data)
 {
 	struct vaapi_recorder *r = data;
+	struct recorder_input *input;
+	int slot;
 
 	pthread_mutex_lock(&r->mutex);
 
-	while (!r->destroying) {
-		if (!r->input.valid)
+	while (r->queue_count > 0 || !r->destroying) {
+		if (r->queue_count == 0) {
 			pthread_cond_wait(&r->input_cond, &r->mutex);
-
-		/* If the thread is awaken by destroy_worker_thread(),
-		 * there might not be valid input */
-		if (!r->input.valid)
 			continue;
+		}
+
+		slot = r->queue_head;
+		input = &r->queue[slot];
+
+		/* The compositor may queue more frames meanwhile, the slot
+		 * stays taken until it is popped below */
+		pthread_mutex_unlock(&r->mutex);
+
+		if (!r->encode_error)
+			recorder_frame(r, input, slot);
+		recorder_input_fini(input);
 
-		recorder_frame(r);
-		r->input.valid = 0;
+		pthread_mutex_lock(&r->mutex);
+
+		r->queue_head = (r->queue_head + 1) % RECORDER_QUEUE_LENGTH;
+		r->queue_count--;
+		if (r->encode_error)
+			r->error = r->encode_error;
 	}
 
 	pthread_mutex_unlock(&r->mutex);
@@ -1132,9 +1681,33 @@ worker_thread_function(void *data)
 	return NULL;
 }
 
-int
+/* Returns the next free queue slot, or NULL if the worker is behind. Called
+ * with the mutex held. The slot only becomes visible to the worker in
+ * recorder_queue_commit(), so it can be filled without the mutex. */
+static struct recorder_input *
+recorder_queue_reserve(struct vaapi_recorder *r)
+{
+	if (r->queue_count == RECORDER_QUEUE_LENGTH)
+		return NULL;
+
+	return &r->queue[(r->queue_head + r->queue_count) %
+			 RECORDER_QUEUE_LENGTH];
+}
+
+static void
+recorder_queue_commit(struct vaapi_recorder *r, struct recorder_input *input)
+{
+	input->repeats_before = r->pending_repeats;
+	r->pending_repeats = 0;
+
+	r->queue_count++;
+	pthread_cond_signal(&r->input_cond);
+}
+
+static int
 vaapi_recorder_frame(struct vaapi_recorder *r, int prime_fd, int stride)
 {
+	struct recorder_input *input;
 	int ret = 0;
 
 	pthread_mutex_lock(&r->mutex);
@@ -1142,20 +1715,93 @@ vaapi_recorder_frame(struct vaapi_recorder *r, int prime_fd, int stride)
 	if (r->error) {
 		errno = r->error;
 		ret = -1;
-		goto unlock;
+		goto err_close;
 	}
 
-	/* The mutex is never released while encoding, so this point should
-	 * never be reached if input.valid is true. */
-	assert(!r->input.valid);
+	if (!recorder_is_hardware(r)) {
+		errno = ENOTSUP;
+		ret = -1;
+		goto err_close;
+	}
 
-	r->input.prime_fd = prime_fd;
-	r->input.stride = stride;
-	r->input.valid = 1;
-	pthread_cond_signal(&r->input_cond);
+	input = recorder_queue_reserve(r);
+	if (!input) {
+		ret = 1;
+		goto err_close;
+	}
+
+	input->type = RECORDER_INPUT_DMABUF;
+	input->prime_fd = prime_fd;
+	input->stride = stride;
+	recorder_queue_commit(r, input);
 
-unlock:
 	pthread_mutex_unlock(&r->mutex);
 
+	return 0;
+
+err_close:
+	pthread_mutex_unlock(&r->mutex);
+	close(prime_fd);
+
 	return ret;
 }
+
+static int
+vaapi_recorder_frame_pixels(struct vaapi_recorder *r, const uint32_t *pixels,
+			    uint32_t format)
+{
+	struct recorder_input *input;
+	size_t size = (size_t) r->width * r->height * 4;
+
+	if (!recorder_format_supported(format)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pthread_mutex_lock(&r->mutex);
+
+	if (r->error) {
+		errno = r->error;
+		pthread_mutex_unlock(&r->mutex);
+		return -1;
+	}
+
+	input = recorder_queue_reserve(r);
+
+	pthread_mutex_unlock(&r->mutex);
+
+	if (!input)
+		return 1;
+
+	if (!input->pixels) {
+		input->pixels = malloc(size);
+		if (!input->pixels)
+			return -1;
+	}
+
+	input->type = RECORDER_INPUT_PIXELS;
+	input->format = format;
+	memcpy(input->pixels, pixels, size);
+
+	pthread_mutex_lock(&r->mutex);
+	recorder_queue_commit(r, input);
+	pthread_mutex_unlock(&r->mutex);
+
+	return 0;
+}
+
+static void
+vaapi_recorder_repeat_frame(struct vaapi_recorder *r)
+{
+	pthread_mutex_lock(&r->mutex);
+	r->pending_repeats++;
+	pthread_mutex_unlock(&r->mutex);
+}
+
+WL_EXPORT struct vaapi_recorder_interface vaapi_recorder_interface = {
+	.create = vaapi_recorder_create,
+	.destroy = vaapi_recorder_destroy,
+	.frame = vaapi_recorder_frame,
+	.frame_pixels = vaapi_recorder_frame_pixels,
+	.repeat_frame = vaapi_recorder_repeat_frame,
+};
@@ -26,13 +26,32 @@
 #ifndef _VAAPI_RECORDER_H_
 #define _VAAPI_RECORDER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 struct vaapi_recorder;
 
-struct vaapi_recorder *
-vaapi_recorder_create(int drm_fd, int width, int height, const char *filename);
-void
-vaapi_recorder_destroy(struct vaapi_recorder *r);
-int
-vaapi_recorder_frame(struct vaapi_recorder *r, int fd, int stride);
+/* Loaded from vaapi-recorder.so, which is built with VA-API, x264 or both,
+ * so that libweston itself does not link to either. */
+struct vaapi_recorder_interface {
+	/* Takes ownership of drm_fd. With drm_fd < 0 a render node is
+	 * looked up. If VA-API encoding is unavailable and allow_software
+	 * is set, frames are encoded with x264 instead, which only takes
+	 * frame_pixels(). */
+	struct vaapi_recorder *(*create)(int drm_fd, int width, int height,
+					 const char *filename,
+					 bool allow_software);
+	void (*destroy)(struct vaapi_recorder *r);
+
+	/* The frame functions never wait for the encoder. They return 0
+	 * when the frame was queued, 1 when it was dropped because the
+	 * encoder is behind, and -1 with errno set when recording failed. */
+	int (*frame)(struct vaapi_recorder *r, int fd, int stride);
+	int (*frame_pixels)(struct vaapi_recorder *r, const uint32_t *pixels,
+			    uint32_t format);
+
+	/* The previous frame is shown for one more frame period */
+	void (*repeat_frame)(struct vaapi_recorder *r);
+};
 
 #endif /* _VAAPI_RECORDER_H_ */
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <libweston/weston-log.h>
+#include <libweston/zalloc.h>
+#include "shared/helpers.h"
+
+#include "weston-log-internal.h"
+
+/*
+ * Asynchronous writing for log subscribers
+ *
+ * Each subscriber that writes to a file descriptor can get a bounded queue.
+ * Writing to the queue only copies the message; a writer thread of the
+ * queue's own drains it with writev() in batches. A slow disk or a debug
+ * stream reader that stops reading then only stalls its own writer and
+ * fills its own queue, which either drops its oldest messages or makes the
+ * compositor wait, depending on the overflow policy. The other queues keep
+ * draining.
+ *
+ * All queue state is protected by writer.mutex.
+ */
+
+/* Well below IOV_MAX on any system we run on */
+#define BATCH_MAX 64
+
+struct weston_log_async_msg {
+	struct wl_list link;	/**< weston_log_async_queue::msgs */
+	size_t len;
+	char data[];
+};
+
+struct weston_log_async_queue {
+	int fd;
+	bool close_fd;
+	size_t max_bytes;
+	enum weston_log_overflow overflow;
+	pthread_cond_t work;	/**< messages queued or closing */
+
+	struct wl_list msgs;	/**< weston_log_async_msg::link */
+	size_t bytes;
+	uint64_t dropped;	/**< messages, since the last batch */
+	int error;		/**< errno of a failed write, or 0 */
+	bool busy;		/**< a batch is being written */
+	bool closing;		/**< to be freed by the writer when drained */
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t space;	/**< a batch has been taken or written */
+} writer = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.space = PTHREAD_COND_INITIALIZER,
+};
+
+static int
+writev_all(int fd, struct iovec *iov, int count)
+{
+	ssize_t ret;
+
+	while (count > 0) {
+		ret = writev(fd, iov, count);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+
+		while (count > 0 && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+/* Called and returns with writer.mutex locked */
+static void
+writer_write_batch(struct weston_log_async_queue *q)
+{
+	struct weston_log_async_msg *msg, *tmp;
+	struct iovec iov[BATCH_MAX + 1];
+	struct wl_list batch;
+	char notice[64];
+	int count = 0;
+	int error = 0;
+
+	wl_list_init(&batch);
+
+	if (q->dropped > 0) {
+		iov[count].iov_base = notice;
+		iov[count].iov_len = snprintf(notice, sizeof notice,
+					      "[%" PRIu64 " log messages dropped]\n",
+					      q->dropped);
+		count++;
+		q->dropped = 0;
+	}
+
+	wl_list_for_each_safe(msg, tmp, &q->msgs, link) {
+		if (count == ARRAY_LENGTH(iov))
+			break;
+
+		wl_list_remove(&msg->link);
+		wl_list_insert(batch.prev, &msg->link);
+		q->bytes -= msg->len;
+
+		iov[count].iov_base = msg->data;
+		iov[count].iov_len = msg->len;
+		count++;
+	}
+
+	q->busy = true;
+	pthread_cond_broadcast(&writer.space);
+	pthread_mutex_unlock(&writer.mutex);
+
+	if (q->error == 0)
+		error = writev_all(q->fd, iov, count);
+
+	wl_list_for_each_safe(msg, tmp, &batch, link)
+		free(msg);
+
+	pthread_mutex_lock(&writer.mutex);
+	q->busy = false;
+	if (error)
+		q->error = error;
+	pthread_cond_broadcast(&writer.space);
+}
+
+static void *
+writer_thread(void *data)
+{
+	struct weston_log_async_queue *q = data;
+
+	pthread_mutex_lock(&writer.mutex);
+
+	for (;;) {
+		if (!wl_list_empty(&q->msgs)) {
+			writer_write_batch(q);
+			continue;
+		}
+
+		if (q->closing)
+			break;
+
+		pthread_cond_wait(&q->work, &writer.mutex);
+	}
+
+	pthread_mutex_unlock(&writer.mutex);
+
+	/* Drained and no longer used */
+	if (q->close_fd)
+		close(q->fd);
+	pthread_cond_destroy(&q->work);
+	free(q);
+
+	return NULL;
+}
+
+/** Create an asynchronous write queue
+ *
+ * \param fd The file descriptor to write to.
+ * \param close_fd Whether the queue takes ownership of \c fd.
+ * \param max_bytes The most data to hold before \c overflow applies.
+ * \param overflow What to do when the queue is full.
+ * \return The queue, or NULL on failure.
+ *
+ * The queue gets a writer thread of its own, so that a file descriptor
+ * which stops taking data does not hold up any other queue.
+ *
+ * @ingroup internal-log
+ */
+struct weston_log_async_queue *
+weston_log_async_queue_create(int fd, bool close_fd, size_t max_bytes,
+			      enum weston_log_overflow overflow)
+{
+	struct weston_log_async_queue *q;
+	pthread_t thread;
+	pthread_attr_t attr;
+	sigset_t set, old;
+	int ret;
+
+	q = zalloc(sizeof *q);
+	if (!q)
+		return NULL;
+
+	q->fd = fd;
+	q->close_fd = close_fd;
+	q->max_bytes = max_bytes;
+	q->overflow = overflow;
+	wl_list_init(&q->msgs);
+	pthread_cond_init(&q->work, NULL);
+
+	/* The log is set up before the compositor routes its signals,
+	 * leave all signals to the compositor thread. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, writer_thread, q);
+	pthread_attr_destroy(&attr);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret != 0) {
+		pthread_cond_destroy(&q->work);
+		free(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+/** Queue data to be written
+ *
+ * \param q The queue.
+ * \param data The data to write.
+ * \param len The number of bytes in \c data.
+ *
+ * With WESTON_LOG_OVERFLOW_DROP_OLDEST, this never waits for the writer.
+ * Dropped messages are counted and reported in the output.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_log_async_queue_write(struct weston_log_async_queue *q,
+			     const char *data, size_t len)
+{
+	struct weston_log_async_msg *msg, *oldest;
+
+	if (len == 0)
+		return;
+
+	msg = malloc(sizeof *msg + len);
+	if (!msg)
+		return;
+
+	msg->len = len;
+	memcpy(msg->data, data, len);
+
+	pthread_mutex_lock(&writer.mutex);
+
+	while (q->error == 0 && !wl_list_empty(&q->msgs) &&
+	       q->bytes + len > q->max_bytes) {
+		if (q->overflow == WESTON_LOG_OVERFLOW_BLOCK) {
+			pthread_cond_wait(&writer.space, &writer.mutex);
+			continue;
+		}
+
+		oldest = wl_container_of(q->msgs.next, oldest, link);
+		wl_list_remove(&oldest->link);
+		q->bytes -= oldest->len;
+		q->dropped++;
+		free(oldest);
+	}
+
+	if (q->error != 0) {
+		pthread_mutex_unlock(&writer.mutex);
+		free(msg);
+		return;
+	}
+
+	wl_list_insert(q->msgs.prev, &msg->link);
+	q->bytes += len;
+	pthread_cond_signal(&q->work);
+
+	pthread_mutex_unlock(&writer.mutex);
+}
+
+/** Get the error of a failed write
+ *
+ * \return The errno of the write that failed, or 0. After a failure, no
+ * more data is written.
+ *
+ * @ingroup internal-log
+ */
+int
+weston_log_async_queue_get_error(struct weston_log_async_queue *q)
+{
+	int error;
+
+	pthread_mutex_lock(&writer.mutex);
+	error = q->error;
+	pthread_mutex_unlock(&writer.mutex);
+
+	return error;
+}
+
+/** Destroy a queue
+ *
+ * \param q The queue.
+ * \param wait Whether to wait until everything queued has been written.
+ *
+ * The queue is freed by its writer thread once drained, which also closes
+ * the file descriptor if the queue owns it.
+ *
+ * @ingroup internal-log
+ */
+void
+weston_log_async_queue_destroy(struct weston_log_async_queue *q, bool wait)
+{
+	pthread_mutex_lock(&writer.mutex);
+
+	while (wait &&
+	       (q->busy || (q->error == 0 && !wl_list_empty(&q->msgs))))
+		pthread_cond_wait(&writer.space, &writer.mutex);
+
+	q->closing = true;
+	pthread_cond_signal(&q->work);
+	pthread_mutex_unlock(&writer.mutex);
+}
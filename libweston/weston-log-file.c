@@ -38,6 +38,7 @@
 struct weston_debug_log_file {
 	struct weston_log_subscriber base;
 	FILE *file;
+	struct weston_log_async_queue *queue;	/**< writes to file, or NULL */
 };
 
 static struct weston_debug_log_file *
@@ -51,7 +52,11 @@ weston_log_file_write(struct weston_log_subscriber *sub,
 		      const char *data, size_t len)
 {
 	struct weston_debug_log_file *stream = to_weston_debug_log_file(sub);
-	fwrite(data, len, 1, stream->file);
+
+	if (stream->queue)
+		weston_log_async_queue_write(stream->queue, data, len);
+	else
+		fwrite(data, len, 1, stream->file);
 }
 
 static void
@@ -60,6 +65,8 @@ weston_log_subscriber_destroy_log(struct weston_log_subscriber *subscriber)
 	struct weston_debug_log_file *file = to_weston_debug_log_file(subscriber);
 
 	weston_log_subscriber_release(subscriber);
+	if (file->queue)
+		weston_log_async_queue_destroy(file->queue, true);
 	free(file);
 }
 
@@ -96,3 +103,46 @@ weston_log_subscriber_create_log(FILE *dump_to)
 
 	return &file->base;
 }
+
+/** Creates a file type of subscriber that writes from a background thread
+ *
+ * Like weston_log_subscriber_create_log(), but the messages are copied into
+ * a queue of at most \c queue_size bytes, and written to the file by the log
+ * writer thread. \c overflow chooses whether a full queue drops its oldest
+ * messages, or makes the writing thread wait. The number of dropped
+ * messages is written to the file.
+ *
+ * Destroying the subscriber waits until the queue has been written. The
+ * FILE itself is not closed.
+ *
+ * @param dump_to if specified, used for writing data to
+ * @param queue_size the size of the queue in bytes
+ * @param overflow what to do when the queue is full
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ *
+ * @sa weston_log_subscriber_destroy
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_log_async(FILE *dump_to, size_t queue_size,
+				       enum weston_log_overflow overflow)
+{
+	struct weston_log_subscriber *sub;
+	struct weston_debug_log_file *file;
+
+	sub = weston_log_subscriber_create_log(dump_to);
+	if (!sub)
+		return NULL;
+
+	file = to_weston_debug_log_file(sub);
+
+	/* Anything already buffered must come first */
+	fflush(file->file);
+	file->queue = weston_log_async_queue_create(fileno(file->file), false,
+						    queue_size, overflow);
+	if (!file->queue) {
+		weston_log_subscriber_destroy(sub);
+		return NULL;
+	}
+
+	return sub;
+}
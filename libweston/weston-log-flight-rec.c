@@ -30,13 +30,63 @@
 #include <libweston/libweston.h>
 
 #include "weston-log-internal.h"
+#include "shared/os-compatibility.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
+
+/*
+ * Mapped flight recorder layout
+ *
+ * The file starts with a struct flight_rec_file_header, padded to
+ * FLIGHT_REC_HEADER_SIZE, followed by the ring. The ring holds records made
+ * of a struct flight_rec_record and the message, padded to
+ * FLIGHT_REC_ALIGN. A record never wraps around the end of the ring; if it
+ * does not fit, the rest of the ring is left as is and the record goes to
+ * the start.
+ *
+ * The header head is the total number of bytes ever reserved in the ring,
+ * and each record stores its own position in that sequence, written after
+ * the message. A reader walks from head - ring_size to head and only
+ * accepts records whose position matches where they were found, so records
+ * that were overwritten or only partially written, e.g. because of a
+ * crash, are skipped. tools/flight-rec-decode.py decodes the file.
+ *
+ * All fields are in native byte order.
+ */
+#define FLIGHT_REC_MAGIC "WFLTREC1"
+#define FLIGHT_REC_HEADER_SIZE 4096
+#define FLIGHT_REC_ALIGN 8
+#define FLIGHT_REC_SCOPES_MAX 64
+#define FLIGHT_REC_SCOPE_NAME_LEN 32
+#define FLIGHT_REC_SCOPE_UNKNOWN 0xffff
+
+struct flight_rec_file_header {
+	char magic[8];
+	uint32_t header_size;
+	uint32_t record_header_size;
+	uint64_t ring_size;
+	uint64_t head;			/**< bytes reserved so far */
+	int64_t realtime_offset_ns;	/**< CLOCK_REALTIME - CLOCK_MONOTONIC */
+	uint32_t scope_count;		/**< names complete for readers */
+	uint32_t scope_reserved;	/**< names claimed by writers */
+	char scope_names[FLIGHT_REC_SCOPES_MAX][FLIGHT_REC_SCOPE_NAME_LEN];
+};
+
+struct flight_rec_record {
+	uint64_t pos;		/**< position in the head sequence, set last */
+	uint64_t time_ns;	/**< CLOCK_MONOTONIC */
+	uint32_t len;		/**< message length */
+	uint16_t scope;		/**< index into scope_names */
+	uint16_t pad;
+};
 
 struct weston_ring_buffer {
 	uint32_t append_pos;	/**< where in the buffer we are */
@@ -44,6 +94,8 @@ struct weston_ring_buffer {
 	char *buf;		/**< the buffer itself */
 	FILE *file;		/**< where to write in case we need to dump the buf */
 	bool overlap;		/**< in case buff overlaps, hint from where to print buf contents */
+	struct flight_rec_file_header *mapped;	/**< for a mapped flight recorder */
+	int fd;			/**< of the mapped file */
 };
 
 /** allows easy access to the ring buffer in case of a core dump
@@ -177,6 +229,119 @@ weston_log_flight_recorder_write(struct weston_log_subscriber *sub,
 
 }
 
+/*
+ * Scopes may log from several threads, so a new name gets its slot with a
+ * compare-and-swap on scope_reserved. scope_count is then advanced past it
+ * in slot order, which makes a writer wait for one that claimed an earlier
+ * slot and has not copied its name in yet. Two threads registering the same
+ * name at once may both get a slot; that only costs a slot.
+ */
+static uint16_t
+flight_rec_mapped_scope_id(struct weston_ring_buffer *rb, const char *name)
+{
+	struct flight_rec_file_header *hdr = rb->mapped;
+	uint32_t count = __atomic_load_n(&hdr->scope_count, __ATOMIC_ACQUIRE);
+	uint32_t slot, expected;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (strncmp(hdr->scope_names[i], name,
+			    FLIGHT_REC_SCOPE_NAME_LEN - 1) == 0)
+			return i;
+	}
+
+	slot = __atomic_load_n(&hdr->scope_reserved, __ATOMIC_RELAXED);
+	do {
+		if (slot >= FLIGHT_REC_SCOPES_MAX)
+			return FLIGHT_REC_SCOPE_UNKNOWN;
+	} while (!__atomic_compare_exchange_n(&hdr->scope_reserved,
+					      &slot, slot + 1, false,
+					      __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED));
+
+	strncpy(hdr->scope_names[slot], name, FLIGHT_REC_SCOPE_NAME_LEN - 1);
+
+	/* The name must be complete before a reader can see it */
+	do {
+		expected = slot;
+	} while (!__atomic_compare_exchange_n(&hdr->scope_count,
+					      &expected, slot + 1, false,
+					      __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
+
+	return slot;
+}
+
+static void
+weston_log_flight_recorder_write_mapped(struct weston_log_subscriber *sub,
+					const char *scope_name,
+					const char *data, size_t len)
+{
+	struct weston_debug_log_flight_recorder *flight_rec =
+		to_flight_recorder(sub);
+	struct weston_ring_buffer *rb = &flight_rec->rb;
+	struct flight_rec_record *rec;
+	struct timespec ts;
+	uint64_t pos, off, total;
+
+	/* A single message may not take more than a quarter of the ring */
+	if (len > rb->size / 4 - sizeof(*rec))
+		len = rb->size / 4 - sizeof(*rec);
+
+	total = sizeof(*rec) + len;
+	total = (total + FLIGHT_REC_ALIGN - 1) & ~(uint64_t)(FLIGHT_REC_ALIGN - 1);
+
+	do {
+		pos = __atomic_fetch_add(&rb->mapped->head, total,
+					 __ATOMIC_RELAXED);
+		off = pos % rb->size;
+	} while (off + total > rb->size);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	rec = (struct flight_rec_record *)&rb->buf[off];
+	rec->time_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	rec->len = len;
+	rec->scope = flight_rec_mapped_scope_id(rb, scope_name);
+	rec->pad = 0;
+	memcpy(rec + 1, data, len);
+
+	__atomic_store_n(&rec->pos, pos, __ATOMIC_RELEASE);
+}
+
+static void
+flight_rec_mapped_display(struct weston_ring_buffer *rb, FILE *file)
+{
+	struct flight_rec_record *rec;
+	uint64_t head, pos, off, total;
+
+	head = __atomic_load_n(&rb->mapped->head, __ATOMIC_ACQUIRE);
+	pos = head > rb->size ? head - rb->size : 0;
+
+	while (pos < head) {
+		off = pos % rb->size;
+		if (off + sizeof(*rec) > rb->size) {
+			pos += rb->size - off;
+			continue;
+		}
+
+		rec = (struct flight_rec_record *)&rb->buf[off];
+		if (__atomic_load_n(&rec->pos, __ATOMIC_ACQUIRE) != pos) {
+			pos += FLIGHT_REC_ALIGN;
+			continue;
+		}
+
+		total = sizeof(*rec) + rec->len;
+		total = (total + FLIGHT_REC_ALIGN - 1) &
+			~(uint64_t)(FLIGHT_REC_ALIGN - 1);
+		if (off + total > rb->size)
+			break;
+
+		fwrite(rec + 1, sizeof(char), rec->len, file);
+		pos += total;
+	}
+}
+
 static void
 weston_log_subscriber_display_flight_rec_data(struct weston_ring_buffer *rb,
 					      FILE *file)
@@ -185,6 +350,11 @@ weston_log_subscriber_display_flight_rec_data(struct weston_ring_buffer *rb,
 	if (file)
 		file_d = file;
 
+	if (rb->mapped) {
+		flight_rec_mapped_display(rb, file_d);
+		return;
+	}
+
 	if (!rb->overlap) {
 		if (rb->append_pos)
 			fwrite(rb->buf, sizeof(char), rb->append_pos, file_d);
@@ -220,7 +390,13 @@ weston_log_subscriber_destroy_flight_rec(struct weston_log_subscriber *sub)
 		weston_primary_flight_recorder_ring_buffer = NULL;
 
 	weston_log_subscriber_release(sub);
-	free(flight_rec->rb.buf);
+	if (flight_rec->rb.mapped) {
+		munmap(flight_rec->rb.mapped,
+		       FLIGHT_REC_HEADER_SIZE + flight_rec->rb.size);
+		close(flight_rec->rb.fd);
+	} else {
+		free(flight_rec->rb.buf);
+	}
 	free(flight_rec);
 }
 
@@ -267,6 +443,115 @@ weston_log_subscriber_create_flight_rec(size_t size)
 	return &flight_rec->base;
 }
 
+/** Create a flight recorder that keeps its ring in a shared mapping
+ *
+ * Each message is stored as a record with the scope it came from and a
+ * CLOCK_MONOTONIC timestamp, in a ring that lives in a file mapped with
+ * MAP_SHARED. The records survive the compositor crashing or being killed,
+ * and can be read while it is hung, with tools/flight-rec-decode.py.
+ * Writing a record neither allocates nor takes a lock. Only the first
+ * message of a scope may briefly wait for another thread that is
+ * registering a scope at the same time.
+ *
+ * Use weston_log_subscriber_destroy() to clean-up; the file is kept.
+ *
+ * @param path the file to create or truncate, or NULL for an anonymous
+ * file, see weston_log_subscriber_get_flight_rec_fd()
+ * @param size the size (in bytes) of the ring
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_mapped(const char *path, size_t size)
+{
+	struct weston_debug_log_flight_recorder *flight_rec;
+	struct flight_rec_file_header *hdr;
+	struct timespec mono, real;
+	size_t map_size;
+	void *map;
+	int fd;
+
+	assert("Can't create more than one flight recorder." &&
+			!weston_primary_flight_recorder_ring_buffer);
+
+	size &= ~(size_t)(FLIGHT_REC_ALIGN - 1);
+	if (size < 4096 || size >= UINT32_MAX)
+		return NULL;
+
+	map_size = FLIGHT_REC_HEADER_SIZE + size;
+
+	if (path) {
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+		if (fd >= 0 && ftruncate(fd, map_size) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	} else {
+		fd = os_create_anonymous_file(map_size);
+	}
+	if (fd < 0)
+		return NULL;
+
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	flight_rec = zalloc(sizeof(*flight_rec));
+	if (!flight_rec) {
+		munmap(map, map_size);
+		close(fd);
+		return NULL;
+	}
+
+	flight_rec->base.write_scoped = weston_log_flight_recorder_write_mapped;
+	flight_rec->base.destroy = weston_log_subscriber_destroy_flight_rec;
+	wl_list_init(&flight_rec->base.subscription_list);
+
+	/* Fault in all the pages up front, not while logging */
+	memset(map, 0, map_size);
+
+	hdr = map;
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	hdr->header_size = FLIGHT_REC_HEADER_SIZE;
+	hdr->record_header_size = sizeof(struct flight_rec_record);
+	hdr->ring_size = size;
+	hdr->realtime_offset_ns =
+		((int64_t)real.tv_sec - mono.tv_sec) * 1000000000 +
+		real.tv_nsec - mono.tv_nsec;
+	/* Written last so that a reader never sees a half-made header */
+	memcpy(hdr->magic, FLIGHT_REC_MAGIC, sizeof(hdr->magic));
+
+	/* weston_ring_buffer_init() keeps one byte spare, records do not */
+	weston_ring_buffer_init(&flight_rec->rb, size + 1,
+				(char *)map + FLIGHT_REC_HEADER_SIZE);
+	flight_rec->rb.mapped = hdr;
+	flight_rec->rb.fd = fd;
+	weston_primary_flight_recorder_ring_buffer = &flight_rec->rb;
+
+	return &flight_rec->base;
+}
+
+/** Get the file descriptor of a mapped flight recorder
+ *
+ * The file can be mapped by another process, such as a watchdog, to read
+ * the records while the compositor is hung or after it crashed.
+ *
+ * @param sub a flight recorder created with
+ * weston_log_subscriber_create_flight_rec_mapped()
+ * @returns the file descriptor, owned by the flight recorder, or -1 if the
+ * flight recorder is not mapped
+ */
+WL_EXPORT int
+weston_log_subscriber_get_flight_rec_fd(struct weston_log_subscriber *sub)
+{
+	struct weston_debug_log_flight_recorder *flight_rec =
+		to_flight_recorder(sub);
+
+	return flight_rec->rb.mapped ? flight_rec->rb.fd : -1;
+}
+
 /** Retrieve flight recorder ring buffer contents, could be useful when
  * implementing an assert()-like wrapper.
  *
@@ -25,6 +25,8 @@
 #ifndef WESTON_LOG_INTERNAL_H
 #define WESTON_LOG_INTERNAL_H
 
+#include <stdbool.h>
+
 #include "wayland-util.h"
 
 struct weston_log_subscription;
@@ -52,6 +54,11 @@ struct weston_log_subscription;
 struct weston_log_subscriber {
 	/** write the data pointed by @param data */
 	void (*write)(struct weston_log_subscriber *sub, const char *data, size_t len);
+	/** Used instead of write, for the type of streams that record which
+	 * scope the data comes from */
+	void (*write_scoped)(struct weston_log_subscriber *sub,
+			     const char *scope_name,
+			     const char *data, size_t len);
 	/** For destroying the subscriber */
 	void (*destroy)(struct weston_log_subscriber *sub);
 	/** For the type of streams that required additional destroy operation
@@ -62,6 +69,10 @@ struct weston_log_subscriber {
 	 * stream.
 	 */
 	void (*complete)(struct weston_log_subscriber *sub);
+	/** For the type of streams that take binary timeline records
+	 * instead of formatted text, see struct weston_timeline_record */
+	void (*write_record)(struct weston_log_subscriber *sub,
+			     const void *data, size_t len);
 	struct wl_list subscription_list;       /**< weston_log_subscription::owner_link */
 };
 
@@ -106,6 +117,13 @@ weston_log_subscription_get_data(struct weston_log_subscription *sub);
 void
 weston_log_subscription_set_data(struct weston_log_subscription *sub, void *data);
 
+bool
+weston_log_subscription_takes_records(struct weston_log_subscription *sub);
+
+void
+weston_log_subscription_write_record(struct weston_log_subscription *sub,
+				     const void *data, size_t len);
+
 void
 weston_timeline_create_subscription(struct weston_log_subscription *sub,
 				    void *user_data);
@@ -114,4 +132,24 @@ void
 weston_timeline_destroy_subscription(struct weston_log_subscription *sub,
 				     void *user_data);
 
+struct weston_log_async_queue;
+
+struct weston_log_async_queue *
+weston_log_async_queue_create(int fd, bool close_fd, size_t max_bytes,
+			      enum weston_log_overflow overflow);
+
+void
+weston_log_async_queue_write(struct weston_log_async_queue *q,
+			     const char *data, size_t len);
+
+int
+weston_log_async_queue_get_error(struct weston_log_async_queue *q);
+
+void
+weston_log_async_queue_destroy(struct weston_log_async_queue *q, bool wait);
+
+size_t
+weston_log_ctx_get_stream_async(struct weston_log_context *log_ctx,
+				enum weston_log_overflow *overflow);
+
 #endif /* WESTON_LOG_INTERNAL_H */
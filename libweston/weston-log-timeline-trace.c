@@ -0,0 +1,310 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libweston/weston-log.h>
+#include "shared/helpers.h"
+#include <libweston/libweston.h>
+
+#include "timeline.h"
+#include "weston-log-internal.h"
+
+/*
+ * Records are produced by the compositor thread only, so the ring buffer
+ * has a single producer and a single consumer: the producer owns 'head',
+ * the writer thread owns 'tail', and neither takes a lock to pass records.
+ * When the ring is full, point records are dropped rather than stalling
+ * the compositor. Definition records are not: later points refer to the
+ * ids they define, so the producer waits for the writer to make room. They
+ * are sent once per name or object, so this is rare and short.
+ */
+
+#define TRACE_RING_SIZE (1 << 20)	/* bytes, a power of two */
+#define TRACE_FLUSH_MSEC 100
+
+struct weston_log_timeline_trace {
+	struct weston_log_subscriber base;
+	int fd;
+
+	uint8_t *ring;
+	uint64_t head;		/* written by the producer */
+	uint64_t tail;		/* written by the writer thread */
+	uint64_t dropped;	/* bytes, producer only */
+
+	pthread_t writer;
+	pthread_mutex_t wake_mutex;
+	pthread_cond_t wake;
+	pthread_cond_t drained;	/* the writer made room */
+	bool wake_pending;
+	bool stop;
+};
+
+static struct weston_log_timeline_trace *
+to_timeline_trace(struct weston_log_subscriber *sub)
+{
+	return container_of(sub, struct weston_log_timeline_trace, base);
+}
+
+static void
+write_all(int fd, const uint8_t *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, data, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return;
+
+		data += ret;
+		len -= ret;
+	}
+}
+
+/* Write out everything the producer has published so far */
+static void
+trace_drain(struct weston_log_timeline_trace *trace)
+{
+	uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = trace->tail;
+	size_t start, len;
+
+	while (tail != head) {
+		start = tail & (TRACE_RING_SIZE - 1);
+		len = MIN(head - tail, (uint64_t)(TRACE_RING_SIZE - start));
+
+		write_all(trace->fd, trace->ring + start, len);
+		tail += len;
+	}
+
+	__atomic_store_n(&trace->tail, tail, __ATOMIC_RELEASE);
+}
+
+static void *
+trace_writer_thread(void *data)
+{
+	struct weston_log_timeline_trace *trace = data;
+	struct timespec deadline;
+	bool stop;
+
+	while (true) {
+		trace_drain(trace);
+
+		pthread_mutex_lock(&trace->wake_mutex);
+		pthread_cond_broadcast(&trace->drained);
+		stop = trace->stop;
+		if (!stop && !trace->wake_pending) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += TRACE_FLUSH_MSEC * 1000000L;
+			if (deadline.tv_nsec >= 1000000000L) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&trace->wake,
+					       &trace->wake_mutex, &deadline);
+			stop = trace->stop;
+		}
+		trace->wake_pending = false;
+		pthread_mutex_unlock(&trace->wake_mutex);
+
+		if (stop)
+			break;
+	}
+
+	trace_drain(trace);
+
+	return NULL;
+}
+
+/* Block until the writer thread has made room for len bytes */
+static uint64_t
+trace_wait_for_room(struct weston_log_timeline_trace *trace, size_t len)
+{
+	uint64_t tail;
+
+	pthread_mutex_lock(&trace->wake_mutex);
+	trace->wake_pending = true;
+	pthread_cond_signal(&trace->wake);
+	while (true) {
+		tail = __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE);
+		if (TRACE_RING_SIZE - (trace->head - tail) >= len)
+			break;
+		pthread_cond_wait(&trace->drained, &trace->wake_mutex);
+	}
+	pthread_mutex_unlock(&trace->wake_mutex);
+
+	return tail;
+}
+
+static void
+weston_log_timeline_trace_write_record(struct weston_log_subscriber *sub,
+				       const void *data, size_t len)
+{
+	struct weston_log_timeline_trace *trace = to_timeline_trace(sub);
+	const struct weston_timeline_record *rec = data;
+	uint64_t tail = __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE);
+	uint64_t head = trace->head;
+	size_t start = head & (TRACE_RING_SIZE - 1);
+	size_t first = MIN(len, TRACE_RING_SIZE - start);
+
+	if (TRACE_RING_SIZE - (head - tail) < len) {
+		if (rec->type == WTR_POINT) {
+			trace->dropped += len;
+			return;
+		}
+		tail = trace_wait_for_room(trace, len);
+	}
+
+	memcpy(trace->ring + start, data, first);
+	memcpy(trace->ring, (const uint8_t *)data + first, len - first);
+
+	__atomic_store_n(&trace->head, head + len, __ATOMIC_RELEASE);
+
+	/* Hurry the writer up before the ring fills up. A lost wake-up
+	 * only delays the write until its next periodic flush. */
+	if (head + len - tail > TRACE_RING_SIZE / 2)
+		pthread_cond_signal(&trace->wake);
+}
+
+static void
+weston_log_timeline_trace_write(struct weston_log_subscriber *sub,
+				const char *data, size_t len)
+{
+	/* Only the timeline scope produces records, text is not traced. */
+}
+
+static void
+weston_log_subscriber_destroy_timeline_trace(struct weston_log_subscriber *sub)
+{
+	struct weston_log_timeline_trace *trace = to_timeline_trace(sub);
+
+	weston_log_subscriber_release(sub);
+
+	pthread_mutex_lock(&trace->wake_mutex);
+	trace->stop = true;
+	pthread_cond_signal(&trace->wake);
+	pthread_mutex_unlock(&trace->wake_mutex);
+	pthread_join(trace->writer, NULL);
+
+	if (trace->dropped > 0)
+		weston_log("Timeline trace: %" PRIu64 " bytes of records "
+			   "dropped, the writer could not keep up.\n",
+			   trace->dropped);
+
+	pthread_cond_destroy(&trace->drained);
+	pthread_cond_destroy(&trace->wake);
+	pthread_mutex_destroy(&trace->wake_mutex);
+	close(trace->fd);
+	free(trace->ring);
+	free(trace);
+}
+
+/** Creates a binary timeline trace type of subscriber
+ *
+ * Timeline points are queued as compact binary records, see
+ * struct weston_timeline_record, and written to \p path by a separate
+ * thread. This keeps the cost of an enabled timeline low enough to leave
+ * it on. Should only be subscribed to the "timeline" scope.
+ *
+ * Should be destroyed using weston_log_subscriber_destroy()
+ *
+ * @param path the file to write the trace to, truncated if it exists
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ *
+ * @sa weston_log_subscriber_destroy
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_timeline_trace(const char *path)
+{
+	struct weston_log_timeline_trace *trace;
+	sigset_t set, old;
+	int ret;
+
+	trace = zalloc(sizeof(*trace));
+	if (!trace)
+		return NULL;
+
+	trace->ring = malloc(TRACE_RING_SIZE);
+	if (!trace->ring)
+		goto err_free;
+
+	trace->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (trace->fd < 0) {
+		weston_log("Timeline trace: cannot open '%s': %s\n",
+			   path, strerror(errno));
+		goto err_free;
+	}
+
+	write_all(trace->fd, (const uint8_t *)WESTON_TIMELINE_TRACE_MAGIC,
+		  strlen(WESTON_TIMELINE_TRACE_MAGIC));
+
+	pthread_mutex_init(&trace->wake_mutex, NULL);
+	pthread_cond_init(&trace->wake, NULL);
+	pthread_cond_init(&trace->drained, NULL);
+
+	/* The thread may start before the compositor has set up its
+	 * signal handling, leave all signals to the compositor thread. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	ret = pthread_create(&trace->writer, NULL, trace_writer_thread, trace);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (ret != 0) {
+		weston_log("Timeline trace: cannot start the writer thread\n");
+		pthread_cond_destroy(&trace->drained);
+		pthread_cond_destroy(&trace->wake);
+		pthread_mutex_destroy(&trace->wake_mutex);
+		close(trace->fd);
+		goto err_free;
+	}
+
+	trace->base.write = weston_log_timeline_trace_write;
+	trace->base.write_record = weston_log_timeline_trace_write_record;
+	trace->base.destroy = weston_log_subscriber_destroy_timeline_trace;
+	trace->base.destroy_subscription = NULL;
+	trace->base.complete = NULL;
+
+	wl_list_init(&trace->base.subscription_list);
+
+	return &trace->base;
+
+err_free:
+	free(trace->ring);
+	free(trace);
+	return NULL;
+}
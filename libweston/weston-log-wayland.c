@@ -49,10 +49,15 @@
  * The following is specific to weston-debug protocol.
  * Subscription/unsubscription takes place in the stream_create(), respectively
  * in stream_destroy().
+ *
+ * If the log context has asynchronous streams enabled, the messages are
+ * written to the fd by the log writer thread, so that a client that does
+ * not keep up cannot stall the compositor.
  */
 struct weston_log_debug_wayland {
 	struct weston_log_subscriber base;
 	int fd;				/**< client provided fd */
+	struct weston_log_async_queue *queue;	/**< owns fd, or NULL */
 	struct wl_resource *resource;	/**< weston_debug_stream_v1 object */
 };
 
@@ -65,8 +70,11 @@ to_weston_log_debug_wayland(struct weston_log_subscriber *sub)
 static void
 stream_close_unlink(struct weston_log_debug_wayland *stream)
 {
-	if (stream->fd != -1)
+	if (stream->queue)
+		weston_log_async_queue_destroy(stream->queue, false);
+	else if (stream->fd != -1)
 		close(stream->fd);
+	stream->queue = NULL;
 	stream->fd = -1;
 }
 
@@ -107,6 +115,9 @@ stream_close_on_failure(struct weston_log_debug_wayland *stream,
  * Otherwise on failure, the stream is closed and
  * \c weston_debug_stream_v1.failure event is sent to the client.
  *
+ * For an asynchronous stream, the data is queued instead, and a failure of
+ * an earlier write is reported here.
+ *
  * \memberof weston_log_debug_wayland
  */
 static void
@@ -121,6 +132,19 @@ weston_log_debug_wayland_write(struct weston_log_subscriber *sub,
 	if (stream->fd == -1)
 		return;
 
+	if (stream->queue) {
+		e = weston_log_async_queue_get_error(stream->queue);
+		if (e != 0) {
+			stream_close_on_failure(stream,
+					"Error writing: %s (%d)",
+					strerror(e), e);
+			return;
+		}
+
+		weston_log_async_queue_write(stream->queue, data, len);
+		return;
+	}
+
 	while (len_ > 0) {
 		ret = write(stream->fd, data, len_);
 		e = errno;
@@ -173,6 +197,8 @@ stream_create(struct weston_log_context *log_ctx, const char *name,
 {
 	struct weston_log_debug_wayland *stream;
 	struct weston_log_scope *scope;
+	enum weston_log_overflow overflow;
+	size_t queue_size;
 
 	stream = zalloc(sizeof *stream);
 	if (!stream)
@@ -181,6 +207,12 @@ stream_create(struct weston_log_context *log_ctx, const char *name,
 	stream->fd = streamfd;
 	stream->resource = stream_resource;
 
+	queue_size = weston_log_ctx_get_stream_async(log_ctx, &overflow);
+	if (queue_size > 0)
+		stream->queue = weston_log_async_queue_create(streamfd, true,
+							      queue_size,
+							      overflow);
+
 	stream->base.write = weston_log_debug_wayland_write;
 	stream->base.destroy = NULL;
 	stream->base.destroy_subscription = weston_log_debug_wayland_to_destroy;
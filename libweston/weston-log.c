@@ -69,6 +69,8 @@ struct weston_log_context {
 	struct wl_listener compositor_destroy_listener;
 	struct wl_list scope_list; /**< weston_log_scope::compositor_link */
 	struct wl_list pending_subscription_list; /**< weston_log_subscription::source_link */
+	size_t stream_async_size; /**< queue size for debug streams, 0 if sync */
+	enum weston_log_overflow stream_async_overflow;
 };
 
 /** weston-log message scope
@@ -183,10 +185,40 @@ static void
 weston_log_subscription_write(struct weston_log_subscription *sub,
 			      const char *data, size_t len)
 {
-	if (sub->owner && sub->owner->write)
+	if (!sub->owner)
+		return;
+
+	if (sub->owner->write_scoped)
+		sub->owner->write_scoped(sub->owner, sub->scope_name, data, len);
+	else if (sub->owner->write)
 		sub->owner->write(sub->owner, data, len);
 }
 
+/** Whether the subscriber takes binary records rather than text
+ *
+ * @memberof weston_log_subscription
+ */
+bool
+weston_log_subscription_takes_records(struct weston_log_subscription *sub)
+{
+	return sub->owner && sub->owner->write_record;
+}
+
+/** Write a binary record to the stream's subscription
+ *
+ * @memberof weston_log_subscription
+ */
+void
+weston_log_subscription_write_record(struct weston_log_subscription *sub,
+				     const void *data, size_t len)
+{
+	if (!weston_log_scope_is_enabled(sub->source))
+		return;
+
+	if (weston_log_subscription_takes_records(sub))
+		sub->owner->write_record(sub->owner, data, len);
+}
+
 /** Write a formatted string to the stream's subscription
  *
  * @memberof weston_log_subscription
@@ -417,6 +449,40 @@ weston_log_ctx_create(void)
 	return log_ctx;
 }
 
+/** Write weston-debug streams from a background thread
+ *
+ * \param log_ctx The log context.
+ * \param queue_size The queue size in bytes for each stream, or 0 to write
+ * streams synchronously.
+ * \param overflow What to do when the queue of a stream is full.
+ *
+ * Applies to streams created after this call.
+ *
+ * @ingroup log
+ */
+WL_EXPORT void
+weston_log_ctx_set_stream_async(struct weston_log_context *log_ctx,
+				size_t queue_size,
+				enum weston_log_overflow overflow)
+{
+	log_ctx->stream_async_size = queue_size;
+	log_ctx->stream_async_overflow = overflow;
+}
+
+/** Get the asynchronous stream settings
+ *
+ * \return The queue size, or 0 if streams are written synchronously.
+ *
+ * @ingroup internal-log
+ */
+size_t
+weston_log_ctx_get_stream_async(struct weston_log_context *log_ctx,
+				enum weston_log_overflow *overflow)
+{
+	*overflow = log_ctx->stream_async_overflow;
+	return log_ctx->stream_async_size;
+}
+
 /** Destroy weston_log_context structure
  *
  * \param log_ctx The log context to destroy.
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "shared/helpers.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+/* Both sizes are well past the 64 KiB the compositor moves per dispatch */
+#define CLIPBOARD_MAX_SIZE (256 * 1024)
+#define KEPT_SIZE (200 * 1024)
+#define DROPPED_SIZE (512 * 1024)
+
+static const char *mime_type = "text/plain";
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("clipboard-max-size=%d", CLIPBOARD_MAX_SIZE));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static uint8_t
+pattern_byte(size_t i)
+{
+	/* Not a power of two, so that misplaced chunks show */
+	return i % 251;
+}
+
+struct selection_owner {
+	struct client *client;
+	struct wl_data_device_manager *manager;
+	struct wl_data_device *device;
+	struct wl_data_source *source;
+	size_t size;
+	bool sent;
+};
+
+static void
+data_source_target(void *data, struct wl_data_source *source,
+		   const char *mime_type)
+{
+}
+
+static void
+data_source_send(void *data, struct wl_data_source *source,
+		 const char *mime_type, int32_t fd)
+{
+	struct selection_owner *owner = data;
+	uint8_t buf[4096];
+	size_t pos, i, len;
+	ssize_t ret;
+
+	for (pos = 0; pos < owner->size; pos += ret) {
+		len = MIN(sizeof buf, owner->size - pos);
+		for (i = 0; i < len; i++)
+			buf[i] = pattern_byte(pos + i);
+
+		ret = write(fd, buf, len);
+		if (ret < 0 && errno == EINTR) {
+			ret = 0;
+			continue;
+		}
+
+		/* The compositor stops reading past clipboard-max-size */
+		if (ret < 0) {
+			assert(errno == EPIPE);
+			break;
+		}
+	}
+
+	close(fd);
+	owner->sent = true;
+}
+
+static void
+data_source_cancelled(void *data, struct wl_data_source *source)
+{
+}
+
+static const struct wl_data_source_listener data_source_listener = {
+	.target = data_source_target,
+	.send = data_source_send,
+	.cancelled = data_source_cancelled,
+};
+
+/* Set a selection of the given size and hand it over to the clipboard by
+ * destroying the source once the compositor has taken the data. */
+static void
+set_selection_and_leave(size_t size)
+{
+	struct selection_owner owner = { .size = size };
+
+	owner.client = create_client_and_test_surface(10, 10, 1, 1);
+	weston_test_activate_surface(owner.client->test->weston_test,
+				     owner.client->surface->wl_surface);
+	client_roundtrip(owner.client);
+
+	owner.manager = bind_to_singleton_global(owner.client,
+						 &wl_data_device_manager_interface,
+						 3);
+	owner.device =
+		wl_data_device_manager_get_data_device(owner.manager,
+						       owner.client->input->wl_seat);
+	owner.source =
+		wl_data_device_manager_create_data_source(owner.manager);
+	wl_data_source_add_listener(owner.source, &data_source_listener,
+				    &owner);
+	wl_data_source_offer(owner.source, mime_type);
+	wl_data_device_set_selection(owner.device, owner.source,
+				     owner.client->input->keyboard->serial);
+
+	while (!owner.sent)
+		assert(wl_display_dispatch(owner.client->wl_display) >= 0);
+
+	wl_data_source_destroy(owner.source);
+	client_roundtrip(owner.client);
+
+	wl_data_device_release(owner.device);
+	wl_data_device_manager_destroy(owner.manager);
+	client_destroy(owner.client);
+}
+
+struct selection_reader {
+	struct client *client;
+	struct wl_data_device_manager *manager;
+	struct wl_data_device *device;
+	struct wl_data_offer *offer;
+	bool got_selection;
+};
+
+static void
+data_device_data_offer(void *data, struct wl_data_device *device,
+		       struct wl_data_offer *offer)
+{
+}
+
+static void
+data_device_enter(void *data, struct wl_data_device *device,
+		  uint32_t serial, struct wl_surface *surface,
+		  wl_fixed_t x, wl_fixed_t y, struct wl_data_offer *offer)
+{
+}
+
+static void
+data_device_leave(void *data, struct wl_data_device *device)
+{
+}
+
+static void
+data_device_motion(void *data, struct wl_data_device *device,
+		   uint32_t time, wl_fixed_t x, wl_fixed_t y)
+{
+}
+
+static void
+data_device_drop(void *data, struct wl_data_device *device)
+{
+}
+
+static void
+data_device_selection(void *data, struct wl_data_device *device,
+		      struct wl_data_offer *offer)
+{
+	struct selection_reader *reader = data;
+
+	if (reader->offer)
+		wl_data_offer_destroy(reader->offer);
+
+	reader->offer = offer;
+	reader->got_selection = true;
+}
+
+static const struct wl_data_device_listener data_device_listener = {
+	.data_offer = data_device_data_offer,
+	.enter = data_device_enter,
+	.leave = data_device_leave,
+	.motion = data_device_motion,
+	.drop = data_device_drop,
+	.selection = data_device_selection,
+};
+
+static void
+selection_reader_init(struct selection_reader *reader)
+{
+	reader->client = create_client_and_test_surface(20, 20, 1, 1);
+	reader->manager = bind_to_singleton_global(reader->client,
+						   &wl_data_device_manager_interface,
+						   3);
+	reader->device =
+		wl_data_device_manager_get_data_device(reader->manager,
+						       reader->client->input->wl_seat);
+	wl_data_device_add_listener(reader->device, &data_device_listener,
+				    reader);
+	client_roundtrip(reader->client);
+
+	/* The selection is sent along with the keyboard focus */
+	reader->got_selection = false;
+	weston_test_activate_surface(reader->client->test->weston_test,
+				     reader->client->surface->wl_surface);
+	while (!reader->got_selection)
+		assert(wl_display_dispatch(reader->client->wl_display) >= 0);
+}
+
+static void
+selection_reader_fini(struct selection_reader *reader)
+{
+	if (reader->offer)
+		wl_data_offer_destroy(reader->offer);
+	wl_data_device_release(reader->device);
+	wl_data_device_manager_destroy(reader->manager);
+	client_destroy(reader->client);
+}
+
+TEST(kept_selection_streams_to_slow_reader)
+{
+	struct selection_reader reader = {};
+	uint8_t buf[4096];
+	size_t received = 0;
+	ssize_t ret;
+	ssize_t i;
+	int p[2];
+
+	signal(SIGPIPE, SIG_IGN);
+
+	set_selection_and_leave(KEPT_SIZE);
+
+	selection_reader_init(&reader);
+	assert(reader.offer);
+
+	assert(pipe2(p, O_CLOEXEC) == 0);
+	wl_data_offer_receive(reader.offer, mime_type, p[1]);
+	close(p[1]);
+	client_roundtrip(reader.client);
+
+	/* Let the pipe fill up, so that the compositor has to wait for us
+	 * instead of writing everything in one go. */
+	usleep(100 * 1000);
+
+	for (;;) {
+		ret = read(p[0], buf, sizeof buf);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		assert(ret >= 0);
+		if (ret == 0)
+			break;
+
+		for (i = 0; i < ret; i++)
+			assert(buf[i] == pattern_byte(received + i));
+		received += ret;
+
+		usleep(1000);
+	}
+
+	close(p[0]);
+	testlog("received %zu bytes of %d\n", received, KEPT_SIZE);
+	assert(received == KEPT_SIZE);
+
+	selection_reader_fini(&reader);
+}
+
+TEST(oversized_selection_is_not_kept)
+{
+	struct selection_reader reader = {};
+
+	signal(SIGPIPE, SIG_IGN);
+
+	set_selection_and_leave(DROPPED_SIZE);
+
+	selection_reader_init(&reader);
+	assert(reader.offer == NULL);
+
+	selection_reader_fini(&reader);
+}
@@ -136,6 +136,7 @@ const struct lcms_pipeline pipeline_BT2020 = {
 
 struct setup_args {
 	struct fixture_metadata meta;
+	enum weston_renderer_type renderer;
 	int ref_image_index;
 	const struct lcms_pipeline *pipeline;
 
@@ -169,19 +170,39 @@ struct setup_args {
 	double vcgt_exponents[COLOR_CHAN_NUM];
 };
 
+#define GL WESTON_RENDERER_GL
+#define PIXMAN WESTON_RENDERER_PIXMAN
+
+/*
+ * The pixman renderer does the same color transformations on the CPU, with
+ * the same LUT interpolation as GL, so it is held to the same tolerances
+ * and reference images.
+ */
 static const struct setup_args my_setup_args[] = {
-	/* name,                    ref img, pipeline,     tolerance, dim, profile type, clut tolerance, vcgt_exponents */
-	{ { "sRGB->sRGB MAT" },           0, &pipeline_sRGB,     0.0,  0, PTYPE_MATRIX_SHAPER },
-	{ { "sRGB->sRGB MAT VCGT" },      3, &pipeline_sRGB,     0.8,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
-	{ { "sRGB->adobeRGB MAT" },       1, &pipeline_adobeRGB, 1.4,  0, PTYPE_MATRIX_SHAPER },
-	{ { "sRGB->adobeRGB MAT VCGT" },  4, &pipeline_adobeRGB, 1.0,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
-	{ { "sRGB->BT2020 MAT" },         2, &pipeline_BT2020,   4.5,  0, PTYPE_MATRIX_SHAPER },
-	{ { "sRGB->sRGB CLUT" },          0, &pipeline_sRGB,     0.0, 17, PTYPE_CLUT,          0.0005 },
-	{ { "sRGB->sRGB CLUT VCGT" },     3, &pipeline_sRGB,     0.9, 17, PTYPE_CLUT,          0.0005,   {1.1, 1.2, 1.3} },
-	{ { "sRGB->adobeRGB CLUT" },      1, &pipeline_adobeRGB, 1.8, 17, PTYPE_CLUT,          0.0065 },
-	{ { "sRGB->adobeRGB CLUT VCGT" }, 4, &pipeline_adobeRGB, 1.1, 17, PTYPE_CLUT,          0.0065,   {1.1, 1.2, 1.3} },
+	/* name,                           renderer, ref img, pipeline,     tolerance, dim, profile type, clut tolerance, vcgt_exponents */
+	{ { "sRGB->sRGB MAT" },                  GL,     0, &pipeline_sRGB,     0.0,  0, PTYPE_MATRIX_SHAPER },
+	{ { "sRGB->sRGB MAT VCGT" },             GL,     3, &pipeline_sRGB,     0.8,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
+	{ { "sRGB->adobeRGB MAT" },              GL,     1, &pipeline_adobeRGB, 1.4,  0, PTYPE_MATRIX_SHAPER },
+	{ { "sRGB->adobeRGB MAT VCGT" },         GL,     4, &pipeline_adobeRGB, 1.0,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
+	{ { "sRGB->BT2020 MAT" },                GL,     2, &pipeline_BT2020,   4.5,  0, PTYPE_MATRIX_SHAPER },
+	{ { "sRGB->sRGB CLUT" },                 GL,     0, &pipeline_sRGB,     0.0, 17, PTYPE_CLUT,          0.0005 },
+	{ { "sRGB->sRGB CLUT VCGT" },            GL,     3, &pipeline_sRGB,     0.9, 17, PTYPE_CLUT,          0.0005,   {1.1, 1.2, 1.3} },
+	{ { "sRGB->adobeRGB CLUT" },             GL,     1, &pipeline_adobeRGB, 1.8, 17, PTYPE_CLUT,          0.0065 },
+	{ { "sRGB->adobeRGB CLUT VCGT" },        GL,     4, &pipeline_adobeRGB, 1.1, 17, PTYPE_CLUT,          0.0065,   {1.1, 1.2, 1.3} },
+	{ { "pixman sRGB->sRGB MAT" },           PIXMAN, 0, &pipeline_sRGB,     0.0,  0, PTYPE_MATRIX_SHAPER },
+	{ { "pixman sRGB->sRGB MAT VCGT" },      PIXMAN, 3, &pipeline_sRGB,     0.8,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
+	{ { "pixman sRGB->adobeRGB MAT" },       PIXMAN, 1, &pipeline_adobeRGB, 1.4,  0, PTYPE_MATRIX_SHAPER },
+	{ { "pixman sRGB->adobeRGB MAT VCGT" },  PIXMAN, 4, &pipeline_adobeRGB, 1.0,  0, PTYPE_MATRIX_SHAPER, 0.0000,   {1.1, 1.2, 1.3} },
+	{ { "pixman sRGB->BT2020 MAT" },         PIXMAN, 2, &pipeline_BT2020,   4.5,  0, PTYPE_MATRIX_SHAPER },
+	{ { "pixman sRGB->sRGB CLUT" },          PIXMAN, 0, &pipeline_sRGB,     0.0, 17, PTYPE_CLUT,          0.0005 },
+	{ { "pixman sRGB->sRGB CLUT VCGT" },     PIXMAN, 3, &pipeline_sRGB,     0.9, 17, PTYPE_CLUT,          0.0005,   {1.1, 1.2, 1.3} },
+	{ { "pixman sRGB->adobeRGB CLUT" },      PIXMAN, 1, &pipeline_adobeRGB, 1.8, 17, PTYPE_CLUT,          0.0065 },
+	{ { "pixman sRGB->adobeRGB CLUT VCGT" }, PIXMAN, 4, &pipeline_adobeRGB, 1.1, 17, PTYPE_CLUT,          0.0065,   {1.1, 1.2, 1.3} },
 };
 
+#undef GL
+#undef PIXMAN
+
 static void
 test_roundtrip(uint8_t r, uint8_t g, uint8_t b, cmsPipeline *pip,
 	       struct rgb_diff_stat *stat)
@@ -471,7 +492,7 @@ fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 	cmsSetLogErrorHandler(test_lcms_error_logger);
 
 	compositor_setup_defaults(&setup);
-	setup.renderer = WESTON_RENDERER_GL;
+	setup.renderer = arg->renderer;
 	setup.backend = WESTON_BACKEND_HEADLESS;
 	setup.width = WINDOW_WIDTH;
 	setup.height = WINDOW_HEIGHT;
@@ -482,9 +503,11 @@ fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 	if (!file_name)
 		return RESULT_HARD_ERROR;
 
+	/* The pixman renderer does not draw output decorations */
 	weston_ini_setup(&setup,
 		cfgln("[core]"),
-		cfgln("output-decorations=true"),
+		cfgln("output-decorations=%s",
+		      arg->renderer == WESTON_RENDERER_GL ? "true" : "false"),
 		cfgln("color-management=true"),
 		cfgln("[output]"),
 		cfgln("name=headless"),
@@ -911,6 +934,12 @@ TEST(output_icc_decorations)
 	pixman_image_t *img;
 	bool match;
 
+	if (arg->renderer != WESTON_RENDERER_GL) {
+		testlog("%s: no output decorations with this renderer\n",
+			__func__);
+		return;
+	}
+
 	client = create_client();
 
 	shot = client_capture_output(client, client->output,
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <drm_fourcc.h>
+#ifdef HAVE_LINUX_UDMABUF_H
+#include <linux/udmabuf.h>
+#endif
+
+#include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "image-iter.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+
+#define BUFFER_SIZE 256
+
+static bool
+have_udmabuf(void)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	int fd;
+
+	fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	close(fd);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	/* The client side of the test wraps udmabufs */
+	if (!have_udmabuf())
+		return RESULT_SKIP;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.backend = WESTON_BACKEND_DRM;
+	setup.renderer = WESTON_RENDERER_GL;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct udmabuf {
+	int fd;
+	void *data;
+	size_t size;
+	uint32_t stride;
+};
+
+static struct udmabuf *
+udmabuf_create(uint32_t xrgb)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	struct udmabuf_create create = { 0 };
+	struct udmabuf *buf;
+	uint32_t *pixel;
+	int memfd, dev;
+	size_t i;
+
+	buf = xzalloc(sizeof *buf);
+	buf->stride = BUFFER_SIZE * 4;
+	buf->size = buf->stride * BUFFER_SIZE;
+
+	memfd = os_create_anonymous_file(buf->size);
+	assert(memfd >= 0);
+
+	buf->data = mmap(NULL, buf->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 memfd, 0);
+	assert(buf->data != MAP_FAILED);
+	for (pixel = buf->data, i = 0; i < buf->size / 4; i++)
+		pixel[i] = xrgb;
+
+	dev = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	assert(dev >= 0);
+
+	create.memfd = memfd;
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.offset = 0;
+	create.size = buf->size;
+	buf->fd = ioctl(dev, UDMABUF_CREATE, &create);
+	assert(buf->fd >= 0);
+
+	close(dev);
+	close(memfd);
+
+	return buf;
+#else
+	assert(0 && "udmabuf support was not built in");
+	return NULL;
+#endif
+}
+
+static void
+udmabuf_destroy(struct udmabuf *buf)
+{
+	close(buf->fd);
+	assert(munmap(buf->data, buf->size) == 0);
+	free(buf);
+}
+
+/* A new wl_buffer around the same dmabuf, the way video clients recycle
+ * their buffers */
+static struct wl_buffer *
+udmabuf_wrap(struct zwp_linux_dmabuf_v1 *dmabuf, struct udmabuf *buf)
+{
+	struct zwp_linux_buffer_params_v1 *params;
+	struct wl_buffer *buffer;
+
+	params = zwp_linux_dmabuf_v1_create_params(dmabuf);
+	zwp_linux_buffer_params_v1_add(params, buf->fd, 0, 0, buf->stride,
+				       DRM_FORMAT_MOD_LINEAR >> 32,
+				       DRM_FORMAT_MOD_LINEAR & 0xffffffff);
+	buffer = zwp_linux_buffer_params_v1_create_immed(params,
+							 BUFFER_SIZE,
+							 BUFFER_SIZE,
+							 DRM_FORMAT_XRGB8888,
+							 0);
+	zwp_linux_buffer_params_v1_destroy(params);
+	assert(buffer);
+
+	return buffer;
+}
+
+static void
+show_udmabuf(struct client *client, struct zwp_linux_dmabuf_v1 *dmabuf,
+	     struct udmabuf *buf, int frames)
+{
+	struct wl_surface *surface = client->surface->wl_surface;
+	struct wl_buffer *buffer, *prev = NULL;
+	int i, done;
+
+	for (i = 0; i < frames; i++) {
+		buffer = udmabuf_wrap(dmabuf, buf);
+
+		wl_surface_attach(surface, buffer, 0, 0);
+		wl_surface_damage(surface, 0, 0, BUFFER_SIZE, BUFFER_SIZE);
+		frame_callback_set(surface, &done);
+		wl_surface_commit(surface);
+		frame_callback_wait(client, &done);
+
+		if (prev)
+			wl_buffer_destroy(prev);
+		prev = buffer;
+	}
+
+	/* No protocol error from the dmabuf import */
+	assert(wl_display_roundtrip(client->wl_display) >= 0);
+
+	wl_buffer_destroy(prev);
+}
+
+static void
+check_screen_color(struct client *client, uint32_t xrgb)
+{
+	struct buffer *shot;
+	struct image_header ih;
+	uint32_t *row;
+
+	shot = capture_screenshot_of_output(client, NULL);
+	ih = image_header_from(shot->image);
+	row = image_header_get_row_u32(&ih, BUFFER_SIZE / 2);
+
+	testlog("pixel 0x%08x, expected 0x%08x\n",
+		row[BUFFER_SIZE / 2], xrgb);
+	assert((row[BUFFER_SIZE / 2] & 0xffffff) == (xrgb & 0xffffff));
+
+	buffer_destroy(shot);
+}
+
+static struct client *
+create_dmabuf_client(struct zwp_linux_dmabuf_v1 **dmabuf)
+{
+	struct client *client;
+
+	client = create_client();
+	client->surface = create_test_surface(client);
+	client->surface->width = BUFFER_SIZE;
+	client->surface->height = BUFFER_SIZE;
+	weston_test_move_surface(client->test->weston_test,
+				 client->surface->wl_surface, 0, 0);
+
+	*dmabuf = bind_to_singleton_global(client,
+					   &zwp_linux_dmabuf_v1_interface, 3);
+
+	return client;
+}
+
+/*
+ * The same dmabuf wrapped in a new wl_buffer every frame keeps showing
+ * its content, which comes from a cached framebuffer when the view is on
+ * a plane. The cache hit rate is in the drm-backend debug scope.
+ */
+TEST(recycled_dmabuf_is_shown)
+{
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	struct client *client;
+	struct udmabuf *buf;
+
+	client = create_dmabuf_client(&dmabuf);
+	buf = udmabuf_create(0xffff0000);
+
+	show_udmabuf(client, dmabuf, buf, 8);
+	check_screen_color(client, 0xffff0000);
+
+	udmabuf_destroy(buf);
+	zwp_linux_dmabuf_v1_destroy(dmabuf);
+	client_destroy(client);
+}
+
+/*
+ * Framebuffers cached for a client go away with it, and a new client's
+ * dmabufs get framebuffers of their own.
+ */
+TEST(cached_fb_does_not_outlive_client)
+{
+	static const uint32_t colors[] = { 0xffff0000, 0xff00ff00, 0xff0000ff };
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	struct client *client;
+	struct udmabuf *buf;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(colors); i++) {
+		client = create_dmabuf_client(&dmabuf);
+		buf = udmabuf_create(colors[i]);
+
+		show_udmabuf(client, dmabuf, buf, 4);
+		check_screen_color(client, colors[i]);
+
+		zwp_linux_dmabuf_v1_destroy(dmabuf);
+		client_destroy(client);
+		udmabuf_destroy(buf);
+	}
+}
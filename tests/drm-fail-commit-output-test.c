@@ -0,0 +1,163 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "shared/string-helpers.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+/* Name of the output whose atomic commits the backend is told to fail. */
+static char *failing_output;
+
+static char *
+find_second_connected_connector(const char *drm_device)
+{
+	char path[64];
+	drmModeRes *res;
+	drmModeConnector *conn;
+	const char *type_name;
+	char *name = NULL;
+	int connected = 0;
+	int fd;
+	int i;
+
+	snprintf(path, sizeof path, "/dev/dri/%s", drm_device);
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	res = drmModeGetResources(fd);
+	if (!res) {
+		close(fd);
+		return NULL;
+	}
+
+	for (i = 0; i < res->count_connectors && !name; i++) {
+		conn = drmModeGetConnector(fd, res->connectors[i]);
+		if (!conn)
+			continue;
+
+		if (conn->connection == DRM_MODE_CONNECTED &&
+		    ++connected == 2) {
+			type_name = drmModeGetConnectorTypeName(conn->connector_type);
+			str_printf(&name, "%s-%d", type_name ? type_name : "UNNAMED",
+				   conn->connector_type_id);
+		}
+
+		drmModeFreeConnector(conn);
+	}
+
+	drmModeFreeResources(res);
+	close(fd);
+
+	return name;
+}
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+	const char *drm_device;
+
+	drm_device = getenv("WESTON_TEST_SUITE_DRM_DEVICE");
+	if (drm_device)
+		failing_output = find_second_connected_connector(drm_device);
+
+	if (!failing_output) {
+		fprintf(stderr, "Skipping: need a DRM device with at least "
+			"two connected connectors.\n");
+		return RESULT_SKIP;
+	}
+
+	/* The hook only exists on the atomic path. */
+	unsetenv("WESTON_DISABLE_ATOMIC");
+	setenv("WESTON_DRM_FAIL_COMMIT_OUTPUT", failing_output, 1);
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.backend = WESTON_BACKEND_DRM;
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/*
+ * One output has every atomic commit rejected. Commits are per output, so
+ * the other output must keep presenting: a surface on it keeps getting
+ * frame callbacks, which only fire once its output has finished a frame.
+ */
+TEST(healthy_output_keeps_presenting) {
+	struct client *client;
+	struct output *output;
+	struct output *healthy = NULL;
+	struct surface *surface;
+	pixman_color_t red;
+	int i, frame;
+
+	client = create_client();
+	assert(client);
+
+	wl_list_for_each(output, &client->output_list, link) {
+		assert(output->name);
+		if (strcmp(output->name, failing_output) != 0) {
+			healthy = output;
+			break;
+		}
+	}
+	assert(healthy);
+
+	color_rgb888(&red, 255, 0, 0);
+
+	surface = create_test_surface(client);
+	surface->width = 200;
+	surface->height = 200;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, 200, 200);
+	fill_image_with_color(surface->buffer->image, &red);
+	client->surface = surface;
+
+	move_client(client, healthy->x, healthy->y);
+
+	for (i = 0; i < 10; i++) {
+		wl_surface_attach(surface->wl_surface,
+				  surface->buffer->proxy, 0, 0);
+		wl_surface_damage(surface->wl_surface, 0, 0, 200, 200);
+		frame_callback_set(surface->wl_surface, &frame);
+		wl_surface_commit(surface->wl_surface);
+		frame_callback_wait(client, &frame);
+	}
+
+	client_destroy(client);
+	free(failing_output);
+}
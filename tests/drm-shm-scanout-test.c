@@ -0,0 +1,144 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <drm_fourcc.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "image-iter.h"
+#include "weston-output-capture-client-protocol.h"
+
+#define BLOCK_SIZE 64
+#define BLOCK_COUNT 6
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.backend = WESTON_BACKEND_DRM;
+	/* Without GL the backend never tries planes. */
+	setup.renderer = WESTON_RENDERER_GL;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("shm-scanout=true"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+fill_rect(pixman_image_t *image, int x, int y, int width, int height,
+	  uint32_t xrgb)
+{
+	pixman_color_t color;
+	pixman_rectangle16_t rect = { x, y, width, height };
+
+	color_rgb888(&color, (xrgb >> 16) & 0xff, (xrgb >> 8) & 0xff,
+		     xrgb & 0xff);
+	pixman_image_fill_rectangles(PIXMAN_OP_SRC, image, &color, 1, &rect);
+}
+
+static void
+check_pixel(const struct image_header *ih, int x, int y, uint32_t xrgb)
+{
+	uint32_t *row = image_header_get_row_u32(ih, y);
+
+	testlog("pixel %d,%d 0x%08x, expected 0x%08x\n", x, y, row[x], xrgb);
+	assert((row[x] & 0xffffff) == (xrgb & 0xffffff));
+}
+
+/*
+ * A fullscreen SHM client goes on the scanout plane through two dumb
+ * buffers that take turns, and only damaged rectangles get copied. Each
+ * frame repaints a single block; every block painted so far must stay on
+ * screen, whichever of the two buffers is showing, and the undamaged
+ * background must not change. Writeback captures what the CRTC scans out,
+ * so the planes stay in use while checking.
+ */
+TEST(partial_damage_reaches_both_scanout_buffers)
+{
+	struct client *client;
+	struct surface *surface;
+	struct buffer *shot;
+	struct image_header ih;
+	int width, height;
+	int i, k, done;
+
+	client = create_client();
+	width = client->output->width;
+	height = client->output->height;
+	assert(width >= BLOCK_SIZE * (BLOCK_COUNT + 1));
+	assert(height >= BLOCK_SIZE * (BLOCK_COUNT + 1));
+
+	surface = create_test_surface(client);
+	surface->width = width;
+	surface->height = height;
+	surface->buffer = create_shm_buffer(client, width, height,
+					    DRM_FORMAT_XRGB8888);
+	fill_rect(surface->buffer->image, 0, 0, width, height, 0xffff0000);
+	client->surface = surface;
+
+	move_client(client, client->output->x, client->output->y);
+	weston_test_move_pointer(client->test->weston_test, 0, 1, 0,
+				 width - 1, height - 1);
+
+	for (i = 0; i < BLOCK_COUNT; i++) {
+		fill_rect(surface->buffer->image, i * BLOCK_SIZE,
+			  i * BLOCK_SIZE, BLOCK_SIZE, BLOCK_SIZE, 0xff0000ff);
+
+		wl_surface_attach(surface->wl_surface,
+				  surface->buffer->proxy, 0, 0);
+		wl_surface_damage_buffer(surface->wl_surface, i * BLOCK_SIZE,
+					 i * BLOCK_SIZE, BLOCK_SIZE,
+					 BLOCK_SIZE);
+		frame_callback_set(surface->wl_surface, &done);
+		wl_surface_commit(surface->wl_surface);
+		frame_callback_wait(client, &done);
+
+		shot = client_capture_output(client, client->output,
+					     WESTON_CAPTURE_V1_SOURCE_WRITEBACK);
+		ih = image_header_from(shot->image);
+
+		for (k = 0; k <= i; k++)
+			check_pixel(&ih, k * BLOCK_SIZE + BLOCK_SIZE / 2,
+				    k * BLOCK_SIZE + BLOCK_SIZE / 2,
+				    0xff0000ff);
+		check_pixel(&ih, width - BLOCK_SIZE / 2, BLOCK_SIZE / 2,
+			    0xffff0000);
+		check_pixel(&ih, BLOCK_SIZE / 2, height - BLOCK_SIZE / 2,
+			    0xffff0000);
+
+		buffer_destroy(shot);
+	}
+
+	client_destroy(client);
+}
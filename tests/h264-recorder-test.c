@@ -0,0 +1,161 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/stat.h>
+
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+/* Where the Super+Shift+R binding of the frontend records to */
+#define CAPTURE_FILE "capture.h264"
+
+#define NAL_SLICE	1
+#define NAL_IDR		5
+#define NAL_SPS		7
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	/* The recording must not depend on a VA-API capable GPU */
+	setenv("WESTON_RECORDER_FORCE_X264", "1", 1);
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static void
+send_key(struct client *client, uint32_t key, uint32_t state)
+{
+	static const struct timespec t = { .tv_sec = 1, .tv_nsec = 1000001 };
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_to_proto(&t, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_send_key(client->test->weston_test, tv_sec_hi, tv_sec_lo,
+			     tv_nsec, key, state);
+}
+
+static void
+toggle_recording(struct client *client)
+{
+	send_key(client, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(client, KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(client, KEY_R, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(client, KEY_R, WL_KEYBOARD_KEY_STATE_RELEASED);
+	send_key(client, KEY_LEFTSHIFT, WL_KEYBOARD_KEY_STATE_RELEASED);
+	send_key(client, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+	client_roundtrip(client);
+}
+
+/* Every commit damages the surface, so every repaint is a new frame */
+static void
+commit_frames(struct client *client, int count)
+{
+	struct surface *surface = client->surface;
+	int i, done;
+
+	for (i = 0; i < count; i++) {
+		wl_surface_attach(surface->wl_surface,
+				  surface->buffer->proxy, 0, 0);
+		wl_surface_damage(surface->wl_surface, 0, 0,
+				  surface->width, surface->height);
+		frame_callback_set(surface->wl_surface, &done);
+		wl_surface_commit(surface->wl_surface);
+		frame_callback_wait(client, &done);
+	}
+}
+
+TEST(software_encoder_records_frames)
+{
+	struct client *client;
+	uint8_t *data;
+	struct stat st;
+	int nal_type, pictures = 0, idr = 0;
+	off_t i;
+	int fd;
+
+	unlink(CAPTURE_FILE);
+
+	client = create_client_and_test_surface(0, 0, 64, 64);
+	weston_test_activate_surface(client->test->weston_test,
+				     client->surface->wl_surface);
+	client_roundtrip(client);
+
+	toggle_recording(client);
+	commit_frames(client, 10);
+
+	/* The recorder finishes the file on the next repaint */
+	toggle_recording(client);
+	commit_frames(client, 1);
+
+	fd = open(CAPTURE_FILE, O_RDONLY | O_CLOEXEC);
+	assert(fd >= 0);
+	assert(fstat(fd, &st) == 0);
+	testlog("%s is %jd bytes\n", CAPTURE_FILE, (intmax_t) st.st_size);
+	assert(st.st_size > 5);
+
+	data = xzalloc(st.st_size);
+	assert(read(fd, data, st.st_size) == st.st_size);
+	close(fd);
+
+	/* An Annex B stream, which starts with its parameter sets */
+	assert(data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+	assert((data[4] & 0x1f) == NAL_SPS);
+
+	for (i = 0; i + 3 < st.st_size; i++) {
+		if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+			continue;
+
+		nal_type = data[i + 3] & 0x1f;
+		if (nal_type == NAL_IDR)
+			idr++;
+		if (nal_type == NAL_IDR || nal_type == NAL_SLICE)
+			pictures++;
+	}
+
+	testlog("%d pictures, %d of them IDR\n", pictures, idr);
+	assert(idr >= 1);
+	assert(pictures > 1);
+
+	free(data);
+	unlink(CAPTURE_FILE);
+	client_destroy(client);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "image-iter.h"
+
+static bool
+have_udmabuf(void)
+{
+	int fd;
+
+	fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	close(fd);
+
+	return true;
+}
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	static const char * const backend_args[] = { "--gl-dmabuf", NULL };
+	struct compositor_setup setup;
+
+	/* The output dmabufs are allocated from udmabuf without a render
+	 * node */
+	if (!have_udmabuf())
+		return RESULT_SKIP;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_GL;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.backend_args = backend_args;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static uint32_t
+get_pixel(pixman_image_t *image, int x, int y)
+{
+	struct image_header ih = image_header_from(image);
+	uint32_t pixel = image_header_get_row_u32(&ih, y)[x];
+
+	testlog("pixel at %d,%d: 0x%08x\n", x, y, pixel);
+
+	return pixel & 0xffffff;
+}
+
+/*
+ * The GL renderer draws into a dmabuf renderbuffer, and reads it back for
+ * screenshots like it does from a pbuffer.
+ */
+TEST(gl_dmabuf_output_renders)
+{
+	struct client *client;
+	struct buffer *shot;
+	pixman_color_t red;
+	int frame;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client_and_test_surface(20, 20, 100, 100);
+	fill_image_with_color(client->surface->buffer->image, &red);
+
+	wl_surface_attach(client->surface->wl_surface,
+			  client->surface->buffer->proxy, 0, 0);
+	wl_surface_damage(client->surface->wl_surface, 0, 0, 100, 100);
+	frame_callback_set(client->surface->wl_surface, &frame);
+	wl_surface_commit(client->surface->wl_surface);
+	frame_callback_wait(client, &frame);
+
+	shot = capture_screenshot_of_output(client, NULL);
+
+	/* The surface, and the test shell background around it */
+	assert(get_pixel(shot->image, 70, 70) == 0xff0000);
+	assert(get_pixel(shot->image, 5, 5) != 0xff0000);
+
+	buffer_destroy(shot);
+	client_destroy(client);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+/* 20 Hz */
+#define PERIOD_MSEC 50
+#define FRAMES 10
+
+struct setup_args {
+	struct fixture_metadata meta;
+	const char *pacing;
+	const char * const *backend_args;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.meta.name = "fixed",
+		.pacing = "fixed",
+		.backend_args = (const char * const []) {
+			"--refresh-rate=20000", "--pacing=fixed", NULL
+		},
+	},
+	{
+		.meta.name = "asap",
+		.pacing = "asap",
+		.backend_args = (const char * const []) {
+			"--refresh-rate=20000", "--pacing=asap", NULL
+		},
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.backend_args = arg->backend_args;
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+/*
+ * A client which redraws on every frame callback is paced by the virtual
+ * vblank of the refresh rate with fixed pacing, and only by the rendering
+ * with asap pacing.
+ */
+TEST(frame_interval_follows_pacing)
+{
+	const struct setup_args *arg = &my_setup_args[get_test_fixture_index()];
+	struct client *client;
+	struct wl_surface *surface;
+	struct timespec first, last;
+	int64_t interval;
+	int i, frame;
+
+	client = create_client_and_test_surface(0, 0, 100, 100);
+	surface = client->surface->wl_surface;
+
+	for (i = 0; i < FRAMES; i++) {
+		wl_surface_attach(surface, client->surface->buffer->proxy, 0, 0);
+		wl_surface_damage(surface, 0, 0, 100, 100);
+		frame_callback_set(surface, &frame);
+		wl_surface_commit(surface);
+		frame_callback_wait(client, &frame);
+
+		clock_gettime(CLOCK_MONOTONIC, &last);
+		if (i == 0)
+			first = last;
+	}
+
+	interval = timespec_sub_to_msec(&last, &first) / (FRAMES - 1);
+	testlog("%s pacing: %" PRId64 " ms between frames, refresh period "
+		"%d ms\n", arg->pacing, interval, PERIOD_MSEC);
+
+	if (strcmp(arg->pacing, "fixed") == 0)
+		assert(interval >= PERIOD_MSEC - 1);
+	else
+		assert(interval < PERIOD_MSEC / 2);
+
+	client_destroy(client);
+}
@@ -61,6 +61,13 @@ struct test_context {
 	struct wl_listener layer_property_changed;
 	struct wl_listener layer_created;
 	struct wl_listener layer_removed;
+
+	struct order_listener {
+		struct wl_listener listener;
+		struct test_context *ctx;
+	} layer_order_changed[IVI_TEST_LAYER_COUNT];
+	uint32_t notified_ids[IVI_TEST_LAYER_COUNT];
+	uint32_t notified_count;
 };
 
 static void
@@ -418,6 +425,91 @@ test_get_layer_after_destory_layer(struct test_context *ctx)
 	iassert(ivilayer == NULL);
 }
 
+static void
+test_get_layers_from_id_after_destroy_layer(struct test_context *ctx)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+#define LAYER_NUM (64)
+	struct ivi_layout_layer *ivilayers[LAYER_NUM] = {};
+	uint32_t i;
+
+	for (i = 0; i < LAYER_NUM; i++) {
+		ivilayers[i] = lyt->layer_create_with_dimension(
+					IVI_TEST_LAYER_ID(i), 200, 300);
+		iassert(ivilayers[i] != NULL);
+	}
+
+	/* Destroy every other layer, the rest must still be found. */
+	for (i = 0; i < LAYER_NUM; i += 2)
+		lyt->layer_destroy(ivilayers[i]);
+
+	for (i = 0; i < LAYER_NUM; i++) {
+		if (i % 2 == 0)
+			iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) == NULL);
+		else
+			iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) == ivilayers[i]);
+	}
+
+	for (i = 1; i < LAYER_NUM; i += 2)
+		lyt->layer_destroy(ivilayers[i]);
+
+	for (i = 0; i < LAYER_NUM; i++)
+		iassert(lyt->get_layer_from_id(IVI_TEST_LAYER_ID(i)) == NULL);
+#undef LAYER_NUM
+}
+
+static void
+test_commit_changes_only_dirty_layers(struct test_context *ctx)
+{
+#define LAYER_NUM (2)
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer *ivilayers[LAYER_NUM] = {};
+	const struct ivi_layout_layer_properties *prop[LAYER_NUM];
+	uint32_t i;
+
+	for (i = 0; i < LAYER_NUM; i++) {
+		ivilayers[i] = lyt->layer_create_with_dimension(
+					IVI_TEST_LAYER_ID(i), 200, 300);
+		iassert(ivilayers[i] != NULL);
+		prop[i] = lyt->get_properties_of_layer(ivilayers[i]);
+	}
+
+	lyt->commit_changes();
+
+	/* Bypass the setter, so that the layer is not marked dirty and
+	 * commit_changes() must not look at its pending state. */
+	ivilayers[0]->pending.prop.opacity = wl_fixed_from_double(0.5);
+	iassert(lyt->layer_set_opacity(
+		ivilayers[1], wl_fixed_from_double(0.3)) == IVI_SUCCEEDED);
+
+	lyt->commit_changes();
+
+	iassert(prop[0]->opacity == wl_fixed_from_double(1.0));
+	iassert(prop[1]->opacity == wl_fixed_from_double(0.3));
+
+	/* The notified layer stays dirty for one commit, to clear its
+	 * event_mask, and then drops off. */
+	iassert(wl_list_empty(&ivilayers[0]->dirty_link));
+	iassert(!wl_list_empty(&ivilayers[1]->dirty_link));
+
+	lyt->commit_changes();
+
+	iassert(wl_list_empty(&ivilayers[1]->dirty_link));
+	iassert(prop[1]->event_mask == 0);
+
+	/* Going through the setter picks the pending state up */
+	iassert(lyt->layer_set_opacity(
+		ivilayers[0], wl_fixed_from_double(0.5)) == IVI_SUCCEEDED);
+
+	lyt->commit_changes();
+
+	iassert(prop[0]->opacity == wl_fixed_from_double(0.5));
+
+	for (i = 0; i < LAYER_NUM; i++)
+		lyt->layer_destroy(ivilayers[i]);
+#undef LAYER_NUM
+}
+
 static void
 test_screen_render_order(struct test_context *ctx)
 {
@@ -647,6 +739,82 @@ test_layer_properties_changed_notification(struct test_context *ctx)
 	lyt->layer_destroy(ivilayer);
 }
 
+static void
+test_layer_notification_order_callback(struct wl_listener *listener, void *data)
+{
+	struct order_listener *ol =
+			container_of(listener, struct order_listener, listener);
+	struct test_context *ctx = ol->ctx;
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer *ivilayer = data;
+
+	if (!iassert(ctx->notified_count < IVI_TEST_LAYER_COUNT))
+		return;
+
+	ctx->notified_ids[ctx->notified_count++] =
+		lyt->get_id_of_layer(ivilayer);
+}
+
+static void
+test_layer_properties_changed_notification_order(struct test_context *ctx)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer *ivilayers[IVI_TEST_LAYER_COUNT] = {};
+	struct weston_output *output;
+	uint32_t i;
+
+	if (!iassert(!wl_list_empty(&ctx->compositor->output_list)))
+		return;
+
+	output = wl_container_of(ctx->compositor->output_list.next, output, link);
+
+	for (i = 0; i < IVI_TEST_LAYER_COUNT; i++) {
+		ivilayers[i] = lyt->layer_create_with_dimension(
+					IVI_TEST_LAYER_ID(i), 200, 300);
+		ctx->layer_order_changed[i].ctx = ctx;
+		ctx->layer_order_changed[i].listener.notify =
+			test_layer_notification_order_callback;
+		lyt->layer_add_listener(ivilayers[i],
+					&ctx->layer_order_changed[i].listener);
+	}
+
+	lyt->commit_changes();
+
+	/* Layers are notified in the order they were created, not in the
+	 * order they were changed in. */
+	ctx->notified_count = 0;
+	for (i = IVI_TEST_LAYER_COUNT; i-- > 0;)
+		lyt->layer_set_destination_rectangle(ivilayers[i],
+						     10, 20, 200, 300);
+
+	lyt->commit_changes();
+
+	iassert(ctx->notified_count == IVI_TEST_LAYER_COUNT);
+	for (i = 0; i < ctx->notified_count; i++)
+		iassert(ctx->notified_ids[i] == IVI_TEST_LAYER_ID(i));
+
+	/* Let the notified layers drop off the dirty list */
+	lyt->commit_changes();
+
+	/* That also holds for layers which only get an ADD event from
+	 * the screen during the commit. */
+	ctx->notified_count = 0;
+	lyt->layer_set_destination_rectangle(ivilayers[2], 30, 40, 200, 300);
+	lyt->screen_add_layer(output, ivilayers[1]);
+	lyt->screen_add_layer(output, ivilayers[0]);
+
+	lyt->commit_changes();
+
+	iassert(ctx->notified_count == IVI_TEST_LAYER_COUNT);
+	for (i = 0; i < ctx->notified_count; i++)
+		iassert(ctx->notified_ids[i] == IVI_TEST_LAYER_ID(i));
+
+	for (i = 0; i < IVI_TEST_LAYER_COUNT; i++) {
+		wl_list_remove(&ctx->layer_order_changed[i].listener.link);
+		lyt->layer_destroy(ivilayers[i]);
+	}
+}
+
 static void
 test_layer_create_notification_callback(struct wl_listener *listener, void *data)
 {
@@ -762,6 +930,8 @@ run_internal_tests(struct test_context *ctx)
 	test_commit_changes_after_destination_rectangle_set_layer_destroy(ctx);
 	test_layer_create_duplicate(ctx);
 	test_get_layer_after_destory_layer(ctx);
+	test_get_layers_from_id_after_destroy_layer(ctx);
+	test_commit_changes_only_dirty_layers(ctx);
 
 	test_screen_render_order(ctx);
 	test_screen_add_layers(ctx);
@@ -769,6 +939,7 @@ run_internal_tests(struct test_context *ctx)
 	test_commit_changes_after_render_order_set_layer_destroy(ctx);
 
 	test_layer_properties_changed_notification(ctx);
+	test_layer_properties_changed_notification_order(ctx);
 	test_layer_create_notification(ctx);
 	test_layer_remove_notification(ctx);
 }
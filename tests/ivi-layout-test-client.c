@@ -438,6 +438,32 @@ TEST(commit_changes_after_render_order_set_surface_destroy)
 	client_destroy(client);
 }
 
+TEST(ivi_layout_commit_changes_only_dirty)
+{
+	struct client *client;
+	struct runner *runner;
+	struct ivi_application *iviapp;
+	struct ivi_window *winds[IVI_TEST_SURFACE_COUNT];
+	uint32_t i;
+
+	client = create_client();
+	runner = client_create_runner(client);
+	iviapp = get_ivi_application(client);
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++)
+		winds[i] = client_create_ivi_window(client, iviapp,
+						    IVI_TEST_SURFACE_ID(i));
+
+	runner_run(runner, "surface_commit_changes_only_dirty");
+	runner_run(runner, "surface_properties_changed_notification_order");
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++)
+		ivi_window_destroy(winds[i]);
+	runner_destroy(runner);
+	ivi_application_destroy(iviapp);
+	client_destroy(client);
+}
+
 TEST(ivi_layout_surface_configure_notification)
 {
 	struct client *client;
@@ -40,6 +40,7 @@
 #include "weston-test-server-protocol.h"
 #include "ivi-test.h"
 #include "ivi-shell/ivi-layout-export.h"
+#include "ivi-shell/ivi-layout-private.h"
 #include "shared/helpers.h"
 
 struct test_context;
@@ -86,6 +87,13 @@ struct test_context {
 	struct wl_listener surface_created;
 	struct wl_listener surface_removed;
 	struct wl_listener surface_configured;
+
+	struct order_listener {
+		struct wl_listener listener;
+		struct test_context *ctx;
+	} surface_order_changed[IVI_TEST_SURFACE_COUNT];
+	uint32_t notified_ids[IVI_TEST_SURFACE_COUNT];
+	uint32_t notified_count;
 };
 
 struct test_launcher {
@@ -829,6 +837,130 @@ RUNNER_TEST(surface_properties_changed_notification)
 	runner_assert(ctx->user_flags == 0);
 }
 
+RUNNER_TEST(surface_commit_changes_only_dirty)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurfs[2] = {};
+	const struct ivi_layout_surface_properties *prop[2];
+	uint32_t i;
+
+	for (i = 0; i < 2; i++) {
+		ivisurfs[i] = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(i));
+		runner_assert_or_return(ivisurfs[i] != NULL);
+		prop[i] = lyt->get_properties_of_surface(ivisurfs[i]);
+	}
+
+	/* Anything notified about its creation stays dirty for one more
+	 * commit, so settle both surfaces first. */
+	lyt->commit_changes();
+	lyt->commit_changes();
+
+	for (i = 0; i < 2; i++)
+		runner_assert(wl_list_empty(&ivisurfs[i]->dirty_link));
+
+	/* Bypass the setter, so that the surface is not marked dirty and
+	 * commit_changes() must not look at its pending state. */
+	ivisurfs[0]->pending.prop.opacity = wl_fixed_from_double(0.5);
+	runner_assert(lyt->surface_set_opacity(
+		ivisurfs[1], wl_fixed_from_double(0.3)) == IVI_SUCCEEDED);
+
+	lyt->commit_changes();
+
+	runner_assert(prop[0]->opacity == wl_fixed_from_double(1.0));
+	runner_assert(prop[1]->opacity == wl_fixed_from_double(0.3));
+
+	/* The notified surface stays dirty for one commit, to clear its
+	 * event_mask, and then drops off. */
+	runner_assert(wl_list_empty(&ivisurfs[0]->dirty_link));
+	runner_assert(!wl_list_empty(&ivisurfs[1]->dirty_link));
+
+	lyt->commit_changes();
+
+	runner_assert(wl_list_empty(&ivisurfs[1]->dirty_link));
+	runner_assert(prop[1]->event_mask == 0);
+
+	/* Going through the setter picks the pending state up */
+	runner_assert(lyt->surface_set_opacity(
+		ivisurfs[0], wl_fixed_from_double(0.5)) == IVI_SUCCEEDED);
+
+	lyt->commit_changes();
+
+	runner_assert(prop[0]->opacity == wl_fixed_from_double(0.5));
+}
+
+static void
+test_surface_notification_order_callback(struct wl_listener *listener, void *data)
+{
+	struct order_listener *ol =
+			container_of(listener, struct order_listener, listener);
+	struct test_context *ctx = ol->ctx;
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf = data;
+
+	runner_assert_or_return(ctx->notified_count < IVI_TEST_SURFACE_COUNT);
+
+	ctx->notified_ids[ctx->notified_count++] =
+		lyt->get_id_of_surface(ivisurf);
+}
+
+RUNNER_TEST(surface_properties_changed_notification_order)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurfs[IVI_TEST_SURFACE_COUNT] = {};
+	struct ivi_layout_layer *ivilayer;
+	uint32_t i;
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0), 200, 300);
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++) {
+		ivisurfs[i] = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(i));
+		runner_assert_or_return(ivisurfs[i] != NULL);
+
+		ctx->surface_order_changed[i].ctx = ctx;
+		ctx->surface_order_changed[i].listener.notify =
+			test_surface_notification_order_callback;
+		lyt->surface_add_listener(ivisurfs[i],
+					  &ctx->surface_order_changed[i].listener);
+	}
+
+	lyt->commit_changes();
+
+	/* Surfaces are notified in the order they were created, not in
+	 * the order they were changed in. */
+	ctx->notified_count = 0;
+	for (i = IVI_TEST_SURFACE_COUNT; i-- > 0;)
+		lyt->surface_set_destination_rectangle(ivisurfs[i],
+						       10, 20, 200, 300);
+
+	lyt->commit_changes();
+
+	runner_assert(ctx->notified_count == IVI_TEST_SURFACE_COUNT);
+	for (i = 0; i < ctx->notified_count; i++)
+		runner_assert(ctx->notified_ids[i] == IVI_TEST_SURFACE_ID(i));
+
+	/* Let the notified surfaces drop off the dirty list */
+	lyt->commit_changes();
+
+	/* That also holds for surfaces which only get an ADD event from
+	 * a layer during the commit. */
+	ctx->notified_count = 0;
+	lyt->surface_set_destination_rectangle(ivisurfs[2], 30, 40, 200, 300);
+	lyt->layer_add_surface(ivilayer, ivisurfs[1]);
+	lyt->layer_add_surface(ivilayer, ivisurfs[0]);
+
+	lyt->commit_changes();
+
+	runner_assert(ctx->notified_count == IVI_TEST_SURFACE_COUNT);
+	for (i = 0; i < ctx->notified_count; i++)
+		runner_assert(ctx->notified_ids[i] == IVI_TEST_SURFACE_ID(i));
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++)
+		wl_list_remove(&ctx->surface_order_changed[i].listener.link);
+
+	lyt->layer_destroy(ivilayer);
+	lyt->commit_changes();
+}
+
 static void
 test_surface_configure_notification_callback(struct wl_listener *listener, void *data)
 {
@@ -0,0 +1,565 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+
+#include "shared/xalloc.h"
+#include "linux-explicit-synchronization-unstable-v1-client-protocol.h"
+#include "single-pixel-buffer-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "image-iter.h"
+
+/* The sw_sync debugfs interface, which is not part of the UAPI headers */
+#define SW_SYNC_PATH "/sys/kernel/debug/sync/sw_sync"
+
+struct sw_sync_create_fence_data {
+	__u32 value;
+	char name[32];
+	__s32 fence;
+};
+
+#define SW_SYNC_IOC_MAGIC 'W'
+#define SW_SYNC_IOC_CREATE_FENCE \
+	_IOWR(SW_SYNC_IOC_MAGIC, 0, struct sw_sync_create_fence_data)
+#define SW_SYNC_IOC_INC _IOW(SW_SYNC_IOC_MAGIC, 1, __u32)
+
+#define SURFACE_SIZE 100
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	/* Unsignalled fences come from a software sync timeline */
+	if (access(SW_SYNC_PATH, R_OK | W_OK) != 0)
+		return RESULT_SKIP;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("late-latch=true"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static int
+timeline_create(void)
+{
+	int fd;
+
+	fd = open(SW_SYNC_PATH, O_RDWR | O_CLOEXEC);
+	assert(fd >= 0);
+
+	return fd;
+}
+
+/* A fence which signals when the timeline reaches the given value */
+static int
+timeline_create_fence(int timeline, uint32_t value)
+{
+	struct sw_sync_create_fence_data data = { .value = value };
+
+	snprintf(data.name, sizeof data.name, "late-latch-%u", value);
+	assert(ioctl(timeline, SW_SYNC_IOC_CREATE_FENCE, &data) == 0);
+
+	return data.fence;
+}
+
+static void
+timeline_advance(int timeline)
+{
+	__u32 inc = 1;
+
+	assert(ioctl(timeline, SW_SYNC_IOC_INC, &inc) == 0);
+}
+
+struct latch_client {
+	struct client *client;
+	struct wl_surface *surface;
+	struct wp_viewport *viewport;
+	struct wp_single_pixel_buffer_manager_v1 *single_pixel;
+	struct zwp_linux_explicit_synchronization_v1 *sync;
+	struct zwp_linux_surface_synchronization_v1 *surface_sync;
+};
+
+/* A client whose surface has no role yet */
+static struct latch_client *
+latch_client_create_without_role(void)
+{
+	struct latch_client *lc = xzalloc(sizeof *lc);
+
+	lc->client = create_client();
+	lc->client->surface = create_test_surface(lc->client);
+	lc->surface = lc->client->surface->wl_surface;
+
+	lc->viewport = client_create_viewport(lc->client);
+	wp_viewport_set_destination(lc->viewport, SURFACE_SIZE, SURFACE_SIZE);
+
+	lc->single_pixel =
+		bind_to_singleton_global(lc->client,
+					 &wp_single_pixel_buffer_manager_v1_interface,
+					 1);
+	lc->sync =
+		bind_to_singleton_global(lc->client,
+					 &zwp_linux_explicit_synchronization_v1_interface,
+					 2);
+	lc->surface_sync =
+		zwp_linux_explicit_synchronization_v1_get_synchronization(
+			lc->sync, lc->surface);
+
+	return lc;
+}
+
+static struct latch_client *
+latch_client_create(void)
+{
+	struct latch_client *lc = latch_client_create_without_role();
+
+	weston_test_move_surface(lc->client->test->weston_test,
+				 lc->surface, 0, 0);
+
+	return lc;
+}
+
+static void
+latch_client_destroy(struct latch_client *lc)
+{
+	if (lc->surface_sync)
+		zwp_linux_surface_synchronization_v1_destroy(lc->surface_sync);
+	zwp_linux_explicit_synchronization_v1_destroy(lc->sync);
+	wp_single_pixel_buffer_manager_v1_destroy(lc->single_pixel);
+	wp_viewport_destroy(lc->viewport);
+	client_destroy(lc->client);
+	free(lc);
+}
+
+/* An opaque single pixel buffer, as acquire fences are refused for shm */
+static struct wl_buffer *
+create_solid_buffer(struct latch_client *lc, uint32_t xrgb)
+{
+	uint32_t r = (xrgb >> 16) & 0xff;
+	uint32_t g = (xrgb >> 8) & 0xff;
+	uint32_t b = xrgb & 0xff;
+
+	return wp_single_pixel_buffer_manager_v1_create_u32_rgba_buffer(
+			lc->single_pixel,
+			r * 0x01010101, g * 0x01010101, b * 0x01010101,
+			0xffffffff);
+}
+
+static void
+buffer_release_fenced_handler(void *data,
+			      struct zwp_linux_buffer_release_v1 *buffer_release,
+			      int32_t fence)
+{
+	assert(!"Fenced release not supported yet");
+}
+
+static void
+buffer_release_immediate_handler(void *data,
+				 struct zwp_linux_buffer_release_v1 *buffer_release)
+{
+	int *released = data;
+
+	*released += 1;
+	zwp_linux_buffer_release_v1_destroy(buffer_release);
+}
+
+static const struct zwp_linux_buffer_release_v1_listener buffer_release_listener = {
+	buffer_release_fenced_handler,
+	buffer_release_immediate_handler
+};
+
+/*
+ * Attach and commit a buffer, with an acquire fence unless fence is -1,
+ * counting its release events in *released unless that is NULL.
+ */
+static void
+commit_buffer(struct latch_client *lc, struct wl_buffer *buffer, int fence,
+	      int *released, int *frame)
+{
+	struct zwp_linux_buffer_release_v1 *buffer_release;
+
+	if (fence >= 0) {
+		zwp_linux_surface_synchronization_v1_set_acquire_fence(
+			lc->surface_sync, fence);
+		close(fence);
+	}
+
+	if (released) {
+		*released = 0;
+		buffer_release =
+			zwp_linux_surface_synchronization_v1_get_release(
+				lc->surface_sync);
+		zwp_linux_buffer_release_v1_add_listener(buffer_release,
+							 &buffer_release_listener,
+							 released);
+	}
+
+	wl_surface_attach(lc->surface, buffer, 0, 0);
+	wl_surface_damage_buffer(lc->surface, 0, 0, 1, 1);
+	if (frame)
+		frame_callback_set(lc->surface, frame);
+	wl_surface_commit(lc->surface);
+}
+
+static void
+check_screen_color(struct latch_client *lc, uint32_t xrgb)
+{
+	struct buffer *shot;
+	struct image_header ih;
+	uint32_t pixel;
+
+	shot = capture_screenshot_of_output(lc->client, NULL);
+	ih = image_header_from(shot->image);
+	pixel = image_header_get_row_u32(&ih, SURFACE_SIZE / 2)[SURFACE_SIZE / 2];
+
+	testlog("pixel 0x%08x, expected 0x%08x\n", pixel, xrgb);
+	assert((pixel & 0xffffff) == (xrgb & 0xffffff));
+
+	buffer_destroy(shot);
+}
+
+TEST(commit_is_held_until_fence_signals)
+{
+	struct latch_client *lc = latch_client_create();
+	struct wl_buffer *red = create_solid_buffer(lc, 0xff0000);
+	struct wl_buffer *green = create_solid_buffer(lc, 0x00ff00);
+	int timeline = timeline_create();
+	int frame;
+
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+
+	commit_buffer(lc, green, timeline_create_fence(timeline, 1),
+		      NULL, &frame);
+	client_roundtrip(lc->client);
+
+	/* Repaints keep showing the previous buffer */
+	check_screen_color(lc, 0xff0000);
+	assert(!frame);
+
+	timeline_advance(timeline);
+	frame_callback_wait(lc->client, &frame);
+	check_screen_color(lc, 0x00ff00);
+
+	close(timeline);
+	wl_buffer_destroy(green);
+	wl_buffer_destroy(red);
+	latch_client_destroy(lc);
+}
+
+TEST(ready_buffer_skips_older_unsignalled_one)
+{
+	struct latch_client *lc = latch_client_create();
+	struct wl_buffer *red = create_solid_buffer(lc, 0xff0000);
+	struct wl_buffer *green = create_solid_buffer(lc, 0x00ff00);
+	struct wl_buffer *blue = create_solid_buffer(lc, 0x0000ff);
+	int timeline = timeline_create();
+	int ready_timeline = timeline_create();
+	int green_released, blue_released;
+	int frame, green_frame;
+	int fence;
+
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+
+	commit_buffer(lc, green, timeline_create_fence(timeline, 1),
+		      &green_released, &green_frame);
+
+	/* Already signalled by the time it is committed */
+	fence = timeline_create_fence(ready_timeline, 1);
+	timeline_advance(ready_timeline);
+	commit_buffer(lc, blue, fence, &blue_released, &frame);
+
+	frame_callback_wait(lc->client, &frame);
+	check_screen_color(lc, 0x0000ff);
+
+	/* The frame callback of the skipped commit goes with the one that
+	 * replaced it, and its buffer is released without being shown. */
+	assert(green_frame);
+	assert(green_released == 1);
+
+	/* Signalling the skipped buffer changes nothing */
+	timeline_advance(timeline);
+	client_roundtrip(lc->client);
+	assert(green_released == 1);
+	check_screen_color(lc, 0x0000ff);
+
+	/* The shown buffer is released once, when it is replaced at the
+	 * latest */
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+	assert(blue_released == 1);
+
+	close(ready_timeline);
+	close(timeline);
+	wl_buffer_destroy(blue);
+	wl_buffer_destroy(green);
+	wl_buffer_destroy(red);
+	latch_client_destroy(lc);
+}
+
+TEST(queue_is_flushed_when_surface_gains_subsurface)
+{
+	struct latch_client *lc = latch_client_create();
+	struct wl_buffer *red = create_solid_buffer(lc, 0xff0000);
+	struct wl_buffer *green = create_solid_buffer(lc, 0x00ff00);
+	struct wl_subcompositor *subco;
+	struct wl_subsurface *sub;
+	struct wl_surface *child;
+	int timeline = timeline_create();
+	int frame, green_frame;
+
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+
+	commit_buffer(lc, green, timeline_create_fence(timeline, 1),
+		      NULL, &green_frame);
+	client_roundtrip(lc->client);
+	assert(!green_frame);
+
+	subco = bind_to_singleton_global(lc->client,
+					 &wl_subcompositor_interface, 1);
+	child = wl_compositor_create_surface(lc->client->wl_compositor);
+	sub = wl_subcompositor_get_subsurface(subco, child, lc->surface);
+
+	/* The next commit of the parent applies the queue, fence or not */
+	frame_callback_set(lc->surface, &frame);
+	wl_surface_commit(lc->surface);
+	frame_callback_wait(lc->client, &frame);
+	assert(green_frame);
+	check_screen_color(lc, 0x00ff00);
+
+	timeline_advance(timeline);
+	client_roundtrip(lc->client);
+
+	wl_subsurface_destroy(sub);
+	wl_surface_destroy(child);
+	wl_subcompositor_destroy(subco);
+	close(timeline);
+	wl_buffer_destroy(green);
+	wl_buffer_destroy(red);
+	latch_client_destroy(lc);
+}
+
+TEST(surface_destroyed_with_queued_commits)
+{
+	struct latch_client *lc = latch_client_create();
+	struct wl_buffer *red = create_solid_buffer(lc, 0xff0000);
+	struct wl_buffer *green = create_solid_buffer(lc, 0x00ff00);
+	struct wl_buffer *blue = create_solid_buffer(lc, 0x0000ff);
+	int timeline = timeline_create();
+	int green_released, blue_released;
+	int frame;
+
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+
+	commit_buffer(lc, green, timeline_create_fence(timeline, 1),
+		      &green_released, NULL);
+	commit_buffer(lc, blue, timeline_create_fence(timeline, 2),
+		      &blue_released, NULL);
+	client_roundtrip(lc->client);
+	assert(green_released == 0);
+	assert(blue_released == 0);
+
+	zwp_linux_surface_synchronization_v1_destroy(lc->surface_sync);
+	lc->surface_sync = NULL;
+	wl_surface_destroy(lc->surface);
+	lc->client->surface->wl_surface = NULL;
+	client_roundtrip(lc->client);
+
+	/* The queued buffers are released without being shown */
+	assert(green_released == 1);
+	assert(blue_released == 1);
+
+	/* The fences of the discarded commits are not waited on anymore */
+	timeline_advance(timeline);
+	timeline_advance(timeline);
+	client_roundtrip(lc->client);
+
+	close(timeline);
+	wl_buffer_destroy(blue);
+	wl_buffer_destroy(green);
+	wl_buffer_destroy(red);
+	latch_client_destroy(lc);
+}
+
+struct toplevel {
+	struct xdg_wm_base *wm_base;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	bool configured;
+	uint32_t configure_serial;
+	int32_t width, height;
+	bool maximized;
+};
+
+static void
+wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void
+xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+		      uint32_t serial)
+{
+	struct toplevel *tl = data;
+
+	tl->configure_serial = serial;
+	tl->configured = true;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void
+xdg_toplevel_configure(void *data, struct xdg_toplevel *xdg_toplevel,
+		       int32_t width, int32_t height, struct wl_array *states)
+{
+	struct toplevel *tl = data;
+	uint32_t *state;
+
+	tl->width = width;
+	tl->height = height;
+	tl->maximized = false;
+	wl_array_for_each(state, states) {
+		if (*state == XDG_TOPLEVEL_STATE_MAXIMIZED)
+			tl->maximized = true;
+	}
+}
+
+static void
+xdg_toplevel_close(void *data, struct xdg_toplevel *xdg_toplevel)
+{
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_configure,
+	.close = xdg_toplevel_close,
+};
+
+static void
+toplevel_wait_configure(struct latch_client *lc, struct toplevel *tl)
+{
+	tl->configured = false;
+	while (!tl->configured)
+		assert(wl_display_dispatch(lc->client->wl_display) >= 0);
+}
+
+static void
+toplevel_init(struct toplevel *tl, struct latch_client *lc)
+{
+	tl->wm_base = bind_to_singleton_global(lc->client,
+					       &xdg_wm_base_interface, 1);
+	xdg_wm_base_add_listener(tl->wm_base, &wm_base_listener, tl);
+
+	tl->xdg_surface = xdg_wm_base_get_xdg_surface(tl->wm_base,
+						      lc->surface);
+	xdg_surface_add_listener(tl->xdg_surface, &xdg_surface_listener, tl);
+	tl->xdg_toplevel = xdg_surface_get_toplevel(tl->xdg_surface);
+	xdg_toplevel_add_listener(tl->xdg_toplevel, &xdg_toplevel_listener,
+				  tl);
+
+	wl_surface_commit(lc->surface);
+	toplevel_wait_configure(lc, tl);
+	xdg_surface_ack_configure(tl->xdg_surface, tl->configure_serial);
+}
+
+static void
+toplevel_fini(struct toplevel *tl)
+{
+	xdg_toplevel_destroy(tl->xdg_toplevel);
+	xdg_surface_destroy(tl->xdg_surface);
+	xdg_wm_base_destroy(tl->wm_base);
+}
+
+TEST(xdg_toplevel_commit_is_not_held_back)
+{
+	struct latch_client *lc = latch_client_create_without_role();
+	struct wl_buffer *red = create_solid_buffer(lc, 0xff0000);
+	struct wl_buffer *green = create_solid_buffer(lc, 0x00ff00);
+	struct wl_buffer *blue = create_solid_buffer(lc, 0x0000ff);
+	struct toplevel tl = {};
+	int timeline = timeline_create();
+	int frame;
+
+	toplevel_init(&tl, lc);
+	commit_buffer(lc, red, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+
+	xdg_toplevel_set_maximized(tl.xdg_toplevel);
+	toplevel_wait_configure(lc, &tl);
+	assert(tl.maximized);
+	assert(tl.width > SURFACE_SIZE && tl.height > SURFACE_SIZE);
+
+	/* Still at the old size, as that configure is not acked yet */
+	commit_buffer(lc, green, timeline_create_fence(timeline, 1),
+		      NULL, NULL);
+
+	/* If the commit above were held back, it would be applied along
+	 * with the maximized state acked here, and its size would not
+	 * match that state: the client would be disconnected. */
+	xdg_surface_ack_configure(tl.xdg_surface, tl.configure_serial);
+	wp_viewport_set_destination(lc->viewport, tl.width, tl.height);
+	commit_buffer(lc, blue, -1, NULL, &frame);
+	frame_callback_wait(lc->client, &frame);
+	check_screen_color(lc, 0x0000ff);
+
+	timeline_advance(timeline);
+	client_roundtrip(lc->client);
+	check_screen_color(lc, 0x0000ff);
+
+	close(timeline);
+	toplevel_fini(&tl);
+	wl_buffer_destroy(blue);
+	wl_buffer_destroy(green);
+	wl_buffer_destroy(red);
+	latch_client_destroy(lc);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define OCCLUDED_FRAME_INTERVAL 400 /* ms */
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = WESTON_RENDERER_PIXMAN;
+	setup.width = 320;
+	setup.height = 240;
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	weston_ini_setup(&setup,
+			 cfgln("[shell]"),
+			 cfgln("occluded-frame-interval=%d",
+			       OCCLUDED_FRAME_INTERVAL));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static struct surface *
+create_mapped_surface(struct client *client, int x, int y,
+		      int width, int height)
+{
+	struct surface *surface;
+	struct rectangle opaque = { 0, 0, width, height };
+	int done;
+
+	surface = create_test_surface(client);
+	surface->width = width;
+	surface->height = height;
+	surface->buffer = create_shm_buffer_a8r8g8b8(client, width, height);
+	surface_set_opaque_rect(surface, &opaque);
+
+	weston_test_move_surface(client->test->weston_test,
+				 surface->wl_surface, x, y);
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0, width, height);
+	frame_callback_set(surface->wl_surface, &done);
+	wl_surface_commit(surface->wl_surface);
+	frame_callback_wait(client, &done);
+
+	return surface;
+}
+
+static void
+surface_commit_with_frame(struct surface *surface, int *done)
+{
+	wl_surface_attach(surface->wl_surface, surface->buffer->proxy, 0, 0);
+	wl_surface_damage(surface->wl_surface, 0, 0,
+			  surface->width, surface->height);
+	frame_callback_set(surface->wl_surface, done);
+	wl_surface_commit(surface->wl_surface);
+	wl_display_flush(surface->client->wl_display);
+}
+
+/*
+ * Two surfaces completely hidden behind an opaque one start being
+ * throttled half an interval apart. Each must be held for a full interval
+ * from its own commit, not released together with the one that started
+ * the throttle timer.
+ */
+TEST(occluded_surfaces_are_held_for_their_own_interval)
+{
+	struct client *client;
+	struct surface *first, *second, *cover;
+	struct timespec first_commit, second_commit, now;
+	int64_t first_held = -1, second_held = -1;
+	int first_done, second_done;
+
+	client = create_client();
+
+	first = create_mapped_surface(client, 20, 20, 100, 100);
+	second = create_mapped_surface(client, 140, 20, 100, 100);
+	/* Stacked on top of both */
+	cover = create_mapped_surface(client, 0, 0, 320, 240);
+
+	surface_commit_with_frame(first, &first_done);
+	clock_gettime(CLOCK_MONOTONIC, &first_commit);
+
+	usleep(OCCLUDED_FRAME_INTERVAL / 2 * 1000);
+
+	surface_commit_with_frame(second, &second_done);
+	clock_gettime(CLOCK_MONOTONIC, &second_commit);
+
+	while (first_held < 0 || second_held < 0) {
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if (first_done && first_held < 0)
+			first_held = timespec_sub_to_msec(&now, &first_commit);
+		if (second_done && second_held < 0)
+			second_held = timespec_sub_to_msec(&now, &second_commit);
+	}
+
+	testlog("frame callbacks held for %" PRId64 " ms and %" PRId64 " ms\n",
+		first_held, second_held);
+
+	assert(first_held >= OCCLUDED_FRAME_INTERVAL);
+	assert(second_held >= OCCLUDED_FRAME_INTERVAL);
+
+	surface_destroy(cover);
+	surface_destroy(second);
+	surface_destroy(first);
+	client_destroy(client);
+}
+
+/*
+ * A surface which is not occluded gets its frame callbacks with the
+ * output repaint.
+ */
+TEST(visible_surface_is_not_held)
+{
+	struct client *client;
+	struct surface *surface;
+	struct timespec commit, now;
+	int done;
+
+	client = create_client();
+	surface = create_mapped_surface(client, 20, 20, 100, 100);
+
+	surface_commit_with_frame(surface, &done);
+	clock_gettime(CLOCK_MONOTONIC, &commit);
+	frame_callback_wait(client, &done);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	assert(timespec_sub_to_msec(&now, &commit) < OCCLUDED_FRAME_INTERVAL);
+
+	surface_destroy(surface);
+	client_destroy(client);
+}
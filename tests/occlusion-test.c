@@ -0,0 +1,199 @@
+/*
+ * Copyright 2026 The Weston contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <libweston/libweston.h>
+#include "libweston-internal.h"
+#include "compositor/weston.h"
+#include "weston-test-runner.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+
+	return weston_test_harness_execute_as_plugin(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+struct solid_view {
+	struct weston_buffer_reference *buffer_ref;
+	struct weston_surface *surface;
+	struct weston_view *view;
+};
+
+static void
+solid_view_create(struct solid_view *sv, struct weston_layer *layer,
+		  float alpha, int x, int y, int width, int height)
+{
+	struct weston_compositor *compositor = layer->compositor;
+
+	sv->surface = weston_surface_create(compositor);
+	assert(sv->surface);
+	sv->view = weston_view_create(sv->surface);
+	assert(sv->view);
+	sv->buffer_ref = weston_buffer_create_solid_rgba(compositor,
+							 0.0, 0.0, 1.0, alpha);
+	assert(sv->buffer_ref);
+
+	weston_surface_attach_solid(sv->surface, sv->buffer_ref,
+				    width, height);
+	weston_surface_map(sv->surface);
+
+	/* Each new view goes on top of the previous ones */
+	weston_layer_entry_insert(&layer->view_list, &sv->view->layer_link);
+	weston_view_set_position(sv->view, x, y);
+	weston_view_update_transform(sv->view);
+}
+
+static void
+solid_view_destroy(struct solid_view *sv)
+{
+	/* Destroys the view too. */
+	weston_surface_unref(sv->surface);
+	weston_buffer_destroy_solid(sv->buffer_ref);
+}
+
+/* Repaint the output as far as the core goes, without the renderer, and
+ * report whether the damage of the bottom view reached the output. */
+static bool
+repaint_damage_of(struct weston_output *output, struct solid_view *bottom,
+		  struct weston_paint_node **pnode_out)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_output_scene *scene;
+	bool damaged;
+
+	/* Flush whatever the views had when they were created */
+	scene = weston_output_update_scene(output);
+	weston_output_accumulate_damage(output, scene);
+	pixman_region32_clear(&compositor->primary_plane.damage);
+
+	weston_surface_damage(bottom->surface);
+
+	scene = weston_output_update_scene(output);
+	*pnode_out = weston_view_find_paint_node(bottom->view, output);
+	assert(*pnode_out);
+	weston_output_accumulate_damage(output, scene);
+
+	damaged = pixman_region32_not_empty(&compositor->primary_plane.damage);
+	pixman_region32_clear(&compositor->primary_plane.damage);
+
+	return damaged;
+}
+
+PLUGIN_TEST(covered_view_is_not_repainted)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	struct weston_paint_node *pnode;
+	struct weston_layer layer;
+	struct solid_view bottom, top;
+	bool damaged;
+
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	solid_view_create(&bottom, &layer, 1.0, 50, 50, 100, 100);
+	solid_view_create(&top, &layer, 1.0, 0, 0, 200, 200);
+
+	damaged = repaint_damage_of(output, &bottom, &pnode);
+
+	/* The renderer skips occluded nodes */
+	assert(pnode->occluded);
+	assert(!damaged);
+
+	/* The damage is kept for when the view shows up again */
+	assert(pixman_region32_not_empty(&bottom.surface->damage));
+
+	solid_view_destroy(&top);
+	solid_view_destroy(&bottom);
+	weston_layer_fini(&layer);
+}
+
+PLUGIN_TEST(view_under_translucent_view_is_repainted)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	struct weston_paint_node *pnode;
+	struct weston_layer layer;
+	struct solid_view bottom, top;
+	bool damaged;
+
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	solid_view_create(&bottom, &layer, 1.0, 50, 50, 100, 100);
+	solid_view_create(&top, &layer, 0.5, 0, 0, 200, 200);
+
+	damaged = repaint_damage_of(output, &bottom, &pnode);
+
+	assert(!pnode->occluded);
+	assert(damaged);
+	assert(!pixman_region32_not_empty(&bottom.surface->damage));
+
+	solid_view_destroy(&top);
+	solid_view_destroy(&bottom);
+	weston_layer_fini(&layer);
+}
+
+PLUGIN_TEST(partly_covered_view_is_repainted)
+{
+	/* struct weston_compositor *compositor; */
+	struct weston_output *output;
+	struct weston_paint_node *pnode;
+	struct weston_layer layer;
+	struct solid_view bottom, top;
+	bool damaged;
+
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	weston_layer_init(&layer, compositor);
+	weston_layer_set_position(&layer, WESTON_LAYER_POSITION_NORMAL);
+
+	solid_view_create(&bottom, &layer, 1.0, 50, 50, 100, 100);
+	solid_view_create(&top, &layer, 1.0, 0, 0, 100, 200);
+
+	damaged = repaint_damage_of(output, &bottom, &pnode);
+
+	assert(!pnode->occluded);
+	assert(damaged);
+
+	solid_view_destroy(&top);
+	solid_view_destroy(&bottom);
+	weston_layer_fini(&layer);
+}
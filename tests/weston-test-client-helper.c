@@ -267,6 +267,7 @@ keyboard_handle_enter(void *data, struct wl_keyboard *wl_keyboard,
 {
 	struct keyboard *keyboard = data;
 
+	keyboard->serial = serial;
 	if (wl_surface)
 		keyboard->focus = wl_surface_get_user_data(wl_surface);
 	else
@@ -118,6 +118,7 @@ struct pointer {
 struct keyboard {
 	struct wl_keyboard *wl_keyboard;
 	struct surface *focus;
+	uint32_t serial;
 	uint32_t key;
 	uint32_t state;
 	uint32_t mods_depressed;
@@ -123,6 +123,17 @@ static void
 desktop_surface_maximized_requested(struct weston_desktop_surface *desktop_surface,
 				    bool maximized, void *shell)
 {
+	struct weston_surface *surface =
+		weston_desktop_surface_get_surface(desktop_surface);
+	struct weston_output *output =
+		weston_shell_utils_get_default_output(surface->compositor);
+
+	weston_desktop_surface_set_maximized(desktop_surface, maximized);
+	if (maximized && output)
+		weston_desktop_surface_set_size(desktop_surface,
+						output->width, output->height);
+	else
+		weston_desktop_surface_set_size(desktop_surface, 0, 0);
 }
 
 static void
@@ -187,6 +198,8 @@ wet_shell_init(struct weston_compositor *ec,
 	       int *argc, char *argv[])
 {
 	struct desktest_shell *dts;
+	struct weston_config_section *section;
+	uint32_t occluded_frame_interval;
 	struct weston_curtain_params background_params = {
 		.r = 0.16, .g = 0.32, .b = 0.48, .a = 1.0,
 		.x = 0, .y = 0, .width = 2000, .height = 2000,
@@ -233,6 +246,13 @@ wet_shell_init(struct weston_compositor *ec,
 
 	screenshooter_create(ec);
 
+	section = weston_config_get_section(wet_get_config(ec),
+					    "shell", NULL, NULL);
+	weston_config_section_get_uint(section, "occluded-frame-interval",
+				       &occluded_frame_interval, 0);
+	weston_compositor_set_occluded_frame_interval(ec,
+						      occluded_frame_interval);
+
 	return 0;
 
 out_view:
@@ -198,6 +198,7 @@ compositor_setup_defaults_(struct compositor_setup *setup,
 		.config_file = NULL,
 		.extra_module = NULL,
 		.logging_scopes = NULL,
+		.backend_args = NULL,
 		.testset_name = testset_name,
 	};
 }
@@ -279,6 +280,7 @@ execute_compositor(const struct compositor_setup *setup,
 	const char *drm_device;
 	int lock_fd = -1;
 	int ret = RESULT_OK;
+	int i;
 
 	prog_args_init(&args);
 
@@ -319,6 +321,9 @@ execute_compositor(const struct compositor_setup *setup,
 		prog_args_take(&args, tmp);
 	}
 
+	for (i = 0; setup->backend_args && setup->backend_args[i]; i++)
+		prog_args_take(&args, strdup(setup->backend_args[i]));
+
 	if (setup->config_file) {
 		str_printf(&tmp, "--config=%s", setup->config_file);
 		prog_args_take(&args, tmp);
@@ -84,6 +84,9 @@ struct compositor_setup {
 	/** Debug scopes for the compositor log,
 	 * or NULL for compositor defaults. */
 	const char *logging_scopes;
+	/** Extra command line options for the backend, terminated by NULL,
+	 * or NULL for none. */
+	const char * const *backend_args;
 	/** The name of this test program, used as a unique identifier. */
 	const char *testset_name;
 };
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# encoding=utf-8
+# Copyright © 2026 The Weston contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+"""Decode a Weston flight recorder file.
+
+The file is written by 'weston --flight-rec-file=FILE', the format is
+described at the top of libweston/weston-log-flight-rec.c. It can be decoded
+after the compositor crashed, or while it is still running. Each record is
+printed with its time and scope, oldest first.
+"""
+
+import argparse
+import datetime
+import struct
+import sys
+
+MAGIC = b'WFLTREC1'
+ALIGN = 8
+
+# struct flight_rec_file_header without the scope names, host byte order
+HEADER = struct.Struct('=8sIIQQqII')
+SCOPES_MAX = 64
+SCOPE_NAME_LEN = 32
+
+# struct flight_rec_record
+RECORD = struct.Struct('=QQIHH')
+
+
+def align(n):
+    return (n + ALIGN - 1) & ~(ALIGN - 1)
+
+
+def read_records(data):
+    (magic, header_size, record_size, ring_size, head, realtime_offset,
+     scope_count, _) = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError('not a Weston flight recorder file')
+    if record_size != RECORD.size:
+        raise ValueError('unsupported record size %u' % record_size)
+
+    scopes = []
+    for i in range(min(scope_count, SCOPES_MAX)):
+        start = HEADER.size + i * SCOPE_NAME_LEN
+        name = data[start:start + SCOPE_NAME_LEN].split(b'\0', 1)[0]
+        scopes.append(name.decode('utf-8', 'replace'))
+
+    ring = data[header_size:header_size + ring_size]
+    pos = head - ring_size if head > ring_size else 0
+    while pos < head:
+        off = pos % ring_size
+        if off + RECORD.size > ring_size:
+            pos += ring_size - off
+            continue
+
+        rec_pos, time_ns, length, scope, _ = RECORD.unpack_from(ring, off)
+        total = align(RECORD.size + length)
+        if rec_pos != pos or off + total > ring_size:
+            pos += ALIGN
+            continue
+
+        msg = ring[off + RECORD.size:off + RECORD.size + length]
+        if scope < len(scopes):
+            name = scopes[scope]
+        else:
+            name = '?'
+        yield (time_ns, time_ns + realtime_offset, name, msg)
+        pos += total
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('file', help='flight recorder file written by weston')
+    parser.add_argument('-s', '--scope', action='append',
+                        help='only print this scope, can be repeated')
+    args = parser.parse_args()
+
+    with open(args.file, 'rb') as f:
+        data = f.read()
+
+    out = sys.stdout
+    for time_ns, real_ns, scope, msg in read_records(data):
+        if args.scope and scope not in args.scope:
+            continue
+        when = datetime.datetime.fromtimestamp(real_ns / 1e9)
+        text = msg.decode('utf-8', 'replace').rstrip('\n')
+        for line in text.split('\n'):
+            out.write('%s.%06u %-16s %s\n' % (when.strftime('%H:%M:%S'),
+                                              when.microsecond, scope, line))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+# encoding=utf-8
+# Copyright © 2026 The Weston contributors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+"""Convert a binary Weston timeline trace to Chrome trace event JSON.
+
+The trace is written by 'weston --timeline-trace=FILE', the format is
+described with struct weston_timeline_record in libweston/timeline.h. The
+output can be loaded into Perfetto (ui.perfetto.dev) or chrome://tracing.
+Each output gets its own track, points without an output go on track 0.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b'WTLTRC01'
+
+WTR_POINT = 1
+WTR_NAME = 2
+WTR_OUTPUT = 3
+WTR_SURFACE = 4
+
+# struct weston_timeline_record, host byte order
+RECORD = struct.Struct('=HHIQIIQQ')
+
+
+def read_records(data):
+    pos = len(MAGIC)
+    while pos + RECORD.size <= len(data):
+        rtype, length, rid, time_ns, output, surface, vblank_ns, gpu_ns = \
+            RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        text = data[pos:pos + length].split(b'\0', 1)[0].decode(
+            'utf-8', 'replace')
+        pos += length
+        yield (rtype, rid, time_ns, output, surface, vblank_ns, gpu_ns, text)
+
+
+def convert(data):
+    if not data.startswith(MAGIC):
+        raise ValueError('not a Weston timeline trace')
+
+    names = {}
+    surfaces = {}
+    events = []
+    pid = 1
+
+    def us(ns):
+        return ns / 1000.0
+
+    for (rtype, rid, time_ns, output, surface, vblank_ns, gpu_ns,
+         text) in read_records(data):
+        if rtype == WTR_NAME:
+            names[rid] = text
+        elif rtype == WTR_OUTPUT:
+            events.append({'ph': 'M', 'name': 'thread_name', 'pid': pid,
+                           'tid': rid, 'args': {'name': text or
+                                                'output %u' % rid}})
+        elif rtype == WTR_SURFACE:
+            surfaces[rid] = {'desc': text, 'main_surface': output or None}
+        elif rtype == WTR_POINT:
+            args = {}
+            if surface:
+                args['surface'] = surface
+                desc = surfaces.get(surface, {}).get('desc')
+                if desc:
+                    args['surface_desc'] = desc
+            if vblank_ns:
+                args['vblank_ns'] = vblank_ns
+            if gpu_ns:
+                args['gpu_ns'] = gpu_ns
+            events.append({'ph': 'i', 's': 't', 'pid': pid, 'tid': output,
+                           'name': names.get(rid, 'point %u' % rid),
+                           'ts': us(time_ns), 'args': args})
+            # Show GPU and vblank times where they happened, too.
+            if gpu_ns:
+                events.append({'ph': 'i', 's': 't', 'pid': pid,
+                               'tid': output, 'name': 'gpu',
+                               'ts': us(gpu_ns)})
+            if vblank_ns:
+                events.append({'ph': 'i', 's': 't', 'pid': pid,
+                               'tid': output, 'name': 'vblank',
+                               'ts': us(vblank_ns)})
+
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('trace', help='binary trace written by weston')
+    parser.add_argument('output', nargs='?', help='JSON file, default stdout')
+    args = parser.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        result = convert(f.read())
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f)
+    else:
+        json.dump(result, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
@@ -43,49 +43,102 @@
 #define wm_log(...) do {} while (0)
 #endif
 
+/* Upper bound for the selection data buffered in the compositor at any
+ * time, in either direction: X properties are read and written at most
+ * this many bytes at a time. */
+static const size_t incr_chunk_size = 64 * 1024;
+
+static xcb_get_property_reply_t *
+weston_wm_get_selection_piece(struct weston_wm *wm)
+{
+	xcb_get_property_cookie_t cookie;
+
+	cookie = xcb_get_property(wm->conn,
+				  0, /* delete */
+				  wm->selection_window,
+				  wm->atom.wl_selection,
+				  XCB_GET_PROPERTY_TYPE_ANY,
+				  wm->property_offset / 4, /* offset */
+				  incr_chunk_size / 4 /* length */);
+
+	return xcb_get_property_reply(wm->conn, cookie, NULL);
+}
+
+static void
+weston_wm_end_property_write(struct weston_wm *wm)
+{
+	free(wm->property_reply);
+	wm->property_reply = NULL;
+	wm->property_offset = 0;
+	if (wm->property_source)
+		wl_event_source_remove(wm->property_source);
+	wm->property_source = NULL;
+}
+
 static int
 writable_callback(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
 	unsigned char *property;
-	int len, remainder;
+	int len, length, remainder;
+	bool more;
+
+	/* The property is consumed one piece at a time, and the next
+	 * piece is only fetched once the target has taken the previous
+	 * one, so a slow reader never makes us buffer the whole
+	 * property. */
+	if (wm->property_reply == NULL) {
+		wm->property_start = 0;
+		wm->property_reply = weston_wm_get_selection_piece(wm);
+		if (wm->property_reply == NULL) {
+			weston_wm_end_property_write(wm);
+			close(fd);
+			weston_log("failed to get selection property\n");
+			return 1;
+		}
+	}
 
 	property = xcb_get_property_value(wm->property_reply);
-	remainder = xcb_get_property_value_length(wm->property_reply) -
-		wm->property_start;
+	length = xcb_get_property_value_length(wm->property_reply);
+	remainder = length - wm->property_start;
 
 	len = write(fd, property + wm->property_start, remainder);
 	if (len == -1) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
+		if (errno == EAGAIN || errno == EINTR)
+			return 1;
+
+		weston_wm_end_property_write(wm);
 		close(fd);
 		weston_log("write error to target fd: %s\n", strerror(errno));
 		return 1;
 	}
 
-	weston_log("wrote %d (chunk size %d) of %d bytes\n",
-		wm->property_start + len,
-		len, xcb_get_property_value_length(wm->property_reply));
+	wm_log("wrote %d (chunk size %d) of %d bytes\n",
+	       wm->property_start + len, len, length);
 
 	wm->property_start += len;
-	if (len == remainder) {
-		free(wm->property_reply);
-		wm->property_reply = NULL;
-		if (wm->property_source)
-			wl_event_source_remove(wm->property_source);
-		wm->property_source = NULL;
+	if (len < remainder)
+		return 1;
 
-		if (wm->incr) {
-			xcb_delete_property(wm->conn,
-					    wm->selection_window,
-					    wm->atom.wl_selection);
-		} else {
-			weston_log("transfer complete\n");
-			close(fd);
-		}
+	more = wm->property_reply->bytes_after > 0;
+	wm->property_offset += length;
+	free(wm->property_reply);
+	wm->property_reply = NULL;
+	if (more)
+		return 1;
+
+	weston_wm_end_property_write(wm);
+
+	/* Deleting the property tells an INCR owner to send the next
+	 * chunk. */
+	xcb_delete_property(wm->conn,
+			    wm->selection_window,
+			    wm->atom.wl_selection);
+	xcb_flush(wm->conn);
+
+	if (!wm->incr) {
+		weston_log("transfer complete\n");
+		close(fd);
 	}
 
 	return 1;
@@ -96,34 +149,23 @@ weston_wm_write_property(struct weston_wm *wm, xcb_get_property_reply_t *reply)
 {
 	wm->property_start = 0;
 	wm->property_reply = reply;
-	writable_callback(wm->data_source_fd, WL_EVENT_WRITABLE, wm);
-
-	if (wm->property_reply)
-		wm->property_source =
-			wl_event_loop_add_fd(wm->server->loop,
-					     wm->data_source_fd,
-					     WL_EVENT_WRITABLE,
-					     writable_callback, wm);
+	wm->property_source =
+		wl_event_loop_add_fd(wm->server->loop,
+				     wm->data_source_fd,
+				     WL_EVENT_WRITABLE,
+				     writable_callback, wm);
 }
 
 static void
 weston_wm_get_incr_chunk(struct weston_wm *wm)
 {
-	xcb_get_property_cookie_t cookie;
 	xcb_get_property_reply_t *reply;
 	FILE *fp;
 	char *logstr;
 	size_t logsize;
 
-	cookie = xcb_get_property(wm->conn,
-				  0, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  0x1fffffff /* length */);
-
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
+	wm->property_offset = 0;
+	reply = weston_wm_get_selection_piece(wm);
 	if (reply == NULL)
 		return;
 
@@ -260,21 +302,13 @@ weston_wm_get_selection_targets(struct weston_wm *wm)
 static void
 weston_wm_get_selection_data(struct weston_wm *wm)
 {
-	xcb_get_property_cookie_t cookie;
 	xcb_get_property_reply_t *reply;
 	FILE *fp;
 	char *logstr;
 	size_t logsize;
 
-	cookie = xcb_get_property(wm->conn,
-				  1, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  0x1fffffff /* length */);
-
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
+	wm->property_offset = 0;
+	reply = weston_wm_get_selection_piece(wm);
 
 	fp = open_memstream(&logstr, &logsize);
 	if (fp) {
@@ -289,6 +323,11 @@ weston_wm_get_selection_data(struct weston_wm *wm)
 	} else if (reply->type == wm->atom.incr) {
 		wm->incr = 1;
 		free(reply);
+		/* Deleting the INCR property starts the transfer. */
+		xcb_delete_property(wm->conn,
+				    wm->selection_window,
+				    wm->atom.wl_selection);
+		xcb_flush(wm->conn);
 	} else {
 		wm->incr = 0;
 		/* reply's ownership is transferred to wm, which is responsible
@@ -313,8 +352,6 @@ weston_wm_handle_selection_notify(struct weston_wm *wm,
 	}
 }
 
-static const size_t incr_chunk_size = 64 * 1024;
-
 static void
 weston_wm_send_selection_notify(struct weston_wm *wm, xcb_atom_t property)
 {
@@ -418,8 +455,8 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 		return 1;
 	}
 
-	weston_log("read %d (available %d, mask 0x%x) bytes: \"%.*s\"\n",
-		len, available, mask, len, (char *) p);
+	wm_log("read %d (available %d, mask 0x%x) bytes\n",
+	       len, available, mask);
 
 	wm->source_data.size = current + len;
 	if (wm->source_data.size >= incr_chunk_size) {
@@ -82,6 +82,7 @@ struct weston_wm {
 	struct wl_event_source *property_source;
 	xcb_get_property_reply_t *property_reply;
 	int property_start;
+	uint32_t property_offset;
 	struct wl_array source_data;
 	xcb_selection_request_event_t selection_request;
 	xcb_atom_t selection_target;